@@ -10,13 +10,17 @@
 #include <bootdev.h>
 #include <bootflow.h>
 #include <bootmeth.h>
+#include <bootstage.h>
 #include <bootstd.h>
 #include <fs.h>
+#include <init.h>
 #include <log.h>
 #include <malloc.h>
 #include <part.h>
 #include <sort.h>
 #include <spl.h>
+#include <time.h>
+#include <uthread.h>
 #include <dm/device-internal.h>
 #include <dm/lists.h>
 #include <dm/uclass-internal.h>
@@ -31,8 +35,30 @@ enum {
 
 	/* Maximum supported length of the "boot_targets" env string */
 	BOOT_TARGETS_MAX_LEN	= 100,
+
+	/* Maximum number of hunters, one for each bit in hunters_used */
+	BOOTDEV_MAX_HUNTERS	= 32,
 };
 
+/**
+ * struct bootdev_hunt_job - state of a bootdev hunter
+ *
+ * @info: Hunter to run
+ * @seq: Position of the hunter in the linker list
+ * @show: true to show progress while hunting
+ * @busy: true while the hunter is running in its own thread
+ * @ret: Result of the hunter, when run in its own thread
+ * @stage: Bootstage names for the start and end of hunting
+ */
+static struct bootdev_hunt_job {
+	struct bootdev_hunter *info;
+	uint seq;
+	bool show;
+	bool busy;
+	int ret;
+	char stage[2][24];
+} hunt_job[BOOTDEV_MAX_HUNTERS];
+
 int bootdev_first_bootflow(struct udevice *dev, struct bootflow **bflowp)
 {
 	struct bootstd_priv *std;
@@ -782,6 +808,166 @@ int bootdev_setup_iter(struct bootflow_iter *iter, const char *label,
 	return 0;
 }
 
+/* Runs a hunter, marking the start and end of hunting in bootstage */
+static int bootdev_run_hunter(struct bootdev_hunter *info, uint seq, bool show)
+{
+	const char *name = uclass_get_name(info->uclass);
+	struct bootdev_hunt_job *job;
+	int ret;
+
+	if (seq >= BOOTDEV_MAX_HUNTERS)
+		return info->hunt(info, show);
+
+	job = &hunt_job[seq];
+	if (!*job->stage[0]) {
+		snprintf(job->stage[0], sizeof(job->stage[0]), "hunt_%s", name);
+		snprintf(job->stage[1], sizeof(job->stage[1]), "hunt_%s_done",
+			 name);
+	}
+	bootstage_mark_name(BOOTSTAGE_ID_ALLOC, job->stage[0]);
+	ret = info->hunt(info, show);
+	bootstage_mark_name(BOOTSTAGE_ID_ALLOC, job->stage[1]);
+
+	return ret;
+}
+
+#if IS_ENABLED(CONFIG_BOOTDEV_HUNT_PARALLEL)
+/* Thread group of the hunters which are running, 0 if none */
+static uint hunt_grp;
+
+/* Time when the hunters which are running were started */
+static ulong hunt_start;
+
+/* true if PCI has been set up for the hunters which are running */
+static bool hunt_pci;
+
+bool bootdev_hunt_expired(void)
+{
+	return CONFIG_BOOTDEV_HUNT_TIMEOUT && hunt_grp &&
+		get_timer(hunt_start) >= CONFIG_BOOTDEV_HUNT_TIMEOUT;
+}
+
+/* Check whether a hunter finds its devices on PCI */
+static bool bootdev_hunter_uses_pci(struct bootdev_hunter *info)
+{
+	switch (info->uclass) {
+	case UCLASS_ETH:
+	case UCLASS_NVME:
+	case UCLASS_SCSI:
+	case UCLASS_VIRTIO:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static void bootdev_hunt_thread(void *arg)
+{
+	struct bootdev_hunt_job *job = arg;
+	struct bootstd_priv *std;
+
+	job->ret = bootdev_run_hunter(job->info, job->seq, job->show);
+	log_debug("  - hunt %s result %d\n",
+		  uclass_get_name(job->info->uclass), job->ret);
+	if ((!job->ret || job->ret == -ENOENT) && !bootstd_get_priv(&std)) {
+		std->hunters_used |= BIT(job->seq);
+		job->ret = 0;
+	}
+	job->busy = false;
+}
+
+/**
+ * bootdev_hunt_spawn() - Start a hunter in its own thread
+ *
+ * @info: Hunter to start
+ * @seq: Position of the hunter in the linker list
+ * @show: true to show progress while hunting
+ * Return: 0 if the hunter is running, -EAGAIN if it must be run directly
+ */
+static int bootdev_hunt_spawn(struct bootdev_hunter *info, uint seq,
+			      bool show)
+{
+	struct bootdev_hunt_job *job;
+
+	if (seq >= BOOTDEV_MAX_HUNTERS)
+		return -EAGAIN;
+	job = &hunt_job[seq];
+	if (job->busy)
+		return 0;
+
+	/*
+	 * Hunters which use PCI could otherwise see a bus which another is
+	 * part-way through probing, so set it up before starting them
+	 */
+	if (IS_ENABLED(CONFIG_PCI) && !hunt_pci &&
+	    bootdev_hunter_uses_pci(info)) {
+		if (pci_init())
+			log_warning("Failed to init PCI\n");
+		hunt_pci = true;
+	}
+	if (!hunt_grp) {
+		hunt_grp = uthread_grp_new_id();
+		hunt_start = get_timer(0);
+	}
+	job->info = info;
+	job->seq = seq;
+	job->show = show;
+	job->ret = 0;
+	job->busy = true;
+	if (uthread_create(NULL, bootdev_hunt_thread, job, 0, hunt_grp)) {
+		job->busy = false;
+		return -EAGAIN;
+	}
+
+	return 0;
+}
+
+/**
+ * bootdev_hunt_wait() - Wait for the hunters which are running
+ *
+ * All the hunters must finish before their bootdevs are scanned and booted,
+ * since a hunter left running could probe devices while an OS is loading.
+ * Once CONFIG_BOOTDEV_HUNT_TIMEOUT has passed, hunters stop at their next
+ * wait point, so this does not wait much longer than that.
+ *
+ * Return: 0 if OK, -ve if a hunter failed
+ */
+static int bootdev_hunt_wait(void)
+{
+	int result = 0;
+	int i;
+
+	if (!hunt_grp)
+		return 0;
+	while (!uthread_grp_done(hunt_grp))
+		uthread_schedule();
+	if (bootdev_hunt_expired())
+		log_warning("Bootdev hunters stopped after %d ms\n",
+			    CONFIG_BOOTDEV_HUNT_TIMEOUT);
+	hunt_grp = 0;
+	hunt_pci = false;
+
+	for (i = 0; i < BOOTDEV_MAX_HUNTERS; i++) {
+		if (hunt_job[i].ret)
+			result = hunt_job[i].ret;
+		hunt_job[i].ret = 0;
+	}
+
+	return result;
+}
+#else
+static int bootdev_hunt_spawn(struct bootdev_hunter *info, uint seq,
+			      bool show)
+{
+	return -EAGAIN;
+}
+
+static int bootdev_hunt_wait(void)
+{
+	return 0;
+}
+#endif
+
 static int bootdev_hunt_drv(struct bootdev_hunter *info, uint seq, bool show)
 {
 	const char *name = uclass_get_name(info->uclass);
@@ -798,7 +984,10 @@ static int bootdev_hunt_drv(struct bootdev_hunter *info, uint seq, bool show)
 			       uclass_get_name(info->uclass));
 		log_debug("Hunting with: %s\n", name);
 		if (info->hunt) {
-			ret = info->hunt(info, show);
+			/* The thread marks the hunter as used when it is done */
+			if (!bootdev_hunt_spawn(info, seq, show))
+				return 0;
+			ret = bootdev_run_hunter(info, seq, show);
 			log_debug("  - hunt result %d\n", ret);
 			if (ret && ret != -ENOENT)
 				return ret;
@@ -814,7 +1003,7 @@ int bootdev_hunt(const char *spec, bool show)
 	struct bootdev_hunter *start;
 	const char *end;
 	int n_ent, i;
-	int result;
+	int result, ret;
 	size_t len;
 
 	start = ll_entry_start(struct bootdev_hunter, bootdev_hunter);
@@ -830,7 +1019,6 @@ int bootdev_hunt(const char *spec, bool show)
 	for (i = 0; i < n_ent; i++) {
 		struct bootdev_hunter *info = start + i;
 		const char *name = uclass_get_name(info->uclass);
-		int ret;
 
 		log_debug("looking at %.*s for %s\n",
 			  (int)max(strlen(name), len), spec, name);
@@ -843,10 +1031,30 @@ int bootdev_hunt(const char *spec, bool show)
 		if (ret)
 			result = ret;
 	}
+	ret = bootdev_hunt_wait();
+	if (ret)
+		result = ret;
 
 	return result;
 }
 
+const char *bootdev_get_hunter_name(struct udevice *dev)
+{
+	struct bootdev_hunter *start;
+	int n_ent, i;
+
+	start = ll_entry_start(struct bootdev_hunter, bootdev_hunter);
+	n_ent = ll_entry_count(struct bootdev_hunter, bootdev_hunter);
+	for (; dev; dev = dev_get_parent(dev)) {
+		for (i = 0; i < n_ent; i++) {
+			if (start[i].uclass == device_get_uclass_id(dev))
+				return uclass_get_name(start[i].uclass);
+		}
+	}
+
+	return NULL;
+}
+
 int bootdev_unhunt(enum uclass_id id)
 {
 	struct bootdev_hunter *start;
@@ -878,7 +1086,7 @@ int bootdev_hunt_prio(enum bootdev_prio_t prio, bool show)
 {
 	struct bootdev_hunter *start;
 	int n_ent, i;
-	int result;
+	int result, ret;
 
 	start = ll_entry_start(struct bootdev_hunter, bootdev_hunter);
 	n_ent = ll_entry_count(struct bootdev_hunter, bootdev_hunter);
@@ -887,7 +1095,6 @@ int bootdev_hunt_prio(enum bootdev_prio_t prio, bool show)
 	log_debug("Hunting for priority %d\n", prio);
 	for (i = 0; i < n_ent; i++) {
 		struct bootdev_hunter *info = start + i;
-		int ret;
 
 		if (prio != info->prio)
 			continue;
@@ -896,6 +1103,9 @@ int bootdev_hunt_prio(enum bootdev_prio_t prio, bool show)
 		if (ret && ret != -ENOENT)
 			result = ret;
 	}
+	ret = bootdev_hunt_wait();
+	if (ret)
+		result = ret;
 	log_debug("exit %d\n", result);
 
 	return result;
@@ -11,9 +11,11 @@
 #include <bootmeth.h>
 #include <bootstd.h>
 #include <dm.h>
+#include <env.h>
 #include <env_internal.h>
 #include <malloc.h>
 #include <serial.h>
+#include <u-boot/crc.h>
 #include <dm/device-internal.h>
 #include <dm/uclass-internal.h>
 
@@ -21,6 +23,9 @@
 static_assert(BOOTMETH_MAX_COUNT <=
 	      (sizeof(((struct bootflow_iter *)NULL)->method_flags) * 8));
 
+/* environment variable holding the bootflow which was last booted */
+#define BOOTFLOW_CACHE_VAR	"bootflow_cache"
+
 /* error codes used to signal running out of things */
 enum {
 	BF_NO_MORE_PARTS	= -ESHUTDOWN,
@@ -537,9 +542,9 @@ static int bootflow_check(struct bootflow_iter *iter, struct bootflow *bflow)
 	return log_msg_ret("check", ret);
 }
 
-int bootflow_scan_first(struct udevice *dev, const char *label,
-			struct bootflow_iter *iter, int flags,
-			struct bootflow *bflow)
+static int bootflow_scan_start(struct udevice *dev, const char *label,
+			       struct bootflow_iter *iter, int flags,
+			       struct bootflow *bflow)
 {
 	int ret;
 
@@ -589,10 +594,237 @@ int bootflow_scan_first(struct udevice *dev, const char *label,
 	return 0;
 }
 
+/* Fields of the record in the BOOTFLOW_CACHE_VAR environment variable */
+enum {
+	BFC_DEV,
+	BFC_HUNTER,
+	BFC_PART,
+	BFC_METHOD,
+	BFC_SIZE,
+	BFC_CRC,
+	BFC_ORDER,
+	BFC_FNAME,
+
+	BFC_COUNT,
+};
+
+/* Gets a checksum of the file read by the bootmeth, 0 if none was read */
+static u32 bootflow_cache_crc(const struct bootflow *bflow)
+{
+	if (!bflow->buf || bflow->size <= 0)
+		return 0;
+
+	return crc32(0, (const uchar *)bflow->buf, bflow->size);
+}
+
+/*
+ * Gets a checksum of the bootdevs (e.g. from boot_targets) and bootmeths to
+ * try, in order, so that a record made with another order is not used
+ */
+static u32 bootflow_cache_order_crc(void)
+{
+	const char *const *order;
+	struct bootstd_priv *std;
+	struct udevice *bootstd;
+	const char *name;
+	u32 crc = 0;
+	bool ok;
+	int i;
+
+	if (uclass_first_device_err(UCLASS_BOOTSTD, &bootstd))
+		return 0;
+	std = dev_get_priv(bootstd);
+
+	/* Each name ends with its nul, and an empty name ends the list */
+	order = bootstd_get_bootdev_order(bootstd, &ok);
+	for (i = 0; order && order[i]; i++)
+		crc = crc32(crc, (const uchar *)order[i], strlen(order[i]) + 1);
+	crc = crc32(crc, (const uchar *)"", 1);
+	for (i = 0; i < std->bootmeth_count; i++) {
+		name = std->bootmeth_order[i]->name;
+		crc = crc32(crc, (const uchar *)name, strlen(name) + 1);
+	}
+
+	return crc;
+}
+
+void bootflow_cache_save(struct bootflow *bflow)
+{
+	const char *hunter, *old;
+	char rec[256];
+	int len;
+
+	/* Global bootmeths find their own bootdev, so cannot be recorded */
+	if (!bflow->dev || !bflow->fname)
+		return;
+
+	hunter = bootdev_get_hunter_name(bflow->dev);
+	len = snprintf(rec, sizeof(rec), "%s %s %x %s %x %08x %08x %s",
+		       bflow->dev->name, hunter ?: "-", bflow->part,
+		       bflow->method->name, bflow->size,
+		       bootflow_cache_crc(bflow), bootflow_cache_order_crc(),
+		       bflow->fname);
+	if (len >= sizeof(rec))
+		return;
+	old = env_get(BOOTFLOW_CACHE_VAR);
+	if (old && !strcmp(old, rec))
+		return;
+	if (env_set(BOOTFLOW_CACHE_VAR, rec) || env_save())
+		log_debug("Cannot save bootflow record\n");
+}
+
+/* Forgets the bootflow which was last booted, e.g. because booting failed */
+static void bootflow_cache_drop(void)
+{
+	if (!env_get(BOOTFLOW_CACHE_VAR))
+		return;
+	if (env_set(BOOTFLOW_CACHE_VAR, NULL) || env_save())
+		log_debug("Cannot drop bootflow record\n");
+}
+
+/**
+ * bootflow_cache_scan() - Try the bootflow which was last booted
+ *
+ * This finds the bootdev, partition and bootmeth given by the record, hunting
+ * only for the bootdev's uclass if needed, then checks that the bootflow found
+ * there has the same file as before. The record is not used if the bootdevs or
+ * bootmeths to try have changed since it was made, since the full scan might
+ * then pick another bootflow.
+ *
+ * @iter: Place to store private info (inited by this call)
+ * @flags: Flags for iterator (enum bootflow_iter_flags_t)
+ * @bflow: Place to put the bootflow if found
+ * Return: 0 if found, -ve if there is no record or it does not match, in
+ *	which case @iter is not inited
+ */
+static int bootflow_cache_scan(struct bootflow_iter *iter, int flags,
+			       struct bootflow *bflow)
+{
+	struct udevice *dev, *meth;
+	char *field[BFC_COUNT];
+	const char *val;
+	char *rec, *p;
+	int i, ret;
+
+	val = env_get(BOOTFLOW_CACHE_VAR);
+	if (!val)
+		return -ENOENT;
+	rec = strdup(val);
+	if (!rec)
+		return log_msg_ret("dup", -ENOMEM);
+	p = rec;
+	for (i = 0; i < BFC_FNAME && p; i++)
+		field[i] = strsep(&p, " ");
+	field[BFC_FNAME] = p;
+	if (!p) {
+		ret = log_msg_ret("rec", -EINVAL);
+		goto err;
+	}
+	if (bootflow_cache_order_crc() != hextoul(field[BFC_ORDER], NULL)) {
+		ret = log_msg_ret("ord", -ESTALE);
+		goto err;
+	}
+
+	ret = uclass_get_device_by_name(UCLASS_BOOTMETH, field[BFC_METHOD],
+					&meth);
+	if (ret)
+		goto err;
+	ret = uclass_get_device_by_name(UCLASS_BOOTDEV, field[BFC_DEV], &dev);
+	if (ret == -ENODEV && (flags & BOOTFLOWIF_HUNT) &&
+	    strcmp(field[BFC_HUNTER], "-")) {
+		ret = bootdev_hunt(field[BFC_HUNTER], flags & BOOTFLOWIF_SHOW);
+		if (!ret)
+			ret = uclass_get_device_by_name(UCLASS_BOOTDEV,
+							field[BFC_DEV], &dev);
+	}
+	if (ret)
+		goto err;
+
+	bootflow_iter_init(iter, flags | BOOTFLOWIF_SKIP_GLOBAL |
+			   BOOTFLOWIF_SINGLE_DEV | BOOTFLOWIF_SINGLE_PARTITION |
+			   BOOTFLOWIF_CACHED);
+	iter->scan_flags = flags;
+	iter->method_order = calloc(1, sizeof(struct udevice *));
+	if (!iter->method_order) {
+		ret = log_msg_ret("mem", -ENOMEM);
+		goto err;
+	}
+	iter->method_order[0] = meth;
+	iter->num_methods = 1;
+	iter->method = meth;
+	iter->part = hextoul(field[BFC_PART], NULL);
+	bootflow_iter_set_dev(iter, dev, 0);
+
+	ret = bootflow_check(iter, bflow);
+	if (!ret && (strcmp(bflow->fname, field[BFC_FNAME]) ||
+		     bflow->size != hextoul(field[BFC_SIZE], NULL) ||
+		     bootflow_cache_crc(bflow) != hextoul(field[BFC_CRC], NULL)))
+		ret = -ESTALE;
+	if (ret) {
+		bootflow_free(bflow);
+		bootflow_iter_uninit(iter);
+		goto err;
+	}
+	free(rec);
+	if (flags & BOOTFLOWIF_SHOW)
+		printf("Using last bootflow from bootdev '%s'\n", dev->name);
+
+	return 0;
+err:
+	log_debug("No cached bootflow (err=%d)\n", ret);
+	free(rec);
+
+	return ret;
+}
+
+/**
+ * bootflow_cache_fallback() - Start a full scan after the cached bootflow
+ *
+ * The cached bootflow is skipped when the full scan finds it again, since it
+ * has already been returned
+ *
+ * @iter: Iterator used for the cached bootflow (inited again by this call)
+ * @bflow: Place to put the bootflow if found
+ * Return: 0 if found, -ENODEV if no device, other -ve on other error
+ */
+static int bootflow_cache_fallback(struct bootflow_iter *iter,
+				   struct bootflow *bflow)
+{
+	struct udevice *dev = iter->dev, *meth = iter->method;
+	int flags = iter->scan_flags;
+	int part = iter->part;
+	int ret;
+
+	bootflow_iter_uninit(iter);
+	ret = bootflow_scan_start(NULL, NULL, iter, flags, bflow);
+	while (!ret && bflow->dev == dev && bflow->part == part &&
+	       bflow->method == meth) {
+		bootflow_free(bflow);
+		ret = bootflow_scan_next(iter, bflow);
+	}
+
+	return ret;
+}
+
+int bootflow_scan_first(struct udevice *dev, const char *label,
+			struct bootflow_iter *iter, int flags,
+			struct bootflow *bflow)
+{
+	if (IS_ENABLED(CONFIG_BOOTFLOW_CACHE) && !dev && !label &&
+	    !(flags & BOOTFLOWIF_ALL) && !bootflow_cache_scan(iter, flags, bflow))
+		return 0;
+
+	return bootflow_scan_start(dev, label, iter, flags, bflow);
+}
+
 int bootflow_scan_next(struct bootflow_iter *iter, struct bootflow *bflow)
 {
 	int ret;
 
+	if (IS_ENABLED(CONFIG_BOOTFLOW_CACHE) &&
+	    (iter->flags & BOOTFLOWIF_CACHED))
+		return bootflow_cache_fallback(iter, bflow);
+
 	do {
 		ret = iter_incr(iter);
 		log_debug("iter_incr: ret=%d\n", ret);
@@ -699,7 +931,11 @@ int bootflow_run_boot(struct bootflow_iter *iter, struct bootflow *bflow)
 	if (IS_ENABLED(CONFIG_OF_HAS_PRIOR_STAGE) &&
 	    (bflow->flags & BOOTFLOWF_USE_PRIOR_FDT))
 		printf("Using prior-stage device tree\n");
+	if (IS_ENABLED(CONFIG_BOOTFLOW_CACHE))
+		bootflow_cache_save(bflow);
 	ret = bootflow_boot(bflow);
+	if (IS_ENABLED(CONFIG_BOOTFLOW_CACHE))
+		bootflow_cache_drop();
 	if (!IS_ENABLED(CONFIG_BOOTSTD_FULL)) {
 		printf("Boot failed (err=%d)\n", ret);
 		return ret;
@@ -5,6 +5,7 @@
  */
 
 #ifndef USE_HOSTCC
+#include <blk.h>
 #include <bootm.h>
 #include <bootstage.h>
 #include <cli.h>
@@ -734,6 +735,10 @@ ulong bootm_disable_interrupts(void)
 	 * recover from any failures any more...
 	 */
 	iflag = disable_interrupts();
+
+	/* Nothing may stay behind in the block cache once the OS runs */
+	if (blkcache_flush(-1, 0))
+		log_err("Failed to write back the block cache\n");
 #ifdef CONFIG_NETCONSOLE
 	/* Stop the ethernet stack if NetConsole could have left it up */
 	eth_halt();
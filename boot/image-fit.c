@@ -29,6 +29,7 @@ extern void *aligned_alloc(size_t alignment, size_t size);
 #include <malloc.h>
 #include <memalign.h>
 #include <asm/global_data.h>
+#include <u-boot/schedule.h>
 #ifdef CONFIG_DM_HASH
 #include <dm.h>
 #include <u-boot/hash.h>
@@ -1315,6 +1316,7 @@ static int fit_image_check_hash(const void *fit, int noffset, const void *data,
 	uint8_t *fit_value;
 	int fit_value_len;
 	int ignore;
+	int ret;
 
 	*err_msgp = NULL;
 
@@ -1338,7 +1340,10 @@ static int fit_image_check_hash(const void *fit, int noffset, const void *data,
 		return -1;
 	}
 
-	if (calculate_hash(data, size, algo, value, &value_len)) {
+	bootstage_start(BOOTSTAGE_ID_ACCUM_FIT_HASH, "fit_hash");
+	ret = calculate_hash(data, size, algo, value, &value_len);
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_FIT_HASH);
+	if (ret) {
 		*err_msgp = "Unsupported hash algorithm";
 		return -1;
 	}
@@ -1989,18 +1994,309 @@ int fit_get_data_conf_prop(const void *fit, const char *prop_name,
 	return fit_get_data_tail(fit, noffset, data, size);
 }
 
-static int fit_image_select(const void *fit, int rd_noffset, int verify)
+#define FIT_STREAM_MAX_HASHES	4
+
+/**
+ * struct fit_stream - hashes of an image calculated while it is loaded
+ *
+ * @count:	number of hash nodes
+ * @pos:	number of bytes of image data hashed so far
+ * @hash:	hash nodes being calculated
+ * @hash.noffset:	hash node offset
+ * @hash.algo:		hash algorithm
+ * @hash.ctx:		hash context, NULL if the hash node is to be ignored
+ */
+struct fit_stream {
+	int count;
+	ulong pos;
+	struct {
+		int noffset;
+		struct hash_algo *algo;
+		void *ctx;
+	} hash[FIT_STREAM_MAX_HASHES];
+};
+
+#if !defined(USE_HOSTCC) && CONFIG_IS_ENABLED(HASH)
+/**
+ * fit_image_stream_ok() - check if image hashes can be checked while loading
+ *
+ * This is only possible when all the image data is covered by hash nodes with
+ * a progressive hash algorithm and the data is used as-is. With signature
+ * verification, it is only done when there are no required keys and no
+ * configuration is signed. Otherwise the image data must not reach its load
+ * address before the hashes are known to be good.
+ *
+ * @fit: FIT to check
+ * @image_noffset: Image node offset
+ * Return: true if the hashes can be calculated while loading the image
+ */
+static bool fit_image_stream_ok(const void *fit, int image_noffset)
 {
-	fit_image_print(fit, rd_noffset, "   ");
+	const void *key_blob = gd_fdt_blob();
+	struct hash_algo *algo;
+	const char *algo_name;
+	int noffset, count = 0;
 
-	if (verify) {
-		puts("   Verifying Hash Integrity ... ");
-		if (!fit_image_verify(fit, rd_noffset)) {
-			puts("Bad Data Hash\n");
-			return -EACCES;
+	if (IS_ENABLED(CONFIG_DM_HASH) ||
+	    IS_ENABLED(CONFIG_SHA_PROG_HW_ACCEL) ||
+	    IS_ENABLED(CONFIG_FIT_IMAGE_POST_PROCESS) ||
+	    (IMAGE_ENABLE_DECRYPT &&
+	     fdt_subnode_offset(fit, image_noffset, FIT_CIPHER_NODENAME) >= 0))
+		return false;
+
+	fdt_for_each_subnode(noffset, fit, image_noffset) {
+		const char *name = fit_get_name(fit, noffset, NULL);
+
+		if (FIT_IMAGE_ENABLE_VERIFY &&
+		    !strncmp(name, FIT_SIG_NODENAME, strlen(FIT_SIG_NODENAME)))
+			return false;
+		if (strncmp(name, FIT_HASH_NODENAME, strlen(FIT_HASH_NODENAME)))
+			continue;
+		if (count++ == FIT_STREAM_MAX_HASHES ||
+		    fit_image_hash_get_algo(fit, noffset, &algo_name) ||
+		    hash_progressive_lookup_algo(algo_name, &algo))
+			return false;
+	}
+	if (!count || noffset == -FDT_ERR_TRUNCATED ||
+	    noffset == -FDT_ERR_BADSTRUCTURE)
+		return false;
+
+	/* Data covered by a signature must be checked before it is loaded */
+	if (FIT_IMAGE_ENABLE_VERIFY) {
+		int key_node = fdt_subnode_offset(key_blob, 0,
+						  FIT_SIG_NODENAME);
+		int confs_noffset = fdt_path_offset(fit, FIT_CONFS_PATH);
+		int cfg_noffset;
+
+		fdt_for_each_subnode(noffset, key_blob, key_node) {
+			if (fdt_getprop(key_blob, noffset, FIT_KEY_REQUIRED,
+					NULL))
+				return false;
 		}
-		puts("OK\n");
+		fdt_for_each_subnode(cfg_noffset, fit, confs_noffset) {
+			fdt_for_each_subnode(noffset, fit, cfg_noffset) {
+				const char *name = fit_get_name(fit, noffset,
+								NULL);
+
+				if (!strncmp(name, FIT_SIG_NODENAME,
+					     strlen(FIT_SIG_NODENAME)))
+					return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+static void fit_image_stream_abort(struct fit_stream *st)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(uint8_t, value, FIT_MAX_HASH_LEN);
+	int i;
+
+	for (i = 0; i < st->count; i++) {
+		if (st->hash[i].ctx)
+			st->hash[i].algo->hash_finish(st->hash[i].algo,
+						      st->hash[i].ctx, value,
+						      FIT_MAX_HASH_LEN);
+		st->hash[i].ctx = NULL;
+	}
+}
+
+/**
+ * fit_image_stream_start() - set up hashing an image while loading it
+ *
+ * Must only be called if fit_image_stream_ok() returned true.
+ *
+ * @st: Returns the hash state
+ * @fit: FIT containing the image
+ * @image_noffset: Image node offset
+ * Return: 0 if OK, -ENOMEM if a hash context cannot be allocated
+ */
+static int fit_image_stream_start(struct fit_stream *st, const void *fit,
+				  int image_noffset)
+{
+	struct hash_algo *algo;
+	const char *algo_name;
+	int noffset, ignore;
+
+	st->count = 0;
+	st->pos = 0;
+	fdt_for_each_subnode(noffset, fit, image_noffset) {
+		const char *name = fit_get_name(fit, noffset, NULL);
+
+		if (strncmp(name, FIT_HASH_NODENAME, strlen(FIT_HASH_NODENAME)))
+			continue;
+		fit_image_hash_get_algo(fit, noffset, &algo_name);
+		hash_progressive_lookup_algo(algo_name, &algo);
+		st->hash[st->count].noffset = noffset;
+		st->hash[st->count].algo = algo;
+		st->hash[st->count].ctx = NULL;
+		st->count++;
+
+		fit_image_hash_get_ignore(fit, noffset, &ignore);
+		if (!ignore &&
+		    algo->hash_init(algo, &st->hash[st->count - 1].ctx)) {
+			fit_image_stream_abort(st);
+			return -ENOMEM;
+		}
+	}
+
+	return 0;
+}
+
+/* Hashes the next piece of image data */
+static void fit_image_stream_consume(void *priv, const void *buf,
+				     unsigned long len)
+{
+	struct fit_stream *st = priv;
+	ulong chunk;
+	int i;
+
+	for (; len; len -= chunk, buf += chunk, st->pos += chunk) {
+		chunk = min(len, (ulong)IMAGE_STREAM_CHUNK);
+		bootstage_start(BOOTSTAGE_ID_ACCUM_FIT_HASH, "fit_hash");
+		for (i = 0; i < st->count; i++) {
+			if (st->hash[i].ctx)
+				st->hash[i].algo->hash_update(st->hash[i].algo,
+							      st->hash[i].ctx,
+							      buf, chunk, 0);
+		}
+		bootstage_accum(BOOTSTAGE_ID_ACCUM_FIT_HASH);
+		schedule();
+	}
+}
+
+/**
+ * fit_image_stream_finish() - check the hashes of a loaded image
+ *
+ * Hashes whatever part of the image data was not consumed while loading and
+ * compares the results with the values in the hash nodes.
+ *
+ * @st: Hash state
+ * @fit: FIT containing the image
+ * @image_noffset: Image node offset
+ * @data: Image data
+ * @size: Size of the image data
+ * Return: 0 if all hashes match, -EACCES otherwise
+ */
+static int fit_image_stream_finish(struct fit_stream *st, const void *fit,
+				   int image_noffset, const void *data,
+				   size_t size)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(uint8_t, value, FIT_MAX_HASH_LEN);
+	char *err_msg = NULL;
+	int err_noffset = 0;
+	uint8_t *fit_value;
+	int fit_value_len;
+	int i;
+
+	if (st->pos < size)
+		fit_image_stream_consume(st, data + st->pos, size - st->pos);
+
+	puts("   Verifying Hash Integrity ... ");
+	for (i = 0; i < st->count && !err_msg; i++) {
+		struct hash_algo *algo = st->hash[i].algo;
+		int noffset = st->hash[i].noffset;
+
+		printf("%s", algo->name);
+		if (!st->hash[i].ctx) {
+			printf("-skipped ");
+			continue;
+		}
+		if (algo->hash_finish(algo, st->hash[i].ctx, value,
+				      FIT_MAX_HASH_LEN))
+			err_msg = "Unsupported hash algorithm";
+		else if (fit_image_hash_get_value(fit, noffset, &fit_value,
+						  &fit_value_len))
+			err_msg = "Can't get hash value property";
+		else if (fit_value_len != algo->digest_size)
+			err_msg = "Bad hash value len";
+		else if (memcmp(value, fit_value, fit_value_len))
+			err_msg = "Bad hash value";
+		else
+			puts("+ ");
+		st->hash[i].ctx = NULL;
+		err_noffset = noffset;
+	}
+	fit_image_stream_abort(st);
+
+	if (err_msg) {
+		printf(" error!\n%s for '%s' hash node in '%s' image node\n",
+		       err_msg, fit_get_name(fit, err_noffset, NULL),
+		       fit_get_name(fit, image_noffset, NULL));
+		puts("Bad Data Hash\n");
+		return -EACCES;
+	}
+	puts("OK\n");
+
+	return 0;
+}
+#else
+static bool fit_image_stream_ok(const void *fit, int image_noffset)
+{
+	return false;
+}
+
+static int fit_image_stream_start(struct fit_stream *st, const void *fit,
+				  int image_noffset)
+{
+	return -ENOSYS;
+}
+
+static void fit_image_stream_abort(struct fit_stream *st)
+{
+}
+
+static void fit_image_stream_consume(void *priv, const void *buf,
+				     unsigned long len)
+{
+}
+
+static int fit_image_stream_finish(struct fit_stream *st, const void *fit,
+				   int image_noffset, const void *data,
+				   size_t size)
+{
+	return -ENOSYS;
+}
+#endif
+
+/*
+ * Copies image data to its load address, hashing each piece just before it
+ * is copied if @st is not NULL
+ */
+static void fit_image_copy(struct fit_stream *st, void *dst, const void *src,
+			   ulong len)
+{
+	ulong chunk;
+
+	for (; len; len -= chunk, src += chunk, dst += chunk) {
+		chunk = st && len > IMAGE_STREAM_CHUNK ? IMAGE_STREAM_CHUNK : len;
+		if (st)
+			fit_image_stream_consume(st, src, chunk);
+		bootstage_start(BOOTSTAGE_ID_ACCUM_FIT_COPY, "fit_copy");
+		memcpy(dst, src, chunk);
+		bootstage_accum(BOOTSTAGE_ID_ACCUM_FIT_COPY);
+	}
+}
+
+static int fit_image_check_integrity(const void *fit, int noffset)
+{
+	puts("   Verifying Hash Integrity ... ");
+	if (!fit_image_verify(fit, noffset)) {
+		puts("Bad Data Hash\n");
+		return -EACCES;
 	}
+	puts("OK\n");
+
+	return 0;
+}
+
+static int fit_image_select(const void *fit, int rd_noffset, int verify)
+{
+	fit_image_print(fit, rd_noffset, "   ");
+
+	if (verify)
+		return fit_image_check_integrity(fit, rd_noffset);
 
 	return 0;
 }
@@ -2076,7 +2372,9 @@ int fit_image_load(struct bootm_headers *images, ulong addr,
 		   enum fit_load_op load_op, ulong *datap, ulong *lenp)
 {
 	int image_type = image_ph_type(ph_type);
+	struct fit_stream stream, *st = NULL;
 	int cfg_noffset, noffset;
+	bool stream_ok = false;
 	const char *fit_uname;
 	const char *fit_uname_config;
 	const char *fit_base_uname_config;
@@ -2166,7 +2464,13 @@ int fit_image_load(struct bootm_headers *images, ulong addr,
 
 	printf("   Trying '%s' %s subimage\n", fit_uname, prop_name);
 
-	ret = fit_image_select(fit, noffset, images->verify);
+	/*
+	 * If possible, check the hashes while the data is copied or
+	 * decompressed, rather than making a separate pass over it
+	 */
+	if (images->verify)
+		stream_ok = fit_image_stream_ok(fit, noffset);
+	ret = fit_image_select(fit, noffset, images->verify && !stream_ok);
 	if (ret) {
 		bootstage_error(bootstage_id + BOOTSTAGE_SUB_HASH);
 		return ret;
@@ -2285,6 +2589,19 @@ int fit_image_load(struct bootm_headers *images, ulong addr,
 		load = data;	/* No load address specified */
 	}
 
+	if (stream_ok) {
+		if (!fit_image_stream_start(&stream, fit, noffset)) {
+			st = &stream;
+		} else {
+			ret = fit_image_check_integrity(fit, noffset);
+			if (ret) {
+				bootstage_error(bootstage_id +
+						BOOTSTAGE_SUB_HASH);
+				return ret;
+			}
+		}
+	}
+
 	comp = IH_COMP_NONE;
 	loadbuf = buf;
 	/* Kernel images get decompressed later in bootm_load_os(). */
@@ -2303,9 +2620,13 @@ int fit_image_load(struct bootm_headers *images, ulong addr,
 		} else {
 			loadbuf = map_sysmem(load, max_decomp_len);
 		}
-		if (image_decomp(comp, load, data, image_type,
-				loadbuf, buf, len, max_decomp_len, &load_end)) {
+		if (image_decomp_stream(comp, load, data, image_type, loadbuf,
+					buf, len, max_decomp_len, &load_end,
+					st ? fit_image_stream_consume : NULL,
+					st)) {
 			printf("Error decompressing %s\n", prop_name);
+			if (st)
+				fit_image_stream_abort(st);
 
 			return -ENOEXEC;
 		}
@@ -2314,11 +2635,19 @@ int fit_image_load(struct bootm_headers *images, ulong addr,
 		   ((uintptr_t)buf & 7)) {
 		loadbuf = aligned_alloc(8, len);
 		load = map_to_sysmem(loadbuf);
-		memcpy(loadbuf, buf, len);
+		fit_image_copy(st, loadbuf, buf, len);
 	} else if (load != data) {
 		log_debug("copying\n");
 		loadbuf = map_sysmem(load, len);
-		memcpy(loadbuf, buf, len);
+		fit_image_copy(st, loadbuf, buf, len);
+	}
+
+	if (st) {
+		ret = fit_image_stream_finish(st, fit, noffset, buf, size);
+		if (ret) {
+			bootstage_error(bootstage_id + BOOTSTAGE_SUB_HASH);
+			return ret;
+		}
 	}
 
 	if (image_type == IH_TYPE_RAMDISK && comp != IH_COMP_NONE)
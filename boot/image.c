@@ -52,6 +52,7 @@ DECLARE_GLOBAL_DATA_PTR;
 #endif /* !USE_HOSTCC*/
 
 #include <abuf.h>
+#include <bootstage.h>
 #include <bzlib.h>
 #include <display_options.h>
 #include <gzip.h>
@@ -453,11 +454,33 @@ int image_decomp(int comp, ulong load, ulong image_start, int type,
 		 void *load_buf, void *image_buf, ulong image_len,
 		 uint unc_len, ulong *load_end)
 {
+	return image_decomp_stream(comp, load, image_start, type, load_buf,
+				   image_buf, image_len, unc_len, load_end,
+				   NULL, NULL);
+}
+
+int image_decomp_stream(int comp, ulong load, ulong image_start, int type,
+			void *load_buf, void *image_buf, ulong image_len,
+			uint unc_len, ulong *load_end,
+			void (*consume)(void *priv, const void *buf,
+					unsigned long len),
+			void *priv)
+{
+	bool stream_gzip = !tools_build() && CONFIG_IS_ENABLED(GZIP) &&
+		comp == IH_COMP_GZIP;
 	int ret = -ENOSYS;
 
 	*load_end = load;
 	print_decomp_msg(comp, type, load == image_start, load);
 
+	/* Only gzip can be fed to its decompressor a piece at a time */
+	if (consume && !stream_gzip) {
+		consume(priv, image_buf, image_len);
+		consume = NULL;
+	}
+
+	bootstage_start(BOOTSTAGE_ID_ACCUM_DECOMP, "decomp");
+
 	/*
 	 * Load the image to the right place, decompressing if needed. After
 	 * this, image_len will be set to the number of uncompressed bytes
@@ -474,7 +497,11 @@ int image_decomp(int comp, ulong load, ulong image_start, int type,
 			ret = -ENOSPC;
 		break;
 	case IH_COMP_GZIP:
-		if (!tools_build() && CONFIG_IS_ENABLED(GZIP))
+		if (stream_gzip && consume)
+			ret = gunzip_stream(load_buf, unc_len, image_buf,
+					    &image_len, IMAGE_STREAM_CHUNK,
+					    consume, priv);
+		else if (stream_gzip)
 			ret = gunzip(load_buf, unc_len, image_buf, &image_len);
 		break;
 	case IH_COMP_BZIP2:
@@ -530,6 +557,7 @@ int image_decomp(int comp, ulong load, ulong image_start, int type,
 		}
 		break;
 	}
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_DECOMP);
 	if (ret == -ENOSYS) {
 		printf("Unimplemented compression type %d\n", comp);
 		return ret;
@@ -18,11 +18,15 @@ static int blkc_show(struct cmd_tbl *cmdtp, int flag,
 
 	printf("hits: %u\n"
 	       "misses: %u\n"
+	       "read-aheads: %u\n"
+	       "write-backs: %u\n"
 	       "entries: %u\n"
+	       "dirty entries: %u\n"
 	       "max blocks/entry: %u\n"
 	       "max cache entries: %u\n",
-	       stats.hits, stats.misses, stats.entries,
-	       stats.max_blocks_per_entry, stats.max_entries);
+	       stats.hits, stats.misses, stats.readaheads, stats.writebacks,
+	       stats.entries, stats.dirty, stats.max_blocks_per_entry,
+	       stats.max_entries);
 	return 0;
 }
 
@@ -41,9 +45,50 @@ static int blkc_configure(struct cmd_tbl *cmdtp, int flag,
 	return 0;
 }
 
+static int blkc_flush(struct cmd_tbl *cmdtp, int flag,
+		      int argc, char *const argv[])
+{
+	if (blkcache_flush(-1, 0)) {
+		printf("failed to write back cached blocks\n");
+		return CMD_RET_FAILURE;
+	}
+	return 0;
+}
+
+static int blkc_sync(struct cmd_tbl *cmdtp, int flag,
+		     int argc, char *const argv[])
+{
+	struct blk_desc *desc;
+
+	if (argc < 3 || argc > 4)
+		return CMD_RET_USAGE;
+
+	desc = blk_get_dev(argv[1], dectoul(argv[2], NULL));
+	if (!desc) {
+		printf("no such device: %s %s\n", argv[1], argv[2]);
+		return CMD_RET_FAILURE;
+	}
+
+	if (argc == 4) {
+		if (!strcmp(argv[3], "on"))
+			desc->cache_sync = true;
+		else if (!strcmp(argv[3], "off"))
+			desc->cache_sync = false;
+		else
+			return CMD_RET_USAGE;
+		if (desc->cache_sync && blk_dflush(desc))
+			return CMD_RET_FAILURE;
+	}
+	printf("%s %s: writes are %s\n", argv[1], argv[2],
+	       desc->cache_sync ? "synchronous" : "held back");
+	return 0;
+}
+
 static struct cmd_tbl cmd_blkc_sub[] = {
 	U_BOOT_CMD_MKENT(show, 0, 0, blkc_show, "", ""),
 	U_BOOT_CMD_MKENT(configure, 3, 0, blkc_configure, "", ""),
+	U_BOOT_CMD_MKENT(flush, 0, 0, blkc_flush, "", ""),
+	U_BOOT_CMD_MKENT(sync, 4, 0, blkc_sync, "", ""),
 };
 
 static int do_blkcache(struct cmd_tbl *cmdtp, int flag,
@@ -67,9 +112,12 @@ static int do_blkcache(struct cmd_tbl *cmdtp, int flag,
 }
 
 U_BOOT_CMD(
-	blkcache, 4, 0, do_blkcache,
+	blkcache, 5, 0, do_blkcache,
 	"block cache diagnostics and control",
 	"show - show and reset statistics\n"
 	"blkcache configure <blocks> <entries> "
 	"- set max blocks per entry and max cache entries\n"
+	"blkcache flush - write back all held back writes\n"
+	"blkcache sync <interface> <dev> [on|off] "
+	"- show or set synchronous writes for a device\n"
 );
@@ -48,6 +48,16 @@ static int do_dm_dump_mem(struct cmd_tbl *cmdtp, int flag, int argc,
 }
 #endif /* DM_STATS */
 
+#if CONFIG_IS_ENABLED(DM_LAZY_BIND)
+static int do_dm_dump_lazy(struct cmd_tbl *cmdtp, int flag, int argc,
+			   char *const argv[])
+{
+	dm_dump_lazy();
+
+	return 0;
+}
+#endif /* DM_LAZY_BIND */
+
 static int do_dm_dump_static_driver_info(struct cmd_tbl *cmdtp, int flag,
 					 int argc, char * const argv[])
 {
@@ -104,6 +114,14 @@ static int do_dm_dump_uclass(struct cmd_tbl *cmdtp, int flag, int argc,
 	return 0;
 }
 
+#if CONFIG_IS_ENABLED(DM_LAZY_BIND)
+#define DM_LAZY_HELP	"dm lazy          Show stats on deferred binding\n"
+#define DM_LAZY		U_BOOT_SUBCMD_MKENT(lazy, 1, 1, do_dm_dump_lazy),
+#else
+#define DM_LAZY_HELP
+#define DM_LAZY
+#endif
+
 #if CONFIG_IS_ENABLED(DM_STATS)
 #define DM_MEM_HELP	"dm mem           Provide a summary of memory usage\n"
 #define DM_MEM		U_BOOT_SUBCMD_MKENT(mem, 1, 1, do_dm_dump_mem),
@@ -116,6 +134,7 @@ U_BOOT_LONGHELP(dm,
 	"compat        Dump list of drivers with compatibility strings\n"
 	"dm devres        Dump list of device resources for each device\n"
 	"dm drivers       Dump list of drivers with uclass and instances\n"
+	DM_LAZY_HELP
 	DM_MEM_HELP
 	"dm static        Dump list of drivers with static platform data\n"
 	"dm tree [-s][-e][name]   Dump tree of driver model devices (-s=sort)\n"
@@ -125,6 +144,7 @@ U_BOOT_CMD_WITH_SUBCMDS(dm, "Driver model low level access", dm_help_text,
 	U_BOOT_SUBCMD_MKENT(compat, 1, 1, do_dm_dump_driver_compat),
 	U_BOOT_SUBCMD_MKENT(devres, 1, 1, do_dm_dump_devres),
 	U_BOOT_SUBCMD_MKENT(drivers, 1, 1, do_dm_dump_drivers),
+	DM_LAZY
 	DM_MEM
 	U_BOOT_SUBCMD_MKENT(static, 1, 1, do_dm_dump_static_driver_info),
 	U_BOOT_SUBCMD_MKENT(tree, 4, 1, do_dm_dump_tree),
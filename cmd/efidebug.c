@@ -607,7 +607,7 @@ static void print_memory_attributes(u64 attributes)
  * Return:	CMD_RET_SUCCESS on success, CMD_RET_RET_FAILURE on failure
  *
  * Implement efidebug "memmap" sub-command.
- * Show UEFI memory map.
+ * Show UEFI memory map, or with -s the slabs used for small pool allocations.
  */
 static int do_efi_show_memmap(struct cmd_tbl *cmdtp, int flag,
 			      int argc, char *const argv[])
@@ -618,6 +618,15 @@ static int do_efi_show_memmap(struct cmd_tbl *cmdtp, int flag,
 	int i;
 	efi_status_t ret;
 
+	if (argc > 2)
+		return CMD_RET_USAGE;
+	if (argc == 2) {
+		if (strcmp(argv[1], "-s"))
+			return CMD_RET_USAGE;
+		efi_dump_pool_slabs();
+		return CMD_RET_SUCCESS;
+	}
+
 	ret = efi_get_memory_map_alloc(&map_size, &memmap);
 	if (ret != EFI_SUCCESS)
 		return CMD_RET_FAILURE;
@@ -1682,8 +1691,8 @@ U_BOOT_LONGHELP(efidebug,
 	"  - show default EFI filename and PXE architecture\n"
 	"efidebug images\n"
 	"  - show loaded images\n"
-	"efidebug memmap\n"
-	"  - show UEFI memory map\n"
+	"efidebug memmap [-s]\n"
+	"  - show UEFI memory map (-s: slabs used for pool allocations)\n"
 	"efidebug tables\n"
 	"  - show UEFI configuration tables\n"
 #ifdef CONFIG_EFI_BOOTMGR
@@ -70,6 +70,31 @@ U_BOOT_CMD(ext4write, 7, 1, do_ext4_write,
 
 #endif
 
+static int do_ext4_cachestats(struct cmd_tbl *cmdtp, int flag, int argc,
+			      char *const argv[])
+{
+	struct ext_cache_stats stats;
+
+	ext_cache_get_stats(&stats);
+
+	printf("hits: %lu\n"
+	       "misses: %lu\n"
+	       "evictions: %lu\n"
+	       "entries: %d\n"
+	       "max cache entries: %d\n",
+	       stats.hits, stats.misses, stats.evictions, stats.entries,
+	       stats.max_entries);
+
+	return 0;
+}
+
+U_BOOT_CMD(ext4cachestats, 1, 0, do_ext4_cachestats,
+	   "show and reset ext4 metadata cache statistics",
+	   "\n"
+	   "    - show the hit, miss and eviction counts of the metadata cache\n"
+	   "      of the mounted ext4 filesystem, then reset them"
+);
+
 U_BOOT_CMD(
 	ext4size,	4,	0,	do_ext4_size,
 	"determine a file's size",
@@ -73,6 +73,12 @@ static void display_ubi_info(struct ubi_device *ubi)
 	ubi_msg("number of PEBs reserved for bad PEB handling: %d",
 			ubi->beb_rsvd_pebs);
 	ubi_msg("max/mean erase counter: %d/%d", ubi->max_ec, ubi->mean_ec);
+	ubi_msg("attach time: fastmap %lu us, scan %lu us",
+		ubi->attach_us[UBI_ATTACH_FASTMAP],
+		ubi->attach_us[UBI_ATTACH_SCAN]);
+	ubi_msg("attach time: volume table %lu us, wear-leveling %lu us, EBA %lu us",
+		ubi->attach_us[UBI_ATTACH_VTBL], ubi->attach_us[UBI_ATTACH_WL],
+		ubi->attach_us[UBI_ATTACH_EBA]);
 }
 
 static int ubi_info(int layout)
@@ -4,6 +4,7 @@
  * Written by Simon Glass <sjg@chromium.org>
  */
 
+#include <bootstage.h>
 #include <errno.h>
 #include <fpga.h>
 #include <gzip.h>
@@ -225,12 +226,12 @@ static int load_simple_fit(struct spl_load_info *info, ulong fit_offset,
 	const void *data;
 	const void *fit = ctx->fit;
 	bool external_data = false;
+	int ret;
 
 	log_debug("starting\n");
 	if (CONFIG_IS_ENABLED(BOOTMETH_VBE) &&
 	    xpl_get_phase(info) != IH_PHASE_NONE) {
 		enum image_phase_t phase;
-		int ret;
 
 		ret = fit_image_get_phase(fit, node, &phase);
 		/* if the image is for any phase, let's use it */
@@ -291,8 +292,21 @@ static int load_simple_fit(struct spl_load_info *info, ulong fit_offset,
 			return 0;
 		}
 
+		/* Try to decompress the data as it is read, if compressed */
+		size = CONFIG_SYS_BOOTM_LEN;
+		ret = spl_fit_stream_load(info, fit_offset + offset, len,
+					  image_comp, map_sysmem(load_addr, 0),
+					  &size);
+		if (!ret) {
+			length = size;
+			goto loaded;
+		} else if (ret != -EAGAIN) {
+			return ret;
+		}
+
 		if (spl_decompression_enabled() &&
-		    (image_comp == IH_COMP_GZIP || image_comp == IH_COMP_LZMA))
+		    (image_comp == IH_COMP_GZIP || image_comp == IH_COMP_LZMA ||
+		     image_comp == IH_COMP_LZ4 || image_comp == IH_COMP_ZSTD))
 			src_ptr = map_sysmem(ALIGN(CONFIG_SYS_LOAD_ADDR, ARCH_DMA_MINALIGN), len);
 		else
 			src_ptr = map_sysmem(ALIGN(load_addr, ARCH_DMA_MINALIGN), len);
@@ -352,10 +366,22 @@ static int load_simple_fit(struct spl_load_info *info, ulong fit_offset,
 			return -EIO;
 		}
 		length = loadEnd - CONFIG_SYS_LOAD_ADDR;
+	} else if ((IS_ENABLED(CONFIG_SPL_LZ4) && image_comp == IH_COMP_LZ4) ||
+		   (IS_ENABLED(CONFIG_SPL_ZSTD) && image_comp == IH_COMP_ZSTD)) {
+		ulong load_end;
+
+		if (image_decomp(image_comp, load_addr, 0, 0, load_ptr, src,
+				 length, CONFIG_SYS_BOOTM_LEN, &load_end)) {
+			puts("Uncompressing error\n");
+			return -EIO;
+		}
+		length = load_end - load_addr;
 	} else {
 		memmove(load_ptr, src, length);
 	}
 
+loaded:
+	bootstage_mark_name(BOOTSTAGE_ID_ALLOC, fit_get_name(fit, node, NULL));
 	if (image_info) {
 		ulong entry_point;
 
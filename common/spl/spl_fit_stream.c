@@ -0,0 +1,389 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Decompressing FIT images in SPL while they are read
+ *
+ * With CONFIG_SPL_FIT_STREAM, a compressed image with external data is read
+ * from the boot medium a window at a time. Each window is passed straight to
+ * the decompressor, which writes to the image's load address, so the whole
+ * compressed image is never staged in memory and is only passed over once.
+ */
+
+#include <gzip.h>
+#include <image.h>
+#include <log.h>
+#include <malloc.h>
+#include <memalign.h>
+#include <spl.h>
+#include <asm/unaligned.h>
+#include <linux/kernel.h>
+#include <linux/zstd.h>
+#include <lzma/LzmaTypes.h>
+#include <lzma/LzmaDec.h>
+#include <u-boot/lz4.h>
+#include <u-boot/zlib.h>
+
+/* LZ4 frame flags, see lib/lz4_wrapper.c */
+#define LZ4F_BLOCKUNCOMPRESSED_FLAG	0x80000000U
+#define LZ4F_INDEPENDENT_BLOCKS		BIT(5)
+#define LZ4F_BLOCK_CHECKSUM		BIT(4)
+#define LZ4F_CONTENT_SIZE		BIT(3)
+
+/* Size of the window, which tests can change to try different sizes */
+static ulong spl_fit_stream_window = CONFIG_SPL_FIT_STREAM_WINDOW;
+
+void spl_fit_stream_set_window(ulong size)
+{
+	spl_fit_stream_window = size;
+}
+
+/**
+ * struct spl_fit_stream - state of an image being read
+ *
+ * @info: How to read from the boot medium
+ * @pos: Offset on the medium of the next read. This is aligned to the block
+ *	length after the first read
+ * @left: Number of bytes of compressed data not yet read
+ * @win: Window which the compressed data is read into
+ * @in: Next byte in @win not yet used by the decompressor
+ * @avail: Number of bytes at @in
+ */
+struct spl_fit_stream {
+	struct spl_load_info *info;
+	ulong pos;
+	ulong left;
+	u8 *win;
+	u8 *in;
+	ulong avail;
+};
+
+/**
+ * spl_fit_stream_fill() - Read more compressed data into the window
+ *
+ * Any data not yet used is moved down so that it ends just before the new
+ * data, which is read to an aligned address
+ *
+ * @st: Stream to fill
+ * Return: 0 if OK, -ENODATA if all the data has been read, -ENOSPC if the
+ *	window is full, -EIO on read error
+ */
+static int spl_fit_stream_fill(struct spl_fit_stream *st)
+{
+	ulong bl_len = spl_get_bl_len(st->info);
+	ulong skip = st->pos % bl_len;
+	ulong keep, size, len;
+	u8 *dst;
+
+	if (!st->left)
+		return -ENODATA;
+	keep = ALIGN(st->avail, ARCH_DMA_MINALIGN);
+	if (keep + bl_len > spl_fit_stream_window)
+		return -ENOSPC;
+	dst = st->win + keep;
+	memmove(dst - st->avail, st->in, st->avail);
+
+	size = ALIGN_DOWN(spl_fit_stream_window - keep, bl_len);
+	size = min(size, ALIGN(skip + st->left, bl_len));
+	len = min(size - skip, st->left);
+	if (st->info->read(st->info, st->pos - skip, size, dst) < skip + len)
+		return -EIO;
+
+	/* Only the first read can start part-way through a block */
+	st->in = dst - st->avail + skip;
+	st->avail += len;
+	st->pos += size - skip;
+	st->left -= len;
+
+	return 0;
+}
+
+/* Makes sure that there are at least @need bytes in the window */
+static int spl_fit_stream_need(struct spl_fit_stream *st, ulong need)
+{
+	int ret;
+
+	while (st->avail < need) {
+		ret = spl_fit_stream_fill(st);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+static void spl_fit_stream_skip(struct spl_fit_stream *st, ulong len)
+{
+	st->in += len;
+	st->avail -= len;
+}
+
+static int spl_fit_stream_gzip(struct spl_fit_stream *st, void *dst,
+			       ulong *sizep)
+{
+	z_stream s;
+	int ret, r;
+
+	ret = spl_fit_stream_fill(st);
+	if (ret)
+		return ret;
+	r = gzip_parse_header(st->in, st->avail);
+	if (r < 0)
+		return -EINVAL;
+	spl_fit_stream_skip(st, r);
+
+	memset(&s, '\0', sizeof(s));
+	s.zalloc = gzalloc;
+	s.zfree = gzfree;
+	/* Nothing has been written yet, so the image can still be loaded */
+	if (inflateInit2(&s, -MAX_WBITS) != Z_OK)
+		return -EAGAIN;
+	s.next_out = dst;
+	s.avail_out = *sizep;
+	do {
+		if (!st->avail) {
+			ret = spl_fit_stream_fill(st);
+			if (ret)
+				break;
+		}
+		s.next_in = st->in;
+		s.avail_in = st->avail;
+		r = inflate(&s, Z_NO_FLUSH);
+		spl_fit_stream_skip(st, st->avail - s.avail_in);
+		if (r != Z_OK && r != Z_STREAM_END) {
+			log_debug("inflate() returned %d\n", r);
+			ret = -EIO;
+			break;
+		}
+	} while (r != Z_STREAM_END);
+	*sizep = s.next_out - (u8 *)dst;
+	inflateEnd(&s);
+
+	return ret;
+}
+
+static void *spl_fit_lzma_alloc(ISzAllocPtr p, size_t size)
+{
+	return malloc(size);
+}
+
+static void spl_fit_lzma_free(ISzAllocPtr p, void *address)
+{
+	free(address);
+}
+
+static int spl_fit_stream_lzma(struct spl_fit_stream *st, void *dst,
+			       ulong *sizep)
+{
+	ISzAlloc alloc = { spl_fit_lzma_alloc, spl_fit_lzma_free };
+	ELzmaStatus status;
+	SizeT limit, len;
+	CLzmaDec dec;
+	u64 out_size;
+	int ret;
+
+	/* The header has the properties and then the uncompressed size */
+	ret = spl_fit_stream_need(st, LZMA_PROPS_SIZE + sizeof(u64));
+	if (ret)
+		return ret;
+	limit = *sizep;
+	out_size = get_unaligned_le64(st->in + LZMA_PROPS_SIZE);
+	if (out_size != (u64)-1) {
+		if (out_size > limit)
+			return -ENOSPC;
+		limit = out_size;
+	}
+
+	LzmaDec_Construct(&dec);
+	if (LzmaDec_AllocateProbs(&dec, st->in, LZMA_PROPS_SIZE, &alloc))
+		return -EAGAIN;
+	spl_fit_stream_skip(st, LZMA_PROPS_SIZE + sizeof(u64));
+	dec.dic = dst;
+	dec.dicBufSize = limit;
+	LzmaDec_Init(&dec);
+	do {
+		if (!st->avail) {
+			ret = spl_fit_stream_fill(st);
+			if (ret)
+				break;
+		}
+		len = st->avail;
+		if (LzmaDec_DecodeToDic(&dec, limit, st->in, &len,
+					LZMA_FINISH_ANY, &status)) {
+			ret = -EIO;
+			break;
+		}
+		spl_fit_stream_skip(st, len);
+	} while (status == LZMA_STATUS_NEEDS_MORE_INPUT ||
+		 (status == LZMA_STATUS_NOT_FINISHED && dec.dicPos < limit));
+	*sizep = dec.dicPos;
+	LzmaDec_FreeProbs(&dec, &alloc);
+
+	return ret;
+}
+
+static int spl_fit_stream_lz4(struct spl_fit_stream *st, void *dst,
+			      ulong *sizep)
+{
+	u8 *out = dst, *end = dst + *sizep;
+	ulong hdr_len, max_block, need;
+	u32 block, size;
+	u8 flags;
+	int ret;
+
+	ret = spl_fit_stream_need(st, 7);
+	if (ret)
+		return ret;
+	flags = st->in[4];
+	if (get_unaligned_le32(st->in) != LZ4F_MAGIC || (flags >> 6) != 1 ||
+	    (flags & 0x03) || (st->in[5] & 0x8f))
+		return -EINVAL;
+	if (!(flags & LZ4F_INDEPENDENT_BLOCKS))
+		return -EPROTONOSUPPORT;
+	hdr_len = flags & LZ4F_CONTENT_SIZE ? 15 : 7;
+
+	/* Each block must fit in the window, along with its header */
+	max_block = 1UL << (8 + 2 * (st->in[5] >> 4));
+	if (max_block + 2 * sizeof(u32) + ARCH_DMA_MINALIGN +
+	    spl_get_bl_len(st->info) > spl_fit_stream_window) {
+		log_debug("LZ4 blocks of %lx do not fit in the window\n",
+			  max_block);
+		return -EAGAIN;
+	}
+	ret = spl_fit_stream_need(st, hdr_len);
+	if (ret)
+		return ret;
+	spl_fit_stream_skip(st, hdr_len);
+
+	while (1) {
+		ret = spl_fit_stream_need(st, sizeof(u32));
+		if (ret)
+			break;
+		block = get_unaligned_le32(st->in);
+		size = block & ~LZ4F_BLOCKUNCOMPRESSED_FLAG;
+		if (!size)
+			break;
+		if (size > max_block) {
+			ret = -EINVAL;
+			break;
+		}
+		need = sizeof(u32) + size;
+		if (flags & LZ4F_BLOCK_CHECKSUM)
+			need += sizeof(u32);
+		ret = spl_fit_stream_need(st, need);
+		if (ret)
+			break;
+
+		if (block & LZ4F_BLOCKUNCOMPRESSED_FLAG) {
+			if (size > end - out) {
+				ret = -ENOSPC;
+				break;
+			}
+			memcpy(out, st->in + sizeof(u32), size);
+			out += size;
+		} else {
+			ret = LZ4_decompress_safe((char *)st->in + sizeof(u32),
+						  (char *)out, size,
+						  min_t(ulong, end - out,
+							INT_MAX));
+			if (ret < 0) {
+				ret = -EIO;
+				break;
+			}
+			out += ret;
+			ret = 0;
+		}
+		spl_fit_stream_skip(st, need);
+	}
+	*sizep = out - (u8 *)dst;
+
+	return ret;
+}
+
+static int spl_fit_stream_zstd(struct spl_fit_stream *st, void *dst,
+			       ulong *sizep)
+{
+	zstd_out_buffer out = { .dst = dst, .size = *sizep };
+	zstd_in_buffer in;
+	zstd_dstream *ds;
+	size_t wsize, r;
+	void *ws;
+	int ret = 0;
+
+	/*
+	 * With a stable output buffer, the data is written straight to @dst,
+	 * so the only buffer needed is for input, holding up to one block
+	 */
+	wsize = ZSTD_estimateDCtxSize() + ZSTD_BLOCKSIZE_MAX;
+	ws = malloc(wsize);
+	if (!ws)
+		return -EAGAIN;
+	ds = ZSTD_initStaticDStream(ws, wsize);
+	if (!ds ||
+	    zstd_is_error(ZSTD_DCtx_setParameter(ds, ZSTD_d_stableOutBuffer,
+						 1))) {
+		ret = -EINVAL;
+		goto err;
+	}
+
+	do {
+		if (!st->avail) {
+			ret = spl_fit_stream_fill(st);
+			if (ret)
+				break;
+		}
+		in.src = st->in;
+		in.size = st->avail;
+		in.pos = 0;
+		r = zstd_decompress_stream(ds, &out, &in);
+		spl_fit_stream_skip(st, in.pos);
+		if (zstd_is_error(r)) {
+			log_debug("zstd error %d\n", zstd_get_error_code(r));
+			ret = -EIO;
+			break;
+		}
+	} while (r);
+	*sizep = out.pos;
+err:
+	free(ws);
+
+	return ret;
+}
+
+int spl_fit_stream_load(struct spl_load_info *info, ulong offset, ulong len,
+			int comp, void *dst, ulong *sizep)
+{
+	int (*decomp)(struct spl_fit_stream *st, void *dst, ulong *sizep);
+	struct spl_fit_stream st;
+	int ret;
+
+	if (CONFIG_IS_ENABLED(GZIP) && comp == IH_COMP_GZIP)
+		decomp = spl_fit_stream_gzip;
+	else if (CONFIG_IS_ENABLED(LZMA) && comp == IH_COMP_LZMA)
+		decomp = spl_fit_stream_lzma;
+	else if (CONFIG_IS_ENABLED(LZ4) && comp == IH_COMP_LZ4)
+		decomp = spl_fit_stream_lz4;
+	else if (CONFIG_IS_ENABLED(ZSTD) && comp == IH_COMP_ZSTD)
+		decomp = spl_fit_stream_zstd;
+	else
+		return -EAGAIN;
+
+	st.info = info;
+	st.pos = offset;
+	st.left = len;
+	st.avail = 0;
+	st.win = malloc_cache_aligned(spl_fit_stream_window);
+	if (!st.win)
+		return -EAGAIN;
+	st.in = st.win;
+
+	ret = decomp(&st, dst, sizep);
+	free(st.win);
+	if (ret == -EAGAIN)
+		return ret;
+	if (ret) {
+		printf("Uncompressing error %d\n", ret);
+		return -EIO;
+	}
+	log_debug("streamed %lx bytes to %p, size %lx\n", len, dst, *sizep);
+
+	return 0;
+}
@@ -21,6 +21,7 @@
  * Probes device for being a hub and configurate it
  */
 
+#include <bootdev.h>
 #include <command.h>
 #include <dm.h>
 #include <env.h>
@@ -584,6 +585,16 @@ static int usb_device_list_scan(void)
 		if (list_empty(&usb_scan_list))
 			goto out;
 
+		/* Stop waiting for ports to connect once bootdev hunting expires */
+		if (bootdev_hunt_expired()) {
+			list_for_each_entry_safe(usb_scan, tmp, &usb_scan_list,
+						 list) {
+				list_del(&usb_scan->list);
+				free(usb_scan);
+			}
+			goto out;
+		}
+
 		list_for_each_entry_safe(usb_scan, tmp, &usb_scan_list, list) {
 			int ret;
 
@@ -10,6 +10,7 @@
 #include <dm.h>
 #include <log.h>
 #include <malloc.h>
+#include <memalign.h>
 #include <part.h>
 #include <dm/device-internal.h>
 #include <dm/lists.h>
@@ -322,13 +323,28 @@ int blk_show_device(enum uclass_id uclass_id, int devnum)
 int blk_select_hwpart(struct udevice *dev, int hwpart)
 {
 	const struct blk_ops *ops = blk_get_ops(dev);
+	struct blk_desc *desc;
+	int ret;
 
 	if (!ops)
 		return -ENOSYS;
 	if (!ops->select_hwpart)
 		return 0;
 
-	return ops->select_hwpart(dev, hwpart);
+	desc = dev_get_uclass_plat(dev);
+	if (desc->hwpart == hwpart)
+		return ops->select_hwpart(dev, hwpart);
+
+	/* dirty blocks belong to the hardware partition selected now */
+	ret = blkcache_flush(desc->uclass_id, desc->devnum);
+	if (ret)
+		return ret;
+	ret = ops->select_hwpart(dev, hwpart);
+	if (ret)
+		return ret;
+	blkcache_invalidate(desc->uclass_id, desc->devnum);
+
+	return 0;
 }
 
 int blk_dselect_hwpart(struct blk_desc *desc, int hwpart)
@@ -429,19 +445,13 @@ static int blk_buffer_aligned(struct bounce_buffer *state)
 	return 1;	/* Default, any buffer is OK */
 }
 
-long blk_read(struct udevice *dev, lbaint_t start, lbaint_t blkcnt, void *buf)
+static long blk_read_dev(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
+			 void *buf)
 {
 	struct blk_desc *desc = dev_get_uclass_plat(dev);
 	const struct blk_ops *ops = blk_get_ops(dev);
 	ulong blks_read;
 
-	if (!ops->read)
-		return -ENOSYS;
-
-	if (blkcache_read(desc->uclass_id, desc->devnum,
-			  start, blkcnt, desc->blksz, buf))
-		return blkcnt;
-
 	if (IS_ENABLED(CONFIG_BOUNCE_BUFFER) && desc->bb) {
 		struct blk_bounce_buffer bbstate = { .dev = dev };
 		int ret;
@@ -460,6 +470,67 @@ long blk_read(struct udevice *dev, lbaint_t start, lbaint_t blkcnt, void *buf)
 		blks_read = ops->read(dev, start, blkcnt, buf);
 	}
 
+	return blks_read;
+}
+
+/*
+ * Reads @ra_blkcnt blocks into a temporary buffer so that the blocks following
+ * the request end up in the block cache. Returns -ENOMEM if the buffer cannot
+ * be allocated, in which case the caller reads just what was asked for.
+ */
+static long blk_read_ahead(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
+			   lbaint_t ra_blkcnt, void *buf)
+{
+	struct blk_desc *desc = dev_get_uclass_plat(dev);
+	long blks_read;
+	void *ra_buf;
+
+	ra_buf = malloc_cache_aligned(ra_blkcnt * desc->blksz);
+	if (!ra_buf)
+		return -ENOMEM;
+
+	blks_read = blk_read_dev(dev, start, ra_blkcnt, ra_buf);
+	if (blks_read == ra_blkcnt) {
+		blkcache_fill(desc->uclass_id, desc->devnum, start, ra_blkcnt,
+			      desc->blksz, ra_buf);
+		blks_read = blkcnt;
+	} else if (blks_read > (long)blkcnt) {
+		blks_read = blkcnt;
+	}
+	if (blks_read > 0)
+		memcpy(buf, ra_buf, blks_read * desc->blksz);
+	free(ra_buf);
+
+	return blks_read;
+}
+
+long blk_read(struct udevice *dev, lbaint_t start, lbaint_t blkcnt, void *buf)
+{
+	struct blk_desc *desc = dev_get_uclass_plat(dev);
+	const struct blk_ops *ops = blk_get_ops(dev);
+	lbaint_t ra_blkcnt;
+	ulong blks_read;
+	int ret;
+
+	if (!ops->read)
+		return -ENOSYS;
+
+	ret = blkcache_read(desc->uclass_id, desc->devnum,
+			    start, blkcnt, desc->blksz, buf);
+	if (ret)
+		return ret < 0 ? ret : blkcnt;
+
+	ra_blkcnt = blkcache_readahead(desc->uclass_id, desc->devnum, start,
+				       blkcnt, desc->blksz);
+	/* Never read ahead past the end of the device */
+	if (ra_blkcnt > blkcnt && start + ra_blkcnt <= desc->lba) {
+		long ret = blk_read_ahead(dev, start, blkcnt, ra_blkcnt, buf);
+
+		if (ret != -ENOMEM)
+			return ret;
+	}
+
+	blks_read = blk_read_dev(dev, start, blkcnt, buf);
 	if (blks_read == blkcnt)
 		blkcache_fill(desc->uclass_id, desc->devnum, start, blkcnt,
 			      desc->blksz, buf);
@@ -467,18 +538,13 @@ long blk_read(struct udevice *dev, lbaint_t start, lbaint_t blkcnt, void *buf)
 	return blks_read;
 }
 
-long blk_write(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
-	       const void *buf)
+static long blk_write_dev(struct udevice *dev, lbaint_t start,
+			  lbaint_t blkcnt, const void *buf)
 {
 	struct blk_desc *desc = dev_get_uclass_plat(dev);
 	const struct blk_ops *ops = blk_get_ops(dev);
 	long blks_written;
 
-	if (!ops->write)
-		return -ENOSYS;
-
-	blkcache_invalidate(desc->uclass_id, desc->devnum);
-
 	if (IS_ENABLED(CONFIG_BOUNCE_BUFFER) && desc->bb) {
 		struct blk_bounce_buffer bbstate = { .dev = dev };
 		int ret;
@@ -501,19 +567,64 @@ long blk_write(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
 	return blks_written;
 }
 
+/* Writes back blocks held in the block cache */
+static long blk_write_back(void *priv, lbaint_t start, lbaint_t blkcnt,
+			   const void *buf)
+{
+	return blk_write_dev(priv, start, blkcnt, buf);
+}
+
+long blk_write(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
+	       const void *buf)
+{
+	struct blk_desc *desc = dev_get_uclass_plat(dev);
+	const struct blk_ops *ops = blk_get_ops(dev);
+	int ret;
+
+	if (!ops->write)
+		return -ENOSYS;
+
+	if (!desc->cache_sync) {
+		ret = blkcache_write(desc->uclass_id, desc->devnum, start,
+				     blkcnt, desc->blksz, buf, blk_write_back,
+				     dev);
+		if (ret)
+			return ret < 0 ? ret : blkcnt;
+	}
+
+	/* earlier writes held in the cache must reach the device first */
+	ret = blkcache_flush(desc->uclass_id, desc->devnum);
+	if (ret)
+		return ret;
+	blkcache_invalidate(desc->uclass_id, desc->devnum);
+
+	return blk_write_dev(dev, start, blkcnt, buf);
+}
+
 long blk_erase(struct udevice *dev, lbaint_t start, lbaint_t blkcnt)
 {
 	struct blk_desc *desc = dev_get_uclass_plat(dev);
 	const struct blk_ops *ops = blk_get_ops(dev);
+	int ret;
 
 	if (!ops->erase)
 		return -ENOSYS;
 
+	ret = blkcache_flush(desc->uclass_id, desc->devnum);
+	if (ret)
+		return ret;
 	blkcache_invalidate(desc->uclass_id, desc->devnum);
 
 	return ops->erase(dev, start, blkcnt);
 }
 
+int blk_flush(struct udevice *dev)
+{
+	struct blk_desc *desc = dev_get_uclass_plat(dev);
+
+	return blkcache_flush(desc->uclass_id, desc->devnum);
+}
+
 ulong blk_dread(struct blk_desc *desc, lbaint_t start, lbaint_t blkcnt,
 		void *buffer)
 {
@@ -531,6 +642,11 @@ ulong blk_derase(struct blk_desc *desc, lbaint_t start, lbaint_t blkcnt)
 	return blk_erase(desc->bdev, start, blkcnt);
 }
 
+int blk_dflush(struct blk_desc *desc)
+{
+	return blk_flush(desc->bdev);
+}
+
 int blk_find_from_parent(struct udevice *parent, struct udevice **devp)
 {
 	struct udevice *dev;
@@ -841,9 +957,20 @@ static int blk_post_probe(struct udevice *dev)
 	return 0;
 }
 
+static int blk_pre_remove(struct udevice *dev)
+{
+	struct blk_desc *desc = dev_get_uclass_plat(dev);
+
+	/* write back dirty blocks while the device is still usable */
+	blkcache_invalidate(desc->uclass_id, desc->devnum);
+
+	return 0;
+}
+
 UCLASS_DRIVER(blk) = {
 	.id		= UCLASS_BLK,
 	.name		= "blk",
 	.post_probe	= blk_post_probe,
+	.pre_remove	= blk_pre_remove,
 	.per_device_plat_auto	= sizeof(struct blk_desc),
 };
@@ -5,61 +5,283 @@
  *
  */
 #include <blk.h>
+#include <div64.h>
+#include <errno.h>
 #include <log.h>
 #include <malloc.h>
 #include <part.h>
+#include <sort.h>
 #include <asm/global_data.h>
 #include <linux/ctype.h>
+#include <linux/err.h>
 #include <linux/list.h>
 
-struct block_cache_node {
+#define BLKCACHE_HASH_BITS	6
+
+/*
+ * Each device is split into chunks of max_blocks_per_entry blocks. An entry
+ * caches one contiguous range of blocks inside a single chunk, and is found
+ * through a per-device hash table indexed by chunk number. A read covering
+ * several chunks, or only part of an entry, is a hit as long as every block
+ * it needs is cached.
+ *
+ * With CONFIG_BLOCK_CACHE_WRITEBACK, writes can be kept in the cache as dirty
+ * blocks instead. They are written back when their entry is evicted, before
+ * the device reads them, or by blkcache_flush(), which sorts the dirty entries
+ * of a device by block number and merges contiguous ones into a single write.
+ */
+
+/**
+ * struct block_cache_dev - cache state of a block device
+ *
+ * @lh:		entry in the list of devices
+ * @iftype:	uclass_id of the device
+ * @devnum:	device index of particular type
+ * @blksz:	size in bytes of each block
+ * @buckets:	entries of the device, hashed by chunk number
+ * @next:	block following the last read, to detect sequential access
+ * @ra_blocks:	current read-ahead window in blocks, 0 if not sequential
+ * @dirty:	number of entries holding blocks not yet written to the device
+ * @write:	function writing dirty blocks back to the device
+ * @priv:	private data for @write
+ */
+struct block_cache_dev {
 	struct list_head lh;
 	int iftype;
 	int devnum;
+	unsigned long blksz;
+	struct hlist_head buckets[1 << BLKCACHE_HASH_BITS];
+	lbaint_t next;
+	lbaint_t ra_blocks;
+	unsigned int dirty;
+	blkcache_write_t write;
+	void *priv;
+};
+
+/**
+ * struct block_cache_node - cached blocks of a chunk
+ *
+ * @lh:		entry in the LRU list, most recently used first
+ * @hash:	entry in the hash bucket of @chunk
+ * @cdev:	device the blocks belong to
+ * @chunk:	chunk number
+ * @start:	first cached block
+ * @blkcnt:	number of cached blocks
+ * @dstart:	first block not yet written to the device
+ * @dblkcnt:	number of blocks not yet written to the device, 0 if clean
+ * @size:	size of @cache in bytes
+ * @cache:	cached data, laid out as the whole chunk
+ */
+struct block_cache_node {
+	struct list_head lh;
+	struct hlist_node hash;
+	struct block_cache_dev *cdev;
+	lbaint_t chunk;
 	lbaint_t start;
 	lbaint_t blkcnt;
-	unsigned long blksz;
+	lbaint_t dstart;
+	lbaint_t dblkcnt;
+	unsigned long size;
 	char *cache;
 };
 
 static LIST_HEAD(block_cache);
+static LIST_HEAD(block_cache_devs);
 
 static struct block_cache_stats _stats = {
 	.max_blocks_per_entry = 8,
 	.max_entries = 32
 };
 
-static struct block_cache_node *cache_find(int iftype, int devnum,
-					   lbaint_t start, lbaint_t blkcnt,
-					   unsigned long blksz)
+static struct hlist_head *cache_bucket(struct block_cache_dev *cdev,
+				       lbaint_t chunk)
+{
+	return &cdev->buckets[((u32)chunk * 0x9e3779b9) >>
+			      (32 - BLKCACHE_HASH_BITS)];
+}
+
+static lbaint_t cache_chunk(lbaint_t blk)
+{
+	return lldiv(blk, _stats.max_blocks_per_entry);
+}
+
+static lbaint_t cache_chunk_start(lbaint_t chunk)
+{
+	return chunk * _stats.max_blocks_per_entry;
+}
+
+static struct block_cache_dev *cache_find_dev(int iftype, int devnum)
+{
+	struct block_cache_dev *cdev;
+
+	list_for_each_entry(cdev, &block_cache_devs, lh)
+		if (cdev->iftype == iftype && cdev->devnum == devnum)
+			return cdev;
+
+	return NULL;
+}
+
+static struct block_cache_dev *cache_get_dev(int iftype, int devnum,
+					     unsigned long blksz)
+{
+	struct block_cache_dev *cdev;
+	int i;
+
+	cdev = cache_find_dev(iftype, devnum);
+	if (cdev && cdev->blksz != blksz) {
+		blkcache_invalidate(iftype, devnum);
+		cdev = NULL;
+	}
+	if (cdev)
+		return cdev;
+
+	cdev = calloc(1, sizeof(*cdev));
+	if (!cdev)
+		return NULL;
+
+	cdev->iftype = iftype;
+	cdev->devnum = devnum;
+	cdev->blksz = blksz;
+	for (i = 0; i < ARRAY_SIZE(cdev->buckets); i++)
+		INIT_HLIST_HEAD(&cdev->buckets[i]);
+	list_add(&cdev->lh, &block_cache_devs);
+
+	return cdev;
+}
+
+static struct block_cache_node *cache_find(struct block_cache_dev *cdev,
+					   lbaint_t chunk)
 {
 	struct block_cache_node *node;
 
-	list_for_each_entry(node, &block_cache, lh)
-		if ((node->iftype == iftype) &&
-		    (node->devnum == devnum) &&
-		    (node->blksz == blksz) &&
-		    (node->start <= start) &&
-		    (node->start + node->blkcnt >= start + blkcnt)) {
+	hlist_for_each_entry(node, cache_bucket(cdev, chunk), hash)
+		if (node->chunk == chunk)
+			return node;
+
+	return NULL;
+}
+
+static void *cache_data(struct block_cache_node *node, lbaint_t blk)
+{
+	return node->cache +
+		(blk - cache_chunk_start(node->chunk)) * node->cdev->blksz;
+}
+
+static void cache_drop(struct block_cache_node *node)
+{
+	if (node->dblkcnt) {
+		--node->cdev->dirty;
+		--_stats.dirty;
+	}
+	hlist_del(&node->hash);
+	list_del(&node->lh);
+	free(node->cache);
+	free(node);
+	--_stats.entries;
+}
+
+static int cache_write_dev(struct block_cache_dev *cdev, lbaint_t start,
+			   lbaint_t blkcnt, const void *buffer)
+{
+	long ret;
+
+	debug("write back: start " LBAF ", count " LBAFU "\n", start, blkcnt);
+	ret = cdev->write(cdev->priv, start, blkcnt, buffer);
+	++_stats.writebacks;
+	if (ret < 0)
+		return ret;
+
+	return ret == blkcnt ? 0 : -EIO;
+}
+
+static void cache_clean(struct block_cache_node *node)
+{
+	node->dblkcnt = 0;
+	--node->cdev->dirty;
+	--_stats.dirty;
+}
+
+static int cache_writeback(struct block_cache_node *node)
+{
+	int ret;
+
+	if (!node->dblkcnt)
+		return 0;
+
+	ret = cache_write_dev(node->cdev, node->dstart, node->dblkcnt,
+			      cache_data(node, node->dstart));
+	if (ret)
+		return ret;
+	cache_clean(node);
+
+	return 0;
+}
+
+/* Writes back the dirty blocks of @cdev which overlap [start, end) */
+static int cache_writeback_range(struct block_cache_dev *cdev, lbaint_t start,
+				 lbaint_t end)
+{
+	struct block_cache_node *node;
+	int i, ret;
+
+	for (i = 0; cdev->dirty && i < ARRAY_SIZE(cdev->buckets); i++) {
+		hlist_for_each_entry(node, &cdev->buckets[i], hash) {
+			if (!node->dblkcnt || node->dstart >= end ||
+			    node->dstart + node->dblkcnt <= start)
+				continue;
+			ret = cache_writeback(node);
+			if (ret)
+				return ret;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Checks whether [start, start + blkcnt) is entirely cached. If @buffer is not
+ * NULL the blocks are also copied to it, so this must only be done once the
+ * range is known to be a hit. Returns true on a hit.
+ */
+static bool cache_walk(struct block_cache_dev *cdev, lbaint_t start,
+		       lbaint_t blkcnt, void *buffer)
+{
+	lbaint_t blk, next, end = start + blkcnt;
+	struct block_cache_node *node;
+
+	for (blk = start; blk < end; blk = next) {
+		node = cache_find(cdev, cache_chunk(blk));
+		next = min(end, cache_chunk_start(cache_chunk(blk)) +
+			   _stats.max_blocks_per_entry);
+		if (!node || node->start > blk ||
+		    node->start + node->blkcnt < next)
+			return false;
+
+		if (buffer) {
+			memcpy(buffer + (blk - start) * cdev->blksz,
+			       node->cache + (blk - cache_chunk_start(node->chunk)) *
+			       cdev->blksz, (next - blk) * cdev->blksz);
 			if (block_cache.next != &node->lh) {
 				/* maintain MRU ordering */
 				list_del(&node->lh);
 				list_add(&node->lh, &block_cache);
 			}
-			return node;
 		}
-	return 0;
+	}
+
+	return true;
 }
 
 int blkcache_read(int iftype, int devnum,
 		  lbaint_t start, lbaint_t blkcnt,
 		  unsigned long blksz, void *buffer)
 {
-	struct block_cache_node *node = cache_find(iftype, devnum, start,
-						   blkcnt, blksz);
-	if (node) {
-		const char *src = node->cache + (start - node->start) * blksz;
-		memcpy(buffer, src, blksz * blkcnt);
+	struct block_cache_dev *cdev = cache_find_dev(iftype, devnum);
+
+	if (cdev && cdev->blksz == blksz &&
+	    cache_walk(cdev, start, blkcnt, NULL)) {
+		cache_walk(cdev, start, blkcnt, buffer);
+		cdev->next = start + blkcnt;
 		debug("hit: start " LBAF ", count " LBAFU "\n",
 		      start, blkcnt);
 		++_stats.hits;
@@ -69,76 +291,363 @@ int blkcache_read(int iftype, int devnum,
 	debug("miss: start " LBAF ", count " LBAFU "\n",
 	      start, blkcnt);
 	++_stats.misses;
+
+	/* the device must not return blocks older than the cached ones */
+	if (cdev && cdev->dirty)
+		return cache_writeback_range(cdev, start, start + blkcnt);
+
 	return 0;
 }
 
-void blkcache_fill(int iftype, int devnum,
-		   lbaint_t start, lbaint_t blkcnt,
-		   unsigned long blksz, void const *buffer)
+/* Largest read-ahead window, so that read-ahead cannot thrash the cache */
+static lbaint_t cache_max_readahead(void)
 {
-	lbaint_t bytes;
-	struct block_cache_node *node;
+	return (lbaint_t)_stats.max_entries * _stats.max_blocks_per_entry / 4;
+}
 
-	/* don't cache big stuff */
-	if (blkcnt > _stats.max_blocks_per_entry)
-		return;
+lbaint_t blkcache_readahead(int iftype, int devnum, lbaint_t start,
+			    lbaint_t blkcnt, unsigned long blksz)
+{
+	lbaint_t max = cache_max_readahead();
+	struct block_cache_dev *cdev;
 
-	if (_stats.max_entries == 0)
-		return;
+	if (!max || blkcnt >= max)
+		return blkcnt;
+
+	cdev = cache_get_dev(iftype, devnum, blksz);
+	if (!cdev)
+		return blkcnt;
+
+	/*
+	 * Start with one chunk once two reads in a row are contiguous, then
+	 * double the window for as long as the access stays sequential.
+	 */
+	if (start == cdev->next && start)
+		cdev->ra_blocks = cdev->ra_blocks ?
+			min(cdev->ra_blocks * 2, max) :
+			min((lbaint_t)_stats.max_blocks_per_entry, max);
+	else
+		cdev->ra_blocks = 0;
+	cdev->next = start + blkcnt;
+
+	if (cdev->ra_blocks <= blkcnt)
+		return blkcnt;
+
+	++_stats.readaheads;
+
+	return cdev->ra_blocks;
+}
+
+/* Reads bigger than this are bulk data which would only flush the cache */
+static lbaint_t cache_max_fill(void)
+{
+	return (lbaint_t)_stats.max_entries * _stats.max_blocks_per_entry / 2;
+}
+
+static struct block_cache_node *cache_alloc_node(unsigned long size)
+{
+	struct block_cache_node *node;
+	int ret;
 
-	bytes = blksz * blkcnt;
 	if (_stats.max_entries <= _stats.entries) {
 		/* pop LRU */
-		node = (struct block_cache_node *)block_cache.prev;
-		list_del(&node->lh);
-		_stats.entries--;
+		node = list_last_entry(&block_cache, struct block_cache_node,
+				       lh);
+		ret = cache_writeback(node);
+		if (ret)
+			return ERR_PTR(ret);
 		debug("drop: start " LBAF ", count " LBAFU "\n",
 		      node->start, node->blkcnt);
-		if (node->blkcnt * node->blksz < bytes) {
+		hlist_del(&node->hash);
+		list_del(&node->lh);
+		_stats.entries--;
+		if (node->size < size) {
 			free(node->cache);
-			node->cache = 0;
+			node->cache = NULL;
 		}
 	} else {
 		node = malloc(sizeof(*node));
 		if (!node)
-			return;
-		node->cache = 0;
+			return ERR_PTR(-ENOMEM);
+		node->cache = NULL;
 	}
 
 	if (!node->cache) {
-		node->cache = malloc(bytes);
+		node->cache = malloc(size);
 		if (!node->cache) {
 			free(node);
-			return;
+			return ERR_PTR(-ENOMEM);
 		}
+		node->size = size;
 	}
 
-	debug("fill: start " LBAF ", count " LBAFU "\n",
-	      start, blkcnt);
+	return node;
+}
+
+/*
+ * Returns the entry of @chunk with its cached range extended to cover
+ * [blk, next), allocating it if needed. An entry whose range is disjoint from
+ * [blk, next) is written back and then reused. The entry is taken off the LRU
+ * list, so the caller must put it back once the blocks are copied in.
+ */
+static struct block_cache_node *cache_extend(struct block_cache_dev *cdev,
+					     lbaint_t chunk, lbaint_t blk,
+					     lbaint_t next)
+{
+	struct block_cache_node *node;
+	int ret;
+
+	node = cache_find(cdev, chunk);
+	if (node) {
+		if (blk <= node->start + node->blkcnt &&
+		    node->start <= next) {
+			/* extend the cached range */
+			lbaint_t first = min(blk, node->start);
+
+			node->blkcnt = max(next, node->start +
+					   node->blkcnt) - first;
+			node->start = first;
+		} else {
+			ret = cache_writeback(node);
+			if (ret)
+				return ERR_PTR(ret);
+			node->start = blk;
+			node->blkcnt = next - blk;
+		}
+		list_del(&node->lh);
 
-	node->iftype = iftype;
-	node->devnum = devnum;
-	node->start = start;
-	node->blkcnt = blkcnt;
-	node->blksz = blksz;
-	memcpy(node->cache, buffer, bytes);
-	list_add(&node->lh, &block_cache);
+		return node;
+	}
+
+	node = cache_alloc_node(_stats.max_blocks_per_entry * cdev->blksz);
+	if (IS_ERR(node))
+		return node;
+
+	node->cdev = cdev;
+	node->chunk = chunk;
+	node->start = blk;
+	node->blkcnt = next - blk;
+	node->dblkcnt = 0;
+	hlist_add_head(&node->hash, cache_bucket(cdev, chunk));
 	_stats.entries++;
+
+	return node;
 }
 
-void blkcache_invalidate(int iftype, int devnum)
+void blkcache_fill(int iftype, int devnum,
+		   lbaint_t start, lbaint_t blkcnt,
+		   unsigned long blksz, void const *buffer)
+{
+	lbaint_t blk, next, chunk, end = start + blkcnt;
+	struct block_cache_node *node;
+	struct block_cache_dev *cdev;
+
+	if (_stats.max_entries == 0 || _stats.max_blocks_per_entry == 0)
+		return;
+
+	/* don't cache big stuff */
+	if (blkcnt > cache_max_fill())
+		return;
+
+	cdev = cache_get_dev(iftype, devnum, blksz);
+	if (!cdev)
+		return;
+
+	for (blk = start; blk < end; blk = next) {
+		chunk = cache_chunk(blk);
+		next = min(end, cache_chunk_start(chunk) +
+			   _stats.max_blocks_per_entry);
+
+		node = cache_extend(cdev, chunk, blk, next);
+		if (IS_ERR(node))
+			return;
+
+		debug("fill: start " LBAF ", count " LBAFU "\n",
+		      blk, next - blk);
+		if (node->dblkcnt) {
+			/* keep the dirty blocks, they are newer */
+			lbaint_t dend = node->dstart + node->dblkcnt;
+
+			if (blk < node->dstart)
+				memcpy(cache_data(node, blk),
+				       buffer + (blk - start) * blksz,
+				       (min(next, node->dstart) - blk) * blksz);
+			if (next > dend)
+				memcpy(cache_data(node, max(blk, dend)),
+				       buffer + (max(blk, dend) - start) * blksz,
+				       (next - max(blk, dend)) * blksz);
+		} else {
+			memcpy(cache_data(node, blk),
+			       buffer + (blk - start) * blksz,
+			       (next - blk) * blksz);
+		}
+		list_add(&node->lh, &block_cache);
+	}
+}
+
+int blkcache_write(int iftype, int devnum,
+		   lbaint_t start, lbaint_t blkcnt,
+		   unsigned long blksz, void const *buffer,
+		   blkcache_write_t write, void *priv)
 {
-	struct list_head *entry, *n;
+	lbaint_t blk, next, chunk, end = start + blkcnt;
 	struct block_cache_node *node;
+	struct block_cache_dev *cdev;
+
+	if (!CONFIG_IS_ENABLED(BLOCK_CACHE_WRITEBACK) ||
+	    _stats.max_entries == 0 || _stats.max_blocks_per_entry == 0)
+		return 0;
+
+	/* big writes go straight to the device */
+	if (blkcnt > cache_max_fill())
+		return 0;
+
+	cdev = cache_get_dev(iftype, devnum, blksz);
+	if (!cdev)
+		return 0;
+	cdev->write = write;
+	cdev->priv = priv;
+
+	for (blk = start; blk < end; blk = next) {
+		chunk = cache_chunk(blk);
+		next = min(end, cache_chunk_start(chunk) +
+			   _stats.max_blocks_per_entry);
+
+		node = cache_extend(cdev, chunk, blk, next);
+		if (PTR_ERR(node) == -ENOMEM)
+			return 0;
+		else if (IS_ERR(node))
+			return PTR_ERR(node);
+
+		debug("write: start " LBAF ", count " LBAFU "\n",
+		      blk, next - blk);
+		if (node->dblkcnt) {
+			lbaint_t first = min(blk, node->dstart);
+
+			node->dblkcnt = max(next, node->dstart +
+					    node->dblkcnt) - first;
+			node->dstart = first;
+		} else {
+			node->dstart = blk;
+			node->dblkcnt = next - blk;
+			++cdev->dirty;
+			++_stats.dirty;
+		}
+		memcpy(cache_data(node, blk), buffer + (blk - start) * blksz,
+		       (next - blk) * blksz);
+		list_add(&node->lh, &block_cache);
+	}
+
+	return 1;
+}
+
+static int cache_cmp_dirty(const void *a, const void *b)
+{
+	const struct block_cache_node *na = *(struct block_cache_node **)a;
+	const struct block_cache_node *nb = *(struct block_cache_node **)b;
+
+	if (na->dstart == nb->dstart)
+		return 0;
+
+	return na->dstart < nb->dstart ? -1 : 1;
+}
+
+/*
+ * Writes back the dirty entries of @cdev in block order, merging entries
+ * whose dirty blocks are contiguous into a single write
+ */
+static int cache_flush_dev(struct block_cache_dev *cdev)
+{
+	struct block_cache_node **nodes, *node;
+	int i, j, k, n = 0, ret = 0;
+	lbaint_t blkcnt;
+	char *buf;
+
+	if (!cdev->dirty)
+		return 0;
+
+	nodes = malloc(cdev->dirty * sizeof(*nodes));
+	if (!nodes)
+		return cache_writeback_range(cdev, 0, ~(lbaint_t)0);
 
-	list_for_each_safe(entry, n, &block_cache) {
-		node = (struct block_cache_node *)entry;
+	for (i = 0; i < ARRAY_SIZE(cdev->buckets); i++)
+		hlist_for_each_entry(node, &cdev->buckets[i], hash)
+			if (node->dblkcnt)
+				nodes[n++] = node;
+	qsort(nodes, n, sizeof(*nodes), cache_cmp_dirty);
+
+	for (i = 0; i < n && !ret; i = j) {
+		blkcnt = nodes[i]->dblkcnt;
+		for (j = i + 1; j < n; j++) {
+			if (nodes[j]->dstart != nodes[j - 1]->dstart +
+			    nodes[j - 1]->dblkcnt)
+				break;
+			blkcnt += nodes[j]->dblkcnt;
+		}
+
+		buf = j - i > 1 ? malloc(blkcnt * cdev->blksz) : NULL;
+		if (!buf) {
+			/* single entry, or no memory to merge the run */
+			for (; i < j && !ret; i++)
+				ret = cache_writeback(nodes[i]);
+			continue;
+		}
+
+		for (k = i, blkcnt = 0; k < j; k++) {
+			memcpy(buf + blkcnt * cdev->blksz,
+			       cache_data(nodes[k], nodes[k]->dstart),
+			       nodes[k]->dblkcnt * cdev->blksz);
+			blkcnt += nodes[k]->dblkcnt;
+		}
+		ret = cache_write_dev(cdev, nodes[i]->dstart, blkcnt, buf);
+		free(buf);
+		for (k = i; k < j && !ret; k++)
+			cache_clean(nodes[k]);
+	}
+	free(nodes);
+
+	return ret;
+}
+
+int blkcache_flush(int iftype, int devnum)
+{
+	struct block_cache_dev *cdev;
+	int ret, err = 0;
+
+	list_for_each_entry(cdev, &block_cache_devs, lh) {
+		if (iftype != -1 &&
+		    (cdev->iftype != iftype || cdev->devnum != devnum))
+			continue;
+		ret = cache_flush_dev(cdev);
+		if (ret && !err)
+			err = ret;
+	}
+
+	return err;
+}
+
+void blkcache_invalidate(int iftype, int devnum)
+{
+	struct block_cache_node *node, *n;
+	struct block_cache_dev *cdev, *cn;
+	int ret;
+
+	ret = blkcache_flush(iftype, devnum);
+	if (ret)
+		log_err("Failed to write back cached blocks (err=%d)\n", ret);
+
+	list_for_each_entry_safe(node, n, &block_cache, lh) {
 		if (iftype == -1 ||
-		    (node->iftype == iftype && node->devnum == devnum)) {
-			list_del(entry);
-			free(node->cache);
-			free(node);
-			--_stats.entries;
+		    (node->cdev->iftype == iftype &&
+		     node->cdev->devnum == devnum))
+			cache_drop(node);
+	}
+
+	list_for_each_entry_safe(cdev, cn, &block_cache_devs, lh) {
+		if (iftype == -1 ||
+		    (cdev->iftype == iftype && cdev->devnum == devnum)) {
+			list_del(&cdev->lh);
+			free(cdev);
 		}
 	}
 }
@@ -155,6 +664,8 @@ void blkcache_configure(unsigned blocks, unsigned entries)
 
 	_stats.hits = 0;
 	_stats.misses = 0;
+	_stats.readaheads = 0;
+	_stats.writebacks = 0;
 }
 
 void blkcache_stats(struct block_cache_stats *stats)
@@ -162,6 +673,8 @@ void blkcache_stats(struct block_cache_stats *stats)
 	memcpy(stats, &_stats, sizeof(*stats));
 	_stats.hits = 0;
 	_stats.misses = 0;
+	_stats.readaheads = 0;
+	_stats.writebacks = 0;
 }
 
 void blkcache_free(void)
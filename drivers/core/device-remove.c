@@ -93,6 +93,7 @@ int device_unbind(struct udevice *dev)
 	ret = device_chld_unbind(dev, NULL);
 	if (ret)
 		return log_msg_ret("child unbind", ret);
+	dm_lazy_unbind(dev);
 
 	ret = uclass_pre_unbind_device(dev);
 	if (ret)
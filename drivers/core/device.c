@@ -18,6 +18,7 @@
 #include <fdtdec.h>
 #include <fdt_support.h>
 #include <malloc.h>
+#include <uthread.h>
 #include <asm/cache.h>
 #include <dm/device.h>
 #include <dm/device-internal.h>
@@ -478,14 +479,11 @@ static int device_get_dma_constraints(struct udevice *dev)
 	return 0;
 }
 
-int device_probe(struct udevice *dev)
+static int device_do_probe(struct udevice *dev)
 {
 	const struct driver *drv;
 	int ret;
 
-	if (!dev)
-		return -EINVAL;
-
 	if (dev_get_flags(dev) & DM_FLAG_ACTIVATED)
 		return 0;
 
@@ -616,6 +614,35 @@ fail:
 	return ret;
 }
 
+int device_probe(struct udevice *dev)
+{
+#if CONFIG_IS_ENABLED(DM_PROBE_ASYNC)
+	struct uthread *self = uthread_self();
+	int ret;
+#endif
+
+	if (!dev)
+		return -EINVAL;
+
+#if CONFIG_IS_ENABLED(DM_PROBE_ASYNC)
+	/*
+	 * The device is marked as activated before its probe() method runs,
+	 * so wait until another thread probing it is done with it
+	 */
+	while (dev->prober && dev->prober != self)
+		uthread_schedule();
+	if (!dev->prober) {
+		dev->prober = self;
+		ret = device_do_probe(dev);
+		dev->prober = NULL;
+
+		return ret;
+	}
+#endif
+
+	return device_do_probe(dev);
+}
+
 void *dev_get_plat(const struct udevice *dev)
 {
 	if (!dev) {
@@ -897,6 +924,7 @@ static struct udevice *_device_find_global_by_ofnode(struct udevice *parent,
 
 int device_find_global_by_ofnode(ofnode ofnode, struct udevice **devp)
 {
+	dm_lazy_bind_node(ofnode);
 	*devp = _device_find_global_by_ofnode(gd->dm_root, ofnode);
 
 	return *devp ? 0 : -ENOENT;
@@ -906,6 +934,7 @@ int device_get_global_by_ofnode(ofnode ofnode, struct udevice **devp)
 {
 	struct udevice *dev;
 
+	dm_lazy_bind_node(ofnode);
 	dev = _device_find_global_by_ofnode(gd->dm_root, ofnode);
 	return device_get_device_tail(dev, dev ? 0 : -ENOENT, devp);
 }
@@ -7,6 +7,7 @@
 #include <malloc.h>
 #include <mapmem.h>
 #include <sort.h>
+#include <dm/device-internal.h>
 #include <dm/root.h>
 #include <dm/util.h>
 #include <dm/uclass-internal.h>
@@ -135,6 +136,7 @@ void dm_dump_tree(char *dev_name, bool extended, bool sort)
 	root = dm_root();
 	if (!root)
 		return;
+	dm_lazy_bind_all();
 
 	if (!dev_name || !strcmp(dev_name, "root")) {
 		dm_dump_tree_single(root, sort);
@@ -0,0 +1,248 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Deferred binding of device tree nodes
+ *
+ * With CONFIG_DM_LAZY_BIND, leaf nodes found at the top level or on a simple
+ * bus while scanning the device tree after relocation are only recorded,
+ * along with the uclass of the driver which matches them. They are bound when
+ * their uclass is first looked up or when their node is looked up.
+ */
+
+#define LOG_CATEGORY LOGC_DM
+
+#include <bootstage.h>
+#include <log.h>
+#include <malloc.h>
+#include <dm/device.h>
+#include <dm/device-internal.h>
+#include <dm/lists.h>
+#include <dm/ofnode.h>
+#include <dm/root.h>
+#include <dm/uclass.h>
+#include <dm/util.h>
+
+/* Number of nodes to allocate space for at once */
+#define DM_LAZY_GROW	64
+
+/**
+ * struct dm_lazy_node - a device tree node whose binding is deferred
+ *
+ * @node: device tree node
+ * @parent: device to bind the node to, NULL once it has been bound or dropped
+ * @uclass_id: uclass of the driver which matches the node
+ */
+struct dm_lazy_node {
+	ofnode node;
+	struct udevice *parent;
+	enum uclass_id uclass_id;
+};
+
+/**
+ * struct dm_lazy - state of deferred binding
+ *
+ * @nodes: nodes recorded so far, in the order they were scanned
+ * @count: number of entries in @nodes
+ * @size: number of entries allocated for @nodes
+ * @busy: non-zero while scanning the device tree or binding deferred nodes,
+ *	when looking up devices must not bind anything
+ * @deferred: number of nodes whose binding was deferred
+ * @bound: number of deferred nodes bound so far
+ * @pending: number of nodes still to be bound, for each uclass
+ */
+static struct dm_lazy {
+	struct dm_lazy_node *nodes;
+	int count;
+	int size;
+	int busy;
+	int deferred;
+	int bound;
+	int pending[UCLASS_COUNT];
+} lazy;
+
+static bool lazy_enabled = true;
+
+void dm_lazy_enable(bool enable)
+{
+	lazy_enabled = enable;
+}
+
+void dm_lazy_reset(void)
+{
+	free(lazy.nodes);
+	memset(&lazy, 0, sizeof(lazy));
+}
+
+void dm_lazy_pause(void)
+{
+	lazy.busy++;
+}
+
+void dm_lazy_resume(void)
+{
+	lazy.busy--;
+}
+
+/*
+ * A bind() or post_bind() method may bind more devices or mark the device for
+ * probing straight away, neither of which can wait for a lookup. Scanning for
+ * subnodes does nothing for a leaf node, so that one is fine.
+ */
+static bool dm_lazy_bind_ok(int (*bind)(struct udevice *dev))
+{
+	return !bind || bind == dm_scan_fdt_dev;
+}
+
+bool dm_lazy_defer(struct udevice *parent, ofnode node)
+{
+	struct uclass_driver *uc_drv;
+	struct dm_lazy_node *ln;
+	struct driver *drv;
+
+	/*
+	 * Nodes with subnodes may be buses whose children are looked for in
+	 * other uclasses, so only leaves are deferred
+	 */
+	if (!lazy_enabled || ofnode_pre_reloc(node) ||
+	    ofnode_valid(ofnode_first_subnode(node)))
+		return false;
+
+	/* Buses other than a simple bus may look among their child devices */
+	if (parent != dm_root() &&
+	    device_get_uclass_id(parent) != UCLASS_SIMPLE_BUS)
+		return false;
+	drv = lists_driver_match_fdt(node);
+	if (!drv || (drv->flags & DM_FLAG_PRE_RELOC) || drv->id >= UCLASS_COUNT)
+		return false;
+	uc_drv = lists_uclass_lookup(drv->id);
+	if (!uc_drv || !dm_lazy_bind_ok(drv->bind) ||
+	    !dm_lazy_bind_ok(uc_drv->post_bind))
+		return false;
+
+	if (lazy.count == lazy.size) {
+		ln = realloc(lazy.nodes,
+			     (lazy.size + DM_LAZY_GROW) * sizeof(*ln));
+		if (!ln)
+			return false;
+		lazy.nodes = ln;
+		lazy.size += DM_LAZY_GROW;
+	}
+	ln = &lazy.nodes[lazy.count++];
+	ln->node = node;
+	ln->parent = parent;
+	ln->uclass_id = drv->id;
+	lazy.pending[drv->id]++;
+	lazy.deferred++;
+	log_debug("deferred node %s\n", ofnode_get_name(node));
+
+	return true;
+}
+
+/* Binds the deferred node at index @i in the list */
+static void dm_lazy_bind(int i)
+{
+	struct dm_lazy_node *ln = &lazy.nodes[i];
+	struct udevice *parent = ln->parent;
+	ofnode node = ln->node;
+	int ret;
+
+	ln->parent = NULL;
+	lazy.pending[ln->uclass_id]--;
+	lazy.bound++;
+
+	/* This may add more nodes, so @ln must not be used after it */
+	ret = lists_bind_fdt(parent, node, NULL, NULL, false);
+	if (ret)
+		dm_warn("%s: bind failed: %d\n", ofnode_get_name(node), ret);
+}
+
+void dm_lazy_bind_uclass(enum uclass_id id)
+{
+	int i;
+
+	if (lazy.busy || id >= UCLASS_COUNT || !lazy.pending[id])
+		return;
+
+	bootstage_start(BOOTSTAGE_ID_ACCUM_DM_LAZY, "dm_lazy");
+	dm_lazy_pause();
+	for (i = 0; i < lazy.count && lazy.pending[id]; i++) {
+		if (lazy.nodes[i].parent && lazy.nodes[i].uclass_id == id)
+			dm_lazy_bind(i);
+	}
+	dm_lazy_resume();
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_DM_LAZY);
+}
+
+void dm_lazy_bind_node(ofnode node)
+{
+	int i;
+
+	if (lazy.busy || lazy.bound == lazy.deferred)
+		return;
+
+	for (i = 0; i < lazy.count; i++) {
+		if (lazy.nodes[i].parent &&
+		    ofnode_equal(lazy.nodes[i].node, node)) {
+			bootstage_start(BOOTSTAGE_ID_ACCUM_DM_LAZY, "dm_lazy");
+			dm_lazy_pause();
+			dm_lazy_bind(i);
+			dm_lazy_resume();
+			bootstage_accum(BOOTSTAGE_ID_ACCUM_DM_LAZY);
+			break;
+		}
+	}
+}
+
+void dm_lazy_bind_all(void)
+{
+	int i;
+
+	if (lazy.busy || lazy.bound == lazy.deferred)
+		return;
+
+	bootstage_start(BOOTSTAGE_ID_ACCUM_DM_LAZY, "dm_lazy");
+	dm_lazy_pause();
+	for (i = 0; i < lazy.count; i++) {
+		if (lazy.nodes[i].parent)
+			dm_lazy_bind(i);
+	}
+	dm_lazy_resume();
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_DM_LAZY);
+}
+
+void dm_lazy_unbind(struct udevice *parent)
+{
+	int i;
+
+	for (i = 0; i < lazy.count; i++) {
+		if (lazy.nodes[i].parent == parent) {
+			lazy.nodes[i].parent = NULL;
+			lazy.pending[lazy.nodes[i].uclass_id]--;
+			lazy.deferred--;
+		}
+	}
+}
+
+void dm_lazy_get_stats(int *deferredp, int *boundp)
+{
+	*deferredp = lazy.deferred;
+	*boundp = lazy.bound;
+}
+
+void dm_dump_lazy(void)
+{
+	int i;
+
+	printf("Deferred nodes:   %d\n", lazy.deferred);
+	printf("Bound on demand:  %d\n", lazy.bound);
+	printf("Not bound yet:    %d\n", lazy.deferred - lazy.bound);
+	for (i = 0; i < UCLASS_COUNT; i++) {
+		struct uclass_driver *uc_drv;
+
+		/* Avoid uclass_get(), which would bind the nodes */
+		if (!lazy.pending[i])
+			continue;
+		uc_drv = lists_uclass_lookup(i);
+		printf("   %-20s %d\n", uc_drv ? uc_drv->name : "?",
+		       lazy.pending[i]);
+	}
+}
@@ -287,4 +287,29 @@ int lists_bind_fdt(struct udevice *parent, ofnode node, struct udevice **devp,
 
 	return 0;
 }
+
+struct driver *lists_driver_match_fdt(ofnode node)
+{
+	struct driver *driver = ll_entry_start(struct driver, driver);
+	const int n_ents = ll_entry_count(struct driver, driver);
+	const char *compat_list, *compat;
+	const struct udevice_id *id;
+	struct driver *entry;
+	int compat_length, i;
+
+	compat_list = ofnode_get_property(node, "compatible", &compat_length);
+	if (!compat_list)
+		return NULL;
+
+	for (i = 0; i < compat_length; i += strlen(compat) + 1) {
+		compat = compat_list + i;
+		for (entry = driver; entry != driver + n_ents; entry++) {
+			if (!driver_check_compatible(entry->of_match, &id,
+						     compat))
+				return entry;
+		}
+	}
+
+	return NULL;
+}
 #endif
@@ -12,6 +12,7 @@
 #include <fdtdec.h>
 #include <log.h>
 #include <malloc.h>
+#include <uthread.h>
 #include <asm-generic/sections.h>
 #include <asm/global_data.h>
 #include <linux/libfdt.h>
@@ -99,6 +100,16 @@ int dm_init(bool of_live)
 		dm_warn("Virtual root driver already exists!\n");
 		return -EINVAL;
 	}
+	dm_lazy_reset();
+	if (CONFIG_IS_ENABLED(DM_INDEX) && (gd->flags & GD_FLG_RELOC)) {
+		/* Tests restart driver model, so reuse any existing table */
+		if (gd_uclass_tbl())
+			memset(gd_uclass_tbl(), '\0',
+			       UCLASS_COUNT * sizeof(struct uclass *));
+		else
+			gd_set_uclass_tbl(calloc(UCLASS_COUNT,
+						 sizeof(struct uclass *)));
+	}
 	if (CONFIG_IS_ENABLED(OF_PLATDATA_INST)) {
 		gd->uclass_root = &uclass_head;
 	} else {
@@ -117,8 +128,13 @@ int dm_init(bool of_live)
 					  &DM_ROOT_NON_CONST);
 		if (ret)
 			return ret;
-		if (CONFIG_IS_ENABLED(OF_CONTROL))
+		if (CONFIG_IS_ENABLED(OF_CONTROL)) {
+			uclass_index_remove(DM_ROOT_NON_CONST);
 			dev_set_ofnode(DM_ROOT_NON_CONST, ofnode_root());
+			ret = uclass_index_add(DM_ROOT_NON_CONST);
+			if (ret)
+				return ret;
+		}
 		ret = device_probe(DM_ROOT_NON_CONST);
 		if (ret)
 			return ret;
@@ -202,6 +218,7 @@ static int dm_scan_fdt_node(struct udevice *parent, ofnode parent_node,
 	if (!ofnode_valid(parent_node))
 		return 0;
 
+	dm_lazy_pause();
 	for (node = ofnode_first_subnode(parent_node);
 	     ofnode_valid(node);
 	     node = ofnode_next_subnode(node)) {
@@ -211,12 +228,15 @@ static int dm_scan_fdt_node(struct udevice *parent, ofnode parent_node,
 			pr_debug("   - ignoring disabled device\n");
 			continue;
 		}
+		if (!pre_reloc_only && dm_lazy_defer(parent, node))
+			continue;
 		err = lists_bind_fdt(parent, node, NULL, NULL, pre_reloc_only);
 		if (err && !ret) {
 			ret = err;
 			dm_warn("%s: ret=%d\n", node_name, ret);
 		}
 	}
+	dm_lazy_resume();
 
 	if (ret)
 		dm_warn("Some drivers failed to bind\n");
@@ -288,20 +308,101 @@ void *dm_priv_to_rw(void *priv)
 }
 #endif
 
+/**
+ * struct dm_probe_queue - devices being probed in the background
+ *
+ * @wq: work queue running the probes
+ * @async: list of struct dm_probe_async, one for each device submitted
+ */
+struct dm_probe_queue {
+	struct uthread_wq wq;
+	struct list_head async;
+};
+
+/**
+ * struct dm_probe_async - a device probed in the background
+ *
+ * @work: work item which probes the device and then its children
+ * @queue: queue the work item was submitted to
+ * @dev: device to probe
+ * @pre_reloc_only: probe only devices marked with the DM_FLAG_PRE_RELOC flag
+ * @node: link in the list of devices of @queue
+ */
+struct dm_probe_async {
+	struct uthread_work work;
+	struct dm_probe_queue *queue;
+	struct udevice *dev;
+	bool pre_reloc_only;
+	struct list_head node;
+};
+
+static int dm_probe_devices(struct udevice *dev, bool pre_reloc_only,
+			    struct dm_probe_queue *queue);
+
+static void dm_probe_children(struct udevice *dev, bool pre_reloc_only,
+			      struct dm_probe_queue *queue)
+{
+	struct udevice *child;
+
+	list_for_each_entry(child, &dev->child_head, sibling_node)
+		dm_probe_devices(child, pre_reloc_only, queue);
+}
+
+static void dm_probe_async_work(void *arg)
+{
+	struct dm_probe_async *async = arg;
+	int ret;
+
+	ret = device_probe(async->dev);
+	if (ret) {
+		log_debug("%s: probe failed: %d\n", async->dev->name, ret);
+		return;
+	}
+	dm_probe_children(async->dev, async->pre_reloc_only, async->queue);
+}
+
+/**
+ * dm_probe_async() - Probe a device and its children in the background
+ *
+ * @queue: Queue to use
+ * @dev: Device to probe
+ * @pre_reloc_only: Probe only devices marked with the DM_FLAG_PRE_RELOC flag
+ * Return 0 if OK, -ENOMEM if out of memory
+ */
+static int dm_probe_async(struct dm_probe_queue *queue, struct udevice *dev,
+			  bool pre_reloc_only)
+{
+	struct dm_probe_async *async;
+
+	async = calloc(1, sizeof(*async));
+	if (!async)
+		return -ENOMEM;
+	async->queue = queue;
+	async->dev = dev;
+	async->pre_reloc_only = pre_reloc_only;
+	list_add_tail(&async->node, &queue->async);
+	uthread_work_init(&async->work, dm_probe_async_work, async, 0);
+
+	return uthread_wq_submit(&queue->wq, &async->work);
+}
+
 /**
  * dm_probe_devices() - Check whether to probe a device and all children
  *
  * Probes the device if DM_FLAG_PROBE_AFTER_BIND is enabled for it. Then scans
- * all its children recursively to do the same.
+ * all its children recursively to do the same. If @queue is not NULL, devices
+ * with the DM_FLAG_PROBE_ASYNC flag are probed, along with their children, in
+ * the background.
  *
  * @dev: Device to (maybe) probe
  * @pre_reloc_only: Probe only devices marked with the DM_FLAG_PRE_RELOC flag
+ * @queue: Queue for devices to probe in the background, or NULL for none
  * Return 0 if OK, -ve on error
  */
-static int dm_probe_devices(struct udevice *dev, bool pre_reloc_only)
+static int dm_probe_devices(struct udevice *dev, bool pre_reloc_only,
+			    struct dm_probe_queue *queue)
 {
 	ofnode node = dev_ofnode(dev);
-	struct udevice *child;
 	int ret;
 
 	if (pre_reloc_only &&
@@ -310,23 +411,44 @@ static int dm_probe_devices(struct udevice *dev, bool pre_reloc_only)
 		goto probe_children;
 
 	if (dev_get_flags(dev) & DM_FLAG_PROBE_AFTER_BIND) {
+		if (CONFIG_IS_ENABLED(DM_PROBE_ASYNC) && queue &&
+		    ((dev_get_flags(dev) | dev->driver->flags) &
+		     DM_FLAG_PROBE_ASYNC) &&
+		    !dm_probe_async(queue, dev, pre_reloc_only))
+			return 0;
 		ret = device_probe(dev);
 		if (ret)
 			return ret;
 	}
 
 probe_children:
-	list_for_each_entry(child, &dev->child_head, sibling_node)
-		dm_probe_devices(child, pre_reloc_only);
+	dm_probe_children(dev, pre_reloc_only, queue);
 
 	return 0;
 }
 
 int dm_autoprobe(void)
 {
+	bool pre_reloc_only = !(gd->flags & GD_FLG_RELOC);
+	struct dm_probe_queue queue, *qp = NULL;
+	struct dm_probe_async *async, *next;
 	int ret;
 
-	ret = dm_probe_devices(gd->dm_root, !(gd->flags & GD_FLG_RELOC));
+	if (CONFIG_IS_ENABLED(DM_PROBE_ASYNC) && !pre_reloc_only &&
+	    !uthread_wq_init(&queue.wq,
+			     CONFIG_IF_ENABLED_INT(DM_PROBE_ASYNC,
+						   DM_PROBE_ASYNC_WORKERS), 0)) {
+		INIT_LIST_HEAD(&queue.async);
+		qp = &queue;
+	}
+
+	ret = dm_probe_devices(gd->dm_root, pre_reloc_only, qp);
+
+	if (qp) {
+		uthread_wq_destroy(&qp->wq);
+		list_for_each_entry_safe(async, next, &qp->async, node)
+			free(async);
+	}
 	if (ret)
 		return log_msg_ret("pro", ret);
 
@@ -0,0 +1,368 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Indexes for looking up devices in a uclass
+ *
+ * With CONFIG_DM_INDEX, each uclass keeps hash tables which map a device's
+ * sequence number, device tree node and phandle to the device, so that
+ * looking up a device does not need to walk the list of devices in the
+ * uclass. The tables are updated as devices are bound and unbound.
+ *
+ * Before relocation, malloc() may not be able to free memory, so growing a
+ * table would leak the old one. The tables are only built once U-Boot has
+ * relocated, and lookups walk the lists until then.
+ */
+
+#define LOG_CATEGORY LOGC_DM
+
+#include <log.h>
+#include <malloc.h>
+#include <dm/device.h>
+#include <dm/ofnode.h>
+#include <dm/read.h>
+#include <dm/uclass.h>
+#include <dm/uclass-internal.h>
+#include <asm/global_data.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Number of bits in the hash of an empty table when first allocated */
+#define UCLASS_INDEX_MIN_BITS	4
+
+/**
+ * enum uclass_index_key - keys which a device can be looked up by
+ *
+ * @UCLASS_INDEX_SEQ: sequence number, for devices which have one
+ * @UCLASS_INDEX_OFNODE: device tree node, for devices which have one
+ * @UCLASS_INDEX_PHANDLE: phandle of the device tree node, if it has one
+ */
+enum uclass_index_key {
+	UCLASS_INDEX_SEQ,
+	UCLASS_INDEX_OFNODE,
+	UCLASS_INDEX_PHANDLE,
+
+	UCLASS_INDEX_COUNT,
+};
+
+/**
+ * struct uclass_hash_ent - an entry in a hash table
+ *
+ * @key: key for the entry
+ * @dev: device with this key, NULL if the entry is empty
+ */
+struct uclass_hash_ent {
+	ulong key;
+	struct udevice *dev;
+};
+
+/**
+ * struct uclass_hash - an open-addressing hash table using linear probing
+ *
+ * Where several devices have the same key, the table holds the first one in
+ * the uclass, since that is what a walk of the list would find.
+ *
+ * @ent: entries, NULL if nothing has been added yet
+ * @bits: number of bits in the hash, so there are 1 << @bits entries
+ * @count: number of entries in use
+ * @dups: number of devices which are not in the table because another device
+ *	has the same key
+ */
+struct uclass_hash {
+	struct uclass_hash_ent *ent;
+	uint bits;
+	uint count;
+	uint dups;
+};
+
+/**
+ * struct uclass_index - indexes for a uclass
+ *
+ * @hash: hash table for each key
+ */
+struct uclass_index {
+	struct uclass_hash hash[UCLASS_INDEX_COUNT];
+};
+
+static uint uclass_hash_slot(struct uclass_hash *hash, ulong key)
+{
+	return ((u64)key * 0x61c8864680b583ebull) >> (64 - hash->bits);
+}
+
+static uint uclass_hash_mask(struct uclass_hash *hash)
+{
+	return (1U << hash->bits) - 1;
+}
+
+/**
+ * uclass_index_get_key() - Get the key of a device
+ *
+ * @dev: device to check
+ * @which: key to get
+ * @keyp: returns the key
+ * Return: true if the device has the key, false if not
+ */
+static bool uclass_index_get_key(struct udevice *dev,
+				 enum uclass_index_key which, ulong *keyp)
+{
+	ofnode node = dev_ofnode(dev);
+	int phandle;
+
+	switch (which) {
+	case UCLASS_INDEX_SEQ:
+		if (dev->seq_ < 0)
+			return false;
+		*keyp = dev->seq_;
+		return true;
+	case UCLASS_INDEX_OFNODE:
+		if (!ofnode_valid(node))
+			return false;
+		*keyp = node.of_offset;
+		return true;
+	case UCLASS_INDEX_PHANDLE:
+		if (!CONFIG_IS_ENABLED(OF_REAL) || !ofnode_valid(node))
+			return false;
+		phandle = dev_read_phandle(dev);
+		if (phandle <= 0)
+			return false;
+		*keyp = phandle;
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* Returns the entry with the given key, or NULL if there is none */
+static struct uclass_hash_ent *uclass_hash_lookup(struct uclass_hash *hash,
+						  ulong key)
+{
+	uint mask, i;
+
+	if (!hash->ent)
+		return NULL;
+	mask = uclass_hash_mask(hash);
+	for (i = uclass_hash_slot(hash, key); hash->ent[i].dev;
+	     i = (i + 1) & mask) {
+		if (hash->ent[i].key == key)
+			return &hash->ent[i];
+	}
+
+	return NULL;
+}
+
+static struct udevice *uclass_hash_find(struct uclass_hash *hash, ulong key)
+{
+	struct uclass_hash_ent *ent = uclass_hash_lookup(hash, key);
+
+	return ent ? ent->dev : NULL;
+}
+
+/* Adds an entry, which must not already be present and must fit */
+static void uclass_hash_insert(struct uclass_hash *hash, ulong key,
+			       struct udevice *dev)
+{
+	uint mask = uclass_hash_mask(hash);
+	uint i;
+
+	for (i = uclass_hash_slot(hash, key); hash->ent[i].dev;
+	     i = (i + 1) & mask)
+		;
+	hash->ent[i].key = key;
+	hash->ent[i].dev = dev;
+	hash->count++;
+}
+
+/* Makes sure there is room for another entry, keeping the load below 1/2 */
+static int uclass_hash_reserve(struct uclass_hash *hash)
+{
+	struct uclass_hash_ent *old = hash->ent;
+	uint old_size = old ? 1U << hash->bits : 0;
+	uint bits, i;
+
+	if (old && (hash->count + 1) * 2 <= old_size)
+		return 0;
+
+	bits = old ? hash->bits + 1 : UCLASS_INDEX_MIN_BITS;
+	hash->ent = calloc(1U << bits, sizeof(*hash->ent));
+	if (!hash->ent) {
+		hash->ent = old;
+		return -ENOMEM;
+	}
+	hash->bits = bits;
+	hash->count = 0;
+	for (i = 0; i < old_size; i++) {
+		if (old[i].dev)
+			uclass_hash_insert(hash, old[i].key, old[i].dev);
+	}
+	free(old);
+
+	return 0;
+}
+
+/* Removes the entry at slot @i, moving later entries back to fill the gap */
+static void uclass_hash_delete(struct uclass_hash *hash, uint i)
+{
+	uint mask = uclass_hash_mask(hash);
+	uint j, k;
+
+	hash->ent[i].dev = NULL;
+	hash->count--;
+	for (j = (i + 1) & mask; hash->ent[j].dev; j = (j + 1) & mask) {
+		k = uclass_hash_slot(hash, hash->ent[j].key);
+
+		/* Leave the entry alone if its home slot is in (i, j] */
+		if (i <= j ? (i < k && k <= j) : (i < k || k <= j))
+			continue;
+		hash->ent[i] = hash->ent[j];
+		hash->ent[j].dev = NULL;
+		i = j;
+	}
+}
+
+static int uclass_index_add_key(struct uclass_index *idx, struct udevice *dev,
+				enum uclass_index_key which)
+{
+	struct uclass_hash *hash = &idx->hash[which];
+	struct uclass_hash_ent *ent;
+	struct list_head *pos;
+	ulong key;
+	int ret;
+
+	if (!uclass_index_get_key(dev, which, &key))
+		return 0;
+	ent = uclass_hash_lookup(hash, key);
+	if (ent) {
+		/*
+		 * Keep whichever device comes first in the uclass. Devices are
+		 * normally added at the end, so this loop finishes straight
+		 * away.
+		 */
+		hash->dups++;
+		for (pos = dev->uclass_node.next; pos != &dev->uclass->dev_head;
+		     pos = pos->next) {
+			if (pos == &ent->dev->uclass_node) {
+				ent->dev = dev;
+				break;
+			}
+		}
+		return 0;
+	}
+	ret = uclass_hash_reserve(hash);
+	if (ret)
+		return ret;
+	uclass_hash_insert(hash, key, dev);
+
+	return 0;
+}
+
+static void uclass_index_remove_key(struct uclass_index *idx,
+				    struct udevice *dev,
+				    enum uclass_index_key which)
+{
+	struct uclass_hash *hash = &idx->hash[which];
+	struct uclass_hash_ent *ent;
+	struct udevice *other;
+	ulong key;
+
+	if (!uclass_index_get_key(dev, which, &key))
+		return;
+	ent = uclass_hash_lookup(hash, key);
+	if (!ent)
+		return;
+	if (ent->dev != dev) {
+		/* Another device has this key, so @dev was not in the table */
+		if (hash->dups)
+			hash->dups--;
+		return;
+	}
+	uclass_hash_delete(hash, ent - hash->ent);
+
+	/* Put the next device with the same key in its place, if any */
+	if (!hash->dups)
+		return;
+	uclass_foreach_dev(other, dev->uclass) {
+		ulong other_key;
+
+		if (other != dev &&
+		    uclass_index_get_key(other, which, &other_key) &&
+		    other_key == key) {
+			/* This cannot fail since an entry was just freed */
+			uclass_hash_insert(hash, key, other);
+			hash->dups--;
+			break;
+		}
+	}
+}
+
+int uclass_index_add(struct udevice *dev)
+{
+	struct uclass *uc = dev->uclass;
+	int which;
+	int ret;
+
+	if (!(gd->flags & GD_FLG_RELOC))
+		return 0;
+	if (!uc->index) {
+		uc->index = calloc(1, sizeof(*uc->index));
+		if (!uc->index)
+			return log_msg_ret("idx", -ENOMEM);
+	}
+	for (which = 0; which < UCLASS_INDEX_COUNT; which++) {
+		ret = uclass_index_add_key(uc->index, dev, which);
+		if (ret) {
+			while (--which >= 0)
+				uclass_index_remove_key(uc->index, dev, which);
+			return log_msg_ret("add", ret);
+		}
+	}
+
+	return 0;
+}
+
+void uclass_index_remove(struct udevice *dev)
+{
+	struct uclass *uc = dev->uclass;
+	int which;
+
+	if (!uc->index)
+		return;
+	for (which = 0; which < UCLASS_INDEX_COUNT; which++)
+		uclass_index_remove_key(uc->index, dev, which);
+}
+
+void uclass_index_free(struct uclass *uc)
+{
+	int which;
+
+	if (!uc->index)
+		return;
+	for (which = 0; which < UCLASS_INDEX_COUNT; which++)
+		free(uc->index->hash[which].ent);
+	free(uc->index);
+	uc->index = NULL;
+}
+
+static int uclass_index_find(struct uclass *uc, enum uclass_index_key which,
+			     ulong key, struct udevice **devp)
+{
+	if (!uc->index)
+		return -ENOSYS;
+	*devp = uclass_hash_find(&uc->index->hash[which], key);
+
+	return *devp ? 0 : -ENODEV;
+}
+
+int uclass_index_find_seq(struct uclass *uc, int seq, struct udevice **devp)
+{
+	return uclass_index_find(uc, UCLASS_INDEX_SEQ, seq, devp);
+}
+
+int uclass_index_find_ofnode(struct uclass *uc, ofnode node,
+			     struct udevice **devp)
+{
+	return uclass_index_find(uc, UCLASS_INDEX_OFNODE, node.of_offset, devp);
+}
+
+int uclass_index_find_phandle(struct uclass *uc, uint phandle,
+			      struct udevice **devp)
+{
+	return uclass_index_find(uc, UCLASS_INDEX_PHANDLE, phandle, devp);
+}
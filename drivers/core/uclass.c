@@ -25,15 +25,16 @@ DECLARE_GLOBAL_DATA_PTR;
 
 struct uclass *uclass_find(enum uclass_id key)
 {
+	struct uclass **tbl;
 	struct uclass *uc;
 
 	if (!gd->dm_root)
 		return NULL;
-	/*
-	 * TODO(sjg@chromium.org): Optimise this, perhaps moving the found
-	 * node to the start of the list, or creating a linear array mapping
-	 * id to node.
-	 */
+	dm_lazy_bind_uclass(key);
+	tbl = gd_uclass_tbl();
+	if (tbl)
+		return (uint)key < UCLASS_COUNT ? tbl[key] : NULL;
+
 	list_for_each_entry(uc, gd->uclass_root, sibling_node) {
 		if (uc->uc_drv->id == key)
 			return uc;
@@ -53,6 +54,7 @@ struct uclass *uclass_find(enum uclass_id key)
  */
 static int uclass_add(enum uclass_id id, struct uclass **ucp)
 {
+	struct uclass **tbl = gd_uclass_tbl();
 	struct uclass_driver *uc_drv;
 	struct uclass *uc;
 	int ret;
@@ -86,6 +88,8 @@ static int uclass_add(enum uclass_id id, struct uclass **ucp)
 	INIT_LIST_HEAD(&uc->sibling_node);
 	INIT_LIST_HEAD(&uc->dev_head);
 	list_add(&uc->sibling_node, DM_UCLASS_ROOT_NON_CONST);
+	if (tbl)
+		tbl[id] = uc;
 
 	if (uc_drv->init) {
 		ret = uc_drv->init(uc);
@@ -102,6 +106,8 @@ fail:
 		uclass_set_priv(uc, NULL);
 	}
 	list_del(&uc->sibling_node);
+	if (tbl)
+		tbl[id] = NULL;
 fail_mem:
 	free(uc);
 
@@ -110,6 +116,7 @@ fail_mem:
 
 int uclass_destroy(struct uclass *uc)
 {
+	struct uclass **tbl = gd_uclass_tbl();
 	struct uclass_driver *uc_drv;
 	struct udevice *dev;
 	int ret;
@@ -135,6 +142,9 @@ int uclass_destroy(struct uclass *uc)
 	if (uc_drv->destroy)
 		uc_drv->destroy(uc);
 	list_del(&uc->sibling_node);
+	if (tbl)
+		tbl[uc_drv->id] = NULL;
+	uclass_index_free(uc);
 	if (uc_drv->priv_auto)
 		free(uclass_get_priv(uc));
 	free(uc);
@@ -349,6 +359,9 @@ int uclass_find_device_by_seq(enum uclass_id id, int seq, struct udevice **devp)
 	ret = uclass_get(id, &uc);
 	if (ret)
 		return ret;
+	ret = uclass_index_find_seq(uc, seq, devp);
+	if (ret != -ENOSYS)
+		return ret;
 
 	uclass_foreach_dev(dev, uc) {
 		log_debug("   - %d '%s'\n", dev->seq_, dev->name);
@@ -401,6 +414,9 @@ int uclass_find_device_by_ofnode(enum uclass_id id, ofnode node,
 	ret = uclass_get(id, &uc);
 	if (ret)
 		return ret;
+	ret = uclass_index_find_ofnode(uc, node, devp);
+	if (ret != -ENOSYS)
+		goto done;
 
 	uclass_foreach_dev(dev, uc) {
 		log(LOGC_DM, LOGL_DEBUG_CONTENT, "      - checking %s\n",
@@ -430,6 +446,9 @@ static int uclass_find_device_by_phandle_id(enum uclass_id id,
 	ret = uclass_get(id, &uc);
 	if (ret)
 		return ret;
+	ret = uclass_index_find_phandle(uc, find_phandle, devp);
+	if (ret != -ENOSYS)
+		return ret;
 
 	uclass_foreach_dev(dev, uc) {
 		uint phandle;
@@ -717,6 +736,9 @@ int uclass_bind_device(struct udevice *dev)
 
 	uc = dev->uclass;
 	list_add_tail(&dev->uclass_node, &uc->dev_head);
+	ret = uclass_index_add(dev);
+	if (ret)
+		goto err_index;
 
 	if (dev->parent) {
 		struct uclass_driver *uc_drv = dev->parent->uclass->uc_drv;
@@ -731,11 +753,21 @@ int uclass_bind_device(struct udevice *dev)
 	return 0;
 err:
 	/* There is no need to undo the parent's post_bind call */
+	uclass_index_remove(dev);
+err_index:
 	list_del(&dev->uclass_node);
 
 	return ret;
 }
 
+int uclass_set_device_seq(struct udevice *dev, int seq)
+{
+	uclass_index_remove(dev);
+	dev->seq_ = seq;
+
+	return uclass_index_add(dev);
+}
+
 #if CONFIG_IS_ENABLED(DM_DEVICE_REMOVE)
 int uclass_pre_unbind_device(struct udevice *dev)
 {
@@ -754,6 +786,7 @@ int uclass_pre_unbind_device(struct udevice *dev)
 
 int uclass_unbind_device(struct udevice *dev)
 {
+	uclass_index_remove(dev);
 	list_del(&dev->uclass_node);
 
 	return 0;
@@ -14,6 +14,7 @@
 #include <fat.h>
 #include <dfu.h>
 #include <hash.h>
+#include <uthread.h>
 #include <linux/list.h>
 #include <linux/compiler.h>
 #include <linux/printk.h>
@@ -195,12 +196,50 @@ done:
 	return ret;
 }
 
+#if CONFIG_IS_ENABLED(DFU_BACKGROUND_WRITE)
+#define DFU_WRITE_BUFS	CONFIG_DFU_WRITE_BUFS
+#else
+#define DFU_WRITE_BUFS	1
+#endif
+
 static unsigned char *dfu_buf;
 static unsigned long dfu_buf_size;
 static enum dfu_device_type dfu_buf_device_type;
 
+/**
+ * struct dfu_bg - buffers waiting to be written to the medium
+ *
+ * With CONFIG_DFU_BACKGROUND_WRITE, dfu_buf holds DFU_WRITE_BUFS buffers of
+ * dfu_buf_size bytes each. Once a buffer is full it is queued and a writer
+ * thread writes it to the medium, while data goes on arriving in the next one.
+ *
+ * @len: number of bytes to write from each buffer
+ * @fill: buffer being filled
+ * @next: next buffer to be written
+ * @queued: number of buffers waiting to be written, including the one being
+ *	written
+ * @ret: 0 while all is well, -ve once a write has failed
+ * @running: true while the writer thread is running
+ */
+static struct dfu_bg {
+	long len[DFU_WRITE_BUFS];
+	uint fill;
+	uint next;
+	uint queued;
+	int ret;
+	bool running;
+} dfu_bg;
+
+/* Waits until all queued buffers have been written */
+static void dfu_bg_wait(void)
+{
+	while (dfu_bg.queued)
+		uthread_schedule();
+}
+
 unsigned char *dfu_free_buf(void)
 {
+	dfu_bg_wait();
 	free(dfu_buf);
 	dfu_buf = NULL;
 	return dfu_buf;
@@ -232,10 +271,11 @@ unsigned char *dfu_get_buf(struct dfu_entity *dfu)
 	if (dfu->max_buf_size && dfu_buf_size > dfu->max_buf_size)
 		dfu_buf_size = dfu->max_buf_size;
 
-	dfu_buf = memalign(CONFIG_SYS_CACHELINE_SIZE, dfu_buf_size);
+	dfu_buf = memalign(CONFIG_SYS_CACHELINE_SIZE,
+			   dfu_buf_size * DFU_WRITE_BUFS);
 	if (dfu_buf == NULL)
 		printf("%s: Could not memalign 0x%lx bytes\n",
-		       __func__, dfu_buf_size);
+		       __func__, dfu_buf_size * DFU_WRITE_BUFS);
 
 	dfu_buf_device_type = dfu->dev_type;
 	return dfu_buf;
@@ -258,27 +298,18 @@ static char *dfu_get_hash_algo(void)
 	return NULL;
 }
 
-static int dfu_write_buffer_drain(struct dfu_entity *dfu)
+static int dfu_write_medium_buf(struct dfu_entity *dfu, void *buf, long w_size)
 {
-	long w_size;
 	int ret;
 
-	/* flush size? */
-	w_size = dfu->i_buf - dfu->i_buf_start;
-	if (w_size == 0)
-		return 0;
-
 	if (dfu_hash_algo)
-		dfu_hash_algo->hash_update(dfu_hash_algo, &dfu->crc,
-					   dfu->i_buf_start, w_size, 0);
+		dfu_hash_algo->hash_update(dfu_hash_algo, &dfu->crc, buf,
+					   w_size, 0);
 
-	ret = dfu->write_medium(dfu, dfu->offset, dfu->i_buf_start, &w_size);
+	ret = dfu->write_medium(dfu, dfu->offset, buf, &w_size);
 	if (ret)
 		debug("%s: Write error!\n", __func__);
 
-	/* point back */
-	dfu->i_buf = dfu->i_buf_start;
-
 	/* update offset */
 	dfu->offset += w_size;
 
@@ -287,9 +318,84 @@ static int dfu_write_buffer_drain(struct dfu_entity *dfu)
 	return ret;
 }
 
+/* Writes queued buffers in order until there are none left */
+static void dfu_bg_writer(void *arg)
+{
+	struct dfu_entity *dfu = arg;
+	uint i;
+
+	while (dfu_bg.queued) {
+		i = dfu_bg.next;
+		/* Once a write has failed, the rest of the data is dropped */
+		if (!dfu_bg.ret)
+			dfu_bg.ret = dfu_write_medium_buf(dfu, dfu_buf +
+							  i * dfu_buf_size,
+							  dfu_bg.len[i]);
+		dfu_bg.next = (i + 1) % DFU_WRITE_BUFS;
+		dfu_bg.queued--;
+	}
+	dfu_bg.running = false;
+}
+
+/*
+ * Queues the filled buffer and moves on to the next one, waiting for it to be
+ * written if need be. With @sync, also waits for all the data to be written.
+ */
+static int dfu_bg_drain(struct dfu_entity *dfu, long w_size, bool sync)
+{
+	dfu_bg.len[dfu_bg.fill] = w_size;
+	dfu_bg.queued++;
+	dfu_bg.fill = (dfu_bg.fill + 1) % DFU_WRITE_BUFS;
+	if (!dfu_bg.running) {
+		dfu_bg.running = true;
+		if (uthread_create(NULL, dfu_bg_writer, dfu, 0, 0))
+			dfu_bg_writer(dfu);
+	}
+
+	if (sync)
+		dfu_bg_wait();
+	while (dfu_bg.queued == DFU_WRITE_BUFS)
+		uthread_schedule();
+
+	dfu->i_buf_start = dfu_buf + dfu_bg.fill * dfu_buf_size;
+	dfu->i_buf_end = dfu->i_buf_start + dfu_buf_size;
+	dfu->i_buf = dfu->i_buf_start;
+
+	return dfu_bg.ret;
+}
+
+static int dfu_write_buffer_drain(struct dfu_entity *dfu, bool sync)
+{
+	long w_size;
+	int ret;
+
+	/* flush size? */
+	w_size = dfu->i_buf - dfu->i_buf_start;
+	if (w_size == 0) {
+		if (!sync)
+			return 0;
+		dfu_bg_wait();
+		return dfu_bg.ret;
+	}
+
+	if (DFU_WRITE_BUFS > 1)
+		return dfu_bg_drain(dfu, w_size, sync);
+
+	ret = dfu_write_medium_buf(dfu, dfu->i_buf_start, w_size);
+
+	/* point back */
+	dfu->i_buf = dfu->i_buf_start;
+
+	return ret;
+}
+
 void dfu_transaction_cleanup(struct dfu_entity *dfu)
 {
 	/* clear everything */
+	dfu_bg_wait();
+	dfu_bg.fill = 0;
+	dfu_bg.next = 0;
+	dfu_bg.ret = 0;
 	dfu->crc = 0;
 	dfu->offset = 0;
 	dfu->i_blk_seq_num = 0;
@@ -334,7 +440,7 @@ int dfu_flush(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 {
 	int ret = 0;
 
-	ret = dfu_write_buffer_drain(dfu);
+	ret = dfu_write_buffer_drain(dfu, true);
 	if (ret)
 		return ret;
 
@@ -354,6 +460,7 @@ int dfu_flush(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 
 int dfu_write(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 {
+	bool sync;
 	int ret;
 
 	debug("%s: name: %s buf: 0x%p size: 0x%x p_num: 0x%x offset: 0x%llx bufoffset: 0x%lx\n",
@@ -388,9 +495,18 @@ int dfu_write(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 	/* handle rollover */
 	dfu->i_blk_seq_num = (dfu->i_blk_seq_num + 1) & 0xffff;
 
+	/*
+	 * Some callers receive the data into dfu_buf itself, so it must have
+	 * been written out before they can reuse the buffer. Scripts are not
+	 * run in the background either, since they may do anything.
+	 */
+	sync = ((u8 *)buf >= dfu_buf &&
+		(u8 *)buf < dfu_buf + dfu_buf_size * DFU_WRITE_BUFS) ||
+	       dfu->layout == DFU_SCRIPT;
+
 	/* flush buffer if overflow */
 	if ((dfu->i_buf + size) > dfu->i_buf_end) {
-		ret = dfu_write_buffer_drain(dfu);
+		ret = dfu_write_buffer_drain(dfu, sync);
 		if (ret) {
 			dfu_transaction_cleanup(dfu);
 			dfu_error_callback(dfu, "DFU write error");
@@ -412,7 +528,7 @@ int dfu_write(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 
 	/* if end or if buffer full flush */
 	if (size == 0 || (dfu->i_buf + size) > dfu->i_buf_end) {
-		ret = dfu_write_buffer_drain(dfu);
+		ret = dfu_write_buffer_drain(dfu, sync);
 		if (ret) {
 			dfu_transaction_cleanup(dfu);
 			dfu_error_callback(dfu, "DFU write error");
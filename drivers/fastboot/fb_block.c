@@ -30,6 +30,7 @@
 
 struct fb_block_sparse {
 	struct blk_desc	*dev_desc;
+	uint		alignment;
 };
 
 /* Write 0s instead of using erase operation, inefficient but functional */
@@ -119,6 +120,48 @@ static lbaint_t fb_block_sparse_reserve(struct sparse_storage *info,
 	return blkcnt;
 }
 
+/* Erase the whole erase groups in a don't-care region, leaving the rest */
+static lbaint_t fb_block_sparse_discard(struct sparse_storage *info,
+					lbaint_t blk, lbaint_t blkcnt)
+{
+	struct fb_block_sparse *sparse = info->priv;
+	uint alignment = sparse->alignment;
+	lbaint_t start = blk, end = blk + blkcnt;
+	lbaint_t i, cur_blkcnt;
+
+	if (alignment) {
+		start = (start + alignment - 1) & ~(lbaint_t)(alignment - 1);
+		end &= ~(lbaint_t)(alignment - 1);
+	}
+	for (i = start; i < end; i += cur_blkcnt) {
+		cur_blkcnt = min(end - i, (lbaint_t)FASTBOOT_MAX_BLOCKS_ERASE);
+		if (blk_derase(sparse->dev_desc, i, cur_blkcnt) != cur_blkcnt)
+			break;
+	}
+
+	return blkcnt;
+}
+
+static void fb_block_sparse_init(struct sparse_storage *sparse,
+				 struct fb_block_sparse *sparse_priv,
+				 struct blk_desc *dev_desc,
+				 struct disk_partition *info, uint alignment)
+{
+	sparse_priv->dev_desc = dev_desc;
+	sparse_priv->alignment = alignment;
+
+	memset(sparse, '\0', sizeof(*sparse));
+	sparse->blksz = info->blksz;
+	sparse->start = info->start;
+	sparse->size = info->size;
+	sparse->write = fb_block_sparse_write;
+	sparse->reserve = fb_block_sparse_reserve;
+	if (IS_ENABLED(CONFIG_FASTBOOT_SPARSE_DISCARD))
+		sparse->discard = fb_block_sparse_discard;
+	sparse->mssg = fastboot_fail;
+	sparse->priv = sparse_priv;
+}
+
 int fastboot_block_get_part_info(const char *part_name,
 				 struct blk_desc **dev_desc,
 				 struct disk_partition *part_info,
@@ -278,31 +321,39 @@ void fastboot_block_write_raw_image(struct blk_desc *dev_desc,
 }
 
 void fastboot_block_write_sparse_image(struct blk_desc *dev_desc, struct disk_partition *info,
-				       const char *part_name, void *buffer, char *response)
+				       const char *part_name, void *buffer, uint alignment,
+				       char *response)
 {
 	struct fb_block_sparse sparse_priv;
 	struct sparse_storage sparse;
 	int err;
 
-	sparse_priv.dev_desc = dev_desc;
-
-	sparse.blksz = info->blksz;
-	sparse.start = info->start;
-	sparse.size = info->size;
-	sparse.write = fb_block_sparse_write;
-	sparse.reserve = fb_block_sparse_reserve;
-	sparse.mssg = fastboot_fail;
+	fb_block_sparse_init(&sparse, &sparse_priv, dev_desc, info, alignment);
 
 	printf("Flashing sparse image at offset " LBAFU "\n",
 	       sparse.start);
 
-	sparse.priv = &sparse_priv;
 	err = write_sparse_image(&sparse, part_name, buffer,
 				 response);
 	if (!err)
 		fastboot_okay(NULL, response);
 }
 
+int fastboot_block_stream_start(struct blk_desc *dev_desc, struct disk_partition *info,
+				const char *part_name, uint alignment, u32 size,
+				char *response)
+{
+	/* These must last until the download is finished */
+	static struct fb_block_sparse sparse_priv;
+	static struct sparse_storage sparse;
+
+	fb_block_sparse_init(&sparse, &sparse_priv, dev_desc, info, alignment);
+
+	printf("Streaming sparse image to offset " LBAFU "\n", sparse.start);
+
+	return fastboot_stream_start(&sparse, part_name, size, response);
+}
+
 void fastboot_block_flash_write(const char *part_name, void *download_buffer,
 				u32 download_bytes, char *response)
 {
@@ -314,9 +365,23 @@ void fastboot_block_flash_write(const char *part_name, void *download_buffer,
 
 	if (is_sparse_image(download_buffer)) {
 		fastboot_block_write_sparse_image(dev_desc, &part_info, part_name,
-						  download_buffer, response);
+						  download_buffer, 0, response);
 	} else {
 		fastboot_block_write_raw_image(dev_desc, &part_info, part_name,
 					       download_buffer, download_bytes, response);
 	}
 }
+
+int fastboot_block_stream(const char *part_name, u32 size, char *response)
+{
+	struct blk_desc *dev_desc;
+	struct disk_partition part_info;
+	int ret;
+
+	ret = fastboot_block_get_part_info(part_name, &dev_desc, &part_info, response);
+	if (ret < 0)
+		return ret;
+
+	return fastboot_block_stream_start(dev_desc, &part_info, part_name, 0, size,
+					   response);
+}
@@ -32,6 +32,21 @@ static u32 fastboot_bytes_received;
  */
 static u32 fastboot_bytes_expected;
 
+/**
+ * stream_part - partition to write downloads to as they arrive, if any
+ */
+static char stream_part[PART_NAME_LEN];
+
+/**
+ * stream_state - whether the current or last download was written to
+ * stream_part as it arrived
+ */
+static enum {
+	STREAM_NONE,
+	STREAM_ACTIVE,
+	STREAM_DONE,
+} stream_state;
+
 static void okay(char *, char *);
 static void getvar(char *, char *);
 static void download(char *, char *);
@@ -45,6 +60,7 @@ static void oem_partconf(char *, char *);
 static void oem_bootbus(char *, char *);
 static void oem_console(char *, char *);
 static void oem_board(char *, char *);
+static void oem_stream(char *, char *);
 static void run_ucmd(char *, char *);
 static void run_acmd(char *, char *);
 
@@ -120,6 +136,10 @@ static const struct {
 		.command = "oem board",
 		.dispatch = CONFIG_IS_ENABLED(FASTBOOT_OEM_BOARD, (oem_board), (NULL))
 	},
+	[FASTBOOT_COMMAND_OEM_STREAM] = {
+		.command = "oem stream",
+		.dispatch = CONFIG_IS_ENABLED(FASTBOOT_STREAM, (oem_stream), (NULL))
+	},
 	[FASTBOOT_COMMAND_UCMD] = {
 		.command = "UCmd",
 		.dispatch = CONFIG_IS_ENABLED(FASTBOOT_UUU_SUPPORT, (run_ucmd), (NULL))
@@ -221,6 +241,25 @@ static void getvar(char *cmd_parameter, char *response)
 	fastboot_getvar(cmd_parameter, response);
 }
 
+/**
+ * stream_start() - Start writing a download to stream_part as it arrives
+ *
+ * @size: Number of bytes in the download
+ * @response: Pointer to fastboot response buffer, set on error
+ * Return: 0 on success, -ve on error
+ */
+static int stream_start(u32 size, char *response)
+{
+	if (IS_ENABLED(CONFIG_FASTBOOT_FLASH_BLOCK))
+		return fastboot_block_stream(stream_part, size, response);
+
+	if (IS_ENABLED(CONFIG_FASTBOOT_FLASH_MMC))
+		return fastboot_mmc_stream(stream_part, size, response);
+
+	fastboot_fail("streaming not supported", response);
+	return -ENOSYS;
+}
+
 /**
  * fastboot_download() - Start a download transfer from the client
  *
@@ -241,6 +280,17 @@ static void download(char *cmd_parameter, char *response)
 		fastboot_fail("Expected nonzero image size", response);
 		return;
 	}
+	stream_state = STREAM_NONE;
+	if (IS_ENABLED(CONFIG_FASTBOOT_STREAM) && stream_part[0]) {
+		/* The buffer is only used as a ring, so any size will do */
+		if (stream_start(fastboot_bytes_expected, response))
+			return;
+		stream_state = STREAM_ACTIVE;
+		printf("Starting download of %d bytes to '%s'\n",
+		       fastboot_bytes_expected, stream_part);
+		fastboot_response("DATA", response, "%s", cmd_parameter);
+		return;
+	}
 	/*
 	 * Nothing to download yet. Response is of the form:
 	 * [DATA|FAIL]$cmd_parameter
@@ -294,9 +344,20 @@ void fastboot_data_download(const void *fastboot_data,
 			      response);
 		return;
 	}
-	/* Download data to fastboot_buf_addr */
-	memcpy(fastboot_buf_addr + fastboot_bytes_received,
-	       fastboot_data, fastboot_data_len);
+	if (IS_ENABLED(CONFIG_FASTBOOT_STREAM) &&
+	    stream_state == STREAM_ACTIVE) {
+		if (fastboot_stream_write(fastboot_data, fastboot_data_len,
+					  response)) {
+			/* Reject the rest, which will not fit in the buffer */
+			stream_state = STREAM_NONE;
+			fastboot_bytes_expected = fastboot_bytes_received;
+			return;
+		}
+	} else {
+		/* Download data to fastboot_buf_addr */
+		memcpy(fastboot_buf_addr + fastboot_bytes_received,
+		       fastboot_data, fastboot_data_len);
+	}
 
 	pre_dot_num = fastboot_bytes_received / BYTES_PER_DOT;
 	fastboot_bytes_received += fastboot_data_len;
@@ -321,6 +382,13 @@ void fastboot_data_complete(char *response)
 {
 	/* Download complete. Respond with "OKAY" */
 	fastboot_okay(NULL, response);
+	if (IS_ENABLED(CONFIG_FASTBOOT_STREAM) &&
+	    stream_state == STREAM_ACTIVE) {
+		/* Wait for the rest of the image to be written */
+		stream_state = STREAM_DONE;
+		if (fastboot_stream_finish(response))
+			stream_state = STREAM_NONE;
+	}
 	printf("\ndownloading of %d bytes finished\n", fastboot_bytes_received);
 	image_size = fastboot_bytes_received;
 	env_set_hex("filesize", image_size);
@@ -339,6 +407,16 @@ void fastboot_data_complete(char *response)
  */
 static void __maybe_unused flash(char *cmd_parameter, char *response)
 {
+	if (IS_ENABLED(CONFIG_FASTBOOT_STREAM) && stream_state == STREAM_DONE) {
+		/* The image has already been written */
+		if (cmd_parameter && !strcmp(cmd_parameter, stream_part))
+			fastboot_okay(NULL, response);
+		else
+			fastboot_fail("image was written to another partition",
+				      response);
+		return;
+	}
+
 	if (IS_ENABLED(CONFIG_FASTBOOT_FLASH_BLOCK))
 		fastboot_block_flash_write(cmd_parameter, fastboot_buf_addr,
 					   image_size, response);
@@ -589,3 +667,24 @@ static void __maybe_unused oem_board(char *cmd_parameter, char *response)
 {
 	fastboot_oem_board(cmd_parameter, (void *)fastboot_buf_addr, image_size, response);
 }
+
+/**
+ * oem_stream() - Execute the OEM stream command
+ *
+ * @cmd_parameter: Pointer to command parameter
+ * @response: Pointer to fastboot response buffer
+ *
+ * Sets the partition which following downloads are written to as they
+ * arrive, or goes back to normal downloads if no partition is given. Each
+ * download must be a sparse image.
+ */
+static void __maybe_unused oem_stream(char *cmd_parameter, char *response)
+{
+	if (cmd_parameter && strlen(cmd_parameter) >= sizeof(stream_part)) {
+		fastboot_fail("partition name too long", response);
+		return;
+	}
+	strlcpy(stream_part, cmd_parameter ? cmd_parameter : "",
+		sizeof(stream_part));
+	fastboot_okay(NULL, response);
+}
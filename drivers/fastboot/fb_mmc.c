@@ -356,6 +356,14 @@ static struct blk_desc *fastboot_mmc_get_dev(char *response)
 	return ret;
 }
 
+/* Erase group size, so that discarding a region leaves the data around it */
+static uint fb_mmc_erase_grp_size(void)
+{
+	struct mmc *mmc = find_mmc_device(CONFIG_FASTBOOT_FLASH_MMC_DEV);
+
+	return mmc ? mmc->erase_grp_size : 0;
+}
+
 /**
  * fastboot_mmc_flash_write() - Write image to eMMC for fastboot
  *
@@ -468,13 +476,38 @@ void fastboot_mmc_flash_write(const char *cmd, void *download_buffer,
 
 	if (is_sparse_image(download_buffer)) {
 		fastboot_block_write_sparse_image(dev_desc, &info, cmd,
-						  download_buffer, response);
+						  download_buffer,
+						  fb_mmc_erase_grp_size(),
+						  response);
 	} else {
 		fastboot_block_write_raw_image(dev_desc, &info, cmd, download_buffer,
 					       download_bytes, response);
 	}
 }
 
+/**
+ * fastboot_mmc_stream() - Stream a sparse image to eMMC for fastboot
+ *
+ * @cmd: Named partition to write image to
+ * @size: Size of the image to be downloaded
+ * @response: Pointer to fastboot response buffer
+ * Return: 0 on success, -ve on error
+ */
+int fastboot_mmc_stream(const char *cmd, u32 size, char *response)
+{
+	struct blk_desc *dev_desc;
+	struct disk_partition info;
+	int ret;
+
+	ret = fastboot_mmc_get_part_info(cmd, &dev_desc, &info, response);
+	if (ret < 0)
+		return ret;
+
+	return fastboot_block_stream_start(dev_desc, &info, cmd,
+					   fb_mmc_erase_grp_size(), size,
+					   response);
+}
+
 /**
  * fastboot_mmc_flash_erase() - Erase eMMC for fastboot
  *
@@ -0,0 +1,171 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Writing sparse images to storage while they are downloaded
+ *
+ * With CONFIG_FASTBOOT_STREAM, the partition given by "oem stream" is written
+ * as each download arrives, rather than by a "flash" command once the whole
+ * image is in memory. The download buffer is used as a ring: the transport
+ * adds data to it and a writer thread passes the data on to the sparse image
+ * parser, which writes it out. Storage drivers wait for the hardware with
+ * udelay(), which schedules other threads, so the transfer goes on while
+ * blocks are being written. Without CONFIG_UTHREAD, the data is written as it
+ * arrives instead.
+ */
+
+#include <fastboot.h>
+#include <fastboot-internal.h>
+#include <image-sparse.h>
+#include <log.h>
+#include <uthread.h>
+#include <linux/sizes.h>
+
+/* Most data to pass to the parser at once, so that space is freed often */
+#define FB_STREAM_STEP	SZ_1M
+
+/**
+ * struct fb_stream - state of the download being written
+ *
+ * @ss: sparse image parser
+ * @size: number of bytes in the download
+ * @head: number of bytes added to the ring so far
+ * @tail: number of bytes passed to the parser so far
+ * @grp_id: thread group of the writer thread
+ * @ret: 0 while all is well, -ve once writing has failed or been cancelled
+ * @active: true from fastboot_stream_start() until the download is finished
+ * @progress: progress callback to restore when the download is finished
+ * @response: fastboot response set by the parser when writing fails
+ */
+static struct fb_stream {
+	struct sparse_stream ss;
+	u32 size;
+	u32 head;
+	u32 tail;
+	uint grp_id;
+	int ret;
+	bool active;
+	void (*progress)(const char *msg);
+	char response[FASTBOOT_RESPONSE_LEN];
+} stream;
+
+static void fb_stream_writer(void *arg)
+{
+	u32 off, len;
+
+	while (!stream.ret && stream.tail < stream.size) {
+		len = stream.head - stream.tail;
+		if (!len) {
+			uthread_schedule();
+			continue;
+		}
+		off = stream.tail % fastboot_buf_size;
+		len = min3(len, fastboot_buf_size - off, (u32)FB_STREAM_STEP);
+		stream.ret = sparse_stream_write(&stream.ss,
+						 fastboot_buf_addr + off, len,
+						 stream.response);
+		stream.tail += len;
+	}
+}
+
+/* Waits for the writer thread to exit, then tidies up */
+static int fb_stream_stop(void)
+{
+	int ret;
+
+	while (!uthread_grp_done(stream.grp_id))
+		uthread_schedule();
+	stream.active = false;
+	fastboot_progress_callback = stream.progress;
+
+	ret = sparse_stream_finish(&stream.ss, stream.response);
+	if (stream.ret)
+		ret = stream.ret;
+	if (ret && !stream.response[0])
+		fastboot_fail("failed to write image", stream.response);
+
+	return ret;
+}
+
+int fastboot_stream_start(struct sparse_storage *info, const char *part_name,
+			  u32 size, char *response)
+{
+	int ret;
+
+	/* Drop any download which was not finished */
+	if (stream.active) {
+		stream.ret = -ECANCELED;
+		fb_stream_stop();
+	}
+
+	sparse_stream_init(&stream.ss, info, part_name);
+	stream.size = size;
+	stream.head = 0;
+	stream.tail = 0;
+	stream.ret = 0;
+	stream.response[0] = '\0';
+
+	/* The transport is busy with the download, so cannot report progress */
+	stream.progress = fastboot_progress_callback;
+	fastboot_progress_callback = NULL;
+	stream.active = true;
+
+	if (CONFIG_IS_ENABLED(UTHREAD)) {
+		stream.grp_id = uthread_grp_new_id();
+		ret = uthread_create(NULL, fb_stream_writer, NULL, 0,
+				     stream.grp_id);
+		if (ret) {
+			stream.ret = ret;
+			fb_stream_stop();
+			fastboot_fail("cannot start writer", response);
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+int fastboot_stream_write(const void *data, u32 len, char *response)
+{
+	u32 off, n;
+
+	if (!CONFIG_IS_ENABLED(UTHREAD)) {
+		stream.ret = sparse_stream_write(&stream.ss, data, len,
+						 stream.response);
+		len = 0;
+	}
+
+	while (len && !stream.ret) {
+		/* Wait for the writer thread to make room */
+		n = fastboot_buf_size - (stream.head - stream.tail);
+		if (!n) {
+			uthread_schedule();
+			continue;
+		}
+		off = stream.head % fastboot_buf_size;
+		n = min3(n, fastboot_buf_size - off, len);
+		memcpy(fastboot_buf_addr + off, data, n);
+		stream.head += n;
+		data += n;
+		len -= n;
+	}
+
+	if (stream.ret) {
+		fb_stream_stop();
+		strlcpy(response, stream.response, FASTBOOT_RESPONSE_LEN);
+		return stream.ret;
+	}
+
+	return 0;
+}
+
+int fastboot_stream_finish(char *response)
+{
+	int ret;
+
+	ret = fb_stream_stop();
+	if (ret) {
+		strlcpy(response, stream.response, FASTBOOT_RESPONSE_LEN);
+		return ret;
+	}
+
+	return 0;
+}
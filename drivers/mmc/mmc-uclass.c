@@ -487,7 +487,6 @@ static int mmc_select_hwpart(struct udevice *bdev, int hwpart)
 	struct udevice *mmc_dev = dev_get_parent(bdev);
 	struct mmc *mmc = mmc_get_mmc_dev(mmc_dev);
 	struct blk_desc *desc = dev_get_uclass_plat(bdev);
-	int ret;
 
 	if (desc->hwpart == hwpart)
 		return 0;
@@ -495,11 +494,7 @@ static int mmc_select_hwpart(struct udevice *bdev, int hwpart)
 	if (mmc->part_config == MMCPART_NOAVAILABLE)
 		return -EMEDIUMTYPE;
 
-	ret = mmc_switch_part(mmc, hwpart);
-	if (!ret)
-		blkcache_invalidate(desc->uclass_id, desc->devnum);
-
-	return ret;
+	return mmc_switch_part(mmc, hwpart);
 }
 
 static int mmc_blk_probe(struct udevice *dev)
@@ -903,6 +903,8 @@ static int spi_nor_wait_till_ready_with_timeout(struct spi_nor *nor,
 			return ret;
 		if (ret)
 			return 0;
+		/* Let other threads run while the flash is busy */
+		schedule();
 	}
 
 	dev_err(nor->dev, "flash operation timed out\n");
@@ -79,6 +79,8 @@
 #include <u-boot/crc.h>
 #else
 #include <div64.h>
+#include <time.h>
+#include <uthread.h>
 #include <linux/bug.h>
 #include <linux/err.h>
 #include <linux/printk.h>
@@ -1055,6 +1057,235 @@ adjust_mean_ec:
 	return 0;
 }
 
+#if CONFIG_IS_ENABLED(MTD_UBI_SCAN_AHEAD)
+#define UBI_SCAN_AHEAD_PEBS	CONFIG_MTD_UBI_SCAN_AHEAD_PEBS
+#else
+#define UBI_SCAN_AHEAD_PEBS	1
+#endif
+
+/**
+ * enum ubi_sa_state - state of a slot in the scan-ahead ring
+ * @UBI_SA_READ: the headers were read without any trouble
+ * @UBI_SA_BAD: the PEB is bad
+ * @UBI_SA_SKIP: something went wrong, so the PEB is left to the normal path,
+ *               which reports the problem
+ */
+enum ubi_sa_state {
+	UBI_SA_READ,
+	UBI_SA_BAD,
+	UBI_SA_SKIP,
+};
+
+/**
+ * struct ubi_scan_ahead - PEB headers read ahead of scan_peb()
+ * @buf: one slot for each PEB, holding the start of the PEB up to the end of
+ *       its VID header
+ * @state: state of each slot
+ * @len: size of a slot
+ * @next: next PEB to read
+ * @first: lowest PEB whose slot is still needed
+ * @end: PEB at which to stop
+ * @threaded: true if a thread is reading ahead
+ * @stop: true to make the thread finish
+ * @grp_id: thread group of the thread
+ * @lock: held by whichever thread is using the MTD device
+ *
+ * While scanning, the EC and VID headers of each PEB are read with a single
+ * MTD read, several PEBs ahead of the one being checked. ubi_io_read() and
+ * ubi_io_is_bad() then find what they need here. With CONFIG_UTHREAD the
+ * reading is done by a thread, so that it goes on while the headers read
+ * before are being checked. Anything other than a clean read is left to the
+ * normal path, so errors and bit-flips are handled just as before.
+ */
+struct ubi_scan_ahead {
+	void *buf;
+	u8 state[UBI_SCAN_AHEAD_PEBS];
+	int len;
+	int next;
+	int first;
+	int end;
+	bool threaded;
+	bool stop;
+	uint grp_id;
+	struct uthread_mutex lock;
+};
+
+/* Reads the next PEB ahead, returning false if there is no room for it */
+static bool scan_ahead_one(struct ubi_device *ubi, struct ubi_scan_ahead *sa)
+{
+	int pnum = sa->next, slot = pnum % UBI_SCAN_AHEAD_PEBS;
+	loff_t addr = (loff_t)pnum * ubi->peb_size;
+	size_t read;
+	int err;
+
+	if (pnum >= sa->end || pnum >= sa->first + UBI_SCAN_AHEAD_PEBS)
+		return false;
+
+	uthread_mutex_lock(&sa->lock);
+	err = ubi->bad_allowed ? mtd_block_isbad(ubi->mtd, addr) : 0;
+	if (err > 0) {
+		sa->state[slot] = UBI_SA_BAD;
+	} else if (err) {
+		sa->state[slot] = UBI_SA_SKIP;
+	} else {
+		err = mtd_read(ubi->mtd, addr, sa->len, &read,
+			       sa->buf + slot * sa->len);
+		sa->state[slot] = err || read != sa->len ? UBI_SA_SKIP :
+			UBI_SA_READ;
+	}
+	uthread_mutex_unlock(&sa->lock);
+	sa->next++;
+
+	return true;
+}
+
+static void scan_ahead_thread(void *arg)
+{
+	struct ubi_device *ubi = arg;
+	struct ubi_scan_ahead *sa = ubi->scan_ahead;
+
+	while (!sa->stop && sa->next < sa->end) {
+		if (!scan_ahead_one(ubi, sa))
+			uthread_schedule();
+	}
+}
+
+/**
+ * scan_ahead_start - start reading headers ahead.
+ * @ubi: UBI device description object
+ * @start: first PEB to read
+ * @end: PEB at which to stop
+ *
+ * If there is not enough memory, the PEBs are just scanned one at a time.
+ */
+static void scan_ahead_start(struct ubi_device *ubi, int start, int end)
+{
+	struct ubi_scan_ahead *sa;
+
+	if (!CONFIG_IS_ENABLED(MTD_UBI_SCAN_AHEAD))
+		return;
+
+	sa = kzalloc(sizeof(*sa), GFP_KERNEL);
+	if (!sa)
+		return;
+	sa->len = ubi->vid_hdr_aloffset + ubi->vid_hdr_alsize;
+	sa->buf = kmalloc(UBI_SCAN_AHEAD_PEBS * sa->len, GFP_KERNEL);
+	if (!sa->buf) {
+		kfree(sa);
+		return;
+	}
+	sa->next = start;
+	sa->first = start;
+	sa->end = end;
+	ubi->scan_ahead = sa;
+
+	if (CONFIG_IS_ENABLED(UTHREAD)) {
+		sa->grp_id = uthread_grp_new_id();
+		sa->threaded = !uthread_create(NULL, scan_ahead_thread, ubi, 0,
+					       sa->grp_id);
+	}
+}
+
+/* Waits until the headers of @pnum have been read */
+static void scan_ahead_wait(struct ubi_device *ubi, int pnum)
+{
+	struct ubi_scan_ahead *sa = ubi->scan_ahead;
+
+	if (!sa)
+		return;
+
+	sa->first = pnum;
+	while (sa->next <= pnum) {
+		if (sa->threaded)
+			uthread_schedule();
+		else if (!scan_ahead_one(ubi, sa))
+			break;
+	}
+}
+
+static void scan_ahead_stop(struct ubi_device *ubi)
+{
+	struct ubi_scan_ahead *sa = ubi->scan_ahead;
+
+	if (!sa)
+		return;
+
+	sa->stop = true;
+	while (sa->threaded && !uthread_grp_done(sa->grp_id))
+		uthread_schedule();
+	ubi->scan_ahead = NULL;
+	kfree(sa->buf);
+	kfree(sa);
+}
+
+/**
+ * ubi_scan_ahead_read - get data read ahead while scanning.
+ * @ubi: UBI device description object
+ * @buf: buffer to copy the data to
+ * @pnum: physical eraseblock to read from
+ * @offset: offset within the physical eraseblock
+ * @len: number of bytes to read
+ *
+ * Returns zero if the data was read ahead and has been copied to @buf, and
+ * %-ENOENT if it has to be read from the flash.
+ */
+int ubi_scan_ahead_read(const struct ubi_device *ubi, void *buf, int pnum,
+			int offset, int len)
+{
+	struct ubi_scan_ahead *sa = ubi->scan_ahead;
+	int slot = pnum % UBI_SCAN_AHEAD_PEBS;
+
+	if (pnum < sa->first || pnum >= sa->next ||
+	    sa->state[slot] != UBI_SA_READ || offset + len > sa->len)
+		return -ENOENT;
+	memcpy(buf, sa->buf + slot * sa->len + offset, len);
+
+	return 0;
+}
+
+/**
+ * ubi_scan_ahead_is_bad - check whether a PEB was found to be bad.
+ * @ubi: UBI device description object
+ * @pnum: physical eraseblock number to check
+ *
+ * Returns %1 if the PEB is bad, zero if not, and %-ENOENT if that is not
+ * known yet.
+ */
+int ubi_scan_ahead_is_bad(const struct ubi_device *ubi, int pnum)
+{
+	struct ubi_scan_ahead *sa = ubi->scan_ahead;
+	int slot = pnum % UBI_SCAN_AHEAD_PEBS;
+
+	if (pnum < sa->first || pnum >= sa->next ||
+	    sa->state[slot] == UBI_SA_SKIP)
+		return -ENOENT;
+
+	return sa->state[slot] == UBI_SA_BAD;
+}
+
+/**
+ * ubi_scan_ahead_lock - claim the MTD device while scanning.
+ * @ubi: UBI device description object
+ *
+ * The MTD device may be in use by the thread reading ahead, so this waits for
+ * it to finish.
+ */
+void ubi_scan_ahead_lock(const struct ubi_device *ubi)
+{
+	if (ubi->scan_ahead)
+		uthread_mutex_lock(&ubi->scan_ahead->lock);
+}
+
+/**
+ * ubi_scan_ahead_unlock - release the MTD device while scanning.
+ * @ubi: UBI device description object
+ */
+void ubi_scan_ahead_unlock(const struct ubi_device *ubi)
+{
+	if (ubi->scan_ahead)
+		uthread_mutex_unlock(&ubi->scan_ahead->lock);
+}
+
 /**
  * late_analysis - analyze the overall situation with PEB.
  * @ubi: UBI device description object
@@ -1243,14 +1474,20 @@ static int scan_all(struct ubi_device *ubi, struct ubi_attach_info *ai,
 	if (!vidh)
 		goto out_ech;
 
+	err = 0;
+	scan_ahead_start(ubi, start, ubi->peb_count);
 	for (pnum = start; pnum < ubi->peb_count; pnum++) {
 		cond_resched();
 
 		dbg_gen("process PEB %d", pnum);
+		scan_ahead_wait(ubi, pnum);
 		err = scan_peb(ubi, ai, pnum, NULL, NULL);
 		if (err < 0)
-			goto out_vidh;
+			break;
 	}
+	scan_ahead_stop(ubi);
+	if (err < 0)
+		goto out_vidh;
 
 	ubi_msg(ubi, "scanning is finished");
 
@@ -1352,21 +1589,26 @@ static int scan_fast(struct ubi_device *ubi, struct ubi_attach_info **ai)
 	if (!vidh)
 		goto out_ech;
 
+	scan_ahead_start(ubi, 0, UBI_FM_MAX_START);
 	for (pnum = 0; pnum < UBI_FM_MAX_START; pnum++) {
 		int vol_id = -1;
 		unsigned long long sqnum = -1;
 		cond_resched();
 
 		dbg_gen("process PEB %d", pnum);
+		scan_ahead_wait(ubi, pnum);
 		err = scan_peb(ubi, *ai, pnum, &vol_id, &sqnum);
 		if (err < 0)
-			goto out_vidh;
+			break;
 
 		if (vol_id == UBI_FM_SB_VOLUME_ID && sqnum > max_sqnum) {
 			max_sqnum = sqnum;
 			fm_anchor = pnum;
 		}
 	}
+	scan_ahead_stop(ubi);
+	if (err < 0)
+		goto out_vidh;
 
 	ubi_free_vid_hdr(ubi, vidh);
 	kfree(ech);
@@ -1391,6 +1633,16 @@ out:
 
 #endif
 
+/* Adds the time since @start to that taken by @step, and restarts the clock */
+static void attach_time(struct ubi_device *ubi, enum ubi_attach_step step,
+			ulong *start)
+{
+	ulong now = timer_get_us();
+
+	ubi->attach_us[step] += now - *start;
+	*start = now;
+}
+
 /**
  * ubi_attach - attach an MTD device.
  * @ubi: UBI device descriptor
@@ -1403,11 +1655,15 @@ int ubi_attach(struct ubi_device *ubi, int force_scan)
 {
 	int err;
 	struct ubi_attach_info *ai;
+	ulong start;
 
 	ai = alloc_ai();
 	if (!ai)
 		return -ENOMEM;
 
+	memset(ubi->attach_us, '\0', sizeof(ubi->attach_us));
+	start = timer_get_us();
+
 #ifdef CONFIG_MTD_UBI_FASTMAP
 	/* On small flash devices we disable fastmap in any case. */
 	if ((int)mtd_div_by_eb(ubi->mtd->size, ubi->mtd) <= UBI_FM_MAX_START) {
@@ -1419,6 +1675,7 @@ int ubi_attach(struct ubi_device *ubi, int force_scan)
 		err = scan_all(ubi, ai, 0);
 	else {
 		err = scan_fast(ubi, &ai);
+		attach_time(ubi, UBI_ATTACH_FASTMAP, &start);
 		if (err > 0 || mtd_is_eccerr(err)) {
 			if (err != UBI_NO_FASTMAP) {
 				destroy_ai(ai);
@@ -1435,6 +1692,7 @@ int ubi_attach(struct ubi_device *ubi, int force_scan)
 #else
 	err = scan_all(ubi, ai, 0);
 #endif
+	attach_time(ubi, UBI_ATTACH_SCAN, &start);
 	if (err)
 		goto out_ai;
 
@@ -1446,14 +1704,17 @@ int ubi_attach(struct ubi_device *ubi, int force_scan)
 	dbg_gen("max. sequence number:       %llu", ai->max_sqnum);
 
 	err = ubi_read_volume_table(ubi, ai);
+	attach_time(ubi, UBI_ATTACH_VTBL, &start);
 	if (err)
 		goto out_ai;
 
 	err = ubi_wl_init(ubi, ai);
+	attach_time(ubi, UBI_ATTACH_WL, &start);
 	if (err)
 		goto out_vtbl;
 
 	err = ubi_eba_init(ubi, ai);
+	attach_time(ubi, UBI_ATTACH_EBA, &start);
 	if (err)
 		goto out_wl;
 
@@ -25,8 +25,8 @@
 #include <linux/kernel.h>
 #include <linux/module.h>
 #include <linux/compiler.h>
-#include <u-boot/crc.h>
 #endif
+#include <u-boot/crc.h>
 #include <linux/types.h>
 
 #include <asm/byteorder.h>
@@ -81,7 +81,10 @@ u32 crc32_le(u32 crc, unsigned char const *p, size_t len)
 
 u32 crc32_le(u32 crc, unsigned char const *p, size_t len)
 {
-# if CRC_LE_BITS == 8
+# if CRC_LE_BITS == 8 && defined(__UBOOT__)
+	/* The common code picks the fastest engine there is */
+	return crc32_no_comp(crc, p, len);
+# elif CRC_LE_BITS == 8
 	const u32      *b =(u32 *)p;
 	const u32      *tab = crc32table_le;
 
@@ -136,6 +136,10 @@ int ubi_io_read(const struct ubi_device *ubi, void *buf, int pnum, int offset,
 	if (err)
 		return err;
 
+	/* The headers may have been read already while attaching */
+	if (ubi->scan_ahead && !ubi_scan_ahead_read(ubi, buf, pnum, offset, len))
+		return 0;
+
 	/*
 	 * Deliberately corrupt the buffer to improve robustness. Indeed, if we
 	 * do not do this, the following may happen:
@@ -160,7 +164,9 @@ int ubi_io_read(const struct ubi_device *ubi, void *buf, int pnum, int offset,
 
 	addr = (loff_t)pnum * ubi->peb_size + offset;
 retry:
+	ubi_scan_ahead_lock(ubi);
 	err = mtd_read(ubi->mtd, addr, len, &read, buf);
+	ubi_scan_ahead_unlock(ubi);
 	if (err) {
 		const char *errstr = mtd_is_eccerr(err) ? " (ECC error)" : "";
 
@@ -606,7 +612,15 @@ int ubi_io_is_bad(const struct ubi_device *ubi, int pnum)
 	if (ubi->bad_allowed) {
 		int ret;
 
+		if (ubi->scan_ahead) {
+			ret = ubi_scan_ahead_is_bad(ubi, pnum);
+			if (ret >= 0)
+				return ret;
+		}
+
+		ubi_scan_ahead_lock(ubi);
 		ret = mtd_block_isbad(mtd, (loff_t)pnum * ubi->peb_size);
+		ubi_scan_ahead_unlock(ubi);
 		if (ret < 0)
 			ubi_err(ubi, "error %d while checking if PEB %d is bad",
 				ret, pnum);
@@ -416,6 +416,27 @@ struct ubi_debug_info {
 	struct dentry *dfs_power_cut_max;
 };
 
+/**
+ * enum ubi_attach_step - steps of attaching, each of which is timed
+ * @UBI_ATTACH_FASTMAP: looking for a fastmap and attaching from it
+ * @UBI_ATTACH_SCAN: reading and checking the headers of each PEB
+ * @UBI_ATTACH_VTBL: reading the volume table
+ * @UBI_ATTACH_WL: setting up wear-leveling
+ * @UBI_ATTACH_EBA: setting up the eraseblock association table
+ * @UBI_ATTACH_STEPS: number of steps
+ */
+enum ubi_attach_step {
+	UBI_ATTACH_FASTMAP,
+	UBI_ATTACH_SCAN,
+	UBI_ATTACH_VTBL,
+	UBI_ATTACH_WL,
+	UBI_ATTACH_EBA,
+
+	UBI_ATTACH_STEPS,
+};
+
+struct ubi_scan_ahead;
+
 /**
  * struct ubi_device - UBI device description structure
  * @dev: UBI device object to use the the Linux device model
@@ -529,6 +550,9 @@ struct ubi_debug_info {
  * @buf_mutex: protects @peb_buf
  * @ckvol_mutex: serializes static volume checking when opening
  *
+ * @scan_ahead: headers read ahead while scanning, %NULL when not scanning
+ * @attach_us: time taken by each step of attaching, in microseconds
+ *
  * @dbg: debugging information for this UBI device
  */
 struct ubi_device {
@@ -628,6 +652,9 @@ struct ubi_device {
 	struct mutex buf_mutex;
 	struct mutex ckvol_mutex;
 
+	struct ubi_scan_ahead *scan_ahead;
+	unsigned long attach_us[UBI_ATTACH_STEPS];
+
 	struct ubi_debug_info dbg;
 };
 
@@ -796,6 +823,11 @@ struct ubi_ainf_peb *ubi_early_get_peb(struct ubi_device *ubi,
 				       struct ubi_attach_info *ai);
 int ubi_attach(struct ubi_device *ubi, int force_scan);
 void ubi_destroy_ai(struct ubi_attach_info *ai);
+int ubi_scan_ahead_read(const struct ubi_device *ubi, void *buf, int pnum,
+			int offset, int len);
+int ubi_scan_ahead_is_bad(const struct ubi_device *ubi, int pnum);
+void ubi_scan_ahead_lock(const struct ubi_device *ubi);
+void ubi_scan_ahead_unlock(const struct ubi_device *ubi);
 
 /* vtbl.c */
 int ubi_change_vtbl_record(struct ubi_device *ubi, int idx,
@@ -17,12 +17,14 @@
 #include <linux/compat.h>
 #include "nvme.h"
 
-#define NVME_Q_DEPTH		2
+#define NVME_Q_DEPTH		64
+/* I/O queue depth for controllers with their own command submission */
+#define NVME_SYNC_Q_DEPTH	2
 #define NVME_AQ_DEPTH		2
 #define NVME_SQ_SIZE(depth)	(depth * sizeof(struct nvme_command))
 #define NVME_CQ_SIZE(depth)	(depth * sizeof(struct nvme_completion))
-#define NVME_CQ_ALLOCATION	ALIGN(NVME_CQ_SIZE(NVME_Q_DEPTH), \
-				      ARCH_DMA_MINALIGN)
+#define NVME_CQ_ALLOCATION(depth)	ALIGN(NVME_CQ_SIZE(depth), \
+					      ARCH_DMA_MINALIGN)
 #define ADMIN_TIMEOUT		60
 #define IO_TIMEOUT		30
 #define MAX_PRP_POOL		512
@@ -44,7 +46,18 @@ static int nvme_wait_csts(struct nvme_dev *dev, u32 mask, u32 val)
 	return -ETIME;
 }
 
-static int nvme_setup_prps(struct nvme_dev *dev, u64 *prp2,
+/**
+ * nvme_setup_prps() - set up the PRP entries for a transfer
+ *
+ * @dev:	NVMe device
+ * @prp_list:	memory for the PRP list, which must be large enough for the
+ *		transfer, or NULL to use (and grow if needed) dev->prp_pool
+ * @prp2:	returns the value for the PRP2 field of the command
+ * @total_len:	length of the transfer in bytes
+ * @dma_addr:	start address of the transfer
+ * Return:	0 if OK, -ENOMEM if out of memory
+ */
+static int nvme_setup_prps(struct nvme_dev *dev, u64 *prp_list, u64 *prp2,
 			   int total_len, u64 dma_addr)
 {
 	u32 page_size = dev->page_size;
@@ -73,7 +86,7 @@ static int nvme_setup_prps(struct nvme_dev *dev, u64 *prp2,
 	nprps = DIV_ROUND_UP(length, page_size);
 	num_pages = DIV_ROUND_UP(nprps - 1, prps_per_page - 1);
 
-	if (nprps > dev->prp_entry_num) {
+	if (!prp_list && nprps > dev->prp_entry_num) {
 		free(dev->prp_pool);
 		/*
 		 * Always increase in increments of pages.  It doesn't waste
@@ -86,23 +99,26 @@ static int nvme_setup_prps(struct nvme_dev *dev, u64 *prp2,
 		}
 		dev->prp_entry_num = num_pages * (prps_per_page - 1) + 1;
 	}
+	if (!prp_list)
+		prp_list = dev->prp_pool;
 
-	prp_pool = dev->prp_pool;
+	prp_pool = prp_list;
 	i = 0;
 	while (nprps) {
 		if ((i == (prps_per_page - 1)) && nprps > 1) {
-			*(prp_pool + i) = cpu_to_le64((ulong)prp_pool +
-					page_size);
+			/* The last entry points to the next page of the list */
+			*(prp_pool + i) = cpu_to_le64((ulong)(prp_pool +
+							      prps_per_page));
 			i = 0;
-			prp_pool += page_size;
+			prp_pool += prps_per_page;
 		}
 		*(prp_pool + i++) = cpu_to_le64(dma_addr);
 		dma_addr += page_size;
 		nprps--;
 	}
-	*prp2 = (ulong)dev->prp_pool;
+	*prp2 = (ulong)prp_list;
 
-	flush_dcache_range((ulong)dev->prp_pool, (ulong)dev->prp_pool +
+	flush_dcache_range((ulong)prp_list, (ulong)prp_list +
 			   num_pages * page_size);
 
 	return 0;
@@ -120,17 +136,39 @@ static u16 nvme_read_completion_status(struct nvme_queue *nvmeq, u16 index)
 	/*
 	 * Single CQ entries are always smaller than a cache line, so we
 	 * can't invalidate them individually. However CQ entries are
-	 * read only by the CPU, so it's safe to always invalidate all of them,
-	 * as the cache line should never become dirty.
+	 * read only by the CPU, so it's safe to invalidate the whole cache
+	 * line holding one, as the cache line should never become dirty.
 	 */
-	ulong start = (ulong)&nvmeq->cqes[0];
-	ulong stop = start + NVME_CQ_ALLOCATION;
+	ulong start = ALIGN_DOWN((ulong)&nvmeq->cqes[index],
+				 ARCH_DMA_MINALIGN);
+	ulong stop = start + ARCH_DMA_MINALIGN;
 
 	invalidate_dcache_range(start, stop);
 
 	return readw(&(nvmeq->cqes[index].status));
 }
 
+/**
+ * nvme_queue_cmd() - copy a command into a queue without ringing the doorbell
+ *
+ * This is only for controllers which follow the spec for command submission.
+ *
+ * @nvmeq:	The queue to use
+ * @cmd:	The command to send
+ */
+static void nvme_queue_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
+{
+	u16 tail = nvmeq->sq_tail;
+
+	memcpy(&nvmeq->sq_cmds[tail], cmd, sizeof(*cmd));
+	flush_dcache_range((ulong)&nvmeq->sq_cmds[tail],
+			   (ulong)&nvmeq->sq_cmds[tail] + sizeof(*cmd));
+
+	if (++tail == nvmeq->q_depth)
+		tail = 0;
+	nvmeq->sq_tail = tail;
+}
+
 /**
  * nvme_submit_cmd() - copy a command into a queue and ring the doorbell
  *
@@ -233,7 +271,7 @@ static struct nvme_queue *nvme_alloc_queue(struct nvme_dev *dev,
 		return NULL;
 	memset(nvmeq, 0, sizeof(*nvmeq));
 
-	nvmeq->cqes = (void *)memalign(4096, NVME_CQ_ALLOCATION);
+	nvmeq->cqes = (void *)memalign(4096, NVME_CQ_ALLOCATION(depth));
 	if (!nvmeq->cqes)
 		goto free_nvmeq;
 	memset((void *)nvmeq->cqes, 0, NVME_CQ_SIZE(depth));
@@ -344,7 +382,8 @@ static void nvme_init_queue(struct nvme_queue *nvmeq, u16 qid)
 	nvmeq->q_db = &dev->dbs[qid * 2 * dev->db_stride];
 	memset((void *)nvmeq->cqes, 0, NVME_CQ_SIZE(nvmeq->q_depth));
 	flush_dcache_range((ulong)nvmeq->cqes,
-			   (ulong)nvmeq->cqes + NVME_CQ_ALLOCATION);
+			   (ulong)nvmeq->cqes +
+			   NVME_CQ_ALLOCATION(nvmeq->q_depth));
 	dev->online_queues++;
 }
 
@@ -667,6 +706,33 @@ static int nvme_get_info_from_identify(struct nvme_dev *dev)
 	return 0;
 }
 
+/**
+ * nvme_alloc_prp_lists() - allocate a PRP list for each I/O command in flight
+ *
+ * Each list is large enough for a transfer of the maximum size, so that the
+ * read/write path never needs to allocate memory or wait for one command to
+ * finish before setting up the next.
+ *
+ * @dev:	NVMe device
+ * Return:	0 if OK, -ENOMEM if out of memory
+ */
+static int nvme_alloc_prp_lists(struct nvme_dev *dev)
+{
+	u32 prps_per_page = dev->page_size >> 3;
+	u32 nprps, num_pages;
+
+	/* Allow for a buffer which does not start on a page boundary */
+	nprps = (1U << dev->max_transfer_shift) / dev->page_size + 1;
+	num_pages = max(DIV_ROUND_UP(nprps - 1, prps_per_page - 1), 1U);
+	dev->prp_list_size = num_pages * dev->page_size;
+	dev->prp_lists = memalign(dev->page_size,
+				  (dev->q_depth - 1) * dev->prp_list_size);
+	if (!dev->prp_lists)
+		return -ENOMEM;
+
+	return 0;
+}
+
 int nvme_get_namespace_id(struct udevice *udev, u32 *ns_id, u8 *eui64)
 {
 	struct nvme_ns *ns = dev_get_priv(udev);
@@ -741,6 +807,133 @@ static int nvme_blk_probe(struct udevice *udev)
 	return 0;
 }
 
+/**
+ * nvme_wait_cqe() - wait for the next completion on a queue
+ *
+ * @nvmeq:	queue to check
+ * @timeout_us:	time to wait in microseconds
+ * Return:	status field of the completion, or -ETIMEDOUT
+ */
+static int nvme_wait_cqe(struct nvme_queue *nvmeq, ulong timeout_us)
+{
+	ulong start_time = timer_get_us();
+	u16 status;
+
+	for (;;) {
+		status = nvme_read_completion_status(nvmeq, nvmeq->cq_head);
+		if ((status & 0x01) == nvmeq->cq_phase)
+			return status;
+		if (timer_get_us() - start_time >= timeout_us)
+			return -ETIMEDOUT;
+	}
+}
+
+/**
+ * nvme_blk_rw_queued() - read or write blocks with many commands in flight
+ *
+ * The transfer is split into commands of at most the maximum transfer size.
+ * As many commands as fit in the I/O queue are submitted with a single
+ * doorbell write. Then all the completions which have arrived are handled
+ * together, with a single doorbell write, before submitting more.
+ *
+ * @ns:		namespace to use
+ * @c:		read or write command, with the fields which do not change
+ * @slba:	first block to transfer
+ * @blkcnt:	number of blocks to transfer
+ * @buffer:	address of the data
+ * Return:	number of blocks transferred before the first failure
+ */
+static lbaint_t nvme_blk_rw_queued(struct nvme_ns *ns, struct nvme_command *c,
+				   u64 slba, lbaint_t blkcnt, uintptr_t buffer)
+{
+	struct nvme_dev *dev = ns->dev;
+	struct nvme_queue *nvmeq = dev->queues[NVME_IO_Q];
+	u32 max_lbas = min(1U << (dev->max_transfer_shift - ns->lba_shift),
+			   (u32)U16_MAX + 1);
+	/* Start of the part of the transfer handled by each command */
+	lbaint_t offset[NVME_Q_DEPTH];
+	u16 free_ids[NVME_Q_DEPTH];
+	lbaint_t done = 0, failed = blkcnt;
+	int nfree, inflight = 0;
+	int status, i;
+	u16 cid;
+
+	for (nfree = 0; nfree < nvmeq->q_depth - 1; nfree++)
+		free_ids[nfree] = nfree;
+
+	while ((done < blkcnt && failed == blkcnt) || inflight) {
+		bool queued = false;
+
+		/* Fill the queue, leaving one slot so it never looks empty */
+		while (done < blkcnt && failed == blkcnt && nfree) {
+			u32 lbas = min_t(lbaint_t, max_lbas, blkcnt - done);
+			uintptr_t addr = buffer + (done << ns->lba_shift);
+			u64 prp2;
+
+			cid = free_ids[--nfree];
+			nvme_setup_prps(dev, dev->prp_lists +
+					cid * dev->prp_list_size, &prp2,
+					lbas << ns->lba_shift, addr);
+			c->rw.command_id = cpu_to_le16(cid);
+			c->rw.slba = cpu_to_le64(slba + done);
+			c->rw.length = cpu_to_le16(lbas - 1);
+			c->rw.prp1 = cpu_to_le64(addr);
+			c->rw.prp2 = cpu_to_le64(prp2);
+			nvme_queue_cmd(nvmeq, c);
+			offset[cid] = done;
+			done += lbas;
+			inflight++;
+			queued = true;
+		}
+		if (queued)
+			writel(nvmeq->sq_tail, nvmeq->q_db);
+
+		status = nvme_wait_cqe(nvmeq, IO_TIMEOUT * 100000);
+		if (status < 0) {
+			/* Anything still in flight cannot be relied upon */
+			printf("ERROR: %d commands timed out\n", inflight);
+			for (i = 0; i < nvmeq->q_depth - 1; i++) {
+				bool busy = true;
+				int j;
+
+				for (j = 0; j < nfree; j++)
+					busy &= free_ids[j] != i;
+				if (busy)
+					failed = min(failed, offset[i]);
+			}
+			break;
+		}
+
+		/* Handle all the completions which are ready */
+		do {
+			cid = readw(&nvmeq->cqes[nvmeq->cq_head].command_id);
+			status >>= 1;
+			if (cid >= nvmeq->q_depth - 1) {
+				printf("ERROR: bad command id %d\n", cid);
+				failed = 0;
+			} else {
+				if (status) {
+					printf("ERROR: status = %x, lba = %llx\n",
+					       status,
+					       (u64)(slba + offset[cid]));
+					failed = min(failed, offset[cid]);
+				}
+				free_ids[nfree++] = cid;
+			}
+			inflight--;
+			if (++nvmeq->cq_head == nvmeq->q_depth) {
+				nvmeq->cq_head = 0;
+				nvmeq->cq_phase = !nvmeq->cq_phase;
+			}
+			status = nvme_read_completion_status(nvmeq,
+							     nvmeq->cq_head);
+		} while (inflight && (status & 0x01) == nvmeq->cq_phase);
+		writel(nvmeq->cq_head, nvmeq->q_db + dev->db_stride);
+	}
+
+	return failed;
+}
+
 static ulong nvme_blk_rw(struct udevice *udev, lbaint_t blknr,
 			 lbaint_t blkcnt, void *buffer, bool read)
 {
@@ -771,6 +964,12 @@ static ulong nvme_blk_rw(struct udevice *udev, lbaint_t blknr,
 	c.rw.appmask = 0;
 	c.rw.metadata = 0;
 
+	if (dev->prp_lists) {
+		blkcnt = nvme_blk_rw_queued(ns, &c, slba, blkcnt, temp_buffer);
+		temp_len = total_len - (blkcnt << desc->log2blksz);
+		total_lbas = 0;
+	}
+
 	while (total_lbas) {
 		if (total_lbas < lbas) {
 			lbas = (u16)total_lbas;
@@ -779,7 +978,7 @@ static ulong nvme_blk_rw(struct udevice *udev, lbaint_t blknr,
 			total_lbas -= lbas;
 		}
 
-		if (nvme_setup_prps(dev, &prp2,
+		if (nvme_setup_prps(dev, NULL, &prp2,
 				    lbas << ns->lba_shift, temp_buffer))
 			return -EIO;
 		c.rw.slba = cpu_to_le64(slba);
@@ -831,6 +1030,8 @@ int nvme_init(struct udevice *udev)
 {
 	struct nvme_dev *ndev = dev_get_priv(udev);
 	struct nvme_id_ns *id;
+	struct nvme_ops *ops;
+	int depth;
 	int ret;
 
 	ndev->udev = udev;
@@ -849,8 +1050,12 @@ int nvme_init(struct udevice *udev)
 	}
 	memset(ndev->queues, 0, NVME_Q_NUM * sizeof(struct nvme_queue *));
 
+	/* Controllers with their own submission handle one command at a time */
+	ops = (struct nvme_ops *)udev->driver->ops;
+	depth = ops && ops->submit_cmd ? NVME_SYNC_Q_DEPTH : NVME_Q_DEPTH;
+
 	ndev->cap = nvme_readq(&ndev->bar->cap);
-	ndev->q_depth = min_t(int, NVME_CAP_MQES(ndev->cap) + 1, NVME_Q_DEPTH);
+	ndev->q_depth = min_t(int, NVME_CAP_MQES(ndev->cap) + 1, depth);
 	ndev->db_stride = 1 << NVME_CAP_STRIDE(ndev->cap);
 	ndev->dbs = ((void __iomem *)ndev->bar) + 4096;
 
@@ -877,6 +1082,10 @@ int nvme_init(struct udevice *udev)
 
 	nvme_get_info_from_identify(ndev);
 
+	/* Without these, I/O falls back to one command at a time */
+	if (!(ops && ops->submit_cmd) && nvme_alloc_prp_lists(ndev))
+		log_debug("No memory for PRP lists, not queueing I/O\n");
+
 	/* Create a blk device for each namespace */
 
 	id = memalign(ndev->page_size, sizeof(struct nvme_id_ns));
@@ -928,6 +1137,8 @@ int nvme_init(struct udevice *udev)
 free_id:
 	free(id);
 free_queue:
+	free(ndev->prp_lists);
+	ndev->prp_lists = NULL;
 	free((void *)ndev->queues);
 free_nvme:
 	return ret;
@@ -938,6 +1149,9 @@ int nvme_shutdown(struct udevice *udev)
 	struct nvme_dev *ndev = dev_get_priv(udev);
 	int ret;
 
+	free(ndev->prp_lists);
+	ndev->prp_lists = NULL;
+
 	ret = nvme_shutdown_ctrl(ndev);
 	if (ret < 0) {
 		printf("Error: %s: Shutdown timed out!\n", udev->name);
@@ -620,6 +620,10 @@ struct nvme_dev {
 	u8 vwc;
 	u64 *prp_pool;
 	u32 prp_entry_num;
+	/* PRP lists for each command in flight on the I/O queue, if any */
+	void *prp_lists;
+	/* size of each PRP list in bytes */
+	u32 prp_list_size;
 	u32 nn;
 };
 
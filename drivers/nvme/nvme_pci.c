@@ -37,11 +37,17 @@ static int nvme_probe(struct udevice *udev)
 	return nvme_init(udev);
 }
 
+static int nvme_remove(struct udevice *udev)
+{
+	return nvme_shutdown(udev);
+}
+
 U_BOOT_DRIVER(nvme) = {
 	.name	= "nvme",
 	.id	= UCLASS_NVME,
 	.bind	= nvme_bind,
 	.probe	= nvme_probe,
+	.remove	= nvme_remove,
 	.priv_auto	= sizeof(struct nvme_dev),
 };
 
@@ -1161,7 +1161,10 @@ static int pci_uclass_pre_probe(struct udevice *bus)
 		ret = uclass_get(UCLASS_PCI, &uc);
 		if (ret)
 			return ret;
-		bus->seq_ = uclass_find_next_free_seq(uc);
+		ret = uclass_set_device_seq(bus,
+					    uclass_find_next_free_seq(uc));
+		if (ret)
+			return ret;
 	}
 
 	/* For bridges, use the top-level PCI controller */
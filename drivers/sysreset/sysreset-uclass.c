@@ -6,6 +6,7 @@
 
 #define LOG_CATEGORY UCLASS_SYSRESET
 
+#include <blk.h>
 #include <command.h>
 #include <cpu_func.h>
 #include <dm.h>
@@ -129,6 +130,8 @@ int do_reset(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
 		reset_type = SYSRESET_WARM;
 	}
 
+	if (blkcache_flush(-1, 0))
+		log_err("Failed to write back the block cache\n");
 	printf("resetting ...\n");
 	mdelay(100);
 
@@ -143,6 +146,8 @@ int do_poweroff(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
 {
 	int ret;
 
+	if (blkcache_flush(-1, 0))
+		log_err("Failed to write back the block cache\n");
 	puts("poweroff ...\n");
 	mdelay(100);
 
@@ -12,6 +12,7 @@
 #include <spl.h>
 #include <video.h>
 #include <video_console.h>
+#include <linux/list.h>
 
 /* Functions needed by stb_truetype.h */
 static int tt_floor(double val)
@@ -129,6 +130,34 @@ struct pos_info {
  */
 #define POS_HISTORY_SIZE	(CONFIG_SYS_CBSIZE * 11 / 10)
 
+/* Number of bits in the hash of the glyph cache, for each font / size */
+#define GLYPH_HASH_BITS		6
+
+/**
+ * struct console_tt_glyph - A rendered character in the glyph cache
+ *
+ * @node:	Node in the hash table of the metrics it was rendered with
+ * @lru:	Node in the list of cached glyphs, most recently used first
+ * @cp:		Unicode code point of the character
+ * @x_shift:	Fraction of a pixel by which the character was shifted right
+ * @width:	Width of the image in pixels
+ * @height:	Height of the image in pixels
+ * @xoff:	X offset of the image from the cursor position
+ * @yoff:	Y offset of the image from the baseline
+ * @data:	8-bit-per-pixel image of the character, @width x @height
+ */
+struct console_tt_glyph {
+	struct hlist_node node;
+	struct list_head lru;
+	int cp;
+	float x_shift;
+	int width;
+	int height;
+	int xoff;
+	int yoff;
+	u8 data[];
+};
+
 /**
  * struct console_tt_metrics - Information about a font / size combination
  *
@@ -147,6 +176,7 @@ struct pos_info {
  * @scale:	Scale of the font. This is calculated from the pixel height
  *		of the font. It is used by the STB library to generate images
  *		of the correct size.
+ * @glyphs:	Hash table of glyphs rendered with this font and size
  */
 struct console_tt_metrics {
 	const char *font_name;
@@ -155,6 +185,7 @@ struct console_tt_metrics {
 	stbtt_fontinfo font;
 	int baseline;
 	double scale;
+	struct hlist_head glyphs[1 << GLYPH_HASH_BITS];
 };
 
 /**
@@ -169,6 +200,10 @@ struct console_tt_metrics {
  *		last character. We record enough characters to go back to the
  *		start of the current command line.
  * @pos_ptr:	Current position in the position history
+ * @glyph_lru:	List of all cached glyphs, most recently used first
+ * @glyph_phases: Sub-pixel positions kept for each character, 0 for exact
+ * @glyph_max:	Largest size of the glyph cache, in bytes
+ * @glyph_stats: Statistics of the glyph cache, including the memory used
  */
 struct console_tt_priv {
 	struct console_tt_metrics *cur_met;
@@ -176,6 +211,10 @@ struct console_tt_priv {
 	int num_metrics;
 	struct pos_info pos[POS_HISTORY_SIZE];
 	int pos_ptr;
+	struct list_head glyph_lru;
+	int glyph_phases;
+	uint glyph_max;
+	struct console_tt_glyph_stats glyph_stats;
 };
 
 /**
@@ -270,6 +309,189 @@ static int console_truetype_move_rows(struct udevice *dev, uint rowdst,
 	return 0;
 }
 
+static uint glyph_size(struct console_tt_glyph *glyph)
+{
+	return sizeof(*glyph) + glyph->width * glyph->height;
+}
+
+static uint glyph_hash(int cp, float x_shift)
+{
+	u32 bits;
+
+	memcpy(&bits, &x_shift, sizeof(bits));
+
+	return ((cp ^ bits) * 0x9e3779b1) >> (32 - GLYPH_HASH_BITS);
+}
+
+static void glyph_free(struct console_tt_priv *priv,
+		       struct console_tt_glyph *glyph)
+{
+	hlist_del(&glyph->node);
+	list_del(&glyph->lru);
+	priv->glyph_stats.bytes -= glyph_size(glyph);
+	free(glyph);
+}
+
+/**
+ * glyph_get() - Get the image of a character, from the cache if possible
+ *
+ * The image is rendered and added to the cache if it is not there. The least
+ * recently used glyphs are dropped to keep the cache within
+ * @priv->glyph_max bytes. If the glyph is too large to be
+ * cached at all, it is not added to the cache and the caller must free it.
+ *
+ * @priv:	Private data for the console
+ * @met:	Metrics (font and size) to use
+ * @cp:		Unicode code point of the character
+ * @x_shift:	Fraction of a pixel by which to shift the character right
+ * Return: glyph, or NULL if out of memory
+ */
+static struct console_tt_glyph *glyph_get(struct console_tt_priv *priv,
+					  struct console_tt_metrics *met,
+					  int cp, float x_shift)
+{
+	struct hlist_head *head = &met->glyphs[glyph_hash(cp, x_shift)];
+	struct console_tt_glyph *glyph;
+	int width, height, xoff, yoff;
+	u8 *data;
+	uint size;
+
+	hlist_for_each_entry(glyph, head, node) {
+		if (glyph->cp == cp && glyph->x_shift == x_shift) {
+			list_move(&glyph->lru, &priv->glyph_lru);
+			priv->glyph_stats.hits++;
+			return glyph;
+		}
+	}
+
+	/*
+	 * The render returns a 8-bit-per-pixel image of the character. For
+	 * empty characters, like ' ', data will return NULL
+	 */
+	data = stbtt_GetCodepointBitmapSubpixel(&met->font, met->scale,
+						met->scale, x_shift, 0, cp,
+						&width, &height, &xoff, &yoff);
+	if (!data)
+		width = 0;
+	size = sizeof(*glyph) + width * height;
+	glyph = malloc(size);
+	if (!glyph) {
+		free(data);
+		return NULL;
+	}
+	glyph->cp = cp;
+	glyph->x_shift = x_shift;
+	glyph->width = width;
+	glyph->height = height;
+	glyph->xoff = xoff;
+	glyph->yoff = yoff;
+	memcpy(glyph->data, data, width * height);
+	free(data);
+
+	priv->glyph_stats.misses++;
+
+	if (size > priv->glyph_max) {
+		INIT_HLIST_NODE(&glyph->node);
+		return glyph;
+	}
+	while (priv->glyph_stats.bytes + size > priv->glyph_max) {
+		glyph_free(priv, list_last_entry(&priv->glyph_lru,
+						 struct console_tt_glyph, lru));
+		priv->glyph_stats.evictions++;
+	}
+	hlist_add_head(&glyph->node, head);
+	list_add(&glyph->lru, &priv->glyph_lru);
+	priv->glyph_stats.bytes += size;
+
+	return glyph;
+}
+
+/**
+ * glyph_blit() - Draw a glyph in the frame buffer
+ *
+ * The 8bpp image is converted into the colour depth of the display. We only
+ * expect white-on-black or the reverse, so the code only handles this simple
+ * case. Pixels which would not change the frame buffer are skipped.
+ *
+ * @vid_priv:	Video device to draw on
+ * @line:	Start of the first line to draw on, at the cursor position
+ * @glyph:	Glyph to draw
+ * Return: 0 if OK, -ENOSYS if the colour depth is not supported
+ */
+static int glyph_blit(struct video_priv *vid_priv, void *line,
+		      struct console_tt_glyph *glyph)
+{
+	const bool inv = vid_priv->colour_bg;
+	const bool fg = vid_priv->colour_fg;
+	const u8 *bits = glyph->data;
+	int row, i;
+
+	switch (vid_priv->bpix) {
+	case VIDEO_BPP8:
+		if (!IS_ENABLED(CONFIG_VIDEO_BPP8))
+			break;
+		for (row = 0; row < glyph->height; row++) {
+			u8 *dst = (u8 *)line + glyph->xoff;
+
+			for (i = 0; i < glyph->width; i++, dst++) {
+				u8 out = inv ? 255 - *bits++ : *bits++;
+
+				if (!fg)
+					*dst &= out;
+				else if (out)
+					*dst |= out;
+			}
+			line += vid_priv->line_length;
+		}
+		break;
+	case VIDEO_BPP16:
+		if (!IS_ENABLED(CONFIG_VIDEO_BPP16))
+			break;
+		for (row = 0; row < glyph->height; row++) {
+			u16 *dst = (u16 *)line + glyph->xoff;
+
+			for (i = 0; i < glyph->width; i++, dst++) {
+				uint val = inv ? 255 - *bits++ : *bits++;
+				u16 out = val >> 3 | (val >> 2) << 5 |
+					(val >> 3) << 11;
+
+				if (!fg)
+					*dst &= out;
+				else if (out)
+					*dst |= out;
+			}
+			line += vid_priv->line_length;
+		}
+		break;
+	case VIDEO_BPP32: {
+		/* Spread the value into each colour channel with a multiply */
+		const u32 mul = vid_priv->format == VIDEO_X2R10G10B10 ?
+			1 << 2 | 1 << 12 | 1 << 22 : 1 | 1 << 8 | 1 << 16;
+
+		if (!IS_ENABLED(CONFIG_VIDEO_BPP32))
+			break;
+		for (row = 0; row < glyph->height; row++) {
+			u32 *dst = (u32 *)line + glyph->xoff;
+
+			for (i = 0; i < glyph->width; i++, dst++) {
+				u32 out = (inv ? 255 - *bits++ : *bits++) * mul;
+
+				if (!fg)
+					*dst &= out;
+				else if (out)
+					*dst |= out;
+			}
+			line += vid_priv->line_length;
+		}
+		break;
+	}
+	default:
+		return -ENOSYS;
+	}
+
+	return 0;
+}
+
 static int console_truetype_putc_xy(struct udevice *dev, uint x, uint y,
 				    int cp)
 {
@@ -279,15 +501,14 @@ static int console_truetype_putc_xy(struct udevice *dev, uint x, uint y,
 	struct console_tt_priv *priv = dev_get_priv(dev);
 	struct console_tt_metrics *met = priv->cur_met;
 	stbtt_fontinfo *font = &met->font;
-	int width, height, xoff, yoff;
+	struct console_tt_glyph *glyph;
 	double xpos, x_shift;
 	int lsb;
 	int width_frac, linenum;
 	struct pos_info *pos;
-	u8 *bits, *data;
 	int advance;
-	void *start, *end, *line;
-	int row;
+	void *start;
+	int ret;
 
 	/* First get some basic metrics about this character */
 	stbtt_GetCodepointHMetrics(font, cp, &advance, &lsb);
@@ -309,6 +530,12 @@ static int console_truetype_putc_xy(struct udevice *dev, uint x, uint y,
 	 * it dictates how much the cursor will move forward on the line.
 	 */
 	x_shift = xpos - (double)tt_floor(xpos);
+	if (priv->glyph_phases) {
+		/* Round down to a position which the glyph cache keeps */
+		const int phases = priv->glyph_phases;
+
+		x_shift = (double)(int)(x_shift * phases) / phases;
+	}
 	xpos += advance * met->scale;
 	width_frac = (int)VID_TO_POS(advance * met->scale);
 	if (x + width_frac >= vc_priv->xsize_frac)
@@ -323,120 +550,36 @@ static int console_truetype_putc_xy(struct udevice *dev, uint x, uint y,
 	}
 
 	/*
-	 * Figure out how much past the start of a pixel we are, and pass this
-	 * information into the render, which will return a 8-bit-per-pixel
-	 * image of the character. For empty characters, like ' ', data will
-	 * return NULL;
+	 * Figure out how much past the start of a pixel we are, and get the
+	 * image of the character rendered at that position. For empty
+	 * characters, like ' ', the image has no pixels.
 	 */
-	data = stbtt_GetCodepointBitmapSubpixel(font, met->scale, met->scale,
-						x_shift, 0, cp, &width, &height,
-						&xoff, &yoff);
-	if (!data)
+	glyph = glyph_get(priv, met, cp, x_shift);
+	if (!glyph || !glyph->width) {
+		if (glyph && hlist_unhashed(&glyph->node))
+			free(glyph);
 		return width_frac;
+	}
 
 	/* Figure out where to write the character in the frame buffer */
-	bits = data;
 	start = vid_priv->fb + y * vid_priv->line_length +
 		VID_TO_PIXEL(x) * VNBYTES(vid_priv->bpix);
-	linenum = met->baseline + yoff;
+	linenum = met->baseline + glyph->yoff;
 	if (linenum > 0)
 		start += linenum * vid_priv->line_length;
-	line = start;
 
-	/*
-	 * Write a row at a time, converting the 8bpp image into the colour
-	 * depth of the display. We only expect white-on-black or the reverse
-	 * so the code only handles this simple case.
-	 */
-	for (row = 0; row < height; row++) {
-		switch (vid_priv->bpix) {
-		case VIDEO_BPP8:
-			if (IS_ENABLED(CONFIG_VIDEO_BPP8)) {
-				u8 *dst = line + xoff;
-				int i;
-
-				for (i = 0; i < width; i++) {
-					int val = *bits;
-					int out;
-
-					if (vid_priv->colour_bg)
-						val = 255 - val;
-					out = val;
-					if (vid_priv->colour_fg)
-						*dst++ |= out;
-					else
-						*dst++ &= out;
-					bits++;
-				}
-				end = dst;
-			}
-			break;
-		case VIDEO_BPP16: {
-			uint16_t *dst = (uint16_t *)line + xoff;
-			int i;
-
-			if (IS_ENABLED(CONFIG_VIDEO_BPP16)) {
-				for (i = 0; i < width; i++) {
-					int val = *bits;
-					int out;
-
-					if (vid_priv->colour_bg)
-						val = 255 - val;
-					out = val >> 3 |
-						(val >> 2) << 5 |
-						(val >> 3) << 11;
-					if (vid_priv->colour_fg)
-						*dst++ |= out;
-					else
-						*dst++ &= out;
-					bits++;
-				}
-				end = dst;
-			}
-			break;
-		}
-		case VIDEO_BPP32: {
-			u32 *dst = (u32 *)line + xoff;
-			int i;
+	ret = glyph_blit(vid_priv, start, glyph);
+	if (!ret)
+		video_damage(dev->parent,
+			     VID_TO_PIXEL(x) + glyph->xoff,
+			     y + met->baseline + glyph->yoff,
+			     glyph->width,
+			     glyph->height);
 
-			if (IS_ENABLED(CONFIG_VIDEO_BPP32)) {
-				for (i = 0; i < width; i++) {
-					int val = *bits;
-					int out;
+	if (hlist_unhashed(&glyph->node))
+		free(glyph);
 
-					if (vid_priv->colour_bg)
-						val = 255 - val;
-					if (vid_priv->format == VIDEO_X2R10G10B10)
-						out = val << 2 | val << 12 | val << 22;
-					else
-						out = val | val << 8 | val << 16;
-					if (vid_priv->colour_fg)
-						*dst++ |= out;
-					else
-						*dst++ &= out;
-					bits++;
-				}
-				end = dst;
-			}
-			break;
-		}
-		default:
-			free(data);
-			return -ENOSYS;
-		}
-
-		line += vid_priv->line_length;
-	}
-
-	video_damage(dev->parent,
-		     VID_TO_PIXEL(x) + xoff,
-		     y + met->baseline + yoff,
-		     width,
-		     height);
-
-	free(data);
-
-	return width_frac;
+	return ret ? ret : width_frac;
 }
 
 /**
@@ -1047,6 +1190,9 @@ static int console_truetype_probe(struct udevice *dev)
 	int ret;
 
 	debug("%s: start\n", __func__);
+	INIT_LIST_HEAD(&priv->glyph_lru);
+	priv->glyph_phases = CONFIG_CONSOLE_TRUETYPE_GLYPH_PHASES;
+	priv->glyph_max = CONFIG_CONSOLE_TRUETYPE_GLYPH_CACHE;
 	if (vid_priv->font_size)
 		font_size = vid_priv->font_size;
 	else
@@ -1069,6 +1215,48 @@ static int console_truetype_probe(struct udevice *dev)
 	return 0;
 }
 
+static void glyph_cache_empty(struct console_tt_priv *priv)
+{
+	while (!list_empty(&priv->glyph_lru))
+		glyph_free(priv, list_first_entry(&priv->glyph_lru,
+						  struct console_tt_glyph, lru));
+}
+
+int console_truetype_glyph_cache(struct udevice *dev, int phases, uint size)
+{
+	struct console_tt_priv *priv;
+
+	if (dev->driver != DM_DRIVER_GET(vidconsole_truetype))
+		return -ENOSYS;
+	priv = dev_get_priv(dev);
+	glyph_cache_empty(priv);
+	priv->glyph_phases = phases;
+	priv->glyph_max = size ?: CONFIG_CONSOLE_TRUETYPE_GLYPH_CACHE;
+	memset(&priv->glyph_stats, '\0', sizeof(priv->glyph_stats));
+
+	return 0;
+}
+
+int console_truetype_glyph_stats(struct udevice *dev,
+				 struct console_tt_glyph_stats *stats)
+{
+	struct console_tt_priv *priv;
+
+	if (dev->driver != DM_DRIVER_GET(vidconsole_truetype))
+		return -ENOSYS;
+	priv = dev_get_priv(dev);
+	*stats = priv->glyph_stats;
+
+	return 0;
+}
+
+static int console_truetype_remove(struct udevice *dev)
+{
+	glyph_cache_empty(dev_get_priv(dev));
+
+	return 0;
+}
+
 struct vidconsole_ops console_truetype_ops = {
 	.putc_xy	= console_truetype_putc_xy,
 	.move_rows	= console_truetype_move_rows,
@@ -1090,5 +1278,6 @@ U_BOOT_DRIVER(vidconsole_truetype) = {
 	.id	= UCLASS_VIDEO_CONSOLE,
 	.ops	= &console_truetype_ops,
 	.probe	= console_truetype_probe,
+	.remove	= console_truetype_remove,
 	.priv_auto	= sizeof(struct console_tt_priv),
 };
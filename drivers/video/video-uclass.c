@@ -28,6 +28,13 @@
 #endif
 #include "vidconsole_internal.h"
 
+/*
+ * Cost of flushing or copying each line of a damaged region, in pixels, on top
+ * of the pixels themselves. This stops nearby regions being kept apart when
+ * the saving is small.
+ */
+#define VIDEO_DAMAGE_ROW_COST	32
+
 /*
  * Theory of operation:
  *
@@ -401,8 +408,90 @@ void video_set_default_colors(struct udevice *dev, bool invert)
 	priv->colour_bg = video_index_to_colour(priv, back);
 }
 
-/* Notify about changes in the frame buffer */
 #ifdef CONFIG_VIDEO_DAMAGE
+/* Returns the cost of flushing or copying a region, in pixels */
+static long video_damage_cost(const struct video_damage_rect *rect)
+{
+	return (long)(rect->yend - rect->ystart) *
+		(rect->xend - rect->xstart + VIDEO_DAMAGE_ROW_COST);
+}
+
+static bool video_damage_overlap(const struct video_damage_rect *a,
+				 const struct video_damage_rect *b)
+{
+	return a->xstart < b->xend && b->xstart < a->xend &&
+	       a->ystart < b->yend && b->ystart < a->yend;
+}
+
+static void video_damage_union(struct video_damage_rect *dst,
+			       const struct video_damage_rect *src)
+{
+	dst->xstart = min(dst->xstart, src->xstart);
+	dst->ystart = min(dst->ystart, src->ystart);
+	dst->xend = max(dst->xend, src->xend);
+	dst->yend = max(dst->yend, src->yend);
+}
+
+/**
+ * video_damage_add() - Add a region to the list of damaged regions
+ *
+ * The regions in the list are kept disjoint. The new region is merged with
+ * any region it overlaps and with any region which costs no more to flush
+ * together with it than separately. If the list is still full, it is merged
+ * with whichever region adds the least cost.
+ *
+ * @priv:	Video device information
+ * @rect:	Region to add, which is updated as regions are merged into it
+ */
+static void video_damage_add(struct video_priv *priv,
+			     struct video_damage_rect *rect)
+{
+	struct video_damage_rect merged;
+	long extra, best_extra;
+	int i, best;
+
+	do {
+		/* Merging makes @rect larger, so start again after each one */
+		for (i = 0; i < priv->damage_count;) {
+			struct video_damage_rect *old = &priv->damage_rect[i];
+
+			merged = *rect;
+			video_damage_union(&merged, old);
+			if (video_damage_overlap(rect, old) ||
+			    video_damage_cost(&merged) <=
+			    video_damage_cost(rect) + video_damage_cost(old)) {
+				*rect = merged;
+				*old = priv->damage_rect[--priv->damage_count];
+				i = 0;
+			} else {
+				i++;
+			}
+		}
+		if (priv->damage_count < VIDEO_DAMAGE_RECTS) {
+			priv->damage_rect[priv->damage_count++] = *rect;
+			return;
+		}
+
+		best = 0;
+		best_extra = LONG_MAX;
+		for (i = 0; i < priv->damage_count; i++) {
+			struct video_damage_rect *old = &priv->damage_rect[i];
+
+			merged = *rect;
+			video_damage_union(&merged, old);
+			extra = video_damage_cost(&merged) -
+				video_damage_cost(rect) - video_damage_cost(old);
+			if (extra < best_extra) {
+				best = i;
+				best_extra = extra;
+			}
+		}
+		video_damage_union(rect, &priv->damage_rect[best]);
+		priv->damage_rect[best] = priv->damage_rect[--priv->damage_count];
+	} while (1);
+}
+
+/* Notify about changes in the frame buffer */
 void video_damage(struct udevice *vid, int x, int y, int width, int height)
 {
 	struct video_priv *priv = dev_get_uclass_priv(vid);
@@ -426,6 +515,12 @@ void video_damage(struct udevice *vid, int x, int y, int width, int height)
 	priv->damage.ystart = min(y, priv->damage.ystart);
 	priv->damage.xend = max(xend, priv->damage.xend);
 	priv->damage.yend = max(yend, priv->damage.yend);
+
+	if (xend > x && yend > y) {
+		struct video_damage_rect rect = { x, y, xend, yend };
+
+		video_damage_add(priv, &rect);
+	}
 }
 #endif
 
@@ -434,6 +529,7 @@ static void video_flush_dcache(struct udevice *vid, bool use_copy)
 	struct video_priv *priv = dev_get_uclass_priv(vid);
 	ulong fb = use_copy ? (ulong)priv->copy_fb : (ulong)priv->fb;
 	uint cacheline_size = 32;
+	int i;
 
 #ifdef CONFIG_SYS_CACHELINE_SIZE
 	cacheline_size = CONFIG_SYS_CACHELINE_SIZE;
@@ -446,25 +542,35 @@ static void video_flush_dcache(struct udevice *vid, bool use_copy)
 		return;
 
 	if (!IS_ENABLED(CONFIG_VIDEO_DAMAGE)) {
-		flush_dcache_range(fb, ALIGN(fb + priv->fb_size,
-					     cacheline_size));
+		ulong end = ALIGN(fb + priv->fb_size, cacheline_size);
+
+		flush_dcache_range(fb, end);
+		priv->flush_bytes += end - fb;
 
 		return;
 	}
 
-	if (priv->damage.xend && priv->damage.yend) {
-		int lstart = priv->damage.xstart * VNBYTES(priv->bpix);
-		int lend = priv->damage.xend * VNBYTES(priv->bpix);
+	for (i = 0; i < priv->damage_count; i++) {
+		struct video_damage_rect *rect = &priv->damage_rect[i];
+		int lstart = rect->xstart * VNBYTES(priv->bpix);
+		int len = (rect->xend - rect->xstart) * VNBYTES(priv->bpix);
+		int rows = rect->yend - rect->ystart;
 		int y;
 
-		for (y = priv->damage.ystart; y < priv->damage.yend; y++) {
+		/* Whole lines are contiguous, so flush them in one go */
+		if (len == priv->line_length) {
+			len *= rows;
+			rows = 1;
+		}
+		for (y = rect->ystart; y < rect->ystart + rows; y++) {
 			ulong start = fb + (y * priv->line_length) + lstart;
-			ulong end = start + lend - lstart;
+			ulong end = start + len;
 
 			start = ALIGN_DOWN(start, cacheline_size);
 			end = ALIGN(end, cacheline_size);
 
 			flush_dcache_range(start, end);
+			priv->flush_bytes += end - start;
 		}
 	}
 }
@@ -472,20 +578,27 @@ static void video_flush_dcache(struct udevice *vid, bool use_copy)
 static void video_flush_copy(struct udevice *vid)
 {
 	struct video_priv *priv = dev_get_uclass_priv(vid);
+	int i;
 
 	if (!priv->copy_fb)
 		return;
 
-	if (priv->damage.xend && priv->damage.yend) {
-		int lstart = priv->damage.xstart * VNBYTES(priv->bpix);
-		int lend = priv->damage.xend * VNBYTES(priv->bpix);
+	for (i = 0; i < priv->damage_count; i++) {
+		struct video_damage_rect *rect = &priv->damage_rect[i];
+		int lstart = rect->xstart * VNBYTES(priv->bpix);
+		int len = (rect->xend - rect->xstart) * VNBYTES(priv->bpix);
+		int rows = rect->yend - rect->ystart;
 		int y;
 
-		for (y = priv->damage.ystart; y < priv->damage.yend; y++) {
+		if (len == priv->line_length) {
+			len *= rows;
+			rows = 1;
+		}
+		for (y = rect->ystart; y < rect->ystart + rows; y++) {
 			ulong offset = (y * priv->line_length) + lstart;
-			ulong len = lend - lstart;
 
 			memcpy(priv->copy_fb + offset, priv->fb + offset, len);
+			priv->copy_bytes += len;
 		}
 	}
 }
@@ -497,6 +610,8 @@ int video_sync(struct udevice *vid, bool force)
 	struct video_ops *ops = video_get_ops(vid);
 	int ret;
 
+	priv->flush_bytes = 0;
+	priv->copy_bytes = 0;
 	if (IS_ENABLED(CONFIG_VIDEO_COPY))
 		video_flush_copy(vid);
 
@@ -526,6 +641,7 @@ int video_sync(struct udevice *vid, bool force)
 		priv->damage.ystart = priv->ysize;
 		priv->damage.xend = 0;
 		priv->damage.yend = 0;
+		priv->damage_count = 0;
 	}
 
 	return 0;
@@ -8,6 +8,7 @@
 
 #include <blk.h>
 #include <dm.h>
+#include <malloc.h>
 #include <part.h>
 #include <virtio_types.h>
 #include <virtio.h>
@@ -15,6 +16,31 @@
 #include <linux/log2.h>
 #include "virtio_blk.h"
 
+/*
+ * Largest request, in 512-byte sectors. Larger transfers are split into
+ * several requests, so that the device can work on them at the same time.
+ */
+#define VIRTIO_BLK_MAX_SECTORS	512
+
+/**
+ * struct virtio_blk_req - a request which may be in flight
+ */
+struct virtio_blk_req {
+	/**
+	 * @out_hdr - request header, which comes first since its address is
+	 * what virtqueue_get_buf() hands back
+	 */
+	struct virtio_blk_outhdr out_hdr;
+	/** @wz_hdr - range to zero, for VIRTIO_BLK_T_WRITE_ZEROES */
+	struct virtio_blk_discard_write_zeroes wz_hdr;
+	/** @status - status written by the device */
+	u8 status;
+	/** @offset - blocks from the start of the transfer to this request */
+	lbaint_t offset;
+	/** @next - next free request */
+	struct virtio_blk_req *next;
+};
+
 /**
  * struct virtio_blk_priv - private data for virtio block device
  */
@@ -23,11 +49,18 @@ struct virtio_blk_priv {
 	struct virtqueue *vq;
 	/** @blksz_shift - log2 of block size divided by 512 */
 	u32 blksz_shift;
+	/** @max_blocks - largest number of blocks in a request */
+	u32 max_blocks;
+	/** @reqs - requests, as many as fit in the ring at once */
+	struct virtio_blk_req *reqs;
+	/** @num_reqs - number of entries in @reqs */
+	u32 num_reqs;
 };
 
 static const u32 feature[] = {
+	VIRTIO_BLK_F_SIZE_MAX,
 	VIRTIO_BLK_F_BLK_SIZE,
-	VIRTIO_BLK_F_WRITE_ZEROES
+	VIRTIO_BLK_F_WRITE_ZEROES,
 };
 
 static void virtio_blk_init_header_sg(struct udevice *dev, u64 sector, u32 type,
@@ -67,21 +100,19 @@ static void virtio_blk_init_data_sg(void *buffer, lbaint_t blkcnt, struct virtio
 	sg->length = blkcnt * 512;
 }
 
-static ulong virtio_blk_do_req(struct udevice *dev, u64 sector,
-			       lbaint_t blkcnt, void *buffer, u32 type)
+/* Adds a request to the ring, without telling the device about it */
+static int virtio_blk_queue_req(struct udevice *dev, struct virtio_blk_req *req,
+				u64 sector, lbaint_t blkcnt, void *buffer,
+				u32 type)
 {
 	struct virtio_blk_priv *priv = dev_get_priv(dev);
-	struct virtio_blk_outhdr out_hdr;
-	struct virtio_blk_discard_write_zeroes wz_hdr;
 	unsigned int num_out = 0, num_in = 0;
 	struct virtio_sg hdr_sg, wz_sg, data_sg, status_sg;
 	struct virtio_sg *sgs[3];
-	u8 status;
-	int ret;
 
 	sector <<= priv->blksz_shift;
 	blkcnt <<= priv->blksz_shift;
-	virtio_blk_init_header_sg(dev, sector, type, &out_hdr, &hdr_sg);
+	virtio_blk_init_header_sg(dev, sector, type, &req->out_hdr, &hdr_sg);
 	sgs[num_out++] = &hdr_sg;
 
 	switch (type) {
@@ -95,7 +126,8 @@ static ulong virtio_blk_do_req(struct udevice *dev, u64 sector,
 		break;
 
 	case VIRTIO_BLK_T_WRITE_ZEROES:
-		virtio_blk_init_write_zeroes_sg(dev, sector, blkcnt, &wz_hdr, &wz_sg);
+		virtio_blk_init_write_zeroes_sg(dev, sector, blkcnt,
+						&req->wz_hdr, &wz_sg);
 		sgs[num_out++] = &wz_sg;
 		break;
 
@@ -103,23 +135,103 @@ static ulong virtio_blk_do_req(struct udevice *dev, u64 sector,
 		return -EINVAL;
 	}
 
-	virtio_blk_init_status_sg(&status, &status_sg);
+	req->status = VIRTIO_BLK_S_IOERR;
+	virtio_blk_init_status_sg(&req->status, &status_sg);
 	sgs[num_out + num_in++] = &status_sg;
+
+	return virtqueue_add(priv->vq, sgs, num_out, num_in);
+}
+
+/**
+ * virtio_blk_do_req() - carry out a transfer with many requests in flight
+ *
+ * The transfer is split into requests of at most @priv->max_blocks blocks.
+ * As many requests as fit in the ring are added before the device is told
+ * about them, then all the requests which the device has finished are
+ * handled before adding more.
+ *
+ * @dev:	virtio block device
+ * @sector:	first block to transfer
+ * @blkcnt:	number of blocks to transfer
+ * @buffer:	address of the data, NULL for VIRTIO_BLK_T_WRITE_ZEROES
+ * @type:	type of request (VIRTIO_BLK_T_...)
+ * Return:	number of blocks transferred before the first failure, or a
+ *		negative error if the first request failed
+ */
+static ulong virtio_blk_do_req(struct udevice *dev, u64 sector,
+			       lbaint_t blkcnt, void *buffer, u32 type)
+{
+	struct virtio_blk_priv *priv = dev_get_priv(dev);
+	struct virtio_blk_req *req, *free_reqs = NULL;
+	lbaint_t done = 0, failed = blkcnt;
+	uint inflight = 0;
+	void *buf;
+	int ret = 0;
+	int i;
+
+	for (i = priv->num_reqs - 1; i >= 0; i--) {
+		priv->reqs[i].next = free_reqs;
+		free_reqs = &priv->reqs[i];
+	}
 	log_debug("dev=%s, active=%d, priv=%p, priv->vq=%p\n", dev->name,
 		  device_active(dev), priv, priv->vq);
 
-	ret = virtqueue_add(priv->vq, sgs, num_out, num_in);
-	if (ret)
-		return ret;
-
-	virtqueue_kick(priv->vq);
+	while ((done < blkcnt && failed == blkcnt) || inflight) {
+		uint queued = 0;
+
+		while (done < blkcnt && failed == blkcnt && free_reqs) {
+			lbaint_t count = min_t(lbaint_t, priv->max_blocks,
+					       blkcnt - done);
+			void *data = NULL;
+
+			if (buffer)
+				data = buffer + (done << (priv->blksz_shift + 9));
+			req = free_reqs;
+			ret = virtio_blk_queue_req(dev, req, sector + done, count,
+						   data, type);
+			/* If the ring is full, wait for a request to finish */
+			if (ret == -ENOSPC && inflight) {
+				ret = 0;
+				break;
+			}
+			if (ret) {
+				failed = done;
+				break;
+			}
+			free_reqs = req->next;
+			req->offset = done;
+			done += count;
+			inflight++;
+			queued++;
+		}
+		if (queued)
+			virtqueue_kick(priv->vq);
+		if (!inflight)
+			break;
+
+		log_debug("wait for %u...", inflight);
+		while (!(buf = virtqueue_get_buf(priv->vq, NULL)))
+			;
+		log_debug("done\n");
+
+		/* Handle all the requests which are finished */
+		do {
+			req = container_of(buf, struct virtio_blk_req, out_hdr);
+			if (req->status != VIRTIO_BLK_S_OK) {
+				log_debug("status %d, block %llx\n", req->status,
+					  (u64)(sector + req->offset));
+				failed = min(failed, req->offset);
+			}
+			req->next = free_reqs;
+			free_reqs = req;
+			inflight--;
+		} while (inflight && (buf = virtqueue_get_buf(priv->vq, NULL)));
+	}
 
-	log_debug("wait...");
-	while (!virtqueue_get_buf(priv->vq, NULL))
-		;
-	log_debug("done\n");
+	if (blkcnt && !failed)
+		return ret ? ret : -EIO;
 
-	return status == VIRTIO_BLK_S_OK ? blkcnt >> priv->blksz_shift : -EIO;
+	return failed;
 }
 
 static ulong virtio_blk_read(struct udevice *dev, lbaint_t start,
@@ -187,7 +299,7 @@ static int virtio_blk_probe(struct udevice *dev)
 	struct blk_desc *desc = dev_get_uclass_plat(dev);
 	u64 cap;
 	int ret;
-	u32 blk_size;
+	u32 blk_size, size_max, max_bytes;
 
 	ret = virtio_find_vqs(dev, 1, &priv->vq);
 	if (ret)
@@ -207,9 +319,38 @@ static int virtio_blk_probe(struct udevice *dev)
 	priv->blksz_shift = desc->log2blksz - 9;
 	desc->lba >>= priv->blksz_shift;
 
+	max_bytes = VIRTIO_BLK_MAX_SECTORS << 9;
+	if (virtio_has_feature(dev, VIRTIO_BLK_F_SIZE_MAX)) {
+		virtio_cread(dev, struct virtio_blk_config, size_max,
+			     &size_max);
+		max_bytes = min(max_bytes, size_max);
+	}
+	priv->max_blocks = max(max_bytes >> desc->log2blksz, 1U);
+
+	/*
+	 * Without indirect descriptors, each request takes three descriptors
+	 * (or two for a request with no data, but those are rare)
+	 */
+	priv->num_reqs = virtqueue_get_vring_size(priv->vq);
+	if (!priv->vq->indirect_desc)
+		priv->num_reqs = max(priv->num_reqs / 3, 1U);
+	priv->reqs = calloc(priv->num_reqs, sizeof(*priv->reqs));
+	if (!priv->reqs)
+		return -ENOMEM;
+
 	return 0;
 }
 
+static int virtio_blk_remove(struct udevice *dev)
+{
+	struct virtio_blk_priv *priv = dev_get_priv(dev);
+
+	free(priv->reqs);
+	priv->reqs = NULL;
+
+	return virtio_reset(dev);
+}
+
 static const struct blk_ops virtio_blk_ops = {
 	.read	= virtio_blk_read,
 	.write	= virtio_blk_write,
@@ -222,7 +363,7 @@ U_BOOT_DRIVER(virtio_blk) = {
 	.ops	= &virtio_blk_ops,
 	.bind	= virtio_blk_bind,
 	.probe	= virtio_blk_probe,
-	.remove	= virtio_reset,
+	.remove	= virtio_blk_remove,
 	.priv_auto	= sizeof(struct virtio_blk_priv),
 	.flags	= DM_FLAG_ACTIVE_DMA,
 };
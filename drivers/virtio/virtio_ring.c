@@ -95,6 +95,46 @@ static void virtqueue_detach_desc(struct virtqueue *vq, unsigned int idx)
 	bb = &vq->vring.bouncebufs[idx];
 	bounce_buffer_stop(bb);
 	desc->addr = cpu_to_virtio64(vq->vdev, (u64)(uintptr_t)bb->user_buffer);
+	vq->vring_desc_shadow[idx].addr = (u64)(uintptr_t)bb->user_buffer;
+}
+
+static struct vring_desc *virtqueue_indirect_table(struct virtqueue *vq,
+						   unsigned int head)
+{
+	return &vq->indirect_desc[head * VIRTQUEUE_MAX_INDIRECT];
+}
+
+/*
+ * Puts the buffers in the indirect table which belongs to descriptor @head,
+ * then points @head at the table. Only the guest writes the table, so there
+ * is no need for a shadow copy.
+ */
+static unsigned int virtqueue_attach_indirect(struct virtqueue *vq,
+					      unsigned int head,
+					      struct virtio_sg *sgs[],
+					      unsigned int out_sgs,
+					      unsigned int descs_used)
+{
+	struct vring_desc *table = virtqueue_indirect_table(vq, head);
+	struct virtio_sg sg;
+	unsigned int n;
+
+	for (n = 0; n < descs_used; n++) {
+		u16 flags = n + 1 < descs_used ? VRING_DESC_F_NEXT : 0;
+
+		if (n >= out_sgs)
+			flags |= VRING_DESC_F_WRITE;
+		table[n].addr = cpu_to_virtio64(vq->vdev,
+						(u64)(uintptr_t)sgs[n]->addr);
+		table[n].len = cpu_to_virtio32(vq->vdev, sgs[n]->length);
+		table[n].flags = cpu_to_virtio16(vq->vdev, flags);
+		table[n].next = cpu_to_virtio16(vq->vdev, n + 1);
+	}
+
+	sg.addr = table;
+	sg.length = descs_used * sizeof(*table);
+
+	return virtqueue_attach_desc(vq, head, &sg, VRING_DESC_F_INDIRECT);
 }
 
 int virtqueue_add(struct virtqueue *vq, struct virtio_sg *sgs[],
@@ -103,6 +143,7 @@ int virtqueue_add(struct virtqueue *vq, struct virtio_sg *sgs[],
 	struct vring_desc *desc;
 	unsigned int descs_used = out_sgs + in_sgs;
 	unsigned int i, n, avail, uninitialized_var(prev);
+	bool indirect;
 	int head;
 
 	WARN_ON(descs_used == 0);
@@ -112,7 +153,14 @@ int virtqueue_add(struct virtqueue *vq, struct virtio_sg *sgs[],
 	desc = vq->vring.desc;
 	i = head;
 
-	if (vq->num_free < descs_used) {
+	/* A chain in an indirect table takes up a single descriptor */
+	indirect = vq->indirect_desc && descs_used > 1 &&
+		   descs_used <= VIRTQUEUE_MAX_INDIRECT;
+	if (indirect && vq->num_free) {
+		i = virtqueue_attach_indirect(vq, head, sgs, out_sgs,
+					      descs_used);
+		descs_used = 1;
+	} else if (vq->num_free < descs_used) {
 		debug("Can't add buf len %i - avail = %i\n",
 		      descs_used, vq->num_free);
 		/*
@@ -123,19 +171,20 @@ int virtqueue_add(struct virtqueue *vq, struct virtio_sg *sgs[],
 		if (out_sgs)
 			virtio_notify(vq->vdev, vq);
 		return -ENOSPC;
-	}
-
-	for (n = 0; n < descs_used; n++) {
-		u16 flags = VRING_DESC_F_NEXT;
+	} else {
+		for (n = 0; n < descs_used; n++) {
+			u16 flags = VRING_DESC_F_NEXT;
 
-		if (n >= out_sgs)
-			flags |= VRING_DESC_F_WRITE;
-		prev = i;
-		i = virtqueue_attach_desc(vq, i, sgs[n], flags);
+			if (n >= out_sgs)
+				flags |= VRING_DESC_F_WRITE;
+			prev = i;
+			i = virtqueue_attach_desc(vq, i, sgs[n], flags);
+		}
+		/* Last one doesn't continue */
+		vq->vring_desc_shadow[prev].flags &= ~VRING_DESC_F_NEXT;
+		desc[prev].flags = cpu_to_virtio16(vq->vdev,
+						   vq->vring_desc_shadow[prev].flags);
 	}
-	/* Last one doesn't continue */
-	vq->vring_desc_shadow[prev].flags &= ~VRING_DESC_F_NEXT;
-	desc[prev].flags = cpu_to_virtio16(vq->vdev, vq->vring_desc_shadow[prev].flags);
 
 	/* We're using some buffers from the free list. */
 	vq->num_free -= descs_used;
@@ -280,6 +329,14 @@ void *virtqueue_get_buf(struct virtqueue *vq, unsigned int *len)
 		virtio_store_mb(&vring_used_event(&vq->vring),
 				cpu_to_virtio16(vq->vdev, vq->last_used_idx));
 
+	/* Hand back the first buffer, as for a chain without a table */
+	if (vq->vring_desc_shadow[i].flags & VRING_DESC_F_INDIRECT) {
+		struct vring_desc *table = virtqueue_indirect_table(vq, i);
+
+		return (void *)(uintptr_t)virtio64_to_cpu(vq->vdev,
+							  table->addr);
+	}
+
 	return (void *)(uintptr_t)vq->vring_desc_shadow[i].addr;
 }
 
@@ -316,6 +373,18 @@ static struct virtqueue *__vring_new_virtqueue(unsigned int index,
 
 	vq->event = virtio_has_feature(vdev, VIRTIO_RING_F_EVENT_IDX);
 
+	/*
+	 * Indirect tables are not used with bounce buffers, since the buffers
+	 * they point to would need bouncing too. Without the tables, each
+	 * chain just takes up more of the ring.
+	 */
+	vq->indirect_desc = NULL;
+	if (virtio_has_feature(vdev, VIRTIO_RING_F_INDIRECT_DESC) &&
+	    !vring.bouncebufs)
+		vq->indirect_desc = memalign(VRING_DESC_ALIGN_SIZE,
+					     vring.num * VIRTQUEUE_MAX_INDIRECT *
+					     sizeof(struct vring_desc));
+
 	/* Tell other side not to bother us */
 	vq->avail_flags_shadow |= VRING_AVAIL_F_NO_INTERRUPT;
 	if (!vq->event)
@@ -399,6 +468,7 @@ void vring_del_virtqueue(struct virtqueue *vq)
 	virtio_free_pages(vq->vdev, vq->vring.desc,
 			  DIV_ROUND_UP(vq->vring.size, PAGE_SIZE));
 	free(vq->vring_desc_shadow);
+	free(vq->indirect_desc);
 	list_del(&vq->list);
 	free(vq->vring.bouncebufs);
 	free(vq);
@@ -444,6 +514,7 @@ void virtqueue_dump(struct virtqueue *vq)
 	       vq->free_head, vq->num_added, vq->num_free);
 	printf("\tlast_used_idx %u, avail_flags_shadow %u, avail_idx_shadow %u\n",
 	       vq->last_used_idx, vq->avail_flags_shadow, vq->avail_idx_shadow);
+	printf("\tevent %d, indirect %d\n", vq->event, !!vq->indirect_desc);
 
 	printf("Shadow descriptor dump:\n");
 	for (i = 0; i < vq->vring.num; i++) {
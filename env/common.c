@@ -578,12 +578,34 @@ int env_import_redund(const char *buf1, int buf1_read_fail,
 }
 #endif /* CONFIG_ENV_REDUNDANT */
 
+/**
+ * struct env_export_cache - the last environment exported
+ *
+ * @data: exported variables, ENV_SIZE bytes, NULL if none yet
+ * @crc: CRC32 of @data
+ * @changes: value of env_htab.changes when @data was exported
+ */
+static struct env_export_cache {
+	char *data;
+	u32 crc;
+	uint changes;
+} env_export_cache;
+
 /* Export the environment and generate CRC for it. */
 int env_export(env_t *env_out)
 {
+	struct env_export_cache *cache = &env_export_cache;
 	char *res;
 	ssize_t	len;
 
+	/* Nothing to do if no variable changed since the last export */
+	if (IS_ENABLED(CONFIG_ENV_INCREMENTAL_SAVE) && cache->data &&
+	    cache->changes == env_htab.changes) {
+		memcpy(env_out->data, cache->data, ENV_SIZE);
+		env_out->crc = cache->crc;
+		goto done;
+	}
+
 	res = (char *)env_out->data;
 	len = hexport_r(&env_htab, '\0', 0, &res, ENV_SIZE, 0, NULL);
 	if (len < 0) {
@@ -593,6 +615,17 @@ int env_export(env_t *env_out)
 
 	env_out->crc = crc32(0, env_out->data, ENV_SIZE);
 
+	if (IS_ENABLED(CONFIG_ENV_INCREMENTAL_SAVE)) {
+		if (!cache->data)
+			cache->data = malloc(ENV_SIZE);
+		if (cache->data) {
+			memcpy(cache->data, env_out->data, ENV_SIZE);
+			cache->crc = env_out->crc;
+			cache->changes = env_htab.changes;
+		}
+	}
+
+done:
 #ifdef CONFIG_ENV_REDUNDANT
 	env_out->flags = ++env_flags; /* increase the serial */
 #endif
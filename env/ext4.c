@@ -88,6 +88,8 @@ static int env_ext4_save_buffer(env_t *env_new)
 	err = ext4fs_write(CONFIG_ENV_EXT4_FILE, (void *)env_new,
 			   sizeof(env_t), FILETYPE_REG);
 	ext4fs_close();
+	if (err != -1 && blk_dflush(dev_desc))
+		err = -1;
 
 	if (err == -1) {
 		printf("\n** Unable to write \"%s\" from %s%d:%d **\n",
@@ -94,6 +94,8 @@ static int env_fat_save(void)
 #endif
 
 	err = file_fat_write(file, (void *)&env_new, 0, sizeof(env_t), &size);
+	if (err != -1 && blk_dflush(dev_desc))
+		err = -1;
 	if (err == -1) {
 		/*
 		 * This printf is embedded in the messages from env_save that
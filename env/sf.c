@@ -74,12 +74,101 @@ static int setup_flash_device(struct spi_flash **env_flash)
 	return 0;
 }
 
+/*
+ * Compares each sector of the environment in flash with @image, erasing and
+ * writing only those which differ
+ */
+static int env_sf_write_changed(struct spi_flash *env_flash, u32 offset,
+				u32 sect_size, const char *image, u32 size)
+{
+	u32 off, len, changed = 0;
+	char *cur;
+	int ret = 0;
+
+	cur = memalign(ARCH_DMA_MINALIGN, sect_size);
+	if (!cur)
+		return -ENOMEM;
+
+	puts("Writing changed sectors to SPI flash...");
+	for (off = 0; off < size; off += sect_size) {
+		len = min(sect_size, size - off);
+		ret = spi_flash_read(env_flash, offset + off, len, cur);
+		if (ret)
+			break;
+		if (!memcmp(cur, image + off, len))
+			continue;
+
+		ret = spi_flash_erase(env_flash, offset + off, sect_size);
+		if (ret)
+			break;
+		ret = spi_flash_write(env_flash, offset + off, len,
+				      image + off);
+		if (ret)
+			break;
+		changed++;
+	}
+	if (!ret)
+		printf("%u of %u...", changed, DIV_ROUND_UP(size, sect_size));
+	free(cur);
+
+	return ret;
+}
+
+/*
+ * Writes the environment at @offset, followed by @saved_size bytes of other
+ * data which share its last sector
+ */
+static int env_sf_write(struct spi_flash *env_flash, u32 offset,
+			u32 sect_size, env_t *env_new, char *saved_buffer,
+			u32 saved_size)
+{
+	u32 sector;
+	char *image;
+	int ret;
+
+	if (IS_ENABLED(CONFIG_ENV_INCREMENTAL_SAVE)) {
+		image = malloc(CONFIG_ENV_SIZE + saved_size);
+		if (!image)
+			return -ENOMEM;
+		memcpy(image, env_new, CONFIG_ENV_SIZE);
+		if (saved_size)
+			memcpy(image + CONFIG_ENV_SIZE, saved_buffer,
+			       saved_size);
+		ret = env_sf_write_changed(env_flash, offset, sect_size, image,
+					   CONFIG_ENV_SIZE + saved_size);
+		free(image);
+
+		return ret;
+	}
+
+	sector = DIV_ROUND_UP(CONFIG_ENV_SIZE, sect_size);
+
+	puts("Erasing SPI flash...");
+	ret = spi_flash_erase(env_flash, offset, sector * sect_size);
+	if (ret)
+		return ret;
+
+	puts("Writing to SPI flash...");
+	ret = spi_flash_write(env_flash, offset, CONFIG_ENV_SIZE, env_new);
+	if (ret)
+		return ret;
+
+	if (saved_size) {
+		ret = spi_flash_write(env_flash, offset + CONFIG_ENV_SIZE,
+				      saved_size, saved_buffer);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
 #if defined(CONFIG_ENV_OFFSET_REDUND)
 static int env_sf_save(void)
 {
 	env_t	env_new;
 	char	*saved_buffer = NULL, flag = ENV_REDUND_OBSOLETE;
-	u32	saved_size = 0, saved_offset = 0, sector;
+	u32	saved_size = 0, saved_offset = 0;
 	u32	sect_size = CONFIG_ENV_SECT_SIZE;
 	int	ret;
 	struct spi_flash *env_flash;
@@ -119,28 +208,11 @@ static int env_sf_save(void)
 			goto done;
 	}
 
-	sector = DIV_ROUND_UP(CONFIG_ENV_SIZE, sect_size);
-
-	puts("Erasing SPI flash...");
-	ret = spi_flash_erase(env_flash, env_new_offset,
-				sector * sect_size);
-	if (ret)
-		goto done;
-
-	puts("Writing to SPI flash...");
-
-	ret = spi_flash_write(env_flash, env_new_offset,
-		CONFIG_ENV_SIZE, &env_new);
+	ret = env_sf_write(env_flash, env_new_offset, sect_size, &env_new,
+			   saved_buffer, saved_size);
 	if (ret)
 		goto done;
 
-	if (sect_size > CONFIG_ENV_SIZE) {
-		ret = spi_flash_write(env_flash, saved_offset,
-					saved_size, saved_buffer);
-		if (ret)
-			goto done;
-	}
-
 	ret = spi_flash_write(env_flash, env_offset + offsetof(env_t, flags),
 				sizeof(env_new.flags), &flag);
 	if (ret)
@@ -200,7 +272,7 @@ out:
 #else
 static int env_sf_save(void)
 {
-	u32	saved_size = 0, saved_offset = 0, sector;
+	u32	saved_size = 0, saved_offset = 0;
 	u32	sect_size = CONFIG_ENV_SECT_SIZE;
 	char	*saved_buffer = NULL;
 	int	ret = 1;
@@ -234,27 +306,11 @@ static int env_sf_save(void)
 	if (ret)
 		goto done;
 
-	sector = DIV_ROUND_UP(CONFIG_ENV_SIZE, sect_size);
-
-	puts("Erasing SPI flash...");
-	ret = spi_flash_erase(env_flash, CONFIG_ENV_OFFSET,
-		sector * sect_size);
-	if (ret)
-		goto done;
-
-	puts("Writing to SPI flash...");
-	ret = spi_flash_write(env_flash, CONFIG_ENV_OFFSET,
-		CONFIG_ENV_SIZE, &env_new);
+	ret = env_sf_write(env_flash, CONFIG_ENV_OFFSET, sect_size, &env_new,
+			   saved_buffer, saved_size);
 	if (ret)
 		goto done;
 
-	if (sect_size > CONFIG_ENV_SIZE) {
-		ret = spi_flash_write(env_flash, saved_offset,
-			saved_size, saved_buffer);
-		if (ret)
-			goto done;
-	}
-
 	ret = 0;
 	puts("done\n");
 
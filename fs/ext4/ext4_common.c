@@ -218,6 +218,10 @@ void put_ext4(uint64_t off, const void *buf, uint32_t size)
 		return;
 	}
 
+	ext_mcache_invalidate(startblock - part_offset,
+			      DIV_ROUND_UP(remainder + size,
+					   fs->dev_desc->blksz));
+
 	if (remainder) {
 		blk_dread(fs->dev_desc, startblock, 1, sec_buf);
 		temp_ptr = sec_buf;
@@ -1591,9 +1595,10 @@ static int ext4fs_blockgroup
 	debug("ext4fs read %d group descriptor (blkno %ld blkoff %u)\n",
 	      group, blkno, blkoff);
 
-	return ext4fs_devread((lbaint_t)blkno <<
-			      (LOG2_BLOCK_SIZE(data) - log2blksz),
-			      blkoff, desc_size, (char *)blkgrp);
+	return ext_cache_devread((lbaint_t)blkno <<
+				 (LOG2_BLOCK_SIZE(data) - log2blksz),
+				 EXT2_BLOCK_SIZE(data), blkoff, desc_size,
+				 (char *)blkgrp);
 }
 
 int ext4fs_read_inode(struct ext2_data *data, int ino, struct ext2_inode *inode)
@@ -1637,9 +1642,9 @@ int ext4fs_read_inode(struct ext2_data *data, int ino, struct ext2_inode *inode)
 	free(blkgrp);
 
 	/* Read the inode. */
-	status = ext4fs_devread((lbaint_t)blkno << (LOG2_BLOCK_SIZE(data) -
-				log2blksz), blkoff,
-				sizeof(struct ext2_inode), (char *)inode);
+	status = ext_cache_devread((lbaint_t)blkno << (LOG2_BLOCK_SIZE(data) -
+				   log2blksz), EXT2_BLOCK_SIZE(data), blkoff,
+				   sizeof(struct ext2_inode), (char *)inode);
 	if (status == 0)
 		return 0;
 
@@ -2044,6 +2049,7 @@ void ext4fs_close(void)
 	}
 
 	ext4fs_reinit_global();
+	ext_mcache_fini();
 }
 
 int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
@@ -2398,6 +2404,7 @@ int ext4fs_mount(void)
 	data->diropen.inode_read = 1;
 	data->inode = &data->diropen.inode;
 
+	ext_mcache_init();
 	status = ext4fs_read_inode(data, 2, data->inode);
 	if (status == 0)
 		goto fail;
@@ -2408,6 +2415,7 @@ int ext4fs_mount(void)
 fail:
 	log_debug("Failed to mount ext2 filesystem...\n");
 fail_noerr:
+	ext_mcache_fini();
 	free(data);
 	ext4fs_root = NULL;
 
@@ -87,6 +87,8 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 	char *start_buf = buf;
 	short status;
 	struct ext_block_cache cache;
+	bool is_dir = (le16_to_cpu(node->inode.mode) & FILETYPE_INO_MASK) ==
+		FILETYPE_INO_DIRECTORY;
 
 	ext_cache_init(&cache);
 
@@ -132,7 +134,17 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 			skipfirst = blockoff;
 			blockend -= skipfirst;
 		}
-		if (blknr) {
+		if (blknr && is_dir) {
+			/*
+			 * Directory blocks are read a few bytes at a time and
+			 * again for every lookup, serve them from the cache.
+			 */
+			if (!ext_cache_devread(blknr, blocksize, skipfirst,
+					       blockend, buf)) {
+				ext_cache_fini(&cache);
+				return -1;
+			}
+		} else if (blknr) {
 			int status;
 
 			if (previous_block_number != -1) {
@@ -422,6 +434,186 @@ int ext4fs_uuid(char *uuid_str)
 #endif
 }
 
+/**
+ * struct ext_cache_entry - metadata block held by the per-mount cache
+ *
+ * @lru:	position in the LRU list, most recently used first
+ * @hash:	position in the hash bucket of @block
+ * @block:	first sector of the block, relative to the partition
+ * @size:	size of the block in bytes
+ * @buf:	block content
+ */
+struct ext_cache_entry {
+	struct list_head lru;
+	struct hlist_node hash;
+	lbaint_t block;
+	int size;
+	char *buf;
+};
+
+#define EXT_CACHE_HASH_BITS	6
+
+/*
+ * Extent index nodes, directory blocks, group descriptors and inode table
+ * blocks are kept here from ext4fs_mount() until ext4fs_close(), so that path
+ * lookups and extent tree walks do not read the same blocks again and again.
+ */
+static struct {
+	struct hlist_head buckets[1 << EXT_CACHE_HASH_BITS];
+	struct list_head lru;
+	int count;
+	bool active;
+} ext_mcache;
+
+static struct ext_cache_stats ext_mcache_stats;
+
+static struct hlist_head *ext_mcache_bucket(lbaint_t block)
+{
+	return &ext_mcache.buckets[((u32)block * 0x9e3779b9) >>
+				   (32 - EXT_CACHE_HASH_BITS)];
+}
+
+static void ext_mcache_drop(struct ext_cache_entry *entry)
+{
+	hlist_del(&entry->hash);
+	list_del(&entry->lru);
+	free(entry->buf);
+	free(entry);
+	ext_mcache.count--;
+}
+
+void ext_mcache_init(void)
+{
+	int i;
+
+	ext_mcache_fini();
+	if (!CONFIG_VAL(EXT4_CACHE_BLOCKS))
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(ext_mcache.buckets); i++)
+		INIT_HLIST_HEAD(&ext_mcache.buckets[i]);
+	INIT_LIST_HEAD(&ext_mcache.lru);
+	ext_mcache.active = true;
+}
+
+void ext_mcache_fini(void)
+{
+	struct ext_cache_entry *entry, *tmp;
+
+	if (!ext_mcache.active)
+		return;
+
+	list_for_each_entry_safe(entry, tmp, &ext_mcache.lru, lru)
+		ext_mcache_drop(entry);
+	ext_mcache.active = false;
+}
+
+void ext_mcache_invalidate(lbaint_t start, lbaint_t count)
+{
+	int log2blksz = get_fs()->dev_desc->log2blksz;
+	struct ext_cache_entry *entry, *tmp;
+
+	if (!ext_mcache.active)
+		return;
+
+	list_for_each_entry_safe(entry, tmp, &ext_mcache.lru, lru) {
+		if (entry->block < start + count &&
+		    start < entry->block + (entry->size >> log2blksz))
+			ext_mcache_drop(entry);
+	}
+}
+
+void ext_cache_get_stats(struct ext_cache_stats *stats)
+{
+	*stats = ext_mcache_stats;
+	stats->entries = ext_mcache.count;
+	stats->max_entries = CONFIG_VAL(EXT4_CACHE_BLOCKS);
+	memset(&ext_mcache_stats, 0, sizeof(ext_mcache_stats));
+}
+
+/*
+ * Returns the content of a metadata block through the per-mount cache,
+ * reading it on a miss. Returns -ENOSYS if the cache cannot hold the block,
+ * in which case the caller has to read it by itself.
+ */
+static int ext_mcache_get(lbaint_t block, int size, char **bufp)
+{
+	struct hlist_head *bucket = ext_mcache_bucket(block);
+	struct ext_cache_entry *entry;
+
+	if (!ext_mcache.active)
+		return -ENOSYS;
+
+	hlist_for_each_entry(entry, bucket, hash) {
+		if (entry->block == block && entry->size == size) {
+			list_move(&entry->lru, &ext_mcache.lru);
+			ext_mcache_stats.hits++;
+			*bufp = entry->buf;
+			return 0;
+		}
+	}
+
+	ext_mcache_stats.misses++;
+	if (ext_mcache.count < CONFIG_VAL(EXT4_CACHE_BLOCKS)) {
+		entry = calloc(1, sizeof(*entry));
+		if (!entry)
+			return -ENOSYS;
+		entry->buf = memalign(ARCH_DMA_MINALIGN, size);
+		if (!entry->buf) {
+			free(entry);
+			return -ENOSYS;
+		}
+		ext_mcache.count++;
+	} else {
+		entry = list_last_entry(&ext_mcache.lru, struct ext_cache_entry,
+					lru);
+		hlist_del(&entry->hash);
+		list_del(&entry->lru);
+		ext_mcache_stats.evictions++;
+		if (entry->size != size) {
+			free(entry->buf);
+			entry->buf = memalign(ARCH_DMA_MINALIGN, size);
+			if (!entry->buf) {
+				free(entry);
+				ext_mcache.count--;
+				return -ENOSYS;
+			}
+		}
+	}
+
+	entry->block = block;
+	entry->size = size;
+	if (!ext4fs_devread(block, 0, size, entry->buf)) {
+		free(entry->buf);
+		free(entry);
+		ext_mcache.count--;
+		return -EIO;
+	}
+
+	hlist_add_head(&entry->hash, bucket);
+	list_add(&entry->lru, &ext_mcache.lru);
+	*bufp = entry->buf;
+
+	return 0;
+}
+
+int ext_cache_devread(lbaint_t block, int size, int byte_offset, int byte_len,
+		      char *buf)
+{
+	char *cached;
+	int ret;
+
+	ret = ext_mcache_get(block, size, &cached);
+	if (ret == -ENOSYS)
+		return ext4fs_devread(block, byte_offset, byte_len, buf);
+	if (ret)
+		return 0;
+
+	memcpy(buf, cached + byte_offset, byte_len);
+
+	return 1;
+}
+
 void ext_cache_init(struct ext_block_cache *cache)
 {
 	memset(cache, 0, sizeof(*cache));
@@ -429,14 +621,32 @@ void ext_cache_init(struct ext_block_cache *cache)
 
 void ext_cache_fini(struct ext_block_cache *cache)
 {
-	free(cache->buf);
+	/* Buffers borrowed from the per-mount cache are not ours to free */
+	if (!cache->shared)
+		free(cache->buf);
 	ext_cache_init(cache);
 }
 
 int ext_cache_read(struct ext_block_cache *cache, lbaint_t block, int size)
 {
+	char *buf;
+	int ret;
+
+	ret = ext_mcache_get(block, size, &buf);
+	if (!ret) {
+		ext_cache_fini(cache);
+		cache->buf = buf;
+		cache->block = block;
+		cache->size = size;
+		cache->shared = true;
+		return 1;
+	}
+	if (ret != -ENOSYS)
+		return 0;
+
 	/* This could be more lenient, but this is simple and enough for now */
-	if (cache->buf && cache->block == block && cache->size == size)
+	if (cache->buf && !cache->shared && cache->block == block &&
+	    cache->size == size)
 		return 1;
 	ext_cache_fini(cache);
 	cache->buf = memalign(ARCH_DMA_MINALIGN, size);
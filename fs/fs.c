@@ -521,6 +521,10 @@ void fs_close(void)
 
 	info->close();
 
+	/* write back what the filesystem left in the block cache */
+	if (fs_dev_desc && blk_dflush(fs_dev_desc))
+		log_err("** Unable to flush block device **\n");
+
 	fs_type = FS_TYPE_ANY;
 }
 
@@ -98,6 +98,164 @@ static int sqfs_calc_n_blks(__le64 start, __le64 end, u64 *offset)
 	return DIV_ROUND_UP(table_size + *offset, ctxt.cur_dev->blksz);
 }
 
+/*
+ * Reads 'size' bytes starting at byte offset 'start' of the image. The caller
+ * must free '*bufp' once done with '*datap', which points into it.
+ */
+static int sqfs_read_range(u64 start, u32 size, unsigned char **bufp,
+			   unsigned char **datap)
+{
+	u64 blk, n_blks, offset;
+	size_t buf_size;
+
+	blk = lldiv(start, ctxt.cur_dev->blksz);
+	offset = start - blk * ctxt.cur_dev->blksz;
+	n_blks = DIV_ROUND_UP(size + offset, ctxt.cur_dev->blksz);
+
+	if (__builtin_mul_overflow(n_blks, ctxt.cur_dev->blksz, &buf_size))
+		return -EINVAL;
+
+	*bufp = malloc_cache_aligned(buf_size);
+	if (!*bufp)
+		return -ENOMEM;
+
+	if (sqfs_disk_read(blk, n_blks, *bufp) < 0) {
+		free(*bufp);
+		*bufp = NULL;
+		return -EIO;
+	}
+
+	*datap = *bufp + offset;
+
+	return 0;
+}
+
+/*
+ * Loads the data or fragment block stored at byte offset 'start', whose
+ * on-disk size word is 'size', into 'dest'. On entry '*dest_len' is the room
+ * available in 'dest', on return it holds the decompressed length.
+ */
+static int sqfs_load_block(u64 start, u32 size, void *dest,
+			   unsigned long *dest_len)
+{
+	unsigned char *buf, *data;
+	u32 src_len = SQFS_BLOCK_SIZE(size);
+	int ret;
+
+	ret = sqfs_read_range(start, src_len, &buf, &data);
+	if (ret)
+		return ret;
+
+	if (SQFS_COMPRESSED_BLOCK(size)) {
+		ret = sqfs_decompress(&ctxt, dest, dest_len, data, src_len);
+		if (ret)
+			ret = -EINVAL;
+	} else if (src_len > *dest_len) {
+		ret = -EINVAL;
+	} else {
+		memcpy(dest, data, src_len);
+		*dest_len = src_len;
+	}
+
+	free(buf);
+
+	return ret;
+}
+
+static struct squashfs_cache_entry *sqfs_cache_lookup(u64 start)
+{
+	struct squashfs_cache *cache = &ctxt.cache;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(cache->blocks); i++) {
+		struct squashfs_cache_entry *entry = &cache->blocks[i];
+
+		if (entry->len && entry->start == start) {
+			entry->stamp = ++cache->stamp;
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Picks the least recently used entry of the block cache and makes sure it
+ * has a buffer large enough for any data or metadata block. The entry is
+ * returned invalidated, the caller fills it and sets its start and length.
+ */
+static struct squashfs_cache_entry *sqfs_cache_victim(void)
+{
+	struct squashfs_cache *cache = &ctxt.cache;
+	struct squashfs_cache_entry *entry = &cache->blocks[0];
+	int i;
+
+	for (i = 1; i < ARRAY_SIZE(cache->blocks) && entry->len; i++) {
+		if (!cache->blocks[i].len ||
+		    cache->blocks[i].stamp < entry->stamp)
+			entry = &cache->blocks[i];
+	}
+
+	if (!entry->data) {
+		entry->data = malloc(max_t(u32, SQFS_METADATA_BLOCK_SIZE,
+					   get_unaligned_le32(&ctxt.sblk->block_size)));
+		if (!entry->data)
+			return NULL;
+	}
+
+	entry->len = 0;
+	entry->stamp = ++cache->stamp;
+
+	return entry;
+}
+
+/*
+ * Returns the decompressed content of the data or fragment block stored at
+ * byte offset 'start', reading it from the medium only if it is not cached.
+ */
+static int sqfs_cache_block(u64 start, u32 size,
+			    struct squashfs_cache_entry **entryp)
+{
+	struct squashfs_cache_entry *entry;
+	unsigned long dest_len;
+	int ret;
+
+	entry = sqfs_cache_lookup(start);
+	if (entry) {
+		*entryp = entry;
+		return 0;
+	}
+
+	entry = sqfs_cache_victim();
+	if (!entry)
+		return -ENOMEM;
+
+	dest_len = get_unaligned_le32(&ctxt.sblk->block_size);
+	ret = sqfs_load_block(start, size, entry->data, &dest_len);
+	if (ret)
+		return ret;
+
+	entry->start = start;
+	entry->len = dest_len;
+	*entryp = entry;
+
+	return 0;
+}
+
+static void sqfs_cache_free(void)
+{
+	struct squashfs_cache *cache = &ctxt.cache;
+	int i;
+
+	free(cache->inode_table);
+	free(cache->dir_table);
+	free(cache->dir_pos_list);
+	for (i = 0; i < ARRAY_SIZE(cache->blocks); i++)
+		free(cache->blocks[i].data);
+
+	memset(cache, 0, sizeof(*cache));
+}
+
 /*
  * Retrieves fragment block entry and returns true if the fragment block is
  * compressed
@@ -106,15 +264,15 @@ static int sqfs_frag_lookup(u32 inode_fragment_index,
 			    struct squashfs_fragment_block_entry *e)
 {
 	u64 start, end, exp_tbl, n_blks, src_len, table_offset, start_block;
-	unsigned char *metadata_buffer, *metadata, *table;
 	struct squashfs_fragment_block_entry *entries;
+	unsigned char *metadata_buffer, *metadata, *table;
 	struct squashfs_super_block *sblk = ctxt.sblk;
+	struct squashfs_cache_entry *entry;
 	unsigned long dest_len;
 	int block, offset, ret;
 	u16 header;
 
 	metadata_buffer = NULL;
-	entries = NULL;
 	table = NULL;
 
 	if (inode_fragment_index >= get_unaligned_le32(&sblk->fragments))
@@ -154,6 +312,11 @@ static int sqfs_frag_lookup(u32 inode_fragment_index,
 	start_block = get_unaligned_le64(table + table_offset + block *
 					 sizeof(u64));
 
+	/* Files sharing a fragment block usually share this metadata block */
+	entry = sqfs_cache_lookup(start_block);
+	if (entry)
+		goto found;
+
 	start = start_block / ctxt.cur_dev->blksz;
 	n_blks = sqfs_calc_n_blks(cpu_to_le64(start_block),
 				  sblk->fragment_table_start, &table_offset);
@@ -178,8 +341,8 @@ static int sqfs_frag_lookup(u32 inode_fragment_index,
 		goto out;
 	}
 
-	entries = malloc(SQFS_METADATA_BLOCK_SIZE);
-	if (!entries) {
+	entry = sqfs_cache_victim();
+	if (!entry) {
 		ret = -ENOMEM;
 		goto out;
 	}
@@ -187,21 +350,31 @@ static int sqfs_frag_lookup(u32 inode_fragment_index,
 	if (SQFS_COMPRESSED_METADATA(header)) {
 		src_len = SQFS_METADATA_SIZE(header);
 		dest_len = SQFS_METADATA_BLOCK_SIZE;
-		ret = sqfs_decompress(&ctxt, entries, &dest_len, metadata,
+		ret = sqfs_decompress(&ctxt, entry->data, &dest_len, metadata,
 				      src_len);
 		if (ret) {
 			ret = -EINVAL;
 			goto out;
 		}
 	} else {
-		memcpy(entries, metadata, SQFS_METADATA_SIZE(header));
+		dest_len = SQFS_METADATA_SIZE(header);
+		memcpy(entry->data, metadata, dest_len);
+	}
+
+	entry->start = start_block;
+	entry->len = dest_len;
+
+found:
+	if ((offset + 1) * sizeof(*entries) > entry->len) {
+		ret = -EINVAL;
+		goto out;
 	}
 
+	entries = (struct squashfs_fragment_block_entry *)entry->data;
 	*e = entries[offset];
 	ret = SQFS_COMPRESSED_BLOCK(e->size);
 
 out:
-	free(entries);
 	free(metadata_buffer);
 	free(table);
 
@@ -909,13 +1082,43 @@ out:
 	return metablks_count;
 }
 
+/*
+ * The inode and directory tables are decompressed on the first lookup and kept
+ * until sqfs_close(), so that resolving several paths (or symlinks) in the same
+ * image only inflates them once.
+ */
+static int sqfs_cache_tables(void)
+{
+	struct squashfs_cache *cache = &ctxt.cache;
+	int metablks_count;
+
+	if (cache->inode_table)
+		return 0;
+
+	if (sqfs_read_inode_table(&cache->inode_table)) {
+		cache->inode_table = NULL;
+		return -EINVAL;
+	}
+
+	metablks_count = sqfs_read_directory_table(&cache->dir_table,
+						   &cache->dir_pos_list);
+	if (metablks_count < 1) {
+		free(cache->inode_table);
+		cache->inode_table = NULL;
+		return -EINVAL;
+	}
+
+	cache->dir_metablks = metablks_count;
+
+	return 0;
+}
+
 static int sqfs_opendir_nest(const char *filename, struct fs_dir_stream **dirsp)
 {
-	unsigned char *inode_table = NULL, *dir_table = NULL;
-	int j, token_count = 0, ret = 0, metablks_count;
+	struct squashfs_cache *cache = &ctxt.cache;
+	int j, token_count = 0, ret = 0;
 	struct squashfs_dir_stream *dirs;
 	char **token_list = NULL, *path = NULL;
-	u32 *pos_list = NULL;
 
 	dirs = calloc(1, sizeof(*dirs));
 	if (!dirs)
@@ -928,17 +1131,9 @@ static int sqfs_opendir_nest(const char *filename, struct fs_dir_stream **dirsp)
 	dirs->inode_table = NULL;
 	dirs->dir_table = NULL;
 
-	ret = sqfs_read_inode_table(&inode_table);
-	if (ret) {
-		ret = -EINVAL;
-		goto out;
-	}
-
-	metablks_count = sqfs_read_directory_table(&dir_table, &pos_list);
-	if (metablks_count < 1) {
-		ret = -EINVAL;
+	ret = sqfs_cache_tables();
+	if (ret)
 		goto out;
-	}
 
 	/* Tokenize filename */
 	token_count = sqfs_count_tokens(filename);
@@ -967,10 +1162,10 @@ static int sqfs_opendir_nest(const char *filename, struct fs_dir_stream **dirsp)
 	 * ldir's (extended directory) size is greater than dir, so it works as
 	 * a general solution for the malloc size, since 'i' is a union.
 	 */
-	dirs->inode_table = inode_table;
-	dirs->dir_table = dir_table;
-	ret = sqfs_search_dir(dirs, token_list, token_count, pos_list,
-			      metablks_count);
+	dirs->inode_table = cache->inode_table;
+	dirs->dir_table = cache->dir_table;
+	ret = sqfs_search_dir(dirs, token_list, token_count,
+			      cache->dir_pos_list, cache->dir_metablks);
 	if (ret)
 		goto out;
 
@@ -996,12 +1191,9 @@ out:
 			free(token_list[j]);
 		free(token_list);
 	}
-	free(pos_list);
 	free(path);
-	if (ret) {
-		free(inode_table);
+	if (ret)
 		free(dirs);
-	}
 
 	return ret;
 }
@@ -1140,6 +1332,9 @@ int sqfs_probe(struct blk_desc *fs_dev_desc, struct disk_partition *fs_partition
 	struct squashfs_super_block *sblk;
 	int ret;
 
+	/* Never reuse blocks cached from a previously probed image */
+	sqfs_cache_free();
+
 	ctxt.cur_dev = fs_dev_desc;
 	ctxt.cur_part_info = *fs_partition;
 
@@ -1367,34 +1562,27 @@ static int sqfs_get_lregfile_info(struct squashfs_lreg_inode *lreg,
 static int sqfs_read_nest(const char *filename, void *buf, loff_t offset,
 			  loff_t len, loff_t *actread)
 {
-	char *dir = NULL, *fragment_block, *datablock = NULL;
-	char *fragment = NULL, *file = NULL, *resolved, *data;
-	u64 start, n_blks, table_size, data_offset, table_offset, sparse_size;
-	int ret, j, i_number, datablk_count = 0;
+	int ret, j, i_number, datablk_count = 0, first_blk;
 	struct squashfs_super_block *sblk = ctxt.sblk;
 	struct squashfs_fragment_block_entry frag_entry;
 	struct squashfs_file_info finfo = {0};
 	struct squashfs_symlink_inode *symlink;
+	u64 data_offset, blk_offset, frag_offset;
+	struct squashfs_cache_entry *entry;
 	struct fs_dir_stream *dirsp = NULL;
 	struct squashfs_dir_stream *dirs;
 	struct squashfs_lreg_inode *lreg;
 	struct squashfs_base_inode *base;
+	char *dir = NULL, *file = NULL;
 	struct squashfs_reg_inode *reg;
 	unsigned long dest_len;
 	struct fs_dirent *dent;
 	unsigned char *ipos;
-	size_t buf_size;
+	char *resolved;
+	u32 blk_size, n;
 
 	*actread = 0;
 
-	if (offset) {
-		/*
-		 * TODO: implement reading at an offset in file
-		 */
-		printf("Error: reading at a specific offset in a squashfs file is not supported yet.\n");
-		return -EINVAL;
-	}
-
 	/*
 	 * sqfs_opendir_nest will uncompress inode and directory tables, and will
 	 * return a pointer to the directory that contains the requested file.
@@ -1485,157 +1673,93 @@ static int sqfs_read_nest(const char *filename, void *buf, loff_t offset,
 		goto out;
 	}
 
+	if (offset < 0 || offset > finfo.size) {
+		ret = -EINVAL;
+		goto out;
+	}
+
 	/* If the user specifies a length, check its sanity */
 	if (len) {
-		if (len > finfo.size) {
+		if (len > finfo.size - offset) {
 			ret = -EINVAL;
 			goto out;
 		}
-
-		finfo.size = len;
 	} else {
-		len = finfo.size;
+		len = finfo.size - offset;
 	}
 
-	if (datablk_count) {
-		data_offset = finfo.start;
-		datablock = malloc(get_unaligned_le32(&sblk->block_size));
-		if (!datablock) {
-			ret = -ENOMEM;
-			goto out;
-		}
-	}
-
-	for (j = 0; j < datablk_count; j++) {
-		char *data_buffer;
+	/*
+	 * Use the block list to seek straight to the data block holding
+	 * 'offset': only the compressed sizes of the preceding blocks are
+	 * needed, none of them is read.
+	 */
+	blk_size = get_unaligned_le32(&sblk->block_size);
+	first_blk = lldiv(offset, blk_size);
+	blk_offset = offset - (u64)first_blk * blk_size;
+	data_offset = finfo.start;
+	for (j = 0; j < first_blk && j < datablk_count; j++)
+		data_offset += SQFS_BLOCK_SIZE(finfo.blk_sizes[j]);
 
-		start = lldiv(data_offset, ctxt.cur_dev->blksz);
-		table_size = SQFS_BLOCK_SIZE(finfo.blk_sizes[j]);
-		table_offset = data_offset - (start * ctxt.cur_dev->blksz);
-		n_blks = DIV_ROUND_UP(table_size + table_offset,
-				      ctxt.cur_dev->blksz);
+	for (j = first_blk; j < datablk_count && *actread < len; j++) {
+		n = min_t(u64, blk_size - blk_offset, len - *actread);
 
-		/* Don't load any data for sparse blocks */
 		if (finfo.blk_sizes[j] == 0) {
-			n_blks = 0;
-			table_offset = 0;
-			data_buffer = NULL;
-			data = NULL;
-		} else {
-			data_buffer = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
-
-			if (!data_buffer) {
-				ret = -ENOMEM;
-				goto out;
-			}
-
-			ret = sqfs_disk_read(start, n_blks, data_buffer);
-			if (ret < 0) {
-				/*
-				 * Possible causes: too many data blocks or too large
-				 * SquashFS block size. Tip: re-compile the SquashFS
-				 * image with mksquashfs's -b <block_size> option.
-				 */
-				printf("Error: too many data blocks to be read.\n");
+			/* This is a sparse block */
+			memset(buf + *actread, 0, n);
+		} else if (!blk_offset && n == blk_size) {
+			/* Whole block requested, decompress it in place */
+			dest_len = blk_size;
+			ret = sqfs_load_block(data_offset, finfo.blk_sizes[j],
+					      buf + *actread, &dest_len);
+			if (ret) {
+				printf("Error: failed to read data block %d.\n",
+				       j);
 				goto out;
 			}
-
-			data = data_buffer + table_offset;
-		}
-
-		/* Load the data */
-		if (finfo.blk_sizes[j] == 0) {
-			/* This is a sparse block */
-			sparse_size = get_unaligned_le32(&sblk->block_size);
-			if ((*actread + sparse_size) > len)
-				sparse_size = len - *actread;
-			memset(buf + *actread, 0, sparse_size);
-			*actread += sparse_size;
-		} else if (SQFS_COMPRESSED_BLOCK(finfo.blk_sizes[j])) {
-			dest_len = get_unaligned_le32(&sblk->block_size);
-			ret = sqfs_decompress(&ctxt, datablock, &dest_len,
-					      data, table_size);
+		} else {
+			/* Head or tail of the requested range */
+			ret = sqfs_cache_block(data_offset, finfo.blk_sizes[j],
+					       &entry);
 			if (ret)
 				goto out;
 
-			if ((*actread + dest_len) > len)
-				dest_len = len - *actread;
-			memcpy(buf + *actread, datablock, dest_len);
-			*actread += dest_len;
-		} else {
-			if ((*actread + table_size) > len)
-				table_size = len - *actread;
-			memcpy(buf + *actread, data, table_size);
-			*actread += table_size;
+			if (blk_offset + n > entry->len) {
+				ret = -EINVAL;
+				goto out;
+			}
+			memcpy(buf + *actread, entry->data + blk_offset, n);
 		}
 
-		data_offset += table_size;
-		free(data_buffer);
-		if (*actread >= len)
-			break;
+		*actread += n;
+		data_offset += SQFS_BLOCK_SIZE(finfo.blk_sizes[j]);
+		blk_offset = 0;
 	}
 
 	/*
-	 * There is no need to continue if the file is not fragmented.
+	 * There is no need to continue if the file is not fragmented or if the
+	 * requested range ends before its tail.
 	 */
-	if (!finfo.frag) {
+	if (!finfo.frag || *actread >= len) {
 		ret = 0;
 		goto out;
 	}
 
-	start = lldiv(frag_entry.start, ctxt.cur_dev->blksz);
-	table_size = SQFS_BLOCK_SIZE(frag_entry.size);
-	table_offset = frag_entry.start - (start * ctxt.cur_dev->blksz);
-	n_blks = DIV_ROUND_UP(table_size + table_offset, ctxt.cur_dev->blksz);
-
-	if (__builtin_mul_overflow(n_blks, ctxt.cur_dev->blksz, &buf_size)) {
-		ret = -EINVAL;
+	/* The tail of the file lives at 'finfo.offset' in a fragment block */
+	ret = sqfs_cache_block(frag_entry.start, frag_entry.size, &entry);
+	if (ret)
 		goto out;
-	}
-
-	fragment = malloc_cache_aligned(buf_size);
 
-	if (!fragment) {
-		ret = -ENOMEM;
+	frag_offset = finfo.offset + offset + *actread -
+		(u64)datablk_count * blk_size;
+	if (frag_offset + len - *actread > entry->len) {
+		ret = -EINVAL;
 		goto out;
 	}
 
-	ret = sqfs_disk_read(start, n_blks, fragment);
-	if (ret < 0)
-		goto out;
-
-	/* File compressed and fragmented */
-	if (finfo.frag && finfo.comp) {
-		dest_len = get_unaligned_le32(&sblk->block_size);
-		fragment_block = malloc(dest_len);
-		if (!fragment_block) {
-			ret = -ENOMEM;
-			goto out;
-		}
-
-		ret = sqfs_decompress(&ctxt, fragment_block, &dest_len,
-				      (void *)fragment  + table_offset,
-				      frag_entry.size);
-		if (ret) {
-			free(fragment_block);
-			goto out;
-		}
-
-		memcpy(buf + *actread, &fragment_block[finfo.offset], finfo.size - *actread);
-		*actread = finfo.size;
-
-		free(fragment_block);
-
-	} else if (finfo.frag && !finfo.comp) {
-		fragment_block = (void *)fragment + table_offset;
-
-		memcpy(buf + *actread, &fragment_block[finfo.offset], finfo.size - *actread);
-		*actread = finfo.size;
-	}
+	memcpy(buf + *actread, entry->data + frag_offset, len - *actread);
+	*actread = len;
 
 out:
-	free(fragment);
-	free(datablock);
 	free(file);
 	free(dir);
 	free(finfo.blk_sizes);
@@ -1800,6 +1924,7 @@ int sqfs_size(const char *filename, loff_t *size)
 
 void sqfs_close(void)
 {
+	sqfs_cache_free();
 	sqfs_decompressor_cleanup(&ctxt);
 	free(ctxt.sblk);
 	ctxt.sblk = NULL;
@@ -1814,8 +1939,6 @@ void sqfs_closedir(struct fs_dir_stream *dirs)
 		return;
 
 	sqfs_dirs = (struct squashfs_dir_stream *)dirs;
-	free(sqfs_dirs->inode_table);
-	free(sqfs_dirs->dir_table);
 	free(sqfs_dirs->dir_header);
 	free(sqfs_dirs);
 }
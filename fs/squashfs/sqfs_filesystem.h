@@ -71,6 +71,29 @@ struct squashfs_super_block {
 	__le64 export_table_start;
 };
 
+struct squashfs_cache_entry {
+	/* Byte offset of the block in the image, used as the lookup key */
+	u64 start;
+	/* Number of valid bytes in 'data', zero for an unused entry */
+	u32 len;
+	/* Last use, the entry with the lowest stamp is recycled first */
+	u32 stamp;
+	/* Decompressed content of the block */
+	unsigned char *data;
+};
+
+struct squashfs_cache {
+	/* Decompressed inode and directory tables */
+	unsigned char *inode_table;
+	unsigned char *dir_table;
+	/* Position of each metadata block in the directory table */
+	u32 *dir_pos_list;
+	int dir_metablks;
+	/* LRU of decompressed data, fragment and fragment-table blocks */
+	struct squashfs_cache_entry blocks[CONFIG_SQUASHFS_BLOCK_CACHE_SIZE];
+	u32 stamp;
+};
+
 struct squashfs_ctxt {
 	struct disk_partition cur_part_info;
 	struct blk_desc *cur_dev;
@@ -78,6 +101,8 @@ struct squashfs_ctxt {
 #if IS_ENABLED(CONFIG_ZSTD)
 	void *zstd_workspace;
 #endif
+	/* Kept from the first lookup until sqfs_close() */
+	struct squashfs_cache cache;
 };
 
 struct squashfs_directory_index {
@@ -272,7 +297,8 @@ struct squashfs_dir_stream {
 	struct squashfs_ldir_inode i_ldir;
 	/*
 	 * References to the tables' beginnings. They are assigned in
-	 * sqfs_opendir() and freed in sqfs_closedir().
+	 * sqfs_opendir() and owned by the context cache, which frees them in
+	 * sqfs_close().
 	 */
 	unsigned char *inode_table;
 	unsigned char *dir_table;
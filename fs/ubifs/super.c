@@ -2290,6 +2290,10 @@ static int ubifs_fill_super(struct super_block *sb, void *data, int silent)
 		goto out_bdi;
 
 	sb->s_bdi = &c->bdi;
+#else
+	/* There are no mount options, so bulk-read is chosen when building */
+	if (IS_ENABLED(CONFIG_UBIFS_BULK_READ))
+		c->bulk_read = 1;
 #endif
 	sb->s_fs_info = c;
 	sb->s_magic = UBIFS_SUPER_MAGIC;
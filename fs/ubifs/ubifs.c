@@ -11,11 +11,14 @@
  *          Adrian Hunter
  */
 
+#include <display_options.h>
+#include <div64.h>
 #include <env.h>
 #include <gzip.h>
 #include <log.h>
 #include <malloc.h>
 #include <memalign.h>
+#include <time.h>
 #include <asm/global_data.h>
 #include "ubifs.h"
 #include <part.h>
@@ -721,23 +724,14 @@ static inline void *kmap(struct page *page)
 	return page->addr;
 }
 
-static int read_block(struct inode *inode, void *addr, unsigned int block,
-		      struct ubifs_data_node *dn)
+/* Unpacks the data node @dn for @block into @addr, zeroing the rest of it */
+static int read_data_node(struct ubifs_info *c, struct inode *inode,
+			  void *addr, unsigned int block,
+			  struct ubifs_data_node *dn)
 {
-	struct ubifs_info *c = inode->i_sb->s_fs_info;
 	int err, len, out_len;
-	union ubifs_key key;
 	unsigned int dlen;
 
-	data_key_init(c, &key, inode->i_ino, block);
-	err = ubifs_tnc_lookup(c, &key, dn);
-	if (err) {
-		if (err == -ENOENT)
-			/* Not found, so it must be a hole */
-			memset(addr, 0, UBIFS_BLOCK_SIZE);
-		return err;
-	}
-
 	ubifs_assert(le64_to_cpu(dn->ch.sqnum) > ubifs_inode(inode)->creat_sqnum);
 
 	len = le32_to_cpu(dn->size);
@@ -768,6 +762,85 @@ dump:
 	return -EINVAL;
 }
 
+static int read_block(struct inode *inode, void *addr, unsigned int block,
+		      struct ubifs_data_node *dn)
+{
+	struct ubifs_info *c = inode->i_sb->s_fs_info;
+	union ubifs_key key;
+	int err;
+
+	data_key_init(c, &key, inode->i_ino, block);
+	err = ubifs_tnc_lookup(c, &key, dn);
+	if (err) {
+		if (err == -ENOENT)
+			/* Not found, so it must be a hole */
+			memset(addr, 0, UBIFS_BLOCK_SIZE);
+		return err;
+	}
+
+	return read_data_node(c, inode, addr, block, dn);
+}
+
+/**
+ * bulk_read() - read a run of blocks with a single flash read
+ *
+ * This looks up the data nodes which follow one another in the same LEB,
+ * starting at @block, reads them all at once and unpacks them straight into
+ * @addr. Any holes between them are zeroed.
+ *
+ * @c: UBIFS file-system description object
+ * @inode: inode to read
+ * @addr: where to put the data for @block
+ * @block: first block to read
+ * @max_blocks: most blocks to read, each of which must fit whole in @addr
+ * Return: number of blocks read, 0 if there is no run starting at @block, or
+ * -ve on error
+ */
+static int bulk_read(struct ubifs_info *c, struct inode *inode, void *addr,
+		     unsigned int block, int max_blocks)
+{
+	struct bu_info *bu = &c->bu;
+	unsigned int next;
+	void *buf;
+	int err, i, n;
+
+	mutex_lock(&c->bu_mutex);
+	data_key_init(c, &bu->key, inode->i_ino, block);
+	bu->buf_len = c->max_bu_buf_len;
+	err = ubifs_tnc_get_bu_keys(c, bu);
+	if (!err && bu->cnt < 2)
+		goto out;	/* Not worth it, so read a block at a time */
+	if (!err)
+		err = ubifs_tnc_bulk_read(c, bu);
+	if (err == -EAGAIN) {
+		/* A race with GC, so the buffer is stale: read block by block */
+		err = 0;
+		goto out;
+	}
+	if (err)
+		goto out;
+
+	buf = bu->buf;
+	for (i = 0, n = 0; i < max_blocks && n < bu->cnt; i++) {
+		next = key_block(c, &bu->zbranch[n].key);
+		if (next > block + i) {
+			/* Not in the index, so it must be a hole */
+			memset(addr, 0, UBIFS_BLOCK_SIZE);
+		} else {
+			err = read_data_node(c, inode, addr, block + i, buf);
+			if (err)
+				goto out;
+			buf += ALIGN(bu->zbranch[n++].len, 8);
+		}
+		addr += UBIFS_BLOCK_SIZE;
+	}
+	err = i;
+out:
+	mutex_unlock(&c->bu_mutex);
+
+	return err;
+}
+
 static int do_readpage(struct ubifs_info *c, struct inode *inode,
 		       struct page *page, int last_block_size)
 {
@@ -889,7 +962,7 @@ int ubifs_read(const char *filename, void *buf, loff_t offset,
 	struct inode *inode;
 	struct page page;
 	int err = 0;
-	int i;
+	int i, n;
 	int count;
 	int last_block_size = 0;
 
@@ -943,19 +1016,36 @@ int ubifs_read(const char *filename, void *buf, loff_t offset,
 	page.addr = buf;
 	page.index = offset / PAGE_SIZE;
 	page.inode = inode;
-	for (i = 0; i < count; i++) {
+	for (i = 0; i < count; i += n) {
 		/*
-		 * Make sure to not read beyond the requested size
+		 * Read runs of whole blocks in one go, leaving the last block
+		 * to do_readpage() so that nothing is written beyond it
 		 */
-		if (((i + 1) == count) && (size < inode->i_size))
-			last_block_size = size - (i * PAGE_SIZE);
+		n = 0;
+		if (c->bulk_read && c->bu.buf && i + 1 < count) {
+			n = bulk_read(c, inode, page.addr, page.index,
+				      count - 1 - i);
+			if (n < 0) {
+				err = n;
+				break;
+			}
+		}
 
-		err = do_readpage(c, inode, &page, last_block_size);
-		if (err)
-			break;
+		if (!n) {
+			/*
+			 * Make sure to not read beyond the requested size
+			 */
+			if (((i + 1) == count) && (size < inode->i_size))
+				last_block_size = size - (i * PAGE_SIZE);
 
-		page.addr += PAGE_SIZE;
-		page.index++;
+			err = do_readpage(c, inode, &page, last_block_size);
+			if (err)
+				break;
+			n = 1;
+		}
+
+		page.addr += n * PAGE_SIZE;
+		page.index += n;
 	}
 
 	if (err) {
@@ -980,14 +1070,23 @@ void ubifs_close(void)
 int ubifs_load(char *filename, unsigned long addr, u32 size)
 {
 	loff_t actread;
+	ulong time;
 	int err;
 
 	printf("Loading file '%s' to addr 0x%08lx...\n", filename, addr);
 
+	time = get_timer(0);
 	err = ubifs_read(filename, (void *)(uintptr_t)addr, 0, size, &actread);
+	time = get_timer(time);
 	if (err == 0) {
 		env_set_hex("filesize", actread);
-		printf("Done\n");
+		printf("%llu bytes read in %lu ms", actread, time);
+		if (time > 0) {
+			puts(" (");
+			print_size(div_u64(actread, time) * 1000, "/s");
+			puts(")");
+		}
+		puts("\nDone\n");
 	}
 
 	return err;
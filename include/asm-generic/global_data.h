@@ -242,6 +242,15 @@ struct global_data {
 	 * @uclass_root_s.
 	 */
 	struct list_head *uclass_root;
+# if CONFIG_IS_ENABLED(DM_INDEX)
+	/**
+	 * @uclass_tbl: uclass for each uclass ID, NULL if it does not exist
+	 *
+	 * This is only allocated after relocation. Before that, the list at
+	 * @uclass_root is searched instead.
+	 */
+	struct uclass **uclass_tbl;
+# endif
 # if CONFIG_IS_ENABLED(OF_PLATDATA_DRIVER_RT)
 	/** @dm_driver_rt: Dynamic info about the driver */
 	struct driver_rt *dm_driver_rt;
@@ -475,6 +484,14 @@ static_assert(sizeof(struct global_data) == GD_SIZE);
 #define gd_set_of_root(_root)
 #endif
 
+#if CONFIG_IS_ENABLED(DM_INDEX)
+#define gd_uclass_tbl()			gd->uclass_tbl
+#define gd_set_uclass_tbl(tbl)		gd->uclass_tbl = (tbl)
+#else
+#define gd_uclass_tbl()			((struct uclass **)NULL)
+#define gd_set_uclass_tbl(tbl)
+#endif
+
 #if CONFIG_IS_ENABLED(OF_PLATDATA_DRIVER_RT)
 #define gd_set_dm_driver_rt(dyn)	gd->dm_driver_rt = dyn
 #define gd_dm_driver_rt()		gd->dm_driver_rt
@@ -69,6 +69,8 @@ struct blk_desc {
 	bool	lba48;
 	unsigned char	atapi;		/* Use ATAPI protocol */
 	unsigned char	bb;		/* Use bounce buffer */
+	/* write through the block cache, for crash safety */
+	bool		cache_sync;
 	lbaint_t	lba;		/* number of blocks */
 	unsigned long	blksz;		/* block size */
 	int		log2blksz;	/* for convenience: log2(blksz) */
@@ -107,6 +109,18 @@ struct blk_desc {
 #define PAD_TO_BLOCKSIZE(size, blk_desc) \
 	(PAD_SIZE(size, blk_desc->blksz))
 
+/**
+ * typedef blkcache_write_t - write blocks back to a device
+ *
+ * @priv: private data passed to blkcache_write()
+ * @start: starting block number
+ * @blkcnt: number of blocks to write
+ * @buffer: data to write
+ * Return: number of blocks written, or -ve on error
+ */
+typedef long (*blkcache_write_t)(void *priv, lbaint_t start, lbaint_t blkcnt,
+				 const void *buffer);
+
 #if CONFIG_IS_ENABLED(BLOCK_CACHE)
 /**
  * blkcache_read() - attempt to read a set of blocks from cache
@@ -118,7 +132,11 @@ struct blk_desc {
  * @param blksz - size in bytes of each block
  * @param buffer - buffer to contain cached data
  *
- * Return: - 1 if block returned from cache, 0 otherwise.
+ * On a miss, any dirty blocks in the range are written back first, so that the
+ * device returns up-to-date data.
+ *
+ * Return: - 1 if block returned from cache, 0 otherwise, -ve on error writing
+ * back dirty blocks
  */
 int blkcache_read(int iftype, int dev,
 		  lbaint_t start, lbaint_t blkcnt,
@@ -140,10 +158,67 @@ void blkcache_fill(int iftype, int dev,
 		   lbaint_t start, lbaint_t blkcnt,
 		   unsigned long blksz, void const *buffer);
 
+/**
+ * blkcache_write() - defer a write to a block device
+ *
+ * With CONFIG_BLOCK_CACHE_WRITEBACK, stores the blocks in the cache and marks
+ * them dirty. They reach the device when evicted, when read back from the
+ * device, or on blkcache_flush(). Other writes must be preceded by
+ * blkcache_flush() and blkcache_invalidate() to keep the device consistent.
+ *
+ * @param iftype - uclass_id_x for type of device
+ * @param dev - device index of particular type
+ * @param start - starting block number
+ * @param blkcnt - number of blocks to write
+ * @param blksz - size in bytes of each block
+ * @param buffer - data to write
+ * @param write - function writing dirty blocks back to the device
+ * @param priv - private data for @write
+ *
+ * Return: 1 if the write was deferred, 0 if the caller must write the blocks
+ * to the device, -ve on error writing back evicted blocks
+ */
+int blkcache_write(int iftype, int dev,
+		   lbaint_t start, lbaint_t blkcnt,
+		   unsigned long blksz, void const *buffer,
+		   blkcache_write_t write, void *priv);
+
+/**
+ * blkcache_flush() - write all dirty blocks of a device back to it
+ *
+ * Blocks are written in block order, with contiguous ones merged into a
+ * single write.
+ *
+ * @iftype - UCLASS_ID_ for type of device, or -1 for any
+ * @dev - device index of particular type, if @iftype is not -1
+ * Return: 0 if OK, -ve on error
+ */
+int blkcache_flush(int iftype, int dev);
+
+/**
+ * blkcache_readahead() - size a read that missed the cache
+ *
+ * Tracks the access pattern of the device and, while reads are sequential,
+ * returns a read-ahead window that grows with each miss so that many small
+ * sequential reads turn into a few large ones.
+ *
+ * @param iftype - uclass_id_x for type of device
+ * @param dev - device index of particular type
+ * @param start - starting block number of the read
+ * @param blkcnt - number of blocks requested
+ * @param blksz - size in bytes of each block
+ *
+ * Return: number of blocks to read from @start, at least @blkcnt
+ */
+lbaint_t blkcache_readahead(int iftype, int dev, lbaint_t start,
+			    lbaint_t blkcnt, unsigned long blksz);
+
 /**
  * blkcache_invalidate() - discard the cache for a set of blocks
  * because of a write or device (re)initialization.
  *
+ * Dirty blocks are written back first.
+ *
  * @iftype - UCLASS_ID_ for type of device, or -1 for any
  * @dev - device index of particular type, if @iftype is not -1
  */
@@ -163,7 +238,10 @@ void blkcache_configure(unsigned blocks, unsigned entries);
 struct block_cache_stats {
 	unsigned hits;
 	unsigned misses;
+	unsigned readaheads; /* misses extended by read-ahead */
+	unsigned writebacks; /* device writes of dirty blocks */
 	unsigned entries; /* current entry count */
+	unsigned dirty; /* current count of entries with dirty blocks */
 	unsigned max_blocks_per_entry;
 	unsigned max_entries;
 };
@@ -191,6 +269,25 @@ static inline void blkcache_fill(int iftype, int dev,
 				 lbaint_t start, lbaint_t blkcnt,
 				 unsigned long blksz, void const *buffer) {}
 
+static inline int blkcache_write(int iftype, int dev,
+				 lbaint_t start, lbaint_t blkcnt,
+				 unsigned long blksz, void const *buffer,
+				 blkcache_write_t write, void *priv)
+{
+	return 0;
+}
+
+static inline int blkcache_flush(int iftype, int dev)
+{
+	return 0;
+}
+
+static inline lbaint_t blkcache_readahead(int iftype, int dev, lbaint_t start,
+					  lbaint_t blkcnt, unsigned long blksz)
+{
+	return blkcnt;
+}
+
 static inline void blkcache_invalidate(int iftype, int dev) {}
 
 static inline void blkcache_free(void) {}
@@ -291,6 +388,7 @@ unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 			 lbaint_t blkcnt, const void *buffer);
 unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
 			 lbaint_t blkcnt);
+int blk_dflush(struct blk_desc *block_dev);
 
 #endif /* BLK */
 
@@ -331,6 +429,14 @@ long blk_write(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
  */
 long blk_erase(struct udevice *dev, lbaint_t start, lbaint_t blkcnt);
 
+/**
+ * blk_flush() - Write blocks held back by the block cache to the device
+ *
+ * @dev: Device to flush
+ * @return 0 if OK, -ve on error
+ */
+int blk_flush(struct udevice *dev);
+
 /**
  * blk_find_device() - Find a block device
  *
@@ -559,6 +665,11 @@ static inline ulong blk_derase(struct blk_desc *block_dev, lbaint_t start,
 	return block_dev->block_erase(block_dev, start, blkcnt);
 }
 
+static inline int blk_dflush(struct blk_desc *block_dev)
+{
+	return 0;
+}
+
 /**
  * struct blk_driver - Driver for block interface types
  *
@@ -283,6 +283,38 @@ void bootdev_list_hunters(struct bootstd_priv *std);
  */
 int bootdev_hunt(const char *spec, bool show);
 
+/**
+ * bootdev_get_hunter_name() - Get the name of the hunter which finds a bootdev
+ *
+ * This looks at the bootdev and its parents for one whose uclass has a hunter,
+ * so that the bootdev can be found again by hunting only that uclass
+ *
+ * @dev: Bootdev to check
+ * Returns: uclass name to pass to bootdev_hunt(), e.g. "usb", or NULL if no
+ * hunter is needed to find the bootdev
+ */
+const char *bootdev_get_hunter_name(struct udevice *dev);
+
+/**
+ * bootdev_hunt_expired() - Check whether hunters have run out of time
+ *
+ * With CONFIG_BOOTDEV_HUNT_PARALLEL, hunters which are run together must all
+ * finish within CONFIG_BOOTDEV_HUNT_TIMEOUT milliseconds, if it is not 0. A
+ * hunter which waits for something, e.g. a USB port to connect, should call
+ * this each time around its wait loop and stop waiting once it returns true,
+ * keeping the devices found so far.
+ *
+ * Return: true if the hunters' time is up, false if not or if not hunting
+ */
+#if CONFIG_IS_ENABLED(BOOTSTD) && IS_ENABLED(CONFIG_BOOTDEV_HUNT_PARALLEL)
+bool bootdev_hunt_expired(void);
+#else
+static inline bool bootdev_hunt_expired(void)
+{
+	return false;
+}
+#endif
+
 /**
  * bootdev_hunt_prio() - Hunt for bootdevs of a particular priority
  *
@@ -173,6 +173,8 @@ struct bootflow_img {
  * with things like "mmc1")
  * @BOOTFLOWIF_SINGLE_PARTITION: (internal) Scan one partition in media device
  * (used with things like "mmc1:3")
+ * @BOOTFLOWIF_CACHED: (internal) Scanning the bootflow which was last booted,
+ * before falling back to a full scan (see CONFIG_BOOTFLOW_CACHE)
  */
 enum bootflow_iter_flags_t {
 	BOOTFLOWIF_FIXED		= 1 << 0,
@@ -190,6 +192,7 @@ enum bootflow_iter_flags_t {
 	BOOTFLOWIF_SINGLE_UCLASS	= 1 << 18,
 	BOOTFLOWIF_SINGLE_MEDIA		= 1 << 19,
 	BOOTFLOWIF_SINGLE_PARTITION	= 1 << 20,
+	BOOTFLOWIF_CACHED		= 1 << 21,
 };
 
 /**
@@ -270,6 +273,8 @@ enum {
  * @pending_bootdev: if non-NULL, bootdev which will be used when the global
  * bootmeths are done
  * @pending_method_flags: method flags which will be used with @pending_bootdev
+ * @scan_flags: flags passed to bootflow_scan_first(), used to start the full
+ * scan when BOOTFLOWIF_CACHED is set
  */
 struct bootflow_iter {
 	int flags;
@@ -295,6 +300,7 @@ struct bootflow_iter {
 	uint methods_done;
 	struct udevice *pending_bootdev;
 	int pending_method_flags;
+	int scan_flags;
 };
 
 /**
@@ -435,6 +441,18 @@ int bootflow_read_all(struct bootflow *bflow);
  */
 int bootflow_run_boot(struct bootflow_iter *iter, struct bootflow *bflow);
 
+/**
+ * bootflow_cache_save() - Record a bootflow which is about to be booted
+ *
+ * The record is used by the next bootflow_scan_first() to try this bootflow
+ * before any others (see CONFIG_BOOTFLOW_CACHE). The environment is only saved
+ * if the record has changed, so booting the same bootflow again does not write
+ * anything
+ *
+ * @bflow: Bootflow to record
+ */
+void bootflow_cache_save(struct bootflow *bflow);
+
 /**
  * bootflow_state_get_name() - Get the name of a bootflow state
  *
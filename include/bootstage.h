@@ -213,6 +213,9 @@ enum bootstage_id {
 	BOOTSTAGE_ID_ACCUM_FSP_M,
 	BOOTSTAGE_ID_ACCUM_FSP_S,
 	BOOTSTAGE_ID_ACCUM_MMAP_SPI,
+	BOOTSTAGE_ID_ACCUM_FIT_HASH,
+	BOOTSTAGE_ID_ACCUM_FIT_COPY,
+	BOOTSTAGE_ID_ACCUM_DM_LAZY,
 
 	/* a few spare for the user, from here */
 	BOOTSTAGE_ID_USER,
@@ -13,6 +13,7 @@
 #include <event.h>
 #include <linker_lists.h>
 #include <dm/ofnode.h>
+#include <dm/uclass-id.h>
 
 struct device_node;
 struct driver_info;
@@ -185,7 +186,8 @@ int device_of_to_plat(struct udevice *dev);
  * device_probe() - Probe a device, activating it
  *
  * Activate a device (if not yet activated) so that it is ready for use.
- * All its parents are probed first.
+ * All its parents are probed first. With CONFIG_DM_PROBE_ASYNC, if another
+ * thread is probing the device, this waits until that thread is done.
  *
  * @dev: Pointer to device to probe
  * Return: 0 if OK, -ve on error
@@ -437,4 +439,115 @@ static inline int device_notify(const struct udevice *dev, enum event_t type)
 	return 0;
 #endif
 }
+
+#if CONFIG_IS_ENABLED(DM_LAZY_BIND)
+/**
+ * dm_lazy_reset() - Forget all nodes whose binding was deferred
+ *
+ * This is called when driver model is set up.
+ */
+void dm_lazy_reset(void);
+
+/**
+ * dm_lazy_enable() - Turn deferred binding on or off
+ *
+ * This only affects scans of the device tree done after the call. Binding is
+ * deferred by default. Driver model tests turn it off while they run, since
+ * they expect all devices to be bound in the order of the device tree.
+ *
+ * @enable: true to defer binding leaf nodes, false to bind them all
+ */
+void dm_lazy_enable(bool enable);
+
+/**
+ * dm_lazy_pause() - Stop lookups from binding deferred nodes
+ *
+ * This is used while scanning the device tree, so that devices bound during
+ * the scan do not cause the deferred nodes to be bound straight away. Calls
+ * can be nested and each one must be matched by a call to dm_lazy_resume().
+ */
+void dm_lazy_pause(void);
+
+/**
+ * dm_lazy_resume() - Undo a call to dm_lazy_pause()
+ */
+void dm_lazy_resume(void);
+
+/**
+ * dm_lazy_defer() - Record a device tree node instead of binding it
+ *
+ * Only leaf nodes at the top level or on a simple bus, which are matched by a
+ * driver and are not needed before relocation, are deferred. Nodes whose
+ * driver has a bind() method or whose uclass has a post_bind() method, other
+ * than dm_scan_fdt_dev(), are bound straight away, since these methods may
+ * bind more devices or mark the device to be probed after binding.
+ *
+ * @parent: Device the node should be bound to
+ * @node: Device tree node to check
+ * Return: true if binding the node is deferred, false if the caller must bind
+ * it now
+ */
+bool dm_lazy_defer(struct udevice *parent, ofnode node);
+
+/**
+ * dm_lazy_bind_uclass() - Bind the deferred nodes of a uclass
+ *
+ * This is called by uclass_find(), so whenever the uclass is looked up.
+ *
+ * @id: ID of the uclass
+ */
+void dm_lazy_bind_uclass(enum uclass_id id);
+
+/**
+ * dm_lazy_bind_node() - Bind a device tree node if its binding was deferred
+ *
+ * @node: Device tree node
+ */
+void dm_lazy_bind_node(ofnode node);
+
+/**
+ * dm_lazy_bind_all() - Bind all nodes whose binding was deferred
+ *
+ * This is used to show the whole tree of devices.
+ */
+void dm_lazy_bind_all(void);
+
+/**
+ * dm_lazy_unbind() - Forget the deferred child nodes of a device
+ *
+ * This is called when the device is unbound.
+ *
+ * @parent: Parent device
+ */
+void dm_lazy_unbind(struct udevice *parent);
+
+/**
+ * dm_lazy_get_stats() - Get the number of deferred nodes
+ *
+ * @deferredp: Returns the number of nodes whose binding was deferred
+ * @boundp: Returns how many of those have been bound since
+ */
+void dm_lazy_get_stats(int *deferredp, int *boundp);
+#else
+static inline void dm_lazy_reset(void) {}
+static inline void dm_lazy_enable(bool enable) {}
+static inline void dm_lazy_pause(void) {}
+static inline void dm_lazy_resume(void) {}
+
+static inline bool dm_lazy_defer(struct udevice *parent, ofnode node)
+{
+	return false;
+}
+
+static inline void dm_lazy_bind_uclass(enum uclass_id id) {}
+static inline void dm_lazy_bind_node(ofnode node) {}
+static inline void dm_lazy_bind_all(void) {}
+static inline void dm_lazy_unbind(struct udevice *parent) {}
+
+static inline void dm_lazy_get_stats(int *deferredp, int *boundp)
+{
+	*deferredp = 0;
+	*boundp = 0;
+}
+#endif /* DM_LAZY_BIND */
 #endif
@@ -20,6 +20,7 @@
 #include <linux/printk.h>
 
 struct driver_info;
+struct uthread;
 
 /* Driver is active (probed). Cleared when it is removed */
 #define DM_FLAG_ACTIVATED		(1 << 0)
@@ -87,6 +88,14 @@ struct driver_info;
  */
 #define DM_FLAG_PROBE_AFTER_BIND	(1 << 15)
 
+/*
+ * Device may be probed in the background by dm_autoprobe(), together with
+ * other such devices, when CONFIG_DM_PROBE_ASYNC is enabled. This suits
+ * devices whose probe spends most of its time waiting for hardware. It can be
+ * set on a U_BOOT_DRIVER() definition or per-device in the bind function.
+ */
+#define DM_FLAG_PROBE_ASYNC		(1 << 16)
+
 /*
  * One or multiple of these flags are passed to device_remove() so that
  * a selective device removal as specified by the remove-stage and the
@@ -169,6 +178,8 @@ enum {
  * @dma_offset: Offset between the physical address space (CPU's) and the
  *		device's bus address space
  * @iommu: IOMMU device associated with this device
+ * @prober: Thread which is probing this device, or NULL if none (do not access
+ *	outside driver model)
  */
 struct udevice {
 	const struct driver *driver;
@@ -201,6 +212,9 @@ struct udevice {
 #if CONFIG_IS_ENABLED(IOMMU)
 	struct udevice *iommu;
 #endif
+#if CONFIG_IS_ENABLED(DM_PROBE_ASYNC)
+	struct uthread *prober;
+#endif
 };
 
 static inline int dm_udevice_size(void)
@@ -64,6 +64,17 @@ int lists_bind_drivers(struct udevice *parent, bool pre_reloc_only);
 int lists_bind_fdt(struct udevice *parent, ofnode node, struct udevice **devp,
 		   struct driver *drv, bool pre_reloc_only);
 
+/**
+ * lists_driver_match_fdt() - find the driver for a device tree node
+ *
+ * This finds the driver that lists_bind_fdt() would try first for @node,
+ * without binding anything.
+ *
+ * @node: device tree node to check
+ * Return: pointer to driver, or NULL if no driver matches the node
+ */
+struct driver *lists_driver_match_fdt(ofnode node);
+
 /**
  * device_bind_driver() - bind a device to a driver
  *
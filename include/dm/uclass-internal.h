@@ -10,6 +10,7 @@
 #define _DM_UCLASS_INTERNAL_H
 
 #include <dm/ofnode.h>
+#include <linux/errno.h>
 
 /*
  * These next two macros DM_UCLASS_INST() and DM_UCLASS_REF() are only allowed
@@ -283,6 +284,99 @@ static inline int uclass_pre_unbind_device(struct udevice *dev) { return 0; }
 static inline int uclass_unbind_device(struct udevice *dev) { return 0; }
 #endif
 
+/**
+ * uclass_set_device_seq() - Change the sequence number of a bound device
+ *
+ * This must be used instead of setting @dev->seq_ directly, so that the
+ * uclass indexes are kept up to date
+ *
+ * @dev:	Pointer to the device
+ * @seq:	New sequence number, or -1 for none
+ * Return: 0 on success, -ve on error
+ */
+int uclass_set_device_seq(struct udevice *dev, int seq);
+
+#if CONFIG_IS_ENABLED(DM_INDEX)
+/**
+ * uclass_index_add() - Add a device to the indexes of its uclass
+ *
+ * @dev:	Pointer to the device
+ * Return: 0 on success, -ENOMEM if out of memory
+ */
+int uclass_index_add(struct udevice *dev);
+
+/**
+ * uclass_index_remove() - Remove a device from the indexes of its uclass
+ *
+ * If another device in the uclass has the same sequence number, node or
+ * phandle, it takes the place of @dev in the index
+ *
+ * @dev:	Pointer to the device, which may still be in the uclass list
+ */
+void uclass_index_remove(struct udevice *dev);
+
+/**
+ * uclass_index_free() - Free the indexes of a uclass
+ *
+ * @uc:	uclass to update
+ */
+void uclass_index_free(struct uclass *uc);
+
+/**
+ * uclass_index_find_seq() - Look up a device by sequence number
+ *
+ * @uc:		uclass to search
+ * @seq:	Sequence number to look for
+ * @devp:	Returns the first device in the uclass with that number
+ * Return: 0 if found, -ENODEV if not, -ENOSYS if the uclass has no index
+ */
+int uclass_index_find_seq(struct uclass *uc, int seq, struct udevice **devp);
+
+/**
+ * uclass_index_find_ofnode() - Look up a device by device tree node
+ *
+ * @uc:		uclass to search
+ * @node:	Node to look for, which must be valid
+ * @devp:	Returns the first device in the uclass with that node
+ * Return: 0 if found, -ENODEV if not, -ENOSYS if the uclass has no index
+ */
+int uclass_index_find_ofnode(struct uclass *uc, ofnode node,
+			     struct udevice **devp);
+
+/**
+ * uclass_index_find_phandle() - Look up a device by phandle
+ *
+ * @uc:		uclass to search
+ * @phandle:	phandle to look for
+ * @devp:	Returns the first device in the uclass whose node has it
+ * Return: 0 if found, -ENODEV if not, -ENOSYS if the uclass has no index
+ */
+int uclass_index_find_phandle(struct uclass *uc, uint phandle,
+			      struct udevice **devp);
+#else
+static inline int uclass_index_add(struct udevice *dev) { return 0; }
+static inline void uclass_index_remove(struct udevice *dev) {}
+static inline void uclass_index_free(struct uclass *uc) {}
+
+static inline int uclass_index_find_seq(struct uclass *uc, int seq,
+					struct udevice **devp)
+{
+	return -ENOSYS;
+}
+
+static inline int uclass_index_find_ofnode(struct uclass *uc, ofnode node,
+					   struct udevice **devp)
+{
+	return -ENOSYS;
+}
+
+static inline int uclass_index_find_phandle(struct uclass *uc, uint phandle,
+					    struct udevice **devp)
+{
+	return -ENOSYS;
+}
+#endif
+
 /**
  * uclass_pre_probe_device() - Deal with a device that is about to be probed
  *
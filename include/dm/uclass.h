@@ -30,12 +30,17 @@
  * @dev_head: List of devices in this uclass (devices are attached to their
  * uclass when their bind method is called)
  * @sibling_node: Next uclass in the linked list of uclasses
+ * @index: Indexes for looking up devices in this uclass, NULL if none has
+ * been bound yet (CONFIG_DM_INDEX only)
  */
 struct uclass {
 	void *priv_;
 	struct uclass_driver *uc_drv;
 	struct list_head dev_head;
 	struct list_head sibling_node;
+#if CONFIG_IS_ENABLED(DM_INDEX)
+	struct uclass_index *index;
+#endif
 };
 
 struct driver;
@@ -58,6 +58,14 @@ void dm_dump_static_driver_info(void);
  */
 void dm_dump_mem(struct dm_stats *stats);
 
+/**
+ * dm_dump_lazy() - Dump stats on device tree nodes whose binding is deferred
+ *
+ * This shows how many nodes were deferred, how many of those were bound
+ * since, and which uclasses the others belong to. See CONFIG_DM_LAZY_BIND.
+ */
+void dm_dump_lazy(void);
+
 #if CONFIG_IS_ENABLED(OF_PLATDATA_INST) && CONFIG_IS_ENABLED(READ_ONLY)
 void *dm_priv_to_rw(void *priv);
 #else
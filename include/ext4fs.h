@@ -176,6 +176,25 @@ struct ext_block_cache {
 	char *buf;
 	lbaint_t block;
 	int size;
+	/* buf belongs to the per-mount metadata cache */
+	bool shared;
+};
+
+/**
+ * struct ext_cache_stats - per-mount metadata cache statistics
+ *
+ * @hits:	lookups served from the cache
+ * @misses:	lookups that had to read the medium
+ * @evictions:	blocks dropped to make room for another one
+ * @entries:	blocks currently cached
+ * @max_entries: maximum number of cached blocks
+ */
+struct ext_cache_stats {
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long evictions;
+	int entries;
+	int max_entries;
 };
 
 extern struct ext2_data *ext4fs_root;
@@ -219,6 +238,18 @@ int ext4fs_uuid(char *uuid_str);
 void ext_cache_init(struct ext_block_cache *cache);
 void ext_cache_fini(struct ext_block_cache *cache);
 int ext_cache_read(struct ext_block_cache *cache, lbaint_t block, int size);
+int ext_cache_devread(lbaint_t block, int size, int byte_offset, int byte_len,
+		      char *buf);
+void ext_mcache_init(void);
+void ext_mcache_fini(void);
+void ext_mcache_invalidate(lbaint_t start, lbaint_t count);
+
+/**
+ * ext_cache_get_stats() - get and reset the metadata cache statistics
+ *
+ * @stats:	returns the statistics gathered since the previous call
+ */
+void ext_cache_get_stats(struct ext_cache_stats *stats);
 int ext4fs_opendir(const char *dirname, struct fs_dir_stream **dirsp);
 int ext4fs_readdir(struct fs_dir_stream *dirs, struct fs_dirent **dentp);
 void ext4fs_closedir(struct fs_dir_stream *dirs);
@@ -40,4 +40,39 @@ void fastboot_getvar_all(char *response);
  */
 void fastboot_getvar(char *cmd_parameter, char *response);
 
+struct sparse_storage;
+
+/**
+ * fastboot_stream_start() - Start writing a sparse image as it is downloaded
+ *
+ * @info: Storage to write to, which must stay valid until the download is
+ *	finished
+ * @part_name: Name of the partition, for messages
+ * @size: Number of bytes in the download
+ * @response: Pointer to fastboot response buffer
+ * Return: 0 on success, -ve on error
+ */
+int fastboot_stream_start(struct sparse_storage *info, const char *part_name,
+			  u32 size, char *response);
+
+/**
+ * fastboot_stream_write() - Write the next part of a download being streamed
+ *
+ * @data: Pointer to received fastboot data
+ * @len: Length of received fastboot data
+ * @response: Pointer to fastboot response buffer, set on error
+ * Return: 0 on success, -ve on error, after which the download is dropped
+ */
+int fastboot_stream_write(const void *data, u32 len, char *response);
+
+/**
+ * fastboot_stream_finish() - Finish writing a download being streamed
+ *
+ * This waits for all the data to be written.
+ *
+ * @response: Pointer to fastboot response buffer, set on error
+ * Return: 0 on success, -ve on error
+ */
+int fastboot_stream_finish(char *response);
+
 #endif
@@ -86,10 +86,27 @@ void fastboot_block_write_raw_image(struct blk_desc *dev_desc,
  * @info: Partition we're going write to
  * @part_name: Name of partition we're going write to
  * @buffer: Downloaded buffer pointer
+ * @alignment: erase alignment for discarding don't-care regions, 0 for none
  * @response: Pointer to fastboot response buffer
  */
 void fastboot_block_write_sparse_image(struct blk_desc *dev_desc, struct disk_partition *info,
-				       const char *part_name, void *buffer, char *response);
+				       const char *part_name, void *buffer, uint alignment,
+				       char *response);
+
+/**
+ * fastboot_block_stream_start() - Start streaming a sparse image to a partition
+ *
+ * @dev_desc: Block device we're going write to
+ * @info: Partition we're going write to
+ * @part_name: Name of partition we're going write to
+ * @alignment: erase alignment for discarding don't-care regions, 0 for none
+ * @size: Size of the image to be downloaded
+ * @response: Pointer to fastboot response buffer
+ * Return: 0 on success, -ve on error
+ */
+int fastboot_block_stream_start(struct blk_desc *dev_desc, struct disk_partition *info,
+				const char *part_name, uint alignment, u32 size,
+				char *response);
 
 /**
  * fastboot_block_flash_write() - Write image to block device for fastboot
@@ -102,4 +119,14 @@ void fastboot_block_write_sparse_image(struct blk_desc *dev_desc, struct disk_pa
 void fastboot_block_flash_write(const char *part_name, void *download_buffer,
 				u32 download_bytes, char *response);
 
+/**
+ * fastboot_block_stream() - Stream a sparse image to a block device partition
+ *
+ * @part_name: Named partition to write image to
+ * @size: Size of the image to be downloaded
+ * @response: Pointer to fastboot response buffer
+ * Return: 0 on success, -ve on error
+ */
+int fastboot_block_stream(const char *part_name, u32 size, char *response);
+
 #endif // _FB_BLOCK_H_
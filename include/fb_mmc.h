@@ -32,6 +32,16 @@ int fastboot_mmc_get_part_info(const char *part_name,
  */
 void fastboot_mmc_flash_write(const char *cmd, void *download_buffer,
 			      u32 download_bytes, char *response);
+/**
+ * fastboot_mmc_stream() - Stream a sparse image to eMMC for fastboot
+ *
+ * @cmd: Named partition to write image to
+ * @size: Size of the image to be downloaded
+ * @response: Pointer to fastboot response buffer
+ * Return: 0 on success, -ve on error
+ */
+int fastboot_mmc_stream(const char *cmd, u32 size, char *response);
+
 /**
  * fastboot_mmc_flash_erase() - Erase eMMC for fastboot
  *
@@ -49,6 +49,30 @@ int gunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp);
 int zunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp,
 	   int stoponerr, int offset);
 
+/**
+ * gunzip_stream() - Decompress gzipped data, passing on the input as it is used
+ *
+ * This works like gunzip() but feeds the input to the decompressor in chunks,
+ * passing each chunk to @consume just before it is decompressed. This allows
+ * the input to be hashed while it is still in the CPU cache. All of the input
+ * is passed to @consume, in order, unless an error occurs.
+ *
+ * @dst: Destination for uncompressed data
+ * @dstlen: Size of destination buffer
+ * @src: Source data to decompress
+ * @lenp: On entry, length of data at @src. On exit, number of bytes written to
+ * @dst
+ * @chunk: Maximum number of input bytes to pass to @consume at once
+ * @consume: Function called with each chunk of input
+ * @priv: Private data for @consume
+ * Return: 0 if OK, -ve on error
+ */
+int gunzip_stream(void *dst, int dstlen, unsigned char *src,
+		  unsigned long *lenp, unsigned long chunk,
+		  void (*consume)(void *priv, const void *buf,
+				  unsigned long len),
+		  void *priv);
+
 /**
  * gzwrite progress indicators: defined weak to allow board-specific
  * overrides:
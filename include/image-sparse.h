@@ -26,6 +26,11 @@ struct sparse_storage {
 				 lbaint_t blk,
 				 lbaint_t blkcnt);
 
+	/* Optional: discard a don't-care region instead of reserving it */
+	lbaint_t	(*discard)(struct sparse_storage *info,
+				   lbaint_t blk,
+				   lbaint_t blkcnt);
+
 	void		(*mssg)(const char *str, char *response);
 };
 
@@ -40,5 +45,98 @@ static inline int is_sparse_image(void *buf)
 	return 0;
 }
 
+/**
+ * enum sparse_stream_state - what a sparse image parser expects next
+ *
+ * @SPARSE_STREAM_HEADER: the image header
+ * @SPARSE_STREAM_CHUNK_HEADER: the header of a chunk
+ * @SPARSE_STREAM_CHUNK_DATA: the data of a chunk
+ * @SPARSE_STREAM_DONE: nothing, all chunks have been written
+ * @SPARSE_STREAM_ERROR: nothing, writing the image failed
+ */
+enum sparse_stream_state {
+	SPARSE_STREAM_HEADER,
+	SPARSE_STREAM_CHUNK_HEADER,
+	SPARSE_STREAM_CHUNK_DATA,
+	SPARSE_STREAM_DONE,
+	SPARSE_STREAM_ERROR,
+};
+
+/**
+ * struct sparse_stream - parser for a sparse image which arrives in pieces
+ *
+ * @info: storage to write to
+ * @part_name: name of the partition, for messages
+ * @state: what the parser expects next
+ * @header: image header
+ * @chunk: header of the current chunk
+ * @pos: number of bytes of the current header or chunk data seen so far
+ * @len: number of bytes in the current header or chunk data
+ * @blk: next block to write to
+ * @chunk_num: number of chunks finished
+ * @total_blocks: number of image blocks covered by the finished chunks
+ * @bytes_written: number of bytes written so far
+ * @fill_val: value of the current FILL chunk
+ * @buf: buffer aligned for DMA, holding RAW data waiting to be written
+ * @buf_len: number of bytes in @buf
+ * @fill_buf: buffer aligned for DMA, holding the value of a FILL chunk
+ */
+struct sparse_stream {
+	struct sparse_storage *info;
+	const char *part_name;
+	enum sparse_stream_state state;
+	sparse_header_t header;
+	chunk_header_t chunk;
+	u32 pos;
+	u32 len;
+	lbaint_t blk;
+	u32 chunk_num;
+	u32 total_blocks;
+	u64 bytes_written;
+	u32 fill_val;
+	u8 *buf;
+	size_t buf_len;
+	u32 *fill_buf;
+};
+
+/**
+ * sparse_stream_init() - Set up to write a sparse image in pieces
+ *
+ * @ss: parser to set up
+ * @info: storage to write to, which must stay valid until
+ *	sparse_stream_finish() is called
+ * @part_name: name of the partition, for messages
+ */
+void sparse_stream_init(struct sparse_stream *ss, struct sparse_storage *info,
+			const char *part_name);
+
+/**
+ * sparse_stream_write() - Write the next piece of a sparse image
+ *
+ * The pieces may be any size and need not line up with the headers or chunks
+ * in the image. Data after the last chunk is ignored.
+ *
+ * @ss: parser to use
+ * @data: next part of the image
+ * @len: number of bytes in @data
+ * @response: response buffer for messages
+ * Return: 0 if OK, -ve on error, after which the image cannot be written
+ */
+int sparse_stream_write(struct sparse_stream *ss, const void *data,
+			size_t len, char *response);
+
+/**
+ * sparse_stream_finish() - Finish writing a sparse image
+ *
+ * This frees the parser's buffers and checks that the whole image was
+ * written. It must be called once for each call to sparse_stream_init(), even
+ * if writing failed.
+ *
+ * @ss: parser to use
+ * @response: response buffer for messages
+ * Return: 0 if OK, -ve on error
+ */
+int sparse_stream_finish(struct sparse_stream *ss, char *response);
+
 int write_sparse_image(struct sparse_storage *info, const char *part_name,
 		       void *data, char *response);
@@ -1014,6 +1014,40 @@ int image_decomp(int comp, ulong load, ulong image_start, int type,
 		 void *load_buf, void *image_buf, ulong image_len,
 		 uint unc_len, ulong *load_end);
 
+/*
+ * Size of the pieces in which image data is passed on while it is loaded,
+ * small enough to still be in the CPU cache when it is used again
+ */
+#define IMAGE_STREAM_CHUNK	(32 << 10)
+
+/**
+ * image_decomp_stream() - decompress an image, passing on the input as it is used
+ *
+ * This works like image_decomp() but also passes all of the input to
+ * @consume, for example to hash it. Where the decompressor supports it, the
+ * input is passed in pieces just before they are decompressed, so that it is
+ * only brought into the CPU cache once. Otherwise it is passed all at once
+ * before decompression starts.
+ *
+ * @comp:	Compression algorithm that is used (IH_COMP_...)
+ * @load:	Destination load address in U-Boot memory
+ * @image_start Image start address (where we are decompressing from)
+ * @type:	OS type (IH_OS_...)
+ * @load_buf:	Place to decompress to
+ * @image_buf:	Address to decompress from
+ * @image_len:	Number of bytes in @image_buf to decompress
+ * @unc_len:	Available space for decompression
+ * @consume:	Function called with the input, or NULL
+ * @priv:	Private data for @consume
+ * Return: 0 if OK, -ve on error (BOOTM_ERR_...)
+ */
+int image_decomp_stream(int comp, ulong load, ulong image_start, int type,
+			void *load_buf, void *image_buf, ulong image_len,
+			uint unc_len, ulong *load_end,
+			void (*consume)(void *priv, const void *buf,
+					unsigned long len),
+			void *priv);
+
 /**
  * Set up properties in the FDT
  *
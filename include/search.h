@@ -47,6 +47,12 @@ struct hsearch_data {
 	struct env_entry_node *table;
 	unsigned int size;
 	unsigned int filled;
+/*
+ * Incremented each time an entry is added, changed or deleted, or the table is
+ * created or destroyed, so that callers can tell whether anything changed
+ * since they last looked, e.g. to avoid exporting the table again.
+ */
+	unsigned int changes;
 /*
  * Callback function which will check whether the given change for variable
  * "item" to "newval" may be applied or not, and possibly apply such change.
@@ -16,6 +16,7 @@
 #include <handoff.h>
 #include <image.h>
 #include <mmc.h>
+#include <linux/errno.h>
 
 struct blk_desc;
 struct legacy_img_hdr;
@@ -486,6 +487,44 @@ bool spl_load_simple_fit_skip_processing(void);
  */
 void *spl_load_simple_fit_fix_load(const void *fit);
 
+/**
+ * spl_fit_stream_load() - Decompress an image from a FIT while reading it
+ *
+ * The compressed data is read a window at a time and passed to the
+ * decompressor, which writes it straight to @dst. See CONFIG_SPL_FIT_STREAM
+ *
+ * @info:	Structure containing the information required to load data
+ * @offset:	Offset of the compressed data on the device
+ * @len:	Length of the compressed data
+ * @comp:	Compression type (IH_COMP_...)
+ * @dst:	Place to put the uncompressed image
+ * @sizep:	On entry, space available at @dst; on exit, size of the
+ *	uncompressed image
+ * Return: 0 if OK, -EAGAIN if the image cannot be streamed, in which case
+ *	nothing has been written to @dst, -EIO on error
+ */
+#if CONFIG_IS_ENABLED(FIT_STREAM)
+int spl_fit_stream_load(struct spl_load_info *info, ulong offset, ulong len,
+			int comp, void *dst, ulong *sizep);
+
+/**
+ * spl_fit_stream_set_window() - Set the size of the window used for reading
+ *
+ * This is set to CONFIG_SPL_FIT_STREAM_WINDOW at start-up. It is only changed
+ * by tests
+ *
+ * @size:	Size of the window in bytes
+ */
+void spl_fit_stream_set_window(ulong size);
+#else
+static inline int spl_fit_stream_load(struct spl_load_info *info,
+				      ulong offset, ulong len, int comp,
+				      void *dst, ulong *sizep)
+{
+	return -EAGAIN;
+}
+#endif
+
 /**
  * spl_load_simple_fit() - Loads a fit image from a device.
  * @spl_image:	Image description to set up
@@ -1174,7 +1213,8 @@ int spl_load_fit_image(struct spl_image_info *spl_image,
  */
 static inline bool spl_decompression_enabled(void)
 {
-	return IS_ENABLED(CONFIG_SPL_GZIP) || IS_ENABLED(CONFIG_SPL_LZMA);
+	return IS_ENABLED(CONFIG_SPL_GZIP) || IS_ENABLED(CONFIG_SPL_LZMA) ||
+		IS_ENABLED(CONFIG_SPL_LZ4) || IS_ENABLED(CONFIG_SPL_ZSTD);
 }
 
 /**
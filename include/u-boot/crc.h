@@ -99,6 +99,49 @@ uint32_t crc32_no_comp(uint32_t crc, const unsigned char *buf, uint len);
 void crc32_wd_buf(const uint8_t *input, uint ilen, uint8_t *output,
 		  uint chunk_sz);
 
+/**
+ * enum crc32_engine - ways of working out CRC32 and CRC32C
+ *
+ * crc32(), crc32_no_comp() and crc32c_cal() pick the fastest engine which is
+ * present. The others are there for testing and benchmarking.
+ *
+ * @CRC32_ENGINE_TABLE: one table lookup for each byte
+ * @CRC32_ENGINE_SLICE8: eight bytes at a time, using eight tables
+ *	(CONFIG_CRC32_SLICE_BY_8)
+ * @CRC32_ENGINE_HW: CPU instructions, if the CPU has them
+ * @CRC32_ENGINE_COUNT: number of engines
+ */
+enum crc32_engine {
+	CRC32_ENGINE_TABLE,
+	CRC32_ENGINE_SLICE8,
+	CRC32_ENGINE_HW,
+
+	CRC32_ENGINE_COUNT,
+};
+
+/**
+ * crc32_engine_present() - Check whether an engine can work out CRC32
+ *
+ * @engine: engine to check
+ * Return: true if present
+ */
+bool crc32_engine_present(enum crc32_engine engine);
+
+/**
+ * crc32_engine_no_comp() - Calculate the CRC32 with a given engine
+ *
+ * This is the same as crc32_no_comp(), but uses @engine, or the table if the
+ * engine is not present.
+ *
+ * @engine: engine to use
+ * @crc: Input crc to chain from a previous calculation
+ * @buf: Bytes to checksum
+ * @len: Number of bytes to checksum
+ * Return: checksum value
+ */
+uint32_t crc32_engine_no_comp(enum crc32_engine engine, uint32_t crc,
+			      const unsigned char *buf, uint len);
+
 /* lib/crc32c.c */
 
 /**
@@ -126,4 +169,27 @@ void crc32c_init(uint32_t *crc32c_table, uint32_t pol);
 uint32_t crc32c_cal(uint32_t crc, const char *data, int length,
 		    uint32_t *crc32c_table);
 
+/**
+ * crc32c_engine_present() - Check whether an engine can work out CRC32C
+ *
+ * @engine: engine to check
+ * Return: true if present
+ */
+bool crc32c_engine_present(enum crc32_engine engine);
+
+/**
+ * crc32c_engine_cal() - Calculate the CRC32C with a given engine
+ *
+ * This is the same as crc32c_cal() with a table for the Castagnoli
+ * polynomial, but uses @engine, or a table if the engine is not present.
+ *
+ * @engine: engine to use
+ * @crc: Previous crc (use 0 at start)
+ * @data: Data bytes to checksum
+ * @length: Number of bytes to process
+ * Return: checksum value
+ */
+uint32_t crc32c_engine_cal(enum crc32_engine engine, uint32_t crc,
+			   const void *data, uint length);
+
 #endif /* _UBOOT_CRC_H */
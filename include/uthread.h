@@ -3,6 +3,7 @@
  * Copyright 2025 Linaro Limited
  */
 
+#include <linux/errno.h>
 #include <linux/list.h>
 #include <linux/types.h>
 #include <setjmp.h>
@@ -25,6 +26,12 @@
  * the uthread_create()  and uthread_schedule() functions may still be used so
  * that code differences between uthreads enabled and disabled can be reduced to
  * a minimum.
+ *
+ * On top of this, a work queue (struct uthread_wq) keeps a fixed pool of
+ * worker threads which run work items (struct uthread_work) in the order they
+ * are submitted. This avoids allocating a thread and its stack for each short
+ * job, and bounds how many jobs can be in progress at the same time. When
+ * CONFIG_UTHREAD is disabled, work items run as soon as they are submitted.
  */
 
 /**
@@ -35,6 +42,8 @@
  * @ctx: context to resume execution of this thread (via longjmp())
  * @stack: initial stack pointer for the thread
  * @done: true once @fn has returned, false otherwise
+ * @parked: true while the thread has nothing to do and must not be scheduled,
+ * e.g. an idle work queue worker
  * @grp_id: user-supplied identifier for this thread and possibly others. A
  * thread can belong to zero or one group (not more), and a group may contain
  * any number of threads.
@@ -46,6 +55,7 @@ struct uthread {
 	jmp_buf ctx;
 	void *stack;
 	bool done;
+	bool parked;
 	unsigned int grp_id;
 	struct list_head list;
 };
@@ -72,6 +82,74 @@ struct uthread_mutex {
 
 #define UTHREAD_MUTEX_INITIALIZER { .state = UTHREAD_MUTEX_UNLOCKED }
 
+/**
+ * enum uthread_work_state - state of a struct uthread_work
+ *
+ * @UTHREAD_WORK_IDLE: not queued: never submitted, cancelled or finished
+ * @UTHREAD_WORK_PENDING: submitted and waiting for a worker thread
+ * @UTHREAD_WORK_RUNNING: being run by a worker thread
+ */
+enum uthread_work_state {
+	UTHREAD_WORK_IDLE = 0,
+	UTHREAD_WORK_PENDING,
+	UTHREAD_WORK_RUNNING,
+};
+
+/**
+ * struct uthread_work - an item of work to be run by a work queue
+ *
+ * @fn: function to run
+ * @arg: argument passed to @fn
+ * @grp_id: optional group ID of the work (zero for no group), so that the
+ * completion of several items can be waited for at once
+ * @state: the internal state of the work
+ * @list: link in the pending or running list of the work queue
+ */
+struct uthread_work {
+	void (*fn)(void *arg);
+	void *arg;
+	unsigned int grp_id;
+	enum uthread_work_state state;
+	struct list_head list;
+};
+
+/**
+ * struct uthread_wq - a work queue served by a fixed pool of threads
+ *
+ * The worker threads and their stacks are allocated once by uthread_wq_init()
+ * and then run any number of work items until uthread_wq_destroy() is called.
+ *
+ * @pending: work items waiting for a worker, oldest first
+ * @running: work items being run by a worker
+ * @grp_id: thread group ID of the workers
+ * @stop: true when the workers should exit once no work is pending
+ */
+struct uthread_wq {
+	struct list_head pending;
+	struct list_head running;
+	unsigned int grp_id;
+	bool stop;
+};
+
+/**
+ * uthread_work_init() - set up a work item
+ *
+ * @work: the work item to set up
+ * @fn: function to run
+ * @arg: argument passed to @fn
+ * @grp_id: group ID of the work, zero for no group
+ */
+static inline void uthread_work_init(struct uthread_work *work,
+				     void (*fn)(void *), void *arg,
+				     unsigned int grp_id)
+{
+	work->fn = fn;
+	work->arg = arg;
+	work->grp_id = grp_id;
+	work->state = UTHREAD_WORK_IDLE;
+	INIT_LIST_HEAD(&work->list);
+}
+
 #if CONFIG_IS_ENABLED(UTHREAD)
 
 /**
@@ -101,6 +179,12 @@ int uthread_create(struct uthread *uthr, void (*fn)(void *), void *arg,
  * Return: true if a thread was scheduled, false if no runnable thread was found
  */
 bool uthread_schedule(void);
+/**
+ * uthread_self() - get the thread which is running
+ *
+ * Return: the current thread, which is a static object for the main thread
+ */
+struct uthread *uthread_self(void);
 /**
  * uthread_grp_new_id() - return a new ID for a thread group
  *
@@ -154,6 +238,75 @@ int uthread_mutex_trylock(struct uthread_mutex *mutex);
  */
 int uthread_mutex_unlock(struct uthread_mutex *mutex);
 
+/**
+ * uthread_wq_init() - create a work queue and start its worker threads
+ *
+ * @wq: the work queue to set up
+ * @workers: number of worker threads, i.e. the maximum number of work items
+ * that can run at the same time
+ * @stack_sz: stack size for each worker thread, or zero for the default
+ * Return: 0 on success, -EINVAL if @workers is less than 1, -ENOMEM if the
+ * worker threads cannot be created
+ */
+int uthread_wq_init(struct uthread_wq *wq, int workers, size_t stack_sz);
+
+/**
+ * uthread_wq_destroy() - run all pending work then stop the worker threads
+ *
+ * @wq: the work queue to destroy
+ */
+void uthread_wq_destroy(struct uthread_wq *wq);
+
+/**
+ * uthread_wq_submit() - queue a work item
+ *
+ * The work item is run by the first worker thread that becomes available, in
+ * the order items were submitted. It must stay valid until it has finished or
+ * has been cancelled.
+ *
+ * @wq: the work queue to use
+ * @work: the work item, set up with uthread_work_init()
+ * Return: 0 on success, -EBUSY if the work item is already queued or running
+ */
+int uthread_wq_submit(struct uthread_wq *wq, struct uthread_work *work);
+
+/**
+ * uthread_work_cancel() - remove a work item from its queue
+ *
+ * @work: the work item to cancel
+ * Return: 0 if the work item was removed before it started, -EBUSY if it is
+ * running, -EALREADY if it was not queued
+ */
+int uthread_work_cancel(struct uthread_work *work);
+
+/**
+ * uthread_work_wait() - wait for a work item to finish
+ *
+ * Other threads are scheduled until the work item has finished or has been
+ * cancelled.
+ *
+ * @work: the work item to wait for
+ */
+void uthread_work_wait(struct uthread_work *work);
+
+/**
+ * uthread_wq_grp_done() - test if all work items in a group are finished
+ *
+ * @wq: the work queue the work items were submitted to
+ * @grp_id: the group ID of the work items
+ * Return: false if at least one work item of the group is pending or running,
+ * true otherwise
+ */
+bool uthread_wq_grp_done(struct uthread_wq *wq, unsigned int grp_id);
+
+/**
+ * uthread_wq_grp_wait() - wait for all work items in a group to finish
+ *
+ * @wq: the work queue the work items were submitted to
+ * @grp_id: the group ID of the work items
+ */
+void uthread_wq_grp_wait(struct uthread_wq *wq, unsigned int grp_id);
+
 #else
 
 static inline int uthread_create(struct uthread *uthr, void (*fn)(void *),
@@ -169,6 +322,11 @@ static inline bool uthread_schedule(void)
 	return false;
 }
 
+static inline struct uthread *uthread_self(void)
+{
+	return NULL;
+}
+
 static inline unsigned int uthread_grp_new_id(void)
 {
 	return 0;
@@ -179,6 +337,44 @@ static inline bool uthread_grp_done(unsigned int grp_id)
 	return true;
 }
 
+static inline int uthread_wq_init(struct uthread_wq *wq, int workers,
+				  size_t stack_sz)
+{
+	return 0;
+}
+
+static inline void uthread_wq_destroy(struct uthread_wq *wq)
+{
+}
+
+/* Without threads, work items run as soon as they are submitted */
+static inline int uthread_wq_submit(struct uthread_wq *wq,
+				    struct uthread_work *work)
+{
+	work->fn(work->arg);
+	return 0;
+}
+
+static inline int uthread_work_cancel(struct uthread_work *work)
+{
+	return -EALREADY;
+}
+
+static inline void uthread_work_wait(struct uthread_work *work)
+{
+}
+
+static inline bool uthread_wq_grp_done(struct uthread_wq *wq,
+				       unsigned int grp_id)
+{
+	return true;
+}
+
+static inline void uthread_wq_grp_wait(struct uthread_wq *wq,
+				       unsigned int grp_id)
+{
+}
+
 /* These are macros for convenience on the caller side */
 #define uthread_mutex_lock(_mutex) ({ 0; })
 #define uthread_mutex_trylock(_mutex) ({ 0 })
@@ -69,6 +69,24 @@ enum video_format {
 	VIDEO_X2R10G10B10,
 };
 
+/* Maximum number of separate regions tracked by video_damage() */
+#define VIDEO_DAMAGE_RECTS	4
+
+/**
+ * struct video_damage_rect - A region of the frame buffer
+ *
+ * @xstart:	X start position in pixels from the left
+ * @ystart:	Y start position in pixels from the top
+ * @xend:	X end position in pixels from the left
+ * @yend:	Y end position in pixels from the top
+ */
+struct video_damage_rect {
+	int xstart;
+	int ystart;
+	int xend;
+	int yend;
+};
+
 /**
  * struct video_priv - Device information used by the video uclass
  *
@@ -86,10 +104,12 @@ enum video_format {
  * @copy_fb:	Copy of the frame buffer to keep up to date; see struct
  *		video_uc_plat
  * @damage:	A bounding box of framebuffer regions updated since last sync
- * @damage.xstart:	X start position in pixels from the left
- * @damage.ystart:	Y start position in pixels from the top
- * @damage.xend:	X end position in pixels from the left
- * @damage.xend:	Y end position in pixels from the top
+ * @damage_rect:	Disjoint regions updated since last sync, which are the
+ *		parts of the frame buffer that get flushed or copied
+ * @damage_count:	Number of entries used in @damage_rect
+ * @flush_bytes:	Number of bytes flushed from the data cache by the last
+ *		video_sync(), counting both frame buffers
+ * @copy_bytes:	Number of bytes copied to @copy_fb by the last video_sync()
  * @line_length:	Length of each frame buffer line, in bytes. This can be
  *		set by the driver, but if not, the uclass will set it after
  *		probing
@@ -119,12 +139,11 @@ struct video_priv {
 	void *fb;
 	int fb_size;
 	void *copy_fb;
-	struct {
-		int xstart;
-		int ystart;
-		int xend;
-		int yend;
-	} damage;
+	struct video_damage_rect damage;
+	struct video_damage_rect damage_rect[VIDEO_DAMAGE_RECTS];
+	int damage_count;
+	ulong flush_bytes;
+	ulong copy_bytes;
 	int line_length;
 	u32 colour_fg;
 	u32 colour_bg;
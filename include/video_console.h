@@ -594,4 +594,43 @@ int vidconsole_get_font_size(struct udevice *dev, const char **name, uint *sizep
  */
 void vidconsole_set_quiet(struct udevice *dev, bool quiet);
 
+/**
+ * struct console_tt_glyph_stats - Statistics for the TrueType glyph cache
+ *
+ * @hits:	Number of characters drawn from the cache
+ * @misses:	Number of characters which had to be rendered
+ * @evictions:	Number of glyphs dropped to make room for others
+ * @bytes:	Memory used by the cached glyphs, in bytes
+ */
+struct console_tt_glyph_stats {
+	uint hits;
+	uint misses;
+	uint evictions;
+	uint bytes;
+};
+
+/**
+ * console_truetype_glyph_cache() - Set up the TrueType glyph cache
+ *
+ * This empties the cache and resets its statistics. It is intended for tests,
+ * which need other settings than the ones in the configuration.
+ *
+ * @dev: TrueType console device
+ * @phases: Sub-pixel positions for each character, 0 for exact positions
+ * @size: Largest size of the cache in bytes, 0 for
+ *	CONFIG_CONSOLE_TRUETYPE_GLYPH_CACHE
+ * Return: 0 if OK, -ENOSYS if @dev is not a TrueType console
+ */
+int console_truetype_glyph_cache(struct udevice *dev, int phases, uint size);
+
+/**
+ * console_truetype_glyph_stats() - Get the statistics of the glyph cache
+ *
+ * @dev: TrueType console device
+ * @stats: Returns the statistics since the cache was last set up
+ * Return: 0 if OK, -ENOSYS if @dev is not a TrueType console
+ */
+int console_truetype_glyph_stats(struct udevice *dev,
+				 struct console_tt_glyph_stats *stats);
+
 #endif
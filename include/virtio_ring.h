@@ -10,6 +10,7 @@
 #define _LINUX_VIRTIO_RING_H
 
 #include <virtio_types.h>
+#include <asm/io.h>
 
 /* This marks a buffer as continuing via the next field */
 #define VRING_DESC_F_NEXT		1
@@ -43,6 +44,9 @@
  */
 #define VIRTIO_RING_F_EVENT_IDX		29
 
+/* Longest chain which is put in an indirect table */
+#define VIRTQUEUE_MAX_INDIRECT		4
+
 /* Virtio ring descriptors: 16 bytes. These can chain together via "next". */
 struct vring_desc {
 	/* Address (guest-physical) */
@@ -102,6 +106,8 @@ struct vring {
  * @num_free: number of elements we expect to be able to fit
  * @vring: actual memory layout for this queue
  * @vring_desc_shadow: guest-only copy of descriptors
+ * @indirect_desc: an indirect table of VIRTQUEUE_MAX_INDIRECT entries for each
+ *	descriptor, or NULL if indirect descriptors are not in use
  * @event: host publishes avail event idx
  * @free_head: head of free buffer list
  * @num_added: number we've added since last sync
@@ -116,6 +122,7 @@ struct virtqueue {
 	unsigned int num_free;
 	struct vring vring;
 	struct vring_desc_shadow *vring_desc_shadow;
+	struct vring_desc *indirect_desc;
 	bool event;
 	unsigned int free_head;
 	unsigned int num_added;
@@ -190,6 +197,9 @@ struct virtio_sg;
  * Caller must ensure we don't call this with other virtqueue operations
  * at the same time (except where noted).
  *
+ * If VIRTIO_RING_F_INDIRECT_DESC has been negotiated, a chain of up to
+ * VIRTQUEUE_MAX_INDIRECT buffers takes up a single descriptor in the ring.
+ *
  * Returns zero or a negative error (ie. ENOSPC, ENOMEM, EIO).
  */
 int virtqueue_add(struct virtqueue *vq, struct virtio_sg *sgs[],
@@ -313,25 +323,36 @@ bool virtqueue_poll(struct virtqueue *vq, u16 last_used_idx);
 void virtqueue_dump(struct virtqueue *vq);
 
 /*
- * Barriers in virtio are tricky. Since we are not in a hyperviosr/guest
- * scenario, having these as nops is enough to work as expected.
+ * Barriers in virtio are needed even though U-Boot runs on a single CPU:
+ * the device may be working on the ring at the same time, e.g. in a host
+ * thread on another CPU, so the driver's accesses to the ring must be
+ * ordered as the device sees them. Not every architecture provides read
+ * and write barriers, so all of these use a full one.
  */
 
 static inline void virtio_mb(void)
 {
+	/* Order ring stores against later ring loads, e.g. the kick check */
+	mb();
 }
 
 static inline void virtio_rmb(void)
 {
+	/* Read the used index before the used entries it covers */
+	mb();
 }
 
 static inline void virtio_wmb(void)
 {
+	/* Write the descriptors before the available index which exposes them */
+	mb();
 }
 
 static inline void virtio_store_mb(__virtio16 *p, __virtio16 v)
 {
 	WRITE_ONCE(*p, v);
+	/* The store must be seen before any load which follows */
+	mb();
 }
 
 #endif /* _LINUX_VIRTIO_RING_H */
@@ -29,6 +29,13 @@
 
 #define tole(x) cpu_to_le32(x)
 
+/* Host tools keep to the small table */
+#ifdef USE_HOSTCC
+#define CRC32_SLICE8	0
+#else
+#define CRC32_SLICE8	CONFIG_IS_ENABLED(CRC32_SLICE_BY_8)
+#endif
+
 #ifdef CONFIG_DYNAMIC_CRC_TABLE
 
 static int __efi_runtime_data crc_table_empty = 1;
@@ -82,7 +89,9 @@ static void __efi_runtime make_crc_table(void)
   }
   crc_table_empty = 0;
 }
-#elif !defined(CONFIG_ARM64_CRC32)
+#elif CRC32_SLICE8
+#include "crc32table.h"
+#else
 /* ========================================================================
  * Table of CRC-32's of all single-byte values (made by make_crc_table)
  */
@@ -177,17 +186,50 @@ const uint32_t * ZEXPORT get_crc_table()
 
 /* ========================================================================= */
 
-/* No ones complement version. JFFS2 (and other things ?)
- * don't use ones compliment in their CRC calculations.
+#if CRC32_SLICE8
+/* Works out the CRC a byte at a time, using the first of the slice tables */
+static uint32_t __efi_runtime crc32_table(uint32_t crc, const Bytef *buf,
+					  uInt len)
+{
+	const uint32_t *tab = crc32_slice_table[0];
+
+	while (len--)
+		crc = tab[(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+
+	return crc;
+}
+
+/*
+ * Works out the CRC eight bytes at a time, looking up each byte in its own
+ * table, so that the lookups do not depend on each other
  */
-uint32_t __efi_runtime crc32_no_comp(uint32_t crc, const Bytef *buf, uInt len)
+static uint32_t __efi_runtime crc32_slice8(uint32_t crc, const Bytef *buf,
+					   uInt len)
 {
-#ifdef CONFIG_ARM64_CRC32
-    crc = cpu_to_le32(crc);
-    while (len--)
-        crc = __builtin_aarch64_crc32b(crc, *buf++);
-    return le32_to_cpu(crc);
+	const uint32_t (*tab)[256] = crc32_slice_table;
+	uint32_t hi;
+
+	for (; len && ((ulong)buf & 3); len--)
+		crc = tab[0][(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+
+	for (; len >= 8; len -= 8, buf += 8) {
+		crc ^= le32_to_cpu(*(const uint32_t *)buf);
+		hi = le32_to_cpu(*(const uint32_t *)(buf + 4));
+		crc = tab[7][crc & 0xff] ^ tab[6][(crc >> 8) & 0xff] ^
+		      tab[5][(crc >> 16) & 0xff] ^ tab[4][crc >> 24] ^
+		      tab[3][hi & 0xff] ^ tab[2][(hi >> 8) & 0xff] ^
+		      tab[1][(hi >> 16) & 0xff] ^ tab[0][hi >> 24];
+	}
+
+	while (len--)
+		crc = tab[0][(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+
+	return crc;
+}
 #else
+static uint32_t __efi_runtime crc32_table(uint32_t crc, const Bytef *buf,
+					  uInt len)
+{
     const uint32_t *tab = crc_table;
     const uint32_t *b =(const uint32_t *)buf;
     size_t rem_len;
@@ -225,10 +267,103 @@ uint32_t __efi_runtime crc32_no_comp(uint32_t crc, const Bytef *buf, uInt len)
     }
 
     return le32_to_cpu(crc);
-#endif
 }
+#endif
 #undef DO_CRC
 
+#ifdef CONFIG_ARM64_CRC32
+/*
+ * The CRC32 instructions are optional in ARMv8.0, so check that the CPU has
+ * them. Nothing is stored, since this may run before relocation.
+ */
+static bool __efi_runtime crc32_hw_present(void)
+{
+	u64 isar0;
+
+	asm volatile("mrs %0, id_aa64isar0_el1" : "=r" (isar0));
+
+	return (isar0 >> 16) & 0xf;
+}
+
+static uint32_t __efi_runtime crc32_hw(uint32_t crc, const Bytef *buf,
+				       uInt len)
+{
+	for (; len && ((ulong)buf & 7); len--)
+		crc = __builtin_aarch64_crc32b(crc, *buf++);
+
+	for (; len >= 8; len -= 8, buf += 8) {
+		u64 word = le64_to_cpu(*(const u64 *)buf);
+
+		crc = __builtin_aarch64_crc32x(crc, word);
+	}
+
+	while (len--)
+		crc = __builtin_aarch64_crc32b(crc, *buf++);
+
+	return crc;
+}
+#else
+static bool __efi_runtime crc32_hw_present(void)
+{
+	return false;
+}
+
+static uint32_t __efi_runtime crc32_hw(uint32_t crc, const Bytef *buf,
+				       uInt len)
+{
+	return crc32_table(crc, buf, len);
+}
+#endif
+
+/* No ones complement version. JFFS2 (and other things ?)
+ * don't use ones compliment in their CRC calculations.
+ */
+uint32_t __efi_runtime crc32_no_comp(uint32_t crc, const Bytef *buf, uInt len)
+{
+	if (crc32_hw_present())
+		return crc32_hw(crc, buf, len);
+#if CRC32_SLICE8
+	return crc32_slice8(crc, buf, len);
+#else
+	return crc32_table(crc, buf, len);
+#endif
+}
+
+#ifndef USE_HOSTCC
+bool crc32_engine_present(enum crc32_engine engine)
+{
+	switch (engine) {
+	case CRC32_ENGINE_TABLE:
+		return true;
+	case CRC32_ENGINE_SLICE8:
+		return CRC32_SLICE8;
+	case CRC32_ENGINE_HW:
+		return crc32_hw_present();
+	default:
+		return false;
+	}
+}
+
+uint32_t crc32_engine_no_comp(enum crc32_engine engine, uint32_t crc,
+			      const unsigned char *buf, uint len)
+{
+	switch (engine) {
+	case CRC32_ENGINE_HW:
+		if (crc32_hw_present())
+			return crc32_hw(crc, buf, len);
+		break;
+#if CRC32_SLICE8
+	case CRC32_ENGINE_SLICE8:
+		return crc32_slice8(crc, buf, len);
+#endif
+	default:
+		break;
+	}
+
+	return crc32_table(crc, buf, len);
+}
+#endif
+
 uint32_t __efi_runtime crc32(uint32_t crc, const Bytef *p, uInt len)
 {
      return crc32_no_comp(crc ^ 0xffffffffL, p, len) ^ 0xffffffffL;
@@ -11,15 +11,150 @@
  */
 
 #include <compiler.h>
+#include <u-boot/crc.h>
+#include <asm/byteorder.h>
+#include <linux/kernel.h>
+#ifdef CONFIG_X86
+#include <asm/cpu.h>
+#endif
 
-uint32_t crc32c_cal(uint32_t crc, const char *data, int length,
-		    uint32_t *crc32c_table)
+/* Bit-reflected Castagnoli polynomial, which the CPU instructions use */
+#define CRC32C_POLY	0x82f63b78
+
+#define CRC32C_SLICE8	CONFIG_IS_ENABLED(CRC32_SLICE_BY_8)
+
+/*
+ * Tables for the Castagnoli polynomial, set up on first use. As with CRC32,
+ * each table after the first gives the CRC of a byte followed by one more zero
+ * byte than the one before.
+ */
+static uint32_t crc32c_tab[CRC32C_SLICE8 ? 8 : 1][256];
+static bool crc32c_tab_ready;
+
+/* Whether the CPU has CRC32C instructions, checked along with the tables */
+static bool crc32c_hw_ok;
+
+static uint32_t crc32c_bytes(uint32_t crc, const u8 *data, uint length,
+			     const uint32_t *tab)
+{
+	while (length--)
+		crc = tab[(crc ^ *data++) & 0xff] ^ (crc >> 8);
+
+	return crc;
+}
+
+static uint32_t crc32c_slice8(uint32_t crc, const u8 *data, uint length)
+{
+	const uint32_t (*tab)[256] = crc32c_tab;
+	uint32_t hi;
+
+	for (; length && ((ulong)data & 3); length--)
+		crc = tab[0][(crc ^ *data++) & 0xff] ^ (crc >> 8);
+
+	for (; length >= 8; length -= 8, data += 8) {
+		crc ^= le32_to_cpu(*(const uint32_t *)data);
+		hi = le32_to_cpu(*(const uint32_t *)(data + 4));
+		crc = tab[7][crc & 0xff] ^ tab[6][(crc >> 8) & 0xff] ^
+		      tab[5][(crc >> 16) & 0xff] ^ tab[4][crc >> 24] ^
+		      tab[3][hi & 0xff] ^ tab[2][(hi >> 8) & 0xff] ^
+		      tab[1][(hi >> 16) & 0xff] ^ tab[0][hi >> 24];
+	}
+
+	return crc32c_bytes(crc, data, length, tab[0]);
+}
+
+#if defined(CONFIG_ARM64_CRC32)
+static bool crc32c_hw_present(void)
+{
+	u64 isar0;
+
+	asm volatile("mrs %0, id_aa64isar0_el1" : "=r" (isar0));
+
+	return (isar0 >> 16) & 0xf;
+}
+
+static uint32_t crc32c_hw(uint32_t crc, const u8 *data, uint length)
 {
+	for (; length && ((ulong)data & 7); length--)
+		crc = __builtin_aarch64_crc32cb(crc, *data++);
+
+	for (; length >= 8; length -= 8, data += 8) {
+		u64 word = le64_to_cpu(*(const u64 *)data);
+
+		crc = __builtin_aarch64_crc32cx(crc, word);
+	}
+
 	while (length--)
-		crc = crc32c_table[(u8)(crc ^ *data++)] ^ (crc >> 8);
+		crc = __builtin_aarch64_crc32cb(crc, *data++);
 
 	return crc;
 }
+#elif defined(CONFIG_X86)
+/* The SSE4.2 crc32 instruction works out CRC32C, not CRC32 */
+static bool crc32c_hw_present(void)
+{
+	return cpuid_ecx(1) & BIT(20);
+}
+
+static uint32_t crc32c_hw(uint32_t crc, const u8 *data, uint length)
+{
+	for (; length && ((ulong)data & 3); length--)
+		asm("crc32b %1, %0" : "+r" (crc) : "rm" (*data++));
+
+	for (; length >= 4; length -= 4, data += 4)
+		asm("crc32l %1, %0" : "+r" (crc)
+		    : "rm" (*(const uint32_t *)data));
+
+	while (length--)
+		asm("crc32b %1, %0" : "+r" (crc) : "rm" (*data++));
+
+	return crc;
+}
+#else
+static bool crc32c_hw_present(void)
+{
+	return false;
+}
+
+static uint32_t crc32c_hw(uint32_t crc, const u8 *data, uint length)
+{
+	return crc;
+}
+#endif
+
+static void crc32c_setup(void)
+{
+	int i, k;
+
+	if (crc32c_tab_ready)
+		return;
+	crc32c_init(crc32c_tab[0], CRC32C_POLY);
+	for (k = 1; k < ARRAY_SIZE(crc32c_tab); k++) {
+		for (i = 0; i < 256; i++)
+			crc32c_tab[k][i] = (crc32c_tab[k - 1][i] >> 8) ^
+				crc32c_tab[0][crc32c_tab[k - 1][i] & 0xff];
+	}
+	crc32c_hw_ok = crc32c_hw_present();
+	crc32c_tab_ready = true;
+}
+
+uint32_t crc32c_cal(uint32_t crc, const char *data, int length,
+		    uint32_t *crc32c_table)
+{
+	/*
+	 * Entry 128 of a table is the polynomial, so a Castagnoli table can be
+	 * told apart from others and a faster way used
+	 */
+	if (crc32c_table[128] == CRC32C_POLY) {
+		crc32c_setup();
+		if (crc32c_hw_ok)
+			return crc32c_hw(crc, data, length);
+		if (CRC32C_SLICE8)
+			return crc32c_slice8(crc, data, length);
+	}
+
+	return crc32c_bytes(crc, data, length, crc32c_table);
+}
 
 void crc32c_init(uint32_t *crc32c_table, uint32_t pol)
 {
@@ -35,3 +170,38 @@ void crc32c_init(uint32_t *crc32c_table, uint32_t pol)
 		crc32c_table[i] = v;
 	}
 }
+
+bool crc32c_engine_present(enum crc32_engine engine)
+{
+	switch (engine) {
+	case CRC32_ENGINE_TABLE:
+		return true;
+	case CRC32_ENGINE_SLICE8:
+		return CRC32C_SLICE8;
+	case CRC32_ENGINE_HW:
+		crc32c_setup();
+		return crc32c_hw_ok;
+	default:
+		return false;
+	}
+}
+
+uint32_t crc32c_engine_cal(enum crc32_engine engine, uint32_t crc,
+			   const void *data, uint length)
+{
+	crc32c_setup();
+	switch (engine) {
+	case CRC32_ENGINE_HW:
+		if (crc32c_hw_ok)
+			return crc32c_hw(crc, data, length);
+		break;
+	case CRC32_ENGINE_SLICE8:
+		if (CRC32C_SLICE8)
+			return crc32c_slice8(crc, data, length);
+		break;
+	default:
+		break;
+	}
+
+	return crc32c_bytes(crc, data, length, crc32c_tab[0]);
+}
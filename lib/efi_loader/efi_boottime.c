@@ -7,6 +7,7 @@
 
 #define LOG_CATEGORY LOGC_EFI
 
+#include <blk.h>
 #include <bootm.h>
 #include <div64.h>
 #include <dm/device.h>
@@ -2236,6 +2237,10 @@ static efi_status_t EFIAPI efi_exit_boot_services(efi_handle_t image_handle,
 			list_del(&evt->link);
 	}
 
+	/* Write back anything held back by the block cache */
+	if (blkcache_flush(-1, 0))
+		log_err("Failed to write back the block cache\n");
+
 	if (!efi_st_keep_devices) {
 		bootm_disable_interrupts();
 		if (IS_ENABLED(CONFIG_DM_ETH))
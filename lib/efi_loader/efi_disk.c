@@ -290,7 +290,7 @@ static efi_status_t EFIAPI efi_disk_write_blocks(struct efi_block_io *this,
  * This function implements the FlushBlocks service of the
  * EFI_BLOCK_IO_PROTOCOL.
  *
- * As we always write synchronously nothing is done here.
+ * Writes back any blocks which the block cache holds back for the device.
  *
  * See the Unified Extensible Firmware Interface (UEFI) specification for
  * details.
@@ -300,7 +300,20 @@ static efi_status_t EFIAPI efi_disk_write_blocks(struct efi_block_io *this,
  */
 static efi_status_t EFIAPI efi_disk_flush_blocks(struct efi_block_io *this)
 {
+	struct efi_disk_obj *diskobj;
+	struct udevice *dev;
+
 	EFI_ENTRY("%p", this);
+
+	diskobj = container_of(this, struct efi_disk_obj, ops);
+	dev = diskobj->header.dev;
+	/* a partition is flushed through the block device holding it */
+	if (CONFIG_IS_ENABLED(PARTITIONS) &&
+	    device_get_uclass_id(dev) == UCLASS_PARTITION)
+		dev = dev_get_parent(dev);
+	if (blk_flush(dev))
+		return EFI_EXIT(EFI_DEVICE_ERROR);
+
 	return EFI_EXIT(EFI_SUCCESS);
 }
 
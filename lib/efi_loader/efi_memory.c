@@ -17,7 +17,8 @@
 #include <asm/cache.h>
 #include <asm/global_data.h>
 #include <asm/sections.h>
-#include <linux/list_sort.h>
+#include <linux/log2.h>
+#include <linux/rbtree.h>
 #include <linux/sizes.h>
 
 DECLARE_GLOBAL_DATA_PTR;
@@ -25,20 +26,44 @@ DECLARE_GLOBAL_DATA_PTR;
 /* Magic number identifying memory allocated from pool */
 #define EFI_ALLOC_POOL_MAGIC 0x1fe67ddf6491caa2
 
+/* Magic number identifying a pool slab */
+#define EFI_POOL_SLAB_MAGIC 0x5ab1a110c5ab1a11
+
+/* Size and alignment of the page runs which slabs are carved from */
+#define EFI_POOL_SLAB_SIZE	SZ_64K
+
+/* Smallest and largest slab object, including the allocation header */
+#define EFI_POOL_SLAB_MIN_SHIFT	6
+#define EFI_POOL_SLAB_MAX_SHIFT	11
+#define EFI_POOL_SLAB_CLASSES	(EFI_POOL_SLAB_MAX_SHIFT - \
+				 EFI_POOL_SLAB_MIN_SHIFT + 1)
+
+/* Generation count of the memory map, changed whenever the map changes */
 efi_uintn_t efi_memory_map_key;
 
-struct efi_mem_list {
-	struct list_head link;
+/**
+ * struct efi_mem_node - memory map entry
+ *
+ * @node:	node in efi_mem
+ * @desc:	memory descriptor
+ */
+struct efi_mem_node {
+	struct rb_node node;
 	struct efi_mem_desc desc;
 };
 
-#define EFI_CARVE_NO_OVERLAP		-1
-#define EFI_CARVE_LOOP_AGAIN		-2
-#define EFI_CARVE_OVERLAPS_NONRAM	-3
-#define EFI_CARVE_OUT_OF_RESOURCES	-4
+/* Memory map entries, sorted by address. Entries never overlap. */
+static struct rb_root efi_mem = RB_ROOT;
+/* Number of entries in efi_mem */
+static efi_uintn_t efi_mem_count;
 
-/* This list contains all memory map items */
-static LIST_HEAD(efi_mem);
+/*
+ * Memory map as an array in ascending order, as returned by GetMemoryMap().
+ * This is only valid while efi_mem_cache_key matches efi_memory_map_key.
+ */
+static struct efi_mem_desc *efi_mem_cache;
+static efi_uintn_t efi_mem_cache_size;
+static efi_uintn_t efi_mem_cache_key;
 
 #ifdef CONFIG_EFI_LOADER_BOUNCE_BUFFER
 void *efi_bounce_buffer;
@@ -47,13 +72,14 @@ void *efi_bounce_buffer;
 /**
  * struct efi_pool_allocation - memory block allocated from pool
  *
- * @num_pages:	number of pages allocated
+ * @num_pages:	number of pages allocated, 0 if the block is in a slab
  * @checksum:	checksum
  * @data:	allocated pool memory
  *
- * U-Boot services each UEFI AllocatePool() request as a separate
+ * U-Boot services each large UEFI AllocatePool() request as a separate
  * (multiple) page allocation. We have to track the number of pages
- * to be able to free the correct amount later.
+ * to be able to free the correct amount later. With CONFIG_EFI_POOL_SLAB
+ * small requests are taken from a slab instead, see struct efi_pool_slab.
  *
  * The checksum calculated in function checksum() is used in FreePool() to avoid
  * freeing memory not allocated by AllocatePool() and duplicate freeing.
@@ -84,31 +110,34 @@ static u64 checksum(struct efi_pool_allocation *alloc)
 }
 
 /**
- * efi_mem_cmp() - comparator function for sorting memory map
+ * struct efi_pool_slab - run of pages split into pool blocks of one size
  *
- * Sorts the memory list from highest address to lowest address
+ * Each slab is EFI_POOL_SLAB_SIZE bytes long and aligned to its size, so the
+ * slab holding a block is found by rounding the block address down. The slab
+ * header is at the start, followed by the blocks. Each block starts with a
+ * struct efi_pool_allocation whose @num_pages is 0.
  *
- * When allocating memory we should always start from the highest
- * address chunk, so sort the memory list such that the first list
- * iterator gets the highest address and goes lower from there.
- *
- * @priv:	unused
- * @a:		first memory area
- * @b:		second memory area
- * Return:	1 if @a is before @b, -1 if @b is before @a, 0 if equal
+ * @magic:		EFI_POOL_SLAB_MAGIC xor the slab address
+ * @link:		entry in the list of slabs of this size
+ * @memory_type:	memory type of the slab
+ * @obj_size:		size of each block, including its header
+ * @count:		number of blocks in the slab
+ * @used:		number of blocks allocated
+ * @free:		first free block, whose data holds a pointer to the
+ *			next one
  */
-static int efi_mem_cmp(void *priv, struct list_head *a, struct list_head *b)
-{
-	struct efi_mem_list *mema = list_entry(a, struct efi_mem_list, link);
-	struct efi_mem_list *memb = list_entry(b, struct efi_mem_list, link);
+struct efi_pool_slab {
+	u64 magic;
+	struct list_head link;
+	enum efi_memory_type memory_type;
+	u32 obj_size;
+	u32 count;
+	u32 used;
+	struct efi_pool_allocation *free;
+};
 
-	if (mema->desc.physical_start == memb->desc.physical_start)
-		return 0;
-	else if (mema->desc.physical_start < memb->desc.physical_start)
-		return 1;
-	else
-		return -1;
-}
+/* Slabs for each block size, those with free blocks first */
+static struct list_head efi_pool_slabs[EFI_POOL_SLAB_CLASSES];
 
 /**
  * desc_get_end() - get end address of memory area
@@ -122,139 +151,195 @@ static uint64_t desc_get_end(struct efi_mem_desc *desc)
 }
 
 /**
- * efi_mem_sort() - sort memory map
+ * desc_set_range() - set the address range of a memory descriptor
  *
- * Sort the memory map and then try to merge adjacent memory areas.
+ * @desc:	memory descriptor
+ * @start:	start address
+ * @end:	end address + 1
  */
-static void efi_mem_sort(void)
+static void desc_set_range(struct efi_mem_desc *desc, u64 start, u64 end)
 {
-	struct efi_mem_list *lmem;
-	struct efi_mem_list *prevmem = NULL;
-	bool merge_again = true;
+	desc->physical_start = start;
+	desc->virtual_start = start;
+	desc->num_pages = (end - start) >> EFI_PAGE_SHIFT;
+}
 
-	list_sort(NULL, &efi_mem, efi_mem_cmp);
+static struct efi_mem_node *efi_mem_entry(struct rb_node *node)
+{
+	return rb_entry_safe(node, struct efi_mem_node, node);
+}
 
-	/* Now merge entries that can be merged */
-	while (merge_again) {
-		merge_again = false;
-		list_for_each_entry(lmem, &efi_mem, link) {
-			struct efi_mem_desc *prev;
-			struct efi_mem_desc *cur;
-			uint64_t pages;
+static struct efi_mem_node *efi_mem_next(struct efi_mem_node *mem)
+{
+	return efi_mem_entry(rb_next(&mem->node));
+}
 
-			if (!prevmem) {
-				prevmem = lmem;
-				continue;
-			}
+static struct efi_mem_node *efi_mem_prev(struct efi_mem_node *mem)
+{
+	return efi_mem_entry(rb_prev(&mem->node));
+}
 
-			cur = &lmem->desc;
-			prev = &prevmem->desc;
-
-			if ((desc_get_end(cur) == prev->physical_start) &&
-			    (prev->type == cur->type) &&
-			    (prev->attribute == cur->attribute)) {
-				/* There is an existing map before, reuse it */
-				pages = cur->num_pages;
-				prev->num_pages += pages;
-				prev->physical_start -= pages << EFI_PAGE_SHIFT;
-				prev->virtual_start -= pages << EFI_PAGE_SHIFT;
-				list_del(&lmem->link);
-				free(lmem);
-
-				merge_again = true;
-				break;
-			}
+/**
+ * efi_mem_find() - find the memory map entry holding an address
+ *
+ * @addr:	address to look up
+ * Return:	the last entry starting at or below @addr, which may end
+ *		before @addr, or NULL if there is none
+ */
+static struct efi_mem_node *efi_mem_find(u64 addr)
+{
+	struct efi_mem_node *found = NULL;
+	struct rb_node *node = efi_mem.rb_node;
+
+	while (node) {
+		struct efi_mem_node *mem = efi_mem_entry(node);
 
-			prevmem = lmem;
+		if (addr < mem->desc.physical_start) {
+			node = node->rb_left;
+		} else {
+			found = mem;
+			node = node->rb_right;
 		}
 	}
+
+	return found;
 }
 
 /**
- * efi_mem_carve_out() - unmap memory region
+ * efi_mem_first_overlap() - find the first entry ending above an address
  *
- * @map:			memory map
- * @carve_desc:			memory region to unmap
- * @overlap_conventional:	the carved out region may only overlap free,
- *				or conventional memory
- * Return:			the number of overlapping pages which have been
- *				removed from the map,
- *				EFI_CARVE_NO_OVERLAP, if the regions don't
- *				overlap, EFI_CARVE_OVERLAPS_NONRAM, if the carve
- *				and map overlap, and the map contains anything
- *				but free ram(only when overlap_conventional is
- *				true),
- *				EFI_CARVE_LOOP_AGAIN, if the mapping list should
- *				be traversed again, as it has been altered.
- *
- * Unmaps all memory occupied by the carve_desc region from the list entry
- * pointed to by map.
- *
- * In case of EFI_CARVE_OVERLAPS_NONRAM it is the callers responsibility
- * to re-add the already carved out pages to the mapping.
- */
-static s64 efi_mem_carve_out(struct efi_mem_list *map,
-			     struct efi_mem_desc *carve_desc,
-			     bool overlap_conventional)
-{
-	struct efi_mem_list *newmap;
-	struct efi_mem_desc *map_desc = &map->desc;
-	uint64_t map_start = map_desc->physical_start;
-	uint64_t map_end = map_start + (map_desc->num_pages << EFI_PAGE_SHIFT);
-	uint64_t carve_start = carve_desc->physical_start;
-	uint64_t carve_end = carve_start +
-			     (carve_desc->num_pages << EFI_PAGE_SHIFT);
-
-	/* check whether we're overlapping */
-	if ((carve_end <= map_start) || (carve_start >= map_end))
-		return EFI_CARVE_NO_OVERLAP;
-
-	/* We're overlapping with non-RAM, warn the caller if desired */
-	if (overlap_conventional && (map_desc->type != EFI_CONVENTIONAL_MEMORY))
-		return EFI_CARVE_OVERLAPS_NONRAM;
-
-	/* Sanitize carve_start and carve_end to lie within our bounds */
-	carve_start = max(carve_start, map_start);
-	carve_end = min(carve_end, map_end);
-
-	/* Carving at the beginning of our map? Just move it! */
-	if (carve_start == map_start) {
-		if (map_end == carve_end) {
-			/* Full overlap, just remove map */
-			list_del(&map->link);
-			free(map);
-		} else {
-			map->desc.physical_start = carve_end;
-			map->desc.virtual_start = carve_end;
-			map->desc.num_pages = (map_end - carve_end)
-					      >> EFI_PAGE_SHIFT;
-		}
+ * @addr:	address to look up
+ * Return:	first entry which ends above @addr, or NULL if there is none
+ */
+static struct efi_mem_node *efi_mem_first_overlap(u64 addr)
+{
+	struct efi_mem_node *mem = efi_mem_find(addr);
+
+	if (!mem)
+		return efi_mem_entry(rb_first(&efi_mem));
+	if (desc_get_end(&mem->desc) > addr)
+		return mem;
+
+	return efi_mem_next(mem);
+}
 
-		return (carve_end - carve_start) >> EFI_PAGE_SHIFT;
+static void efi_mem_insert(struct efi_mem_node *new)
+{
+	struct rb_node **link = &efi_mem.rb_node;
+	struct rb_node *parent = NULL;
+
+	while (*link) {
+		parent = *link;
+		if (new->desc.physical_start <
+		    efi_mem_entry(parent)->desc.physical_start)
+			link = &parent->rb_left;
+		else
+			link = &parent->rb_right;
 	}
+	rb_link_node(&new->node, parent, link);
+	rb_insert_color(&new->node, &efi_mem);
+	efi_mem_count++;
+}
 
-	/*
-	 * Overlapping maps, just split the list map at carve_start,
-	 * it will get moved or removed in the next iteration.
-	 *
-	 * [ map_desc |__carve_start__| newmap ]
-	 */
+static void efi_mem_remove(struct efi_mem_node *mem)
+{
+	rb_erase(&mem->node, &efi_mem);
+	efi_mem_count--;
+	free(mem);
+}
+
+/**
+ * efi_mem_merge() - merge a memory map entry with its neighbours
+ *
+ * Adjacent entries with the same type and attributes are combined, so that
+ * the memory map stays as short as possible.
+ *
+ * @mem:	entry to merge, which may be freed
+ */
+static void efi_mem_merge(struct efi_mem_node *mem)
+{
+	struct efi_mem_node *prev = efi_mem_prev(mem);
+	struct efi_mem_node *next = efi_mem_next(mem);
+
+	if (next && desc_get_end(&mem->desc) == next->desc.physical_start &&
+	    mem->desc.type == next->desc.type &&
+	    mem->desc.attribute == next->desc.attribute) {
+		mem->desc.num_pages += next->desc.num_pages;
+		efi_mem_remove(next);
+	}
+	if (prev && desc_get_end(&prev->desc) == mem->desc.physical_start &&
+	    prev->desc.type == mem->desc.type &&
+	    prev->desc.attribute == mem->desc.attribute) {
+		prev->desc.num_pages += mem->desc.num_pages;
+		efi_mem_remove(mem);
+	}
+}
 
-	/* Create a new map from [ carve_start ... map_end ] */
-	newmap = calloc(1, sizeof(*newmap));
-	if (!newmap)
-		return EFI_CARVE_OUT_OF_RESOURCES;
-	newmap->desc = map->desc;
-	newmap->desc.physical_start = carve_start;
-	newmap->desc.virtual_start = carve_start;
-	newmap->desc.num_pages = (map_end - carve_start) >> EFI_PAGE_SHIFT;
-	/* Insert before current entry (descending address order) */
-	list_add_tail(&newmap->link, &map->link);
+/**
+ * efi_mem_is_free() - check that a region is free memory
+ *
+ * @start:	start address
+ * @end:	end address + 1
+ * Return:	true if the whole region is conventional memory
+ */
+static bool efi_mem_is_free(u64 start, u64 end)
+{
+	struct efi_mem_node *mem;
+	u64 pos = start;
+
+	for (mem = efi_mem_first_overlap(start); mem && pos < end;
+	     mem = efi_mem_next(mem)) {
+		if (mem->desc.physical_start > pos ||
+		    mem->desc.type != EFI_CONVENTIONAL_MEMORY)
+			return false;
+		pos = desc_get_end(&mem->desc);
+	}
 
-	/* Shrink the map to [ map_start ... carve_start ] */
-	map_desc->num_pages = (carve_start - map_start) >> EFI_PAGE_SHIFT;
+	return pos >= end;
+}
 
-	return EFI_CARVE_LOOP_AGAIN;
+/**
+ * efi_mem_carve_out() - unmap memory region
+ *
+ * Removes all memory in the region from the map, trimming or splitting the
+ * entries which partly overlap it. If this fails, the map is unchanged.
+ *
+ * @start:	start address
+ * @end:	end address + 1
+ * Return:	0 if OK, -ENOMEM if out of memory
+ */
+static int efi_mem_carve_out(u64 start, u64 end)
+{
+	struct efi_mem_node *mem, *next, *tail;
+	u64 mem_start, mem_end;
+
+	for (mem = efi_mem_first_overlap(start);
+	     mem && mem->desc.physical_start < end; mem = next) {
+		next = efi_mem_next(mem);
+		mem_start = mem->desc.physical_start;
+		mem_end = desc_get_end(&mem->desc);
+
+		if (mem_start < start && mem_end > end) {
+			/* [ mem | carve | tail ] */
+			tail = calloc(1, sizeof(*tail));
+			if (!tail)
+				return -ENOMEM;
+			tail->desc = mem->desc;
+			desc_set_range(&tail->desc, end, mem_end);
+			desc_set_range(&mem->desc, mem_start, start);
+			efi_mem_insert(tail);
+			break;
+		} else if (mem_start < start) {
+			desc_set_range(&mem->desc, mem_start, start);
+		} else if (mem_end > end) {
+			/* Nothing else is left in the region, so order is kept */
+			desc_set_range(&mem->desc, end, mem_end);
+		} else {
+			efi_mem_remove(mem);
+		}
+	}
+
+	return 0;
 }
 
 /**
@@ -272,11 +357,9 @@ static s64 efi_mem_carve_out(struct efi_mem_list *map,
 efi_status_t efi_update_memory_map(u64 start, u64 pages, int memory_type,
 				   bool overlap_conventional, bool remove)
 {
-	struct efi_mem_list *lmem;
-	struct efi_mem_list *newlist;
-	bool carve_again;
-	uint64_t carved_pages = 0;
+	struct efi_mem_node *newmem = NULL;
 	struct efi_event *evt;
+	u64 end;
 
 	EFI_PRINT("%s: 0x%llx 0x%llx %d %s %s\n", __func__,
 		  start, pages, memory_type, overlap_conventional ?
@@ -287,89 +370,48 @@ efi_status_t efi_update_memory_map(u64 start, u64 pages, int memory_type,
 
 	if (!pages)
 		return EFI_SUCCESS;
+	end = start + (pages << EFI_PAGE_SHIFT);
 
-	++efi_memory_map_key;
-	newlist = calloc(1, sizeof(*newlist));
-	if (!newlist)
-		return EFI_OUT_OF_RESOURCES;
-	newlist->desc.type = memory_type;
-	newlist->desc.physical_start = start;
-	newlist->desc.virtual_start = start;
-	newlist->desc.num_pages = pages;
-
-	switch (memory_type) {
-	case EFI_RUNTIME_SERVICES_CODE:
-	case EFI_RUNTIME_SERVICES_DATA:
-		newlist->desc.attribute = EFI_MEMORY_WB | EFI_MEMORY_RUNTIME;
-		break;
-	case EFI_MMAP_IO:
-		newlist->desc.attribute = EFI_MEMORY_RUNTIME;
-		break;
-	default:
-		newlist->desc.attribute = EFI_MEMORY_WB;
-		break;
-	}
-
-	/* Add our new map */
-	do {
-		carve_again = false;
-		list_for_each_entry(lmem, &efi_mem, link) {
-			s64 r;
-
-			r = efi_mem_carve_out(lmem, &newlist->desc,
-					      overlap_conventional);
-			switch (r) {
-			case EFI_CARVE_OUT_OF_RESOURCES:
-				free(newlist);
-				return EFI_OUT_OF_RESOURCES;
-			case EFI_CARVE_OVERLAPS_NONRAM:
-				/*
-				 * The user requested to only have RAM overlaps,
-				 * but we hit a non-RAM region. Error out.
-				 */
-				free(newlist);
-				return EFI_NO_MAPPING;
-			case EFI_CARVE_NO_OVERLAP:
-				/* Just ignore this list entry */
-				break;
-			case EFI_CARVE_LOOP_AGAIN:
-				/*
-				 * We split an entry, but need to loop through
-				 * the list again to actually carve it.
-				 */
-				carve_again = true;
-				break;
-			default:
-				/* We carved a number of pages */
-				carved_pages += r;
-				carve_again = true;
-				break;
-			}
+	/*
+	 * The payload wanted to have RAM overlaps, but we overlapped with
+	 * non-RAM or an unallocated region. Error out.
+	 */
+	if (overlap_conventional && !efi_mem_is_free(start, end))
+		return EFI_NO_MAPPING;
 
-			if (carve_again) {
-				/* The list changed, we need to start over */
-				break;
-			}
+	if (!remove) {
+		newmem = calloc(1, sizeof(*newmem));
+		if (!newmem)
+			return EFI_OUT_OF_RESOURCES;
+		newmem->desc.type = memory_type;
+		desc_set_range(&newmem->desc, start, end);
+
+		switch (memory_type) {
+		case EFI_RUNTIME_SERVICES_CODE:
+		case EFI_RUNTIME_SERVICES_DATA:
+			newmem->desc.attribute = EFI_MEMORY_WB |
+						 EFI_MEMORY_RUNTIME;
+			break;
+		case EFI_MMAP_IO:
+			newmem->desc.attribute = EFI_MEMORY_RUNTIME;
+			break;
+		default:
+			newmem->desc.attribute = EFI_MEMORY_WB;
+			break;
 		}
-	} while (carve_again);
+	}
 
-	if (overlap_conventional && (carved_pages != pages)) {
-		/*
-		 * The payload wanted to have RAM overlaps, but we overlapped
-		 * with an unallocated region. Error out.
-		 */
-		free(newlist);
-		return EFI_NO_MAPPING;
+	if (efi_mem_carve_out(start, end)) {
+		free(newmem);
+		return EFI_OUT_OF_RESOURCES;
 	}
 
 	/* Add our new map */
-	if (!remove)
-		list_add_tail(&newlist->link, &efi_mem);
-	else
-		free(newlist);
-
-	/* And make sure memory is listed in descending order */
-	efi_mem_sort();
+	if (newmem) {
+		efi_mem_insert(newmem);
+		efi_mem_merge(newmem);
+	}
+	++efi_memory_map_key;
 
 	/* Notify that the memory map was changed */
 	list_for_each_entry(evt, &efi_events, link) {
@@ -423,20 +465,12 @@ efi_status_t efi_add_memory_map(u64 start, u64 size, int memory_type)
  */
 static efi_status_t efi_check_allocated(u64 addr, bool must_be_allocated)
 {
-	struct efi_mem_list *item;
-
-	list_for_each_entry(item, &efi_mem, link) {
-		u64 start = item->desc.physical_start;
-		u64 end = start + (item->desc.num_pages << EFI_PAGE_SHIFT);
+	struct efi_mem_node *item = efi_mem_find(addr);
 
-		if (addr >= start && addr < end) {
-			if (must_be_allocated ^
-			    (item->desc.type == EFI_CONVENTIONAL_MEMORY))
-				return EFI_SUCCESS;
-			else
-				return EFI_NOT_FOUND;
-		}
-	}
+	if (!item || addr >= desc_get_end(&item->desc))
+		return EFI_NOT_FOUND;
+	if (must_be_allocated ^ (item->desc.type == EFI_CONVENTIONAL_MEMORY))
+		return EFI_SUCCESS;
 
 	return EFI_NOT_FOUND;
 }
@@ -610,6 +644,158 @@ void *efi_alloc_aligned_pages(u64 len, int memory_type, size_t align)
 	return (void *)(uintptr_t)aligned_mem;
 }
 
+/**
+ * efi_pool_slab_class() - get the slab size class for a pool allocation
+ *
+ * @size:	number of bytes to be allocated
+ * Return:	size class, or -1 if the allocation is too large for a slab
+ */
+static int efi_pool_slab_class(efi_uintn_t size)
+{
+	efi_uintn_t obj_size = size + sizeof(struct efi_pool_allocation);
+
+	if (!IS_ENABLED(CONFIG_EFI_POOL_SLAB) ||
+	    obj_size > BIT(EFI_POOL_SLAB_MAX_SHIFT))
+		return -1;
+	if (obj_size <= BIT(EFI_POOL_SLAB_MIN_SHIFT))
+		return 0;
+
+	return order_base_2(obj_size) - EFI_POOL_SLAB_MIN_SHIFT;
+}
+
+/**
+ * efi_pool_slab_get() - get the slab holding a pool block
+ *
+ * @alloc:	header of the block
+ * Return:	slab, or NULL if @alloc is not a block in a slab
+ */
+static struct efi_pool_slab *efi_pool_slab_get(struct efi_pool_allocation *alloc)
+{
+	struct efi_pool_slab *slab;
+	uintptr_t first;
+
+	slab = (void *)((uintptr_t)alloc & ~(uintptr_t)(EFI_POOL_SLAB_SIZE - 1));
+	if (slab->magic != (EFI_POOL_SLAB_MAGIC ^ (uintptr_t)slab))
+		return NULL;
+	first = (uintptr_t)slab + ALIGN(sizeof(*slab), slab->obj_size);
+	if ((uintptr_t)alloc < first ||
+	    ((uintptr_t)alloc - first) % slab->obj_size)
+		return NULL;
+
+	return slab;
+}
+
+/**
+ * efi_pool_slab_new() - allocate a new slab
+ *
+ * @pool_type:	memory type of the slab
+ * @cls:	size class of the slab
+ * Return:	new slab, or NULL if out of memory
+ */
+static struct efi_pool_slab *efi_pool_slab_new(enum efi_memory_type pool_type,
+					       int cls)
+{
+	struct efi_pool_allocation **nextp;
+	struct efi_pool_slab *slab;
+	u32 obj_size = BIT(EFI_POOL_SLAB_MIN_SHIFT + cls);
+	uintptr_t pos, end;
+
+	slab = efi_alloc_aligned_pages(EFI_POOL_SLAB_SIZE, pool_type,
+				       EFI_POOL_SLAB_SIZE);
+	if (!slab)
+		return NULL;
+	slab->magic = EFI_POOL_SLAB_MAGIC ^ (uintptr_t)slab;
+	slab->memory_type = pool_type;
+	slab->obj_size = obj_size;
+	slab->count = 0;
+	slab->used = 0;
+
+	/* Chain all the blocks together, lowest address first */
+	nextp = &slab->free;
+	end = (uintptr_t)slab + EFI_POOL_SLAB_SIZE;
+	for (pos = (uintptr_t)slab + ALIGN(sizeof(*slab), obj_size); pos < end;
+	     pos += obj_size) {
+		*nextp = (struct efi_pool_allocation *)pos;
+		nextp = (struct efi_pool_allocation **)(*nextp)->data;
+		slab->count++;
+	}
+	*nextp = NULL;
+
+	if (!efi_pool_slabs[cls].next)
+		INIT_LIST_HEAD(&efi_pool_slabs[cls]);
+	list_add(&slab->link, &efi_pool_slabs[cls]);
+
+	return slab;
+}
+
+/**
+ * efi_pool_slab_alloc() - allocate a pool block from a slab
+ *
+ * @pool_type:	memory type of the block
+ * @cls:	size class of the block
+ * Return:	header of the block, or NULL if out of memory
+ */
+static struct efi_pool_allocation *
+efi_pool_slab_alloc(enum efi_memory_type pool_type, int cls)
+{
+	struct efi_pool_allocation *alloc;
+	struct efi_pool_slab *slab = NULL, *pos;
+
+	if (efi_pool_slabs[cls].next) {
+		list_for_each_entry(pos, &efi_pool_slabs[cls], link) {
+			/* Full slabs are kept at the end of the list */
+			if (!pos->free)
+				break;
+			if (pos->memory_type == pool_type) {
+				slab = pos;
+				break;
+			}
+		}
+	}
+	if (!slab) {
+		slab = efi_pool_slab_new(pool_type, cls);
+		if (!slab)
+			return NULL;
+	}
+
+	alloc = slab->free;
+	slab->free = *(struct efi_pool_allocation **)alloc->data;
+	slab->used++;
+	if (!slab->free)
+		list_move_tail(&slab->link, &efi_pool_slabs[cls]);
+	alloc->num_pages = 0;
+	alloc->checksum = checksum(alloc);
+
+	return alloc;
+}
+
+/**
+ * efi_pool_slab_free() - free a pool block in a slab
+ *
+ * The slab is freed once none of its blocks are in use.
+ *
+ * @slab:	slab holding the block
+ * @alloc:	header of the block, whose checksum has been cleared
+ * Return:	status code
+ */
+static efi_status_t efi_pool_slab_free(struct efi_pool_slab *slab,
+				       struct efi_pool_allocation *alloc)
+{
+	*(struct efi_pool_allocation **)alloc->data = slab->free;
+	if (!slab->free)
+		list_move(&slab->link, &efi_pool_slabs[ilog2(slab->obj_size) -
+						       EFI_POOL_SLAB_MIN_SHIFT]);
+	slab->free = alloc;
+	if (--slab->used)
+		return EFI_SUCCESS;
+
+	list_del(&slab->link);
+	slab->magic = 0;
+
+	return efi_free_pages((uintptr_t)slab,
+			      efi_size_in_pages(EFI_POOL_SLAB_SIZE));
+}
+
 /**
  * efi_allocate_pool - allocate memory from pool
  *
@@ -625,6 +811,7 @@ efi_status_t efi_allocate_pool(enum efi_memory_type pool_type, efi_uintn_t size,
 	struct efi_pool_allocation *alloc;
 	u64 num_pages = efi_size_in_pages(size +
 					  sizeof(struct efi_pool_allocation));
+	int cls;
 
 	if (!buffer)
 		return EFI_INVALID_PARAMETER;
@@ -634,6 +821,18 @@ efi_status_t efi_allocate_pool(enum efi_memory_type pool_type, efi_uintn_t size,
 		return EFI_SUCCESS;
 	}
 
+	cls = efi_pool_slab_class(size);
+	if (cls >= 0) {
+		if (pool_type >= EFI_PERSISTENT_MEMORY_TYPE &&
+		    pool_type <= 0x6FFFFFFF)
+			return EFI_INVALID_PARAMETER;
+		alloc = efi_pool_slab_alloc(pool_type, cls);
+		if (!alloc)
+			return EFI_OUT_OF_RESOURCES;
+		*buffer = alloc->data;
+		return EFI_SUCCESS;
+	}
+
 	r = efi_allocate_pages(EFI_ALLOCATE_ANY_PAGES, pool_type, num_pages,
 			       &addr);
 	if (r == EFI_SUCCESS) {
@@ -668,6 +867,33 @@ void *efi_alloc(size_t size)
 	return buf;
 }
 
+/**
+ * efi_pool_check() - check that memory was allocated by efi_allocate_pool()
+ *
+ * @buffer:	start of the memory
+ * @slabp:	returns the slab holding the memory, or NULL if the memory
+ *		is a separate page allocation
+ * Return:	header of the allocation, or NULL if it is not valid
+ */
+static struct efi_pool_allocation *efi_pool_check(void *buffer,
+						  struct efi_pool_slab **slabp)
+{
+	struct efi_pool_allocation *alloc;
+
+	alloc = container_of(buffer, struct efi_pool_allocation, data);
+	*slabp = NULL;
+	if (alloc->checksum != checksum(alloc))
+		return NULL;
+	if (!alloc->num_pages) {
+		*slabp = efi_pool_slab_get(alloc);
+		return *slabp ? alloc : NULL;
+	}
+	if ((uintptr_t)alloc & EFI_PAGE_MASK)
+		return NULL;
+
+	return alloc;
+}
+
 /**
  * efi_realloc() - reallocate boot services data pool memory
  *
@@ -682,9 +908,11 @@ efi_status_t efi_realloc(void **ptr, size_t size)
 	efi_status_t ret;
 	void *new_ptr;
 	struct efi_pool_allocation *alloc;
+	struct efi_pool_slab *slab;
 	u64 num_pages = efi_size_in_pages(size +
 					  sizeof(struct efi_pool_allocation));
 	size_t old_size;
+	int cls;
 
 	if (!*ptr) {
 		*ptr = efi_alloc(size);
@@ -697,21 +925,26 @@ efi_status_t efi_realloc(void **ptr, size_t size)
 	if (ret != EFI_SUCCESS)
 		return ret;
 
-	alloc = container_of(*ptr, struct efi_pool_allocation, data);
-
 	/* Check that this memory was allocated by efi_allocate_pool() */
-	if (((uintptr_t)alloc & EFI_PAGE_MASK) ||
-	    alloc->checksum != checksum(alloc)) {
+	alloc = efi_pool_check(*ptr, &slab);
+	if (!alloc) {
 		printf("%s: illegal realloc 0x%p\n", __func__, *ptr);
 		return EFI_INVALID_PARAMETER;
 	}
 
-	/* Don't realloc. The actual size in pages is the same. */
-	if (alloc->num_pages == num_pages)
-		return EFI_SUCCESS;
-
-	old_size = alloc->num_pages * EFI_PAGE_SIZE -
-		sizeof(struct efi_pool_allocation);
+	/* Don't realloc. The actual size of the block is the same. */
+	cls = efi_pool_slab_class(size);
+	if (slab) {
+		if (cls >= 0 &&
+		    BIT(EFI_POOL_SLAB_MIN_SHIFT + cls) == slab->obj_size)
+			return EFI_SUCCESS;
+		old_size = slab->obj_size;
+	} else {
+		if (cls < 0 && alloc->num_pages == num_pages)
+			return EFI_SUCCESS;
+		old_size = alloc->num_pages * EFI_PAGE_SIZE;
+	}
+	old_size -= sizeof(struct efi_pool_allocation);
 
 	new_ptr = efi_alloc(size);
 	if (!new_ptr)
@@ -738,6 +971,7 @@ efi_status_t efi_free_pool(void *buffer)
 {
 	efi_status_t ret;
 	struct efi_pool_allocation *alloc;
+	struct efi_pool_slab *slab;
 
 	if (!buffer)
 		return EFI_INVALID_PARAMETER;
@@ -746,22 +980,82 @@ efi_status_t efi_free_pool(void *buffer)
 	if (ret != EFI_SUCCESS)
 		return ret;
 
-	alloc = container_of(buffer, struct efi_pool_allocation, data);
-
 	/* Check that this memory was allocated by efi_allocate_pool() */
-	if (((uintptr_t)alloc & EFI_PAGE_MASK) ||
-	    alloc->checksum != checksum(alloc)) {
+	alloc = efi_pool_check(buffer, &slab);
+	if (!alloc) {
 		printf("%s: illegal free 0x%p\n", __func__, buffer);
 		return EFI_INVALID_PARAMETER;
 	}
 	/* Avoid double free */
 	alloc->checksum = 0;
 
+	if (slab)
+		return efi_pool_slab_free(slab, alloc);
+
 	ret = efi_free_pages((uintptr_t)alloc, alloc->num_pages);
 
 	return ret;
 }
 
+/**
+ * efi_dump_pool_slabs() - print the slabs used for small pool allocations
+ *
+ * For each slab this shows the block size, the memory type, the address and
+ * the number of blocks used out of the total.
+ */
+void efi_dump_pool_slabs(void)
+{
+	struct efi_pool_slab *slab;
+	int cls;
+
+	printf("Size Type     Start            Used\n");
+	printf("==== ======== ================ =========\n");
+	for (cls = 0; cls < EFI_POOL_SLAB_CLASSES; cls++) {
+		if (!efi_pool_slabs[cls].next)
+			continue;
+		list_for_each_entry(slab, &efi_pool_slabs[cls], link) {
+			printf("%4u %8x %16lx %4u/%-4u\n", slab->obj_size,
+			       slab->memory_type, (ulong)map_to_sysmem(slab),
+			       slab->used, slab->count);
+		}
+	}
+}
+
+/**
+ * efi_mem_serialize() - get the memory map as an array
+ *
+ * The array is kept until the memory map changes, so boot loaders which call
+ * GetMemoryMap() repeatedly, e.g. around ExitBootServices(), only pay for
+ * walking the map once.
+ *
+ * Return:	efi_mem_count descriptors in ascending order, or NULL if out
+ *		of memory
+ */
+static struct efi_mem_desc *efi_mem_serialize(void)
+{
+	struct efi_mem_node *mem;
+	struct efi_mem_desc *desc;
+
+	if (efi_mem_cache && efi_mem_cache_key == efi_memory_map_key)
+		return efi_mem_cache;
+
+	if (efi_mem_cache_size < efi_mem_count) {
+		desc = realloc(efi_mem_cache, efi_mem_count * sizeof(*desc));
+		if (!desc)
+			return NULL;
+		efi_mem_cache = desc;
+		efi_mem_cache_size = efi_mem_count;
+	}
+
+	desc = efi_mem_cache;
+	for (mem = efi_mem_entry(rb_first(&efi_mem)); mem;
+	     mem = efi_mem_next(mem))
+		*desc++ = mem->desc;
+	efi_mem_cache_key = efi_memory_map_key;
+
+	return efi_mem_cache;
+}
+
 /**
  * efi_get_memory_map() - get map describing memory usage.
  *
@@ -779,9 +1073,7 @@ efi_status_t efi_get_memory_map(efi_uintn_t *memory_map_size,
 				efi_uintn_t *descriptor_size,
 				uint32_t *descriptor_version)
 {
-	size_t map_entries;
 	efi_uintn_t map_size = 0;
-	struct efi_mem_list *lmem;
 	efi_uintn_t provided_map_size;
 
 	if (!memory_map_size)
@@ -789,9 +1081,7 @@ efi_status_t efi_get_memory_map(efi_uintn_t *memory_map_size,
 
 	provided_map_size = *memory_map_size;
 
-	map_entries = list_count_nodes(&efi_mem);
-
-	map_size = map_entries * sizeof(struct efi_mem_desc);
+	map_size = efi_mem_count * sizeof(struct efi_mem_desc);
 
 	*memory_map_size = map_size;
 
@@ -807,12 +1097,10 @@ efi_status_t efi_get_memory_map(efi_uintn_t *memory_map_size,
 	if (!memory_map)
 		return EFI_INVALID_PARAMETER;
 
-	/* Copy list into array */
-	/* Return the list in ascending order */
-	memory_map = &memory_map[map_entries - 1];
-	list_for_each_entry(lmem, &efi_mem, link) {
-		*memory_map = lmem->desc;
-		memory_map--;
+	if (map_size) {
+		if (!efi_mem_serialize())
+			return EFI_OUT_OF_RESOURCES;
+		memcpy(memory_map, efi_mem_cache, map_size);
 	}
 
 	if (map_key)
@@ -838,18 +1126,26 @@ efi_status_t efi_get_memory_map_alloc(efi_uintn_t *map_size,
 	*memory_map = NULL;
 	*map_size = 0;
 	ret = efi_get_memory_map(map_size, *memory_map, NULL, NULL, NULL);
-	if (ret == EFI_BUFFER_TOO_SMALL) {
+	while (ret == EFI_BUFFER_TOO_SMALL) {
+		/*
+		 * Allocating the buffer may split a free region or add a new
+		 * slab, so try again if the map has grown
+		 */
+		if (*memory_map)
+			efi_free_pool(*memory_map);
 		*map_size += sizeof(struct efi_mem_desc); /* for the map */
 		ret = efi_allocate_pool(EFI_BOOT_SERVICES_DATA, *map_size,
 					(void **)memory_map);
-		if (ret != EFI_SUCCESS)
-			return ret;
-		ret = efi_get_memory_map(map_size, *memory_map,
-					 NULL, NULL, NULL);
 		if (ret != EFI_SUCCESS) {
-			efi_free_pool(*memory_map);
 			*memory_map = NULL;
+			return ret;
 		}
+		ret = efi_get_memory_map(map_size, *memory_map,
+					 NULL, NULL, NULL);
+	}
+	if (ret != EFI_SUCCESS && *memory_map) {
+		efi_free_pool(*memory_map);
+		*memory_map = NULL;
 	}
 
 	return ret;
@@ -7,6 +7,7 @@
 
 #define LOG_CATEGORY LOGC_EFI
 
+#include <blk.h>
 #include <command.h>
 #include <cpu_func.h>
 #include <dm.h>
@@ -254,6 +255,11 @@ static void EFIAPI efi_reset_system_boottime(
 			break;
 		}
 	}
+
+	/* Do not lose writes held back by the block cache */
+	if (blkcache_flush(-1, 0))
+		log_err("Failed to write back the block cache\n");
+
 	switch (reset_type) {
 	case EFI_RESET_COLD:
 	case EFI_RESET_WARM:
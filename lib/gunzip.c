@@ -310,3 +310,61 @@ __rcode int zunzip(void *dst, int dstlen, unsigned char *src,
 
 	return err;
 }
+
+int gunzip_stream(void *dst, int dstlen, unsigned char *src,
+		  unsigned long *lenp, unsigned long chunk,
+		  void (*consume)(void *priv, const void *buf,
+				  unsigned long len),
+		  void *priv)
+{
+	unsigned long pos, len = *lenp;
+	z_stream s;
+	int offset;
+	int err = 0;
+	int r;
+
+	offset = gzip_parse_header(src, len);
+	if (offset < 0)
+		return offset;
+
+	s.zalloc = gzalloc;
+	s.zfree = gzfree;
+
+	r = inflateInit2(&s, -MAX_WBITS);
+	if (r != Z_OK) {
+		printf("Error: inflateInit2() returned %d\n", r);
+		return -1;
+	}
+	consume(priv, src, offset);
+	pos = offset;
+	s.avail_in = 0;
+	s.next_out = dst;
+	s.avail_out = dstlen;
+	do {
+		if (!s.avail_in) {
+			if (pos == len) {
+				puts("Error: gunzip out of data\n");
+				err = -1;
+				break;
+			}
+			s.next_in = src + pos;
+			s.avail_in = min(chunk, len - pos);
+			consume(priv, s.next_in, s.avail_in);
+			pos += s.avail_in;
+		}
+		r = inflate(&s, Z_NO_FLUSH);
+		if (r != Z_OK && r != Z_STREAM_END) {
+			printf("Error: inflate() returned %d\n", r);
+			err = r;
+			break;
+		}
+	} while (r != Z_STREAM_END);
+
+	/* pass on the trailer too, so that all the input is seen */
+	if (!err && pos < len)
+		consume(priv, src + pos, len - pos);
+	*lenp = s.next_out - (unsigned char *)dst;
+	inflateEnd(&s);
+
+	return err;
+}
@@ -113,6 +113,7 @@ int hcreate_r(size_t nel, struct hsearch_data *htab)
 
 	htab->size = nel;
 	htab->filled = 0;
+	htab->changes++;
 
 	/* allocate memory and zero out */
 	htab->table = (struct env_entry_node *)calloc(htab->size + 1,
@@ -155,6 +156,7 @@ void hdestroy_r(struct hsearch_data *htab)
 		}
 	}
 	free(htab->table);
+	htab->changes++;
 
 	/* the sign for an existing table is an value != NULL in htable */
 	htab->table = NULL;
@@ -283,12 +285,16 @@ static inline int _compare_and_overwrite_entry(struct env_entry item,
 				return 0;
 			}
 
-			free(htab->table[idx].entry.data);
-			htab->table[idx].entry.data = strdup(item.data);
-			if (!htab->table[idx].entry.data) {
-				__set_errno(ENOMEM);
-				*retval = NULL;
-				return 0;
+			/* Setting the same value again is not a change */
+			if (strcmp(htab->table[idx].entry.data, item.data)) {
+				free(htab->table[idx].entry.data);
+				htab->table[idx].entry.data = strdup(item.data);
+				if (!htab->table[idx].entry.data) {
+					__set_errno(ENOMEM);
+					*retval = NULL;
+					return 0;
+				}
+				htab->changes++;
 			}
 		}
 		/* return found entry */
@@ -409,6 +415,7 @@ int hsearch_r(struct env_entry item, enum env_action action,
 		}
 
 		++htab->filled;
+		htab->changes++;
 
 		/* This is a new entry, so look up a possible callback */
 		env_callback_init(&htab->table[idx].entry);
@@ -468,6 +475,7 @@ static void _hdelete(const char *key, struct hsearch_data *htab,
 	htab->table[idx].used = USED_DELETED;
 
 	--htab->filled;
+	htab->changes++;
 }
 
 int hdelete_r(const char *key, struct hsearch_data *htab, int flag)
@@ -49,98 +49,130 @@
 
 static void default_log(const char *ignored, char *response) {}
 
-static lbaint_t write_sparse_chunk_raw(struct sparse_storage *info,
-				       lbaint_t blk, lbaint_t blkcnt,
-				       void *data,
-				       char *response)
+static void sparse_stream_free(struct sparse_stream *ss)
 {
-	lbaint_t n = blkcnt, write_blks, blks = 0;
-	lbaint_t aligned_buf_blks = FASTBOOT_MAX_BLK_WRITE;
-	uint32_t *aligned_buf = NULL;
+	free(ss->buf);
+	ss->buf = NULL;
+	free(ss->fill_buf);
+	ss->fill_buf = NULL;
+}
 
-	if (CONFIG_IS_ENABLED(SYS_DCACHE_OFF)) {
-		write_blks = info->write(info, blk, n, data);
-		if (write_blks < n)
-			goto write_fail;
+/* Writes @blkcnt blocks from @data at the next block, which is advanced */
+static int sparse_stream_write_blks(struct sparse_stream *ss,
+				    const void *data, lbaint_t blkcnt,
+				    char *response)
+{
+	struct sparse_storage *info = ss->info;
+	lbaint_t blks;
 
-		return write_blks;
+	/* blks might be > blkcnt due to NAND bad-blocks */
+	blks = info->write(info, ss->blk, blkcnt, data);
+	if (IS_ERR_VALUE(blks)) {
+		printf("%s: Write failed, block #" LBAFU " [" LBAFU "] (%lld)\n",
+		       __func__, ss->blk, blkcnt, (long long)blks);
+		info->mssg("flash write failure", response);
+		return -1;
 	}
-
-	aligned_buf = memalign(ARCH_DMA_MINALIGN, info->blksz * aligned_buf_blks);
-	if (!aligned_buf) {
-		info->mssg("Malloc failed for: CHUNK_TYPE_RAW", response);
-		return -ENOMEM;
+	if (blks < blkcnt) {
+		printf("%s: Write failed, block #" LBAFU " [" LBAFU "]\n",
+		       __func__, ss->blk, blkcnt);
+		info->mssg("flash write failure(incomplete)", response);
+		return -1;
 	}
+	ss->blk += blks;
 
-	while (blkcnt > 0) {
-		n = min(aligned_buf_blks, blkcnt);
-		memcpy(aligned_buf, data, n * info->blksz);
+	return 0;
+}
 
-		/* write_blks might be > n due to NAND bad-blocks */
-		write_blks = info->write(info, blk + blks, n, aligned_buf);
-		if (write_blks < n) {
-			free(aligned_buf);
-			goto write_fail;
-		}
+static int sparse_stream_flush_raw(struct sparse_stream *ss, char *response)
+{
+	lbaint_t blkcnt = ss->buf_len / ss->info->blksz;
 
-		blks += write_blks;
-		data += n * info->blksz;
-		blkcnt -= n;
-	}
+	if (!blkcnt)
+		return 0;
+	ss->buf_len = 0;
 
-	free(aligned_buf);
-	return blks;
+	return sparse_stream_write_blks(ss, ss->buf, blkcnt, response);
+}
 
-write_fail:
-	if (IS_ERR_VALUE(write_blks)) {
-		printf("%s: Write failed, block #" LBAFU " [" LBAFU "] (%lld)\n",
-		       __func__, blk + blks, n, (long long)write_blks);
-		info->mssg("flash write failure", response);
-		return write_blks;
+static int sparse_stream_raw(struct sparse_stream *ss, const void *data,
+			     size_t len, char *response)
+{
+	lbaint_t blksz = ss->info->blksz;
+	lbaint_t buf_size = blksz * FASTBOOT_MAX_BLK_WRITE;
+	lbaint_t blkcnt;
+	size_t n;
+	int ret;
+
+	while (len) {
+		/* Write straight from @data if the hardware can use it */
+		if (!ss->buf_len && len >= blksz &&
+		    (CONFIG_IS_ENABLED(SYS_DCACHE_OFF) ||
+		     IS_ALIGNED((ulong)data, ARCH_DMA_MINALIGN))) {
+			blkcnt = min_t(lbaint_t, len / blksz,
+				       FASTBOOT_MAX_BLK_WRITE);
+			ret = sparse_stream_write_blks(ss, data, blkcnt,
+						       response);
+			if (ret)
+				return ret;
+			n = blkcnt * blksz;
+		} else {
+			n = min_t(size_t, len, buf_size - ss->buf_len);
+			memcpy(ss->buf + ss->buf_len, data, n);
+			ss->buf_len += n;
+			if (ss->buf_len == buf_size) {
+				ret = sparse_stream_flush_raw(ss, response);
+				if (ret)
+					return ret;
+			}
+		}
+		data += n;
+		len -= n;
 	}
 
-	/* write_blks < n */
-	printf("%s: Write failed, block #" LBAFU " [" LBAFU "]\n",
-	       __func__, blk + blks, n);
-	info->mssg("flash write failure(incomplete)", response);
-	return -1;
+	return 0;
 }
 
-int write_sparse_image(struct sparse_storage *info,
-		       const char *part_name, void *data, char *response)
+static int sparse_stream_fill(struct sparse_stream *ss, lbaint_t blkcnt,
+			      char *response)
 {
-	lbaint_t blk;
-	lbaint_t blkcnt;
-	lbaint_t blks;
-	uint64_t bytes_written = 0;
-	unsigned int chunk;
-	unsigned int offset;
-	uint64_t chunk_data_sz;
-	uint32_t *fill_buf = NULL;
-	uint32_t fill_val;
-	sparse_header_t *sparse_header;
-	chunk_header_t *chunk_header;
-	uint32_t total_blocks = 0;
+	struct sparse_storage *info = ss->info;
 	int fill_buf_num_blks;
-	int i;
-	int j;
+	lbaint_t i, j;
+	int ret;
 
 	fill_buf_num_blks = CONFIG_IMAGE_SPARSE_FILLBUF_SIZE / info->blksz;
+	for (i = 0; i < info->blksz * fill_buf_num_blks / sizeof(u32); i++)
+		ss->fill_buf[i] = ss->fill_val;
+
+	for (i = 0; i < blkcnt; i += j) {
+		j = min_t(lbaint_t, blkcnt - i, fill_buf_num_blks);
+		ret = sparse_stream_write_blks(ss, ss->fill_buf, j, response);
+		if (ret)
+			return ret;
+	}
 
-	/* Read and skip over sparse image header */
-	sparse_header = (sparse_header_t *)data;
+	return 0;
+}
 
-	data += sparse_header->file_hdr_sz;
-	if (sparse_header->file_hdr_sz > sizeof(sparse_header_t)) {
-		/*
-		 * Skip the remaining bytes in a header that is longer than
-		 * we expected.
-		 */
-		data += (sparse_header->file_hdr_sz - sizeof(sparse_header_t));
+/* Sets up to read the next chunk header, if there is another chunk */
+static void sparse_stream_next_chunk(struct sparse_stream *ss)
+{
+	ss->pos = 0;
+	if (ss->chunk_num == ss->header.total_chunks) {
+		ss->state = SPARSE_STREAM_DONE;
+		return;
 	}
+	ss->state = SPARSE_STREAM_CHUNK_HEADER;
+	ss->len = ss->header.chunk_hdr_sz;
+}
 
-	if (!info->mssg)
-		info->mssg = default_log;
+static int sparse_stream_check_header(struct sparse_stream *ss,
+				      char *response)
+{
+	sparse_header_t *sparse_header = &ss->header;
+	struct sparse_storage *info = ss->info;
+	unsigned int offset;
 
 	debug("=== Sparse Image Header ===\n");
 	debug("magic: 0x%x\n", sparse_header->magic);
@@ -152,6 +184,14 @@ int write_sparse_image(struct sparse_storage *info,
 	debug("total_blks: %d\n", sparse_header->total_blks);
 	debug("total_chunks: %d\n", sparse_header->total_chunks);
 
+	if (!is_sparse_image(sparse_header) ||
+	    sparse_header->file_hdr_sz < sizeof(sparse_header_t) ||
+	    sparse_header->chunk_hdr_sz < sizeof(chunk_header_t)) {
+		printf("%s: Invalid sparse image header\n", __func__);
+		info->mssg("invalid sparse image header", response);
+		return -1;
+	}
+
 	/*
 	 * Verify that the sparse block size is a multiple of our
 	 * storage backend block size
@@ -166,153 +206,287 @@ int write_sparse_image(struct sparse_storage *info,
 
 	puts("Flashing Sparse Image\n");
 
-	/* Start processing chunks */
-	blk = info->start;
-	for (chunk = 0; chunk < sparse_header->total_chunks; chunk++) {
-		/* Read and skip over chunk header */
-		chunk_header = (chunk_header_t *)data;
-		data += sizeof(chunk_header_t);
-
-		if (chunk_header->chunk_type != CHUNK_TYPE_RAW) {
-			debug("=== Chunk Header ===\n");
-			debug("chunk_type: 0x%x\n", chunk_header->chunk_type);
-			debug("chunk_data_sz: 0x%x\n", chunk_header->chunk_sz);
-			debug("total_size: 0x%x\n", chunk_header->total_sz);
-		}
+	return 0;
+}
 
-		if (sparse_header->chunk_hdr_sz > sizeof(chunk_header_t)) {
-			/*
-			 * Skip the remaining bytes in a header that is longer
-			 * than we expected.
-			 */
-			data += (sparse_header->chunk_hdr_sz -
-				 sizeof(chunk_header_t));
-		}
+static int sparse_stream_start_chunk(struct sparse_stream *ss,
+				     char *response)
+{
+	chunk_header_t *chunk_header = &ss->chunk;
+	struct sparse_storage *info = ss->info;
+	uint64_t chunk_data_sz;
+	uint64_t data_sz;
+	lbaint_t blkcnt;
+
+	if (chunk_header->chunk_type != CHUNK_TYPE_RAW) {
+		debug("=== Chunk Header ===\n");
+		debug("chunk_type: 0x%x\n", chunk_header->chunk_type);
+		debug("chunk_data_sz: 0x%x\n", chunk_header->chunk_sz);
+		debug("total_size: 0x%x\n", chunk_header->total_sz);
+	}
 
-		chunk_data_sz = ((u64)sparse_header->blk_sz) * chunk_header->chunk_sz;
-		blkcnt = DIV_ROUND_UP_ULL(chunk_data_sz, info->blksz);
+	chunk_data_sz = ((u64)ss->header.blk_sz) * chunk_header->chunk_sz;
+	blkcnt = DIV_ROUND_UP_ULL(chunk_data_sz, info->blksz);
+
+	switch (chunk_header->chunk_type) {
+	case CHUNK_TYPE_RAW:
+		data_sz = chunk_data_sz;
+		break;
+	case CHUNK_TYPE_FILL:
+	case CHUNK_TYPE_CRC32:
+		data_sz = sizeof(uint32_t);
+		break;
+	case CHUNK_TYPE_DONT_CARE:
+		data_sz = 0;
+		break;
+	default:
+		printf("%s: Unknown chunk type: %x\n", __func__,
+		       chunk_header->chunk_type);
+		info->mssg("Unknown chunk type", response);
+		return -1;
+	}
+
+	if (chunk_header->total_sz != ss->header.chunk_hdr_sz + data_sz) {
 		switch (chunk_header->chunk_type) {
 		case CHUNK_TYPE_RAW:
-			if (chunk_header->total_sz !=
-			    (sparse_header->chunk_hdr_sz + chunk_data_sz)) {
-				info->mssg("Bogus chunk size for chunk type Raw",
-					   response);
-				return -1;
-			}
+			info->mssg("Bogus chunk size for chunk type Raw",
+				   response);
+			break;
+		case CHUNK_TYPE_FILL:
+			info->mssg("Bogus chunk size for chunk type FILL",
+				   response);
+			break;
+		case CHUNK_TYPE_CRC32:
+			info->mssg("Bogus chunk size for chunk type CRC32",
+				   response);
+			break;
+		default:
+			info->mssg("Bogus chunk size for chunk type Dont Care",
+				   response);
+			break;
+		}
+		return -1;
+	}
 
-			if (blk + blkcnt > info->start + info->size) {
-				printf(
-				    "%s: Request would exceed partition size!\n",
-				    __func__);
-				info->mssg("Request would exceed partition size!",
-					   response);
-				return -1;
-			}
+	/* Don't-care regions are only written to when they are discarded */
+	if ((chunk_header->chunk_type == CHUNK_TYPE_RAW ||
+	     chunk_header->chunk_type == CHUNK_TYPE_FILL ||
+	     (chunk_header->chunk_type == CHUNK_TYPE_DONT_CARE &&
+	      info->discard)) &&
+	    ss->blk + blkcnt > info->start + info->size) {
+		printf("%s: Request would exceed partition size!\n", __func__);
+		info->mssg("Request would exceed partition size!", response);
+		return -1;
+	}
 
-			blks = write_sparse_chunk_raw(info, blk, blkcnt,
-						      data, response);
-			if (IS_ERR_VALUE(blks))
-				return -1;
+	if (chunk_header->chunk_type == CHUNK_TYPE_RAW && !ss->buf) {
+		ss->buf = memalign(ARCH_DMA_MINALIGN,
+				   info->blksz * FASTBOOT_MAX_BLK_WRITE);
+		if (!ss->buf) {
+			info->mssg("Malloc failed for: CHUNK_TYPE_RAW",
+				   response);
+			return -1;
+		}
+	}
+	if (chunk_header->chunk_type == CHUNK_TYPE_FILL && !ss->fill_buf) {
+		ss->fill_buf = memalign(ARCH_DMA_MINALIGN,
+					ROUNDUP(CONFIG_IMAGE_SPARSE_FILLBUF_SIZE,
+						ARCH_DMA_MINALIGN));
+		if (!ss->fill_buf) {
+			info->mssg("Malloc failed for: CHUNK_TYPE_FILL",
+				   response);
+			return -1;
+		}
+	}
 
-			blk += blks;
-			bytes_written += ((u64)blkcnt) * info->blksz;
-			total_blocks += chunk_header->chunk_sz;
-			data += chunk_data_sz;
-			break;
+	ss->state = SPARSE_STREAM_CHUNK_DATA;
+	ss->pos = 0;
+	ss->len = data_sz;
 
-		case CHUNK_TYPE_FILL:
-			if (chunk_header->total_sz !=
-			    (sparse_header->chunk_hdr_sz + sizeof(uint32_t))) {
-				info->mssg("Bogus chunk size for chunk type FILL", response);
-				return -1;
-			}
+	return 0;
+}
 
-			fill_buf = (uint32_t *)
-				   memalign(ARCH_DMA_MINALIGN,
-					    ROUNDUP(
-						info->blksz * fill_buf_num_blks,
-						ARCH_DMA_MINALIGN));
-			if (!fill_buf) {
-				info->mssg("Malloc failed for: CHUNK_TYPE_FILL",
-					   response);
-				return -1;
-			}
+static int sparse_stream_end_chunk(struct sparse_stream *ss, char *response)
+{
+	chunk_header_t *chunk_header = &ss->chunk;
+	struct sparse_storage *info = ss->info;
+	uint64_t chunk_data_sz;
+	lbaint_t blkcnt;
+	int ret;
+
+	chunk_data_sz = ((u64)ss->header.blk_sz) * chunk_header->chunk_sz;
+	blkcnt = DIV_ROUND_UP_ULL(chunk_data_sz, info->blksz);
+
+	switch (chunk_header->chunk_type) {
+	case CHUNK_TYPE_RAW:
+		ret = sparse_stream_flush_raw(ss, response);
+		if (ret)
+			return ret;
+		ss->bytes_written += ((u64)blkcnt) * info->blksz;
+		break;
+	case CHUNK_TYPE_FILL:
+		ret = sparse_stream_fill(ss, blkcnt, response);
+		if (ret)
+			return ret;
+		ss->bytes_written += ((u64)blkcnt) * info->blksz;
+		break;
+	case CHUNK_TYPE_DONT_CARE:
+		if (info->discard)
+			ss->blk += info->discard(info, ss->blk, blkcnt);
+		else
+			ss->blk += info->reserve(info, ss->blk, blkcnt);
+		break;
+	}
+	ss->total_blocks += chunk_header->chunk_sz;
+	ss->chunk_num++;
+	sparse_stream_next_chunk(ss);
 
-			fill_val = *(uint32_t *)data;
-			data = (char *)data + sizeof(uint32_t);
-
-			for (i = 0;
-			     i < (info->blksz * fill_buf_num_blks /
-				  sizeof(fill_val));
-			     i++)
-				fill_buf[i] = fill_val;
-
-			if (blk + blkcnt > info->start + info->size) {
-				printf(
-				    "%s: Request would exceed partition size!\n",
-				    __func__);
-				info->mssg("Request would exceed partition size!",
-					   response);
-				return -1;
-			}
+	return 0;
+}
 
-			for (i = 0; i < blkcnt;) {
-				j = blkcnt - i;
-				if (j > fill_buf_num_blks)
-					j = fill_buf_num_blks;
-				blks = info->write(info, blk, j, fill_buf);
-				/* blks might be > j (eg. NAND bad-blocks) */
-				if (blks < j) {
-					printf("%s: %s " LBAFU " [%d]\n",
-					       __func__,
-					       "Write failed, block #",
-					       blk, j);
-					info->mssg("flash write failure",
-						   response);
-					free(fill_buf);
-					return -1;
-				}
-				blk += blks;
-				i += j;
-			}
-			bytes_written += ((u64)blkcnt) * info->blksz;
-			total_blocks += DIV_ROUND_UP_ULL(chunk_data_sz,
-							 sparse_header->blk_sz);
-			free(fill_buf);
-			break;
+/* Moves on once the current header or chunk data is complete */
+static int sparse_stream_next(struct sparse_stream *ss, char *response)
+{
+	int ret;
 
-		case CHUNK_TYPE_DONT_CARE:
-			blk += info->reserve(info, blk, blkcnt);
-			total_blocks += chunk_header->chunk_sz;
-			break;
+	switch (ss->state) {
+	case SPARSE_STREAM_HEADER:
+		if (ss->pos == sizeof(sparse_header_t)) {
+			ret = sparse_stream_check_header(ss, response);
+			if (ret)
+				return ret;
 
-		case CHUNK_TYPE_CRC32:
-			if (chunk_header->total_sz !=
-			    sparse_header->chunk_hdr_sz + sizeof(uint32_t)) {
-				info->mssg("Bogus chunk size for chunk type CRC32",
-					   response);
-				return -1;
-			}
-			total_blocks += chunk_header->chunk_sz;
-			data += chunk_data_sz;
-			break;
+			/*
+			 * Skip the remaining bytes in a header that is longer
+			 * than we expected.
+			 */
+			ss->len = ss->header.file_hdr_sz;
+			if (ss->pos < ss->len)
+				return 0;
+		}
+		sparse_stream_next_chunk(ss);
+		return 0;
+	case SPARSE_STREAM_CHUNK_HEADER:
+		ret = sparse_stream_start_chunk(ss, response);
+		if (ret || ss->len)
+			return ret;
+		fallthrough;
+	case SPARSE_STREAM_CHUNK_DATA:
+		return sparse_stream_end_chunk(ss, response);
+	default:
+		return 0;
+	}
+}
 
+void sparse_stream_init(struct sparse_stream *ss, struct sparse_storage *info,
+			const char *part_name)
+{
+	memset(ss, '\0', sizeof(*ss));
+	ss->info = info;
+	ss->part_name = part_name;
+	ss->state = SPARSE_STREAM_HEADER;
+	ss->len = sizeof(sparse_header_t);
+	ss->blk = info->start;
+	if (!info->mssg)
+		info->mssg = default_log;
+}
+
+int sparse_stream_write(struct sparse_stream *ss, const void *data,
+			size_t len, char *response)
+{
+	size_t n;
+	int ret;
+
+	while (len && ss->state < SPARSE_STREAM_DONE) {
+		n = min_t(size_t, len, ss->len - ss->pos);
+		switch (ss->state) {
+		case SPARSE_STREAM_HEADER:
+			if (ss->pos < sizeof(sparse_header_t))
+				memcpy((void *)&ss->header + ss->pos, data,
+				       min_t(size_t, n,
+					     sizeof(sparse_header_t) - ss->pos));
+			break;
+		case SPARSE_STREAM_CHUNK_HEADER:
+			if (ss->pos < sizeof(chunk_header_t))
+				memcpy((void *)&ss->chunk + ss->pos, data,
+				       min_t(size_t, n,
+					     sizeof(chunk_header_t) - ss->pos));
+			break;
 		default:
-			printf("%s: Unknown chunk type: %x\n", __func__,
-			       chunk_header->chunk_type);
-			info->mssg("Unknown chunk type", response);
-			return -1;
+			if (ss->chunk.chunk_type == CHUNK_TYPE_RAW) {
+				ret = sparse_stream_raw(ss, data, n, response);
+				if (ret)
+					goto err;
+			} else if (ss->chunk.chunk_type == CHUNK_TYPE_FILL) {
+				memcpy((void *)&ss->fill_val + ss->pos, data,
+				       n);
+			}
+			break;
 		}
+		ss->pos += n;
+		data += n;
+		len -= n;
+
+		if (ss->pos == ss->len) {
+			ret = sparse_stream_next(ss, response);
+			if (ret)
+				goto err;
+		}
+	}
+
+	return ss->state == SPARSE_STREAM_ERROR ? -1 : 0;
+
+err:
+	sparse_stream_free(ss);
+	ss->state = SPARSE_STREAM_ERROR;
+
+	return ret;
+}
+
+int sparse_stream_finish(struct sparse_stream *ss, char *response)
+{
+	struct sparse_storage *info = ss->info;
+
+	sparse_stream_free(ss);
+	if (ss->state == SPARSE_STREAM_ERROR)
+		return -1;
+	if (ss->state != SPARSE_STREAM_DONE) {
+		printf("%s: Sparse image is incomplete\n", __func__);
+		info->mssg("sparse image is incomplete", response);
+		return -1;
 	}
 
 	debug("Wrote %d blocks, expected to write %d blocks\n",
-	      total_blocks, sparse_header->total_blks);
-	printf("........ wrote %llu bytes to '%s'\n", bytes_written, part_name);
+	      ss->total_blocks, ss->header.total_blks);
+	printf("........ wrote %llu bytes to '%s'\n", ss->bytes_written,
+	       ss->part_name);
 
-	if (total_blocks != sparse_header->total_blks) {
+	if (ss->total_blocks != ss->header.total_blks) {
 		info->mssg("sparse image write failure", response);
 		return -1;
 	}
 
 	return 0;
 }
+
+int write_sparse_image(struct sparse_storage *info,
+		       const char *part_name, void *data, char *response)
+{
+	struct sparse_stream ss;
+	size_t len;
+
+	sparse_stream_init(&ss, info, part_name);
+
+	/*
+	 * The whole image is in memory, so pass each header and each chunk's
+	 * data in one go
+	 */
+	while (ss.state < SPARSE_STREAM_DONE) {
+		len = ss.len - ss.pos;
+		if (sparse_stream_write(&ss, data, len, response))
+			break;
+		data += len;
+	}
+
+	return sparse_stream_finish(&ss, response);
+}
@@ -108,6 +108,8 @@ bool uthread_schedule(void)
 	struct uthread *tmp;
 
 	list_for_each_entry_safe(next, tmp, &current->list, list) {
+		if (next->parked)
+			continue;
 		if (!next->done) {
 			uthread_resume(next);
 			return true;
@@ -119,6 +121,11 @@ bool uthread_schedule(void)
 	return false;
 }
 
+struct uthread *uthread_self(void)
+{
+	return current;
+}
+
 unsigned int uthread_grp_new_id(void)
 {
 	static unsigned int id;
@@ -163,3 +170,123 @@ int uthread_mutex_unlock(struct uthread_mutex *mutex)
 
 	return 0;
 }
+
+static void uthread_wq_worker(void *arg)
+{
+	struct uthread_wq *wq = arg;
+	struct uthread_work *work;
+
+	while (!wq->stop || !list_empty(&wq->pending)) {
+		if (list_empty(&wq->pending)) {
+			/* sleep until uthread_wq_wake() finds work for us */
+			current->parked = true;
+			uthread_schedule();
+			continue;
+		}
+		work = list_first_entry(&wq->pending, struct uthread_work,
+					list);
+		list_move_tail(&work->list, &wq->running);
+		work->state = UTHREAD_WORK_RUNNING;
+		work->fn(work->arg);
+		list_del_init(&work->list);
+		work->state = UTHREAD_WORK_IDLE;
+	}
+}
+
+/* Lets one parked worker of @wq run again, or all of them if @all is true */
+static void uthread_wq_wake(struct uthread_wq *wq, bool all)
+{
+	struct uthread *thr;
+
+	list_for_each_entry(thr, &main_thread.list, list) {
+		if (thr->grp_id == wq->grp_id && thr->parked) {
+			thr->parked = false;
+			if (!all)
+				break;
+		}
+	}
+}
+
+int uthread_wq_init(struct uthread_wq *wq, int workers, size_t stack_sz)
+{
+	int i;
+
+	if (workers < 1)
+		return -EINVAL;
+	INIT_LIST_HEAD(&wq->pending);
+	INIT_LIST_HEAD(&wq->running);
+	wq->grp_id = uthread_grp_new_id();
+	wq->stop = false;
+
+	for (i = 0; i < workers; i++) {
+		if (uthread_create(NULL, uthread_wq_worker, wq, stack_sz,
+				   wq->grp_id)) {
+			uthread_wq_destroy(wq);
+			return -ENOMEM;
+		}
+	}
+
+	return 0;
+}
+
+void uthread_wq_destroy(struct uthread_wq *wq)
+{
+	wq->stop = true;
+	uthread_wq_wake(wq, true);
+	while (!uthread_grp_done(wq->grp_id))
+		uthread_schedule();
+}
+
+int uthread_wq_submit(struct uthread_wq *wq, struct uthread_work *work)
+{
+	if (work->state != UTHREAD_WORK_IDLE)
+		return -EBUSY;
+
+	work->state = UTHREAD_WORK_PENDING;
+	list_add_tail(&work->list, &wq->pending);
+	uthread_wq_wake(wq, false);
+
+	return 0;
+}
+
+int uthread_work_cancel(struct uthread_work *work)
+{
+	switch (work->state) {
+	case UTHREAD_WORK_PENDING:
+		list_del_init(&work->list);
+		work->state = UTHREAD_WORK_IDLE;
+		return 0;
+	case UTHREAD_WORK_RUNNING:
+		return -EBUSY;
+	default:
+		return -EALREADY;
+	}
+}
+
+void uthread_work_wait(struct uthread_work *work)
+{
+	while (work->state != UTHREAD_WORK_IDLE)
+		uthread_schedule();
+}
+
+bool uthread_wq_grp_done(struct uthread_wq *wq, unsigned int grp_id)
+{
+	struct uthread_work *work;
+
+	list_for_each_entry(work, &wq->pending, list) {
+		if (work->grp_id == grp_id)
+			return false;
+	}
+	list_for_each_entry(work, &wq->running, list) {
+		if (work->grp_id == grp_id)
+			return false;
+	}
+
+	return true;
+}
+
+void uthread_wq_grp_wait(struct uthread_wq *wq, unsigned int grp_id)
+{
+	while (!uthread_wq_grp_done(wq, grp_id))
+		uthread_schedule();
+}
@@ -35,6 +35,11 @@ DECLARE_GLOBAL_DATA_PTR;
 #define WELL_KNOWN_PORT	69
 /* Millisecs to timeout for lost pkt */
 #define TIMEOUT		5000UL
+/*
+ * Least millisecs to wait for the rest of a window before acknowledging
+ * early. Slower links wait a few round-trip times instead
+ */
+#define WINDOW_TIMEOUT	100UL
 /* Number of "loading" hashes per line (for checking the image size) */
 #define HASHES_PER_LINE	65
 
@@ -104,6 +109,16 @@ static ushort	tftp_windowsize;
 static ushort	tftp_next_ack;
 /* Last nack block we send */
 static ushort	tftp_last_nack;
+/* Number of times blocks were lost during this transfer */
+static int	tftp_window_losses;
+/* Smoothed round-trip time to the server in ms, 0 if not measured yet */
+static ulong	tftp_srtt;
+/* Time at which the packet being timed was sent */
+static ulong	tftp_rtt_start;
+/* true if waiting for the reply to a packet to measure the round trip */
+static bool	tftp_rtt_timing;
+/* Number of bytes of the file for which memory has been reserved */
+static ulong	tftp_load_reserved;
 #ifdef CMD_TFTPPUT
 /* 1 if writing, else 0 */
 static int	tftp_put_active;
@@ -158,6 +173,49 @@ static char tftp_filename[MAX_LEN];
 static unsigned short tftp_block_size = TFTP_BLOCK_SIZE;
 static unsigned short tftp_block_size_option = CONFIG_TFTP_BLOCKSIZE;
 static unsigned short tftp_window_size_option = TFTP_WINDOWSIZE;
+/* Largest window to grow to, unless tftp_window_size_option is larger */
+#define TFTP_WINDOWSIZE_MAX	64
+/*
+ * Window size to ask for. This starts at tftp_window_size_option, is halved
+ * after a transfer which loses blocks and doubled after one which does not,
+ * up to TFTP_WINDOWSIZE_MAX
+ */
+static unsigned short tftp_window_size_req = TFTP_WINDOWSIZE;
+/* Value of tftp_window_size_option which tftp_window_size_req started at */
+static unsigned short tftp_window_size_base = TFTP_WINDOWSIZE;
+/* true once the server has accepted the windowsize option */
+static bool tftp_window_negotiated;
+
+/* Start timing the round trip of the packet just sent */
+static void tftp_rtt_begin(void)
+{
+	tftp_rtt_start = get_timer(0);
+	tftp_rtt_timing = true;
+}
+
+/* A reply arrived, so fold its round-trip time into the smoothed one */
+static void tftp_rtt_end(void)
+{
+	ulong rtt;
+
+	if (!tftp_rtt_timing)
+		return;
+	tftp_rtt_timing = false;
+	rtt = max(get_timer(tftp_rtt_start), 1UL);
+	tftp_srtt = tftp_srtt ? (tftp_srtt * 7 + rtt) / 8 : rtt;
+}
+
+/*
+ * Millisecs to wait for the rest of a window: a few round trips, but not
+ * less than WINDOW_TIMEOUT nor more than the timeout for a lost packet
+ */
+static ulong tftp_window_timeout(void)
+{
+	if (!tftp_srtt)
+		return timeout_ms;
+
+	return clamp(tftp_srtt * 4, WINDOW_TIMEOUT, timeout_ms);
+}
 
 static inline int store_block(int block, uchar *src, unsigned int len)
 {
@@ -167,13 +225,24 @@ static inline int store_block(int block, uchar *src, unsigned int len)
 	ulong store_addr = tftp_load_addr + offset;
 	void *ptr;
 
-	if (CONFIG_IS_ENABLED(LMB)) {
+	if (CONFIG_IS_ENABLED(LMB) && newsize > tftp_load_reserved) {
+		ulong end = newsize;
+
+#ifdef CONFIG_TFTP_TSIZE
+		/*
+		 * Reserve memory for the whole file at once if the server told
+		 * us its size, rather than for each block
+		 */
+		if ((ulong)tftp_tsize > end)
+			end = tftp_tsize;
+#endif
 		if (store_addr < tftp_load_addr ||
-		    lmb_read_check(store_addr, len)) {
+		    lmb_read_check(store_addr, end - offset)) {
 			puts("\nTFTP error: ");
 			puts("trying to overwrite reserved memory...\n");
 			return -1;
 		}
+		tftp_load_reserved = end;
 	}
 
 	ptr = map_sysmem(store_addr, len);
@@ -192,6 +261,8 @@ static void new_transfer(void)
 	tftp_prev_block = 0;
 	tftp_block_wrap = 0;
 	tftp_block_wrap_offset = 0;
+	tftp_load_reserved = 0;
+	tftp_window_losses = 0;
 #ifdef CMD_TFTPPUT
 	tftp_put_final_block_sent = 0;
 #endif
@@ -224,6 +295,7 @@ static int load_block(unsigned block, uchar *dst, unsigned len)
 
 static void tftp_send(void);
 static void tftp_timeout_handler(void);
+static void tftp_window_timeout_handler(void);
 
 /**********************************************************************/
 
@@ -308,6 +380,17 @@ static void tftp_complete(void)
 
 	led_activity_off();
 
+	/* Ask for a larger window next time, unless blocks were lost */
+	if (tftp_window_negotiated && tftp_window_size_option > 1 &&
+	    !tftp_put_active) {
+		if (tftp_window_losses)
+			tftp_window_size_req = max(tftp_window_size_req / 2, 1);
+		else
+			tftp_window_size_req = min(tftp_window_size_req * 2,
+						   max(TFTP_WINDOWSIZE_MAX,
+						       (int)tftp_window_size_option));
+	}
+
 	if (!tftp_put_active)
 		efi_set_bootdev("Net", "", tftp_filename,
 				map_sysmem(tftp_load_addr, 0),
@@ -364,11 +447,13 @@ static void tftp_send(void)
 
 		/* try for more effic. window size.
 		 * Implemented only for tftp get.
-		 * Don't bother sending if it's 1
+		 * Don't bother sending if it's 1, unless the server has
+		 * accepted it before, so that it can grow again
 		 */
-		if (tftp_state == STATE_SEND_RRQ && tftp_window_size_option > 1)
+		if (tftp_state == STATE_SEND_RRQ &&
+		    (tftp_window_size_req > 1 || tftp_window_negotiated))
 			pkt += sprintf((char *)pkt, "windowsize%c%d%c",
-					0, tftp_window_size_option, 0);
+					0, tftp_window_size_req, 0);
 		len = pkt - xp;
 		break;
 
@@ -539,6 +624,7 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 				debug("%c", pkt[i]);
 		}
 		debug("\n");
+		tftp_rtt_end();
 		tftp_state = STATE_OACK;
 		tftp_remote_port = src;
 		/*
@@ -580,6 +666,7 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			if (strcasecmp((char *)pkt + i,  "windowsize") == 0) {
 				tftp_windowsize =
 					dectoul((char *)pkt + i + 11, NULL);
+				tftp_window_negotiated = true;
 				debug("windowsize = %s, %d\n",
 				      (char *)pkt + i + 11, tftp_windowsize);
 			}
@@ -595,6 +682,7 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		}
 #endif
 		tftp_send(); /* Send ACK or first data block */
+		tftp_rtt_begin();
 		break;
 	case TFTP_DATA:
 		if (len < 2)
@@ -620,6 +708,8 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			 * This just overwellms the server, let's just send one.
 			 */
 			if (tftp_last_nack != tftp_cur_block) {
+				tftp_window_losses++;
+				tftp_rtt_timing = false;
 				tftp_send();
 				tftp_last_nack = tftp_cur_block;
 				tftp_next_ack = (ushort)(tftp_cur_block +
@@ -657,11 +747,21 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			/* Same block again; ignore it. */
 			break;
 		}
+		tftp_rtt_end();
 
 		update_block_number();
 		tftp_prev_block = tftp_cur_block;
 		timeout_count_max = tftp_timeout_count_max;
-		net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
+		/*
+		 * The rest of a window follows straight away, so do not wait
+		 * long for it in case its last blocks were lost
+		 */
+		if (tftp_cur_block != tftp_next_ack)
+			net_set_timeout_handler(tftp_window_timeout(),
+						tftp_window_timeout_handler);
+		else
+			net_set_timeout_handler(timeout_ms,
+						tftp_timeout_handler);
 
 		if (store_block(tftp_cur_block, pkt + 2, len)) {
 			eth_halt_state_only();
@@ -682,6 +782,7 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		 */
 		if (tftp_cur_block == tftp_next_ack) {
 			tftp_send();
+			tftp_rtt_begin();
 			tftp_next_ack += tftp_windowsize;
 		}
 		break;
@@ -714,15 +815,31 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 static void tftp_timeout_handler(void)
 {
 	if (++timeout_count > timeout_count_max) {
+		tftp_window_size_req = max(tftp_window_size_req / 2, 1);
 		restart("Retry count exceeded");
 	} else {
 		puts("T ");
 		net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
+		/* Replies to a resent packet give no clean round trip */
+		tftp_rtt_timing = false;
 		if (tftp_state != STATE_RECV_WRQ)
 			tftp_send();
 	}
 }
 
+/*
+ * The rest of the window did not arrive, so acknowledge the blocks received
+ * so far, which prompts the server to send the next ones
+ */
+static void tftp_window_timeout_handler(void)
+{
+	tftp_window_losses++;
+	tftp_rtt_timing = false;
+	tftp_send();
+	tftp_next_ack = (ushort)(tftp_cur_block + tftp_windowsize);
+	net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
+}
+
 static void tftp_init_load_addr(void)
 {
 	tftp_load_addr = image_load_addr;
@@ -814,8 +931,14 @@ void tftp_start(enum proto_t protocol)
 
 	sanitize_tftp_block_size_option(protocol);
 
+	/* Start again from the configured window size when it changes */
+	if (tftp_window_size_base != tftp_window_size_option) {
+		tftp_window_size_base = tftp_window_size_option;
+		tftp_window_size_req = tftp_window_size_option;
+	}
+
 	debug("TFTP blocksize = %i, TFTP windowsize = %d timeout = %ld ms\n",
-	      tftp_block_size_option, tftp_window_size_option, timeout_ms);
+	      tftp_block_size_option, tftp_window_size_req, timeout_ms);
 
 	if (IS_ENABLED(CONFIG_IPV6))
 		tftp_remote_ip6 = net_server_ip6;
@@ -946,8 +1069,10 @@ void tftp_start(enum proto_t protocol)
 	tftp_tsize = 0;
 	tftp_tsize_num_hash = 0;
 #endif
+	tftp_srtt = 0;
 
 	tftp_send();
+	tftp_rtt_begin();
 }
 
 #ifdef CONFIG_CMD_TFTPSRV
@@ -37,6 +37,8 @@ static struct in_addr web_server_ip;
 static unsigned int server_port;
 static unsigned long content_length;
 static u32 http_hdr_size, max_rx_pos;
+/* Number of bytes after the load address for which memory is reserved */
+static ulong wget_load_reserved;
 static int wget_tsize_num_hash;
 
 static char *image_url;
@@ -51,20 +53,34 @@ static enum net_loop_state wget_loop_state;
 static inline int store_block(uchar *src, unsigned int offset, unsigned int len)
 {
 	ulong store_addr = image_load_addr + offset;
+	ulong newsize = offset + len;
 	uchar *ptr;
 
 	// Avoid overflow
-	if (wget_info->buffer_size && wget_info->buffer_size < offset + len)
+	if (wget_info->buffer_size && wget_info->buffer_size < newsize)
 		return -1;
-	if (CONFIG_IS_ENABLED(LMB) && wget_info->set_bootdev) {
+	if (CONFIG_IS_ENABLED(LMB) && wget_info->set_bootdev &&
+	    newsize > wget_load_reserved) {
+		ulong end = newsize;
+
+		/*
+		 * Reserve memory for the whole file at once when its size is
+		 * known, rather than for each segment. Anything before this
+		 * segment is reserved too, since it is still to arrive.
+		 */
+		if (http_hdr_size && content_length != -1 &&
+		    content_length > end)
+			end = content_length;
 		if (store_addr < image_load_addr ||
-		    lmb_read_check(store_addr, len)) {
+		    lmb_read_check(image_load_addr + wget_load_reserved,
+				   end - wget_load_reserved)) {
 			if (!wget_info->silent) {
 				printf("\nwget error: ");
 				printf("trying to overwrite reserved memory\n");
 			}
 			return -1;
 		}
+		wget_load_reserved = end;
 	}
 
 	ptr = map_sysmem(store_addr, len);
@@ -343,6 +359,7 @@ void wget_start(void)
 	max_rx_pos = (u32)(-1);
 	net_boot_file_size = 0;
 	http_hdr_size = 0;
+	wget_load_reserved = 0;
 	wget_tsize_num_hash = 0;
 	wget_loop_state = NETLOOP_FAIL;
 
@@ -442,12 +442,15 @@ static int bootdev_test_cmd_hunt(struct unit_test_state *uts)
 	ut_assert_nextline("Hunting with: nvme");
 	ut_assert_nextline("Hunting with: qfw");
 	ut_assert_nextline("Hunting with: scsi");
-	ut_assert_nextline("scanning bus for devices...");
 	ut_assert_skip_to_line("Hunting with: spi_flash");
 	ut_assert_nextline("Hunting with: usb");
-	ut_assert_skip_to_line("Bus usb@1: 5 USB Device(s) found");
-	ut_assert_nextline("Hunting with: virtio");
-	ut_assert_console_end();
+	ut_assert_skip_to_line("Hunting with: virtio");
+
+	/*
+	 * Hunters may run together, so the SCSI and USB output can come before
+	 * or after this; the list below shows that all of them were used
+	 */
+	console_record_reset();
 
 	/* List available hunters */
 	ut_assertok(run_command("bootdev hunt -l", 0));
@@ -553,6 +556,41 @@ static int bootdev_test_hunt_prio(struct unit_test_state *uts)
 }
 BOOTSTD_TEST(bootdev_test_hunt_prio, UTF_DM | UTF_SCAN_FDT | UTF_CONSOLE);
 
+/* Check hunting with each hunter in its own thread */
+static int bootdev_test_hunt_parallel(struct unit_test_state *uts)
+{
+	struct bootstd_priv *std;
+	struct udevice *dev;
+
+	if (!IS_ENABLED(CONFIG_BOOTDEV_HUNT_PARALLEL))
+		return -EAGAIN;
+	bootstd_reset_usb();
+	test_set_skip_delays(true);
+	test_set_eth_enable(false);
+	ut_assertok(bootstd_get_priv(&std));
+
+	/*
+	 * Each thread marks its hunter as used when it is done, so all of them
+	 * must have finished by the time this returns
+	 */
+	ut_assertok(bootdev_hunt_prio(BOOTDEVP_4_SCAN_FAST, false));
+	ut_asserteq(BIT(3) | BIT(4) | BIT(5) | BIT(6) | BIT(8),
+		    std->hunters_used);
+	ut_assertok(uclass_get_device_by_name(UCLASS_BOOTDEV,
+					      "scsi.id0lun0.bootdev", &dev));
+
+	/* Hunt with the rest, skipping those which have already been used */
+	ut_assertok(bootdev_hunt(NULL, false));
+	ut_asserteq(GENMASK(MAX_HUNTER, 0), std->hunters_used);
+	ut_assertok(uclass_get_device_by_name(UCLASS_BOOTDEV,
+					      "usb_mass_storage.lun0.bootdev",
+					      &dev));
+
+	return 0;
+}
+BOOTSTD_TEST(bootdev_test_hunt_parallel, UTF_DM | UTF_SCAN_FDT |
+	     UTF_ETH_BOOTDEV);
+
 /* Check hunting for bootdevs with a particular label */
 static int bootdev_test_hunt_label(struct unit_test_state *uts)
 {
@@ -741,7 +779,7 @@ static int bootdev_test_next_prio(struct unit_test_state *uts)
 	 * starts looking at the devices, so we se virtio as well
 	 */
 	ut_assert_nextline("Hunting with: virtio");
-	ut_assert_nextlinen("SF: Detected m25p16");
+	ut_assert_skip_to_linen("SF: Detected m25p16");
 
 	ut_assertok(bootdev_next_prio(&iter, &dev));
 	ut_asserteq_str("spi.bin@1.bootdev", dev->name);
@@ -586,6 +586,173 @@ static int bootflow_cmd_boot(struct unit_test_state *uts)
 }
 BOOTSTD_TEST(bootflow_cmd_boot, UTF_DM | UTF_SCAN_FDT | UTF_CONSOLE);
 
+/* Record the bootflow found by a full scan, so that it is tried first */
+static int setup_cache(struct unit_test_state *uts)
+{
+	struct bootflow_iter iter;
+	struct bootflow bflow;
+
+	bootstd_clear_glob();
+	ut_assertok(env_set("bootflow_cache", NULL));
+
+	ut_assertok(bootflow_scan_first(NULL, NULL, &iter,
+					BOOTFLOWIF_SKIP_GLOBAL, &bflow));
+	ut_assert(!(iter.flags & BOOTFLOWIF_CACHED));
+	ut_asserteq_str("mmc1.bootdev.part_1", bflow.name);
+	bootflow_cache_save(&bflow);
+	ut_assertnonnull(env_get("bootflow_cache"));
+	bootflow_free(&bflow);
+	bootflow_iter_uninit(&iter);
+
+	return 0;
+}
+
+/* Tidy up after setup_cache(), so that other tests do not see the record */
+static void clear_cache(void)
+{
+	env_set("bootflow_cache", NULL);
+	env_set("boot_targets", NULL);
+	bootmeth_set_order(NULL);
+}
+
+/* Run a test with a record of the bootflow on mmc1, then remove the record */
+static int run_with_cache(struct unit_test_state *uts,
+			  int (*test)(struct unit_test_state *uts))
+{
+	int ret;
+
+	if (!IS_ENABLED(CONFIG_BOOTFLOW_CACHE))
+		return -EAGAIN;
+	ret = setup_cache(uts);
+	if (!ret)
+		ret = test(uts);
+	clear_cache();
+
+	return ret;
+}
+
+/*
+ * Scan with a record, which is expected to be used if @cached is true. The
+ * bootflow on mmc1 is found either way
+ */
+static int check_cache(struct unit_test_state *uts, bool cached)
+{
+	struct bootflow_iter iter;
+	struct bootflow bflow;
+
+	ut_assertok(bootflow_scan_first(NULL, NULL, &iter,
+					BOOTFLOWIF_SKIP_GLOBAL, &bflow));
+	ut_asserteq(cached, !!(iter.flags & BOOTFLOWIF_CACHED));
+	ut_asserteq_str("mmc1.bootdev.part_1", bflow.name);
+	ut_asserteq_str("extlinux", bflow.method->name);
+	bootflow_free(&bflow);
+	bootflow_iter_uninit(&iter);
+
+	return 0;
+}
+
+static int check_cache_hit(struct unit_test_state *uts)
+{
+	struct bootflow_iter iter;
+	struct bootflow bflow;
+
+	/* mmc2 comes first in the bootdev order but is not looked at */
+	ut_assertok(bootflow_scan_first(NULL, NULL, &iter,
+					BOOTFLOWIF_SKIP_GLOBAL, &bflow));
+	ut_assert(iter.flags & BOOTFLOWIF_CACHED);
+	ut_asserteq_str("mmc1.bootdev", iter.dev->name);
+	ut_asserteq(1, iter.part);
+	ut_asserteq(1, iter.num_methods);
+	ut_asserteq_str("mmc1.bootdev.part_1", bflow.name);
+	ut_asserteq(BOOTFLOWST_READY, bflow.state);
+	bootflow_free(&bflow);
+	bootflow_iter_uninit(&iter);
+
+	/* The record is ignored when a bootdev or label is given */
+	ut_assertok(bootflow_scan_first(NULL, "mmc1", &iter,
+					BOOTFLOWIF_SKIP_GLOBAL, &bflow));
+	ut_assert(!(iter.flags & BOOTFLOWIF_CACHED));
+	bootflow_free(&bflow);
+	bootflow_iter_uninit(&iter);
+
+	return 0;
+}
+
+/* Check that the last bootflow is tried without scanning other bootdevs */
+static int bootflow_cache_hit(struct unit_test_state *uts)
+{
+	return run_with_cache(uts, check_cache_hit);
+}
+BOOTSTD_TEST(bootflow_cache_hit, UTF_DM | UTF_SCAN_FDT);
+
+static int check_cache_stale(struct unit_test_state *uts)
+{
+	char rec[256];
+
+	strlcpy(rec, env_get("bootflow_cache"), sizeof(rec));
+
+	/* Changing the bootdev order may mean another bootflow is wanted */
+	ut_assertok(env_set("boot_targets", "mmc1"));
+	ut_assertok(check_cache(uts, false));
+	ut_assertok(env_set("boot_targets", NULL));
+	ut_assertok(check_cache(uts, true));
+
+	/* Likewise the bootmeth order */
+	ut_assertok(bootmeth_set_order("efi extlinux"));
+	ut_assertok(check_cache(uts, false));
+	ut_assertok(bootmeth_set_order(NULL));
+	ut_assertok(check_cache(uts, true));
+
+	/* The file found must be the one recorded */
+	strlcat(rec, ".old", sizeof(rec));
+	ut_assertok(env_set("bootflow_cache", rec));
+	ut_assertok(check_cache(uts, false));
+
+	/* A record which cannot be parsed is ignored */
+	ut_assertok(env_set("bootflow_cache", "mmc1.bootdev - 1"));
+	ut_assertok(check_cache(uts, false));
+
+	return 0;
+}
+
+/* Check that a record which no longer matches is not used */
+static int bootflow_cache_stale(struct unit_test_state *uts)
+{
+	return run_with_cache(uts, check_cache_stale);
+}
+BOOTSTD_TEST(bootflow_cache_stale, UTF_DM | UTF_SCAN_FDT);
+
+static int check_cache_skip(struct unit_test_state *uts)
+{
+	struct bootflow_iter iter;
+	struct bootflow bflow;
+	int ret;
+
+	ut_assertok(bootflow_scan_first(NULL, NULL, &iter,
+					BOOTFLOWIF_SKIP_GLOBAL, &bflow));
+	ut_assert(iter.flags & BOOTFLOWIF_CACHED);
+	bootflow_free(&bflow);
+
+	/* The full scan starts again with mmc2, without the record */
+	while (!(ret = bootflow_scan_next(&iter, &bflow))) {
+		ut_assert(!(iter.flags & BOOTFLOWIF_CACHED));
+		ut_assert(strcmp("mmc1.bootdev.part_1", bflow.name) ||
+			  strcmp("extlinux", bflow.method->name));
+		bootflow_free(&bflow);
+	}
+	ut_asserteq(-ENODEV, ret);
+	bootflow_iter_uninit(&iter);
+
+	return 0;
+}
+
+/* Check that the full scan after the last bootflow does not return it again */
+static int bootflow_cache_skip(struct unit_test_state *uts)
+{
+	return run_with_cache(uts, check_cache_skip);
+}
+BOOTSTD_TEST(bootflow_cache_skip, UTF_DM | UTF_SCAN_FDT);
+
 /**
  * prep_mmc_bootdev() - Set up an mmc bootdev so we can access other distros
  *
@@ -10,6 +10,8 @@
 #include <usb.h>
 #include <asm/global_data.h>
 #include <asm/state.h>
+#include <dm/device-internal.h>
+#include <dm/root.h>
 #include <dm/test.h>
 #include <test/test.h>
 #include <test/ut.h>
@@ -294,3 +296,218 @@ static int dm_test_blk_foreach(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_blk_foreach, UTF_SCAN_PDATA | UTF_SCAN_FDT);
+
+/* Test that the block cache serves partial and sequential reads */
+static int dm_test_blk_cache(struct unit_test_state *uts)
+{
+	struct block_cache_stats stats;
+	struct blk_desc *desc;
+	struct udevice *dev;
+	char write[64 * 512], read[8 * 512];
+	int i;
+
+	if (!CONFIG_IS_ENABLED(BLOCK_CACHE))
+		return -EAGAIN;
+
+	ut_assertok(uclass_get_device(UCLASS_MMC, 0, &dev));
+	ut_assertok(blk_get_device_by_str("mmc", "0", &desc));
+	for (i = 0; i < sizeof(write); i++)
+		write[i] = i * 7 + i / 512;
+	ut_asserteq(64, blk_dwrite(desc, 0, 64, write));
+	blkcache_configure(8, 32);
+
+	/* Blocks within and across cached entries are hits */
+	ut_asserteq(8, blk_dread(desc, 0, 8, read));
+	ut_asserteq(8, blk_dread(desc, 8, 8, read));
+	ut_asserteq(3, blk_dread(desc, 2, 3, read));
+	ut_asserteq_mem(&write[2 * 512], read, 3 * 512);
+	ut_asserteq(6, blk_dread(desc, 5, 6, read));
+	ut_asserteq_mem(&write[5 * 512], read, 6 * 512);
+	blkcache_stats(&stats);
+	ut_asserteq(2, stats.hits);
+	ut_asserteq(2, stats.misses);
+
+	/* Small sequential reads are turned into read-ahead */
+	blkcache_invalidate(UCLASS_MMC, 0);
+	for (i = 16; i < 64; i++) {
+		ut_asserteq(1, blk_dread(desc, i, 1, read));
+		ut_asserteq_mem(&write[i * 512], read, 512);
+	}
+	blkcache_stats(&stats);
+	ut_assert(stats.readaheads > 0);
+	ut_assert(stats.misses < 8);
+	ut_asserteq(48, stats.hits + stats.misses);
+
+	/* A write drops the cached blocks of the device */
+	memset(write, 0, 512);
+	ut_asserteq(1, blk_dwrite(desc, 16, 1, write));
+	ut_asserteq(1, blk_dread(desc, 16, 1, read));
+	ut_asserteq_mem(write, read, 512);
+
+	return 0;
+}
+DM_TEST(dm_test_blk_cache, UTF_SCAN_PDATA | UTF_SCAN_FDT);
+
+/* Test that writes held back in the block cache are flushed in one go */
+static int dm_test_blk_cache_writeback(struct unit_test_state *uts)
+{
+	struct block_cache_stats stats;
+	struct blk_desc *desc;
+	struct udevice *dev;
+	char write[16 * 512], read[16 * 512];
+	int i;
+
+	if (!CONFIG_IS_ENABLED(BLOCK_CACHE_WRITEBACK))
+		return -EAGAIN;
+
+	ut_assertok(uclass_get_device(UCLASS_MMC, 0, &dev));
+	ut_assertok(blk_get_device_by_str("mmc", "0", &desc));
+	blkcache_configure(8, 32);
+
+	for (i = 0; i < sizeof(write); i++)
+		write[i] = i * 3 + i / 512;
+	for (i = 0; i < 16; i++)
+		ut_asserteq(1, blk_dwrite(desc, 32 + i, 1, &write[i * 512]));
+	blkcache_stats(&stats);
+	ut_asserteq(0, stats.writebacks);
+	ut_asserteq(2, stats.dirty);
+
+	/* the cache returns the data not yet written */
+	ut_asserteq(16, blk_dread(desc, 32, 16, read));
+	ut_asserteq_mem(write, read, sizeof(write));
+
+	ut_assertok(blk_dflush(desc));
+	blkcache_stats(&stats);
+	ut_asserteq(1, stats.writebacks);
+	ut_asserteq(0, stats.dirty);
+
+	/* the data reached the device */
+	blkcache_invalidate(desc->uclass_id, desc->devnum);
+	memset(read, 0, sizeof(read));
+	ut_asserteq(16, blk_dread(desc, 32, 16, read));
+	ut_asserteq_mem(write, read, sizeof(write));
+
+	/* in sync mode, writes go straight to the device */
+	desc->cache_sync = true;
+	ut_asserteq(1, blk_dwrite(desc, 32, 1, write));
+	desc->cache_sync = false;
+	blkcache_stats(&stats);
+	ut_asserteq(0, stats.dirty);
+
+	/* dropping the cache of a device writes back its dirty blocks */
+	ut_asserteq(1, blk_dwrite(desc, 40, 1, &write[512]));
+	blkcache_stats(&stats);
+	ut_asserteq(1, stats.dirty);
+	blkcache_invalidate(desc->uclass_id, desc->devnum);
+	blkcache_stats(&stats);
+	ut_asserteq(1, stats.writebacks);
+	ut_asserteq(0, stats.dirty);
+	ut_asserteq(1, blk_dread(desc, 40, 1, read));
+	ut_asserteq_mem(&write[512], read, 512);
+
+	return 0;
+}
+DM_TEST(dm_test_blk_cache_writeback, UTF_SCAN_PDATA | UTF_SCAN_FDT);
+
+#define TEST_HWPART_BLOCKS	8
+
+/* Block device with two hardware partitions, held in memory */
+struct test_hwpart_priv {
+	char buf[2][TEST_HWPART_BLOCKS * 512];
+};
+
+static ulong test_hwpart_read(struct udevice *dev, lbaint_t start,
+			      lbaint_t blkcnt, void *buf)
+{
+	struct blk_desc *desc = dev_get_uclass_plat(dev);
+	struct test_hwpart_priv *priv = dev_get_priv(dev);
+
+	if (start + blkcnt > TEST_HWPART_BLOCKS)
+		return -EINVAL;
+	memcpy(buf, &priv->buf[desc->hwpart][start * 512], blkcnt * 512);
+
+	return blkcnt;
+}
+
+static ulong test_hwpart_write(struct udevice *dev, lbaint_t start,
+			       lbaint_t blkcnt, const void *buf)
+{
+	struct blk_desc *desc = dev_get_uclass_plat(dev);
+	struct test_hwpart_priv *priv = dev_get_priv(dev);
+
+	if (start + blkcnt > TEST_HWPART_BLOCKS)
+		return -EINVAL;
+	memcpy(&priv->buf[desc->hwpart][start * 512], buf, blkcnt * 512);
+
+	return blkcnt;
+}
+
+static int test_hwpart_select(struct udevice *dev, int hwpart)
+{
+	struct blk_desc *desc = dev_get_uclass_plat(dev);
+
+	if (hwpart < 0 || hwpart > 1)
+		return -EINVAL;
+	desc->hwpart = hwpart;
+
+	return 0;
+}
+
+static const struct blk_ops test_hwpart_blk_ops = {
+	.read		= test_hwpart_read,
+	.write		= test_hwpart_write,
+	.select_hwpart	= test_hwpart_select,
+};
+
+U_BOOT_DRIVER(test_hwpart_blk) = {
+	.name		= "test_hwpart_blk",
+	.id		= UCLASS_BLK,
+	.ops		= &test_hwpart_blk_ops,
+	.priv_auto	= sizeof(struct test_hwpart_priv),
+};
+
+/* Test that dirty blocks are written to the hwpart they were written in */
+static int dm_test_blk_cache_hwpart(struct unit_test_state *uts)
+{
+	struct test_hwpart_priv *priv;
+	struct block_cache_stats stats;
+	struct blk_desc *desc;
+	struct udevice *dev;
+	char write[512], read[512], zero[512];
+
+	if (!CONFIG_IS_ENABLED(BLOCK_CACHE_WRITEBACK))
+		return -EAGAIN;
+
+	ut_assertok(blk_create_devicef(dm_root(), "test_hwpart_blk", "blk",
+				       UCLASS_ROOT, -1, 512,
+				       TEST_HWPART_BLOCKS, &dev));
+	ut_assertok(device_probe(dev));
+	desc = dev_get_uclass_plat(dev);
+	priv = dev_get_priv(dev);
+	blkcache_configure(8, 32);
+
+	memset(write, 0xa5, sizeof(write));
+	memset(zero, 0, sizeof(zero));
+	ut_asserteq(1, blk_dwrite(desc, 2, 1, write));
+	blkcache_stats(&stats);
+	ut_asserteq(1, stats.dirty);
+
+	/* switching writes the block back to the partition it came from */
+	ut_assertok(blk_dselect_hwpart(desc, 1));
+	blkcache_stats(&stats);
+	ut_asserteq(0, stats.dirty);
+	ut_asserteq_mem(write, &priv->buf[0][2 * 512], 512);
+	ut_asserteq_mem(zero, &priv->buf[1][2 * 512], 512);
+
+	/* the new partition does not see the cached data */
+	ut_asserteq(1, blk_dread(desc, 2, 1, read));
+	ut_asserteq_mem(zero, read, 512);
+
+	/* and switching back reads it from the device */
+	ut_assertok(blk_dselect_hwpart(desc, 0));
+	ut_asserteq(1, blk_dread(desc, 2, 1, read));
+	ut_asserteq_mem(write, read, 512);
+
+	return 0;
+}
+DM_TEST(dm_test_blk_cache_hwpart, UTF_SCAN_PDATA | UTF_SCAN_FDT);
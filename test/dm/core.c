@@ -10,12 +10,15 @@
 #include <fdtdec.h>
 #include <log.h>
 #include <malloc.h>
+#include <time.h>
 #include <asm/global_data.h>
 #include <dm/device-internal.h>
+#include <dm/lists.h>
 #include <dm/root.h>
 #include <dm/util.h>
 #include <dm/test.h>
 #include <dm/uclass-internal.h>
+#include <linux/delay.h>
 #include <linux/list.h>
 #include <test/test.h>
 #include <test/ut.h>
@@ -299,6 +302,63 @@ static int dm_test_autoprobe(struct unit_test_state *uts)
 }
 DM_TEST(dm_test_autoprobe, UTF_SCAN_PDATA);
 
+/* Order in which the background probes started ('+') and finished ('-') */
+static char async_log[16];
+static struct udevice *async_first;
+
+static int test_async_probe(struct udevice *dev)
+{
+	strlcat(async_log, dev->name, sizeof(async_log));
+	strlcat(async_log, "+", sizeof(async_log));
+
+	/* The first device waits for its hardware, the second one needs it */
+	if (dev == async_first)
+		mdelay(5);
+	else if (device_probe(async_first))
+		return -EIO;
+
+	strlcat(async_log, dev->name, sizeof(async_log));
+	strlcat(async_log, "-", sizeof(async_log));
+
+	return 0;
+}
+
+U_BOOT_DRIVER(test_async_probe) = {
+	.name	= "test_async_probe",
+	.id	= UCLASS_NOP,
+	.probe	= test_async_probe,
+	.flags	= DM_FLAG_PROBE_ASYNC,
+};
+
+/* Test that devices are probed in the background by autoprobe */
+static int dm_test_autoprobe_async(struct unit_test_state *uts)
+{
+	struct udevice *dev;
+
+	if (!CONFIG_IS_ENABLED(DM_PROBE_ASYNC))
+		return -EAGAIN;
+
+	ut_assertok(device_bind_driver(uts->root, "test_async_probe", "a",
+				       &async_first));
+	dev_or_flags(async_first, DM_FLAG_PROBE_AFTER_BIND);
+	ut_assertok(device_bind_driver(uts->root, "test_async_probe", "b",
+				       &dev));
+	dev_or_flags(dev, DM_FLAG_PROBE_AFTER_BIND);
+
+	/*
+	 * The second probe starts while the first one waits, then waits for
+	 * the first one to finish before using its device
+	 */
+	async_log[0] = '\0';
+	ut_assertok(dm_autoprobe());
+	ut_asserteq_str("a+b+a-b-", async_log);
+	ut_assert(dev_get_flags(async_first) & DM_FLAG_ACTIVATED);
+	ut_assert(dev_get_flags(dev) & DM_FLAG_ACTIVATED);
+
+	return 0;
+}
+DM_TEST(dm_test_autoprobe_async, UTF_SCAN_PDATA);
+
 /* Check that we see the correct plat in each device */
 static int dm_test_plat(struct unit_test_state *uts)
 {
@@ -1425,3 +1485,140 @@ static int dm_test_multimatch(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_multimatch, UTF_SCAN_FDT);
+
+/* Test that deferred nodes are bound when they are looked up */
+static int dm_test_lazy_bind_run(struct unit_test_state *uts)
+{
+	int deferred, bound, before;
+	struct udevice *dev;
+	struct uclass *uc;
+	ofnode node;
+
+	ut_assertok(dm_extended_scan(false));
+	dm_lazy_get_stats(&deferred, &before);
+	ut_assert(deferred > before);
+
+	/* The RNG is a leaf node, so it is only bound on first lookup */
+	dev = uclass_try_first_device(UCLASS_RNG);
+	ut_assertnonnull(dev);
+	ut_asserteq_str("rng", dev->name);
+	dm_lazy_get_stats(&deferred, &bound);
+	ut_assert(bound > before);
+	before = bound;
+
+	/* Finding a uclass binds its devices too */
+	uc = uclass_find(UCLASS_PWM);
+	ut_assertnonnull(uc);
+	ut_assert(!list_empty(&uc->dev_head));
+	ut_assertok(uclass_find_device_by_name(UCLASS_PWM, "pwm2", &dev));
+	dm_lazy_get_stats(&deferred, &bound);
+	ut_assert(bound > before);
+	before = bound;
+
+	/* Looking up a node binds just that node */
+	node = ofnode_path("/reset-ctl-test");
+	ut_assert(ofnode_valid(node));
+	ut_assertok(device_find_global_by_ofnode(node, &dev));
+	ut_asserteq_str("reset-ctl-test", dev->name);
+	dm_lazy_get_stats(&deferred, &bound);
+	ut_asserteq(before + 1, bound);
+
+	/* Nothing more is bound when the same devices are looked up again */
+	ut_assertok(uclass_first_device_err(UCLASS_RNG, &dev));
+	ut_assertok(device_find_global_by_ofnode(node, &dev));
+	dm_lazy_get_stats(&deferred, &bound);
+	ut_asserteq(before + 1, bound);
+
+	return 0;
+}
+
+static int dm_test_lazy_bind(struct unit_test_state *uts)
+{
+	if (!CONFIG_IS_ENABLED(DM_LAZY_BIND))
+		return -EAGAIN;
+
+	/* Deferral is off while tests run, so scan again with it on */
+	dm_lazy_enable(true);
+
+	return dm_test_lazy_bind_run(uts);
+}
+DM_TEST(dm_test_lazy_bind, 0);
+
+/* Number of devices to bind and lookups to time in dm_test_uclass_index() */
+#define INDEX_TEST_DEVS		2000
+#define INDEX_TEST_LOOPS	1000
+
+/* Test looking up devices in a large uclass, showing how long it takes */
+static int dm_test_uclass_index(struct unit_test_state *uts)
+{
+	struct udevice *dev, *last, *dup;
+	ulong start, find_us, seq_us, node_us, phandle_us;
+	int i, seq, phandle;
+	ofnode node;
+
+	for (i = 0; i < INDEX_TEST_DEVS; i++)
+		ut_assertok(device_bind(dm_root(), DM_DRIVER_GET(test_drv),
+					"index-test", NULL, ofnode_null(),
+					&dev));
+
+	/* Only the last device has a node, so a list walk is slowest */
+	node = ofnode_path("/phandle-node-1");
+	ut_assertok(device_bind(dm_root(), DM_DRIVER_GET(test_drv),
+				"index-node", NULL, node, &last));
+	phandle = dev_read_phandle(last);
+	ut_assert(phandle > 0);
+	seq = dev_seq(last);
+
+	ut_assertok(uclass_find_device_by_seq(UCLASS_TEST, seq, &dev));
+	ut_asserteq_ptr(last, dev);
+	ut_assertok(uclass_find_device_by_ofnode(UCLASS_TEST, node, &dev));
+	ut_asserteq_ptr(last, dev);
+	ut_assertok(uclass_get_device_by_phandle_id(UCLASS_TEST, phandle,
+						    &dev));
+	ut_asserteq_ptr(last, dev);
+	ut_asserteq(-ENODEV, uclass_find_device_by_seq(UCLASS_TEST, seq + 1,
+						       &dev));
+
+	start = timer_get_us();
+	for (i = 0; i < INDEX_TEST_LOOPS; i++)
+		ut_assertnonnull(uclass_find(UCLASS_TEST));
+	find_us = timer_get_us() - start;
+
+	start = timer_get_us();
+	for (i = 0; i < INDEX_TEST_LOOPS; i++)
+		ut_assertok(uclass_find_device_by_seq(UCLASS_TEST, seq, &dev));
+	seq_us = timer_get_us() - start;
+
+	start = timer_get_us();
+	for (i = 0; i < INDEX_TEST_LOOPS; i++)
+		ut_assertok(uclass_find_device_by_ofnode(UCLASS_TEST, node,
+							 &dev));
+	node_us = timer_get_us() - start;
+
+	start = timer_get_us();
+	for (i = 0; i < INDEX_TEST_LOOPS; i++)
+		ut_assertok(uclass_get_device_by_phandle_id(UCLASS_TEST,
+							    phandle, &dev));
+	phandle_us = timer_get_us() - start;
+
+	printf("%d devices, %d lookups: uclass %lu us, seq %lu us, ofnode %lu us, phandle %lu us\n",
+	       INDEX_TEST_DEVS + 1, INDEX_TEST_LOOPS, find_us, seq_us, node_us,
+	       phandle_us);
+
+	/* Another device with the same node is found once the first is gone */
+	ut_assertok(device_bind(dm_root(), DM_DRIVER_GET(test_drv),
+				"index-dup", NULL, node, &dup));
+	ut_assertok(uclass_find_device_by_ofnode(UCLASS_TEST, node, &dev));
+	ut_asserteq_ptr(last, dev);
+	ut_assertok(device_remove(last, DM_REMOVE_NORMAL));
+	ut_assertok(device_unbind(last));
+	ut_assertok(uclass_find_device_by_ofnode(UCLASS_TEST, node, &dev));
+	ut_asserteq_ptr(dup, dev);
+	ut_assertok(uclass_get_device_by_phandle_id(UCLASS_TEST, phandle,
+						    &dev));
+	ut_asserteq_ptr(dup, dev);
+	ut_asserteq(-ENODEV, uclass_find_device_by_seq(UCLASS_TEST, seq, &dev));
+
+	return 0;
+}
+DM_TEST(dm_test_uclass_index, 0);
@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for writing through DFU, using the RAM back end
+ */
+
+#include <dfu.h>
+#include <env.h>
+#include <malloc.h>
+#include <mapmem.h>
+#include <dm/test.h>
+#include <test/ut.h>
+#include <linux/stringify.h>
+
+/* Size of each DFU buffer and of each piece of data passed to dfu_write() */
+#define BUF_SIZE	0x1000
+#define CHUNK		0x200
+#define DATA_SIZE	(BUF_SIZE * 5 + CHUNK * 3)
+
+/* Sets up a single RAM entity covering @size bytes at @dst */
+static int setup_entity(struct unit_test_state *uts, void *dst, ulong size,
+			struct dfu_entity **dfup)
+{
+	char alt[40];
+
+	ut_assertok(env_set("dfu_bufsiz", __stringify(BUF_SIZE)));
+	snprintf(alt, sizeof(alt), "test ram %lx %lx",
+		 (ulong)map_to_sysmem(dst), size);
+	ut_assertok(dfu_config_entities(alt, "ram", "0"));
+	*dfup = dfu_get_entity(0);
+	ut_assertnonnull(*dfup);
+
+	return 0;
+}
+
+/* Test writing in pieces, with full buffers written in the background */
+static int dm_test_dfu_write(struct unit_test_state *uts)
+{
+	struct dfu_entity *dfu;
+	u8 *src, *dst;
+	int i, seq;
+
+	src = malloc(DATA_SIZE);
+	ut_assertnonnull(src);
+	dst = calloc(1, DATA_SIZE);
+	ut_assertnonnull(dst);
+	for (i = 0; i < DATA_SIZE; i++)
+		src[i] = i * 7 + (i >> 8) + 1;
+	ut_assertok(setup_entity(uts, dst, DATA_SIZE, &dfu));
+
+	for (i = 0, seq = 0; i < DATA_SIZE; i += CHUNK, seq++) {
+		ut_assertok(dfu_write(dfu, src + i, CHUNK, seq));
+
+		/* The first buffer is queued, but not written until we yield */
+		if (IS_ENABLED(CONFIG_DFU_BACKGROUND_WRITE) &&
+		    i + CHUNK == BUF_SIZE)
+			ut_asserteq(0, dst[0]);
+	}
+	ut_assertok(dfu_flush(dfu, NULL, 0, seq));
+	ut_assertok(memcmp(src, dst, DATA_SIZE));
+
+	dfu_free_entities();
+	env_set("dfu_bufsiz", NULL);
+	free(dst);
+	free(src);
+
+	return 0;
+}
+DM_TEST(dm_test_dfu_write, 0);
+
+/* Test that a failed write in the background is reported */
+static int dm_test_dfu_write_fail(struct unit_test_state *uts)
+{
+	struct dfu_entity *dfu;
+	u8 *src, *dst;
+	int i, ret;
+
+	if (!IS_ENABLED(CONFIG_DFU_BACKGROUND_WRITE))
+		return -EAGAIN;
+
+	src = calloc(1, BUF_SIZE * 2);
+	ut_assertnonnull(src);
+	dst = calloc(1, BUF_SIZE * 2);
+	ut_assertnonnull(dst);
+
+	/* The second buffer starts beyond the end of the entity */
+	ut_assertok(setup_entity(uts, dst, BUF_SIZE / 2, &dfu));
+
+	/* Filling both buffers waits for the first, then both are written */
+	for (i = 0; i < BUF_SIZE * 2 / CHUNK - 1; i++)
+		ut_assertok(dfu_write(dfu, src + i * CHUNK, CHUNK, i));
+	ret = dfu_write(dfu, src + i * CHUNK, CHUNK, i);
+	ut_asserteq(-EINVAL, ret);
+
+	dfu_free_entities();
+	env_set("dfu_bufsiz", NULL);
+	free(dst);
+	free(src);
+
+	return 0;
+}
+DM_TEST(dm_test_dfu_write_fail, 0);
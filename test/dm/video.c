@@ -633,6 +633,56 @@ static int dm_test_video_truetype_bs(struct unit_test_state *uts)
 }
 DM_TEST(dm_test_video_truetype_bs, UTF_SCAN_PDATA | UTF_SCAN_FDT);
 
+/* Test the TrueType glyph cache with sub-pixel positions and eviction */
+static int dm_test_video_truetype_cache(struct unit_test_state *uts)
+{
+	struct console_tt_glyph_stats stats;
+	struct udevice *dev, *con;
+	uint size_a, size_b;
+
+	ut_assertok(video_get_nologo(uts, &dev));
+	ut_assertok(uclass_get_device(UCLASS_VIDEO_CONSOLE, 0, &con));
+
+	/* Each character has at most four images, one for each phase */
+	ut_assertok(console_truetype_glyph_cache(con, 4, 0));
+	vidconsole_put_string(con, "aaaaaaaaaaaaaaaa");
+	ut_assertok(console_truetype_glyph_stats(con, &stats));
+	ut_asserteq(16, stats.hits + stats.misses);
+	ut_assert(stats.misses >= 1 && stats.misses <= 4);
+	ut_asserteq(0, stats.evictions);
+
+	/* Measure the image of each character, with one phase */
+	ut_assertok(console_truetype_glyph_cache(con, 1, 0));
+	vidconsole_put_string(con, "a");
+	ut_assertok(console_truetype_glyph_stats(con, &stats));
+	ut_asserteq(1, stats.misses);
+	size_a = stats.bytes;
+
+	ut_assertok(console_truetype_glyph_cache(con, 1, 0));
+	vidconsole_put_string(con, "b");
+	ut_assertok(console_truetype_glyph_stats(con, &stats));
+	size_b = stats.bytes;
+
+	/* Only one of the two fits, so each evicts the other */
+	ut_assertok(console_truetype_glyph_cache(con, 1, size_a + size_b - 1));
+	vidconsole_put_string(con, "abaa");
+	ut_assertok(console_truetype_glyph_stats(con, &stats));
+	ut_asserteq(1, stats.hits);
+	ut_asserteq(3, stats.misses);
+	ut_asserteq(2, stats.evictions);
+	ut_asserteq(size_a, stats.bytes);
+
+	/* With exact positions, the images still come from the cache */
+	ut_assertok(console_truetype_glyph_cache(con, 0, 0));
+	vidconsole_put_string(con, "abab");
+	ut_assertok(console_truetype_glyph_stats(con, &stats));
+	ut_asserteq(4, stats.hits + stats.misses);
+	ut_assert(stats.misses >= 2);
+
+	return 0;
+}
+DM_TEST(dm_test_video_truetype_cache, UTF_SCAN_PDATA | UTF_SCAN_FDT);
+
 /* Test partial rendering onto hardware frame buffer */
 static int dm_test_video_copy(struct unit_test_state *uts)
 {
@@ -753,6 +803,59 @@ static int dm_test_video_damage(struct unit_test_state *uts)
 }
 DM_TEST(dm_test_video_damage, UTF_SCAN_PDATA | UTF_SCAN_FDT);
 
+/* Test that separate damaged regions are flushed separately */
+static int dm_test_video_damage_rects(struct unit_test_state *uts)
+{
+	struct video_priv *priv;
+	struct udevice *dev;
+
+	if (!IS_ENABLED(CONFIG_VIDEO_COPY))
+		return -EAGAIN;
+
+	ut_assertok(uclass_find_first_device(UCLASS_VIDEO, &dev));
+	ut_assertok(sandbox_sdl_set_bpp(dev, VIDEO_BPP32));
+	priv = dev_get_uclass_priv(dev);
+	video_set_flush_dcache(dev, true);
+	ut_assertok(video_sync(dev, true));
+	ut_asserteq(0, priv->damage_count);
+
+	/* The second region is next to the first, so they are merged */
+	video_damage(dev, 8, 10, 24, 16);
+	video_damage(dev, 1200, 700, 100, 20);
+	video_damage(dev, 32, 10, 24, 16);
+	ut_asserteq(2, priv->damage_count);
+
+	/*
+	 * Each line is 5464 bytes, so odd lines start half-way through a
+	 * 16-byte cache line and need an extra 16 bytes flushing
+	 */
+	ut_assertok(video_sync(dev, true));
+	ut_asserteq(0, priv->damage_count);
+	ut_asserteq(16 * 48 * 4 + 20 * 100 * 4, priv->copy_bytes);
+	ut_asserteq(2 * (16 * 48 * 4 + 8 * 16 + 20 * 100 * 4 + 10 * 16),
+		    priv->flush_bytes);
+	ut_assertok(video_check_copy_fb(uts, dev));
+
+	/* When the list is full, the cheapest pair is merged */
+	video_damage(dev, 0, 0, 10, 10);
+	video_damage(dev, 1356, 0, 10, 10);
+	video_damage(dev, 0, 758, 10, 10);
+	video_damage(dev, 1356, 758, 10, 10);
+	ut_asserteq(4, priv->damage_count);
+	video_damage(dev, 600, 0, 10, 10);
+	ut_asserteq(4, priv->damage_count);
+
+	/* Whole lines are flushed in one go */
+	video_damage(dev, 0, 0, priv->xsize, priv->ysize);
+	ut_asserteq(1, priv->damage_count);
+	ut_assertok(video_sync(dev, true));
+	ut_asserteq(priv->fb_size, priv->copy_bytes);
+	ut_asserteq(2 * priv->fb_size, priv->flush_bytes);
+
+	return 0;
+}
+DM_TEST(dm_test_video_damage_rects, UTF_SCAN_PDATA | UTF_SCAN_FDT);
+
 /* Test font measurement */
 static int dm_test_font_measure(struct unit_test_state *uts)
 {
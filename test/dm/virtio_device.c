@@ -192,6 +192,28 @@ static int dm_test_virtio_ring(struct unit_test_state *uts)
 	ut_asserteq(6, len);
 	ut_assertok(virtio_del_vqs(dev));
 
+	/* a chain in an indirect table uses a single descriptor */
+	__virtio_set_bit(bus, VIRTIO_RING_F_INDIRECT_DESC);
+	ut_assertok(virtio_find_vqs(dev, 1, &vq));
+	ut_assertnonnull(vq->indirect_desc);
+	ut_assertok(virtqueue_add(vq, sgs, 1, 1));
+	ut_asserteq(virtqueue_get_vring_size(vq) - 1, vq->num_free);
+	ut_asserteq(VRING_DESC_F_INDIRECT,
+		    virtio16_to_cpu(dev, vq->vring.desc[0].flags));
+	ut_asserteq(2 * sizeof(struct vring_desc),
+		    virtio32_to_cpu(dev, vq->vring.desc[0].len));
+	ut_asserteq(VRING_DESC_F_NEXT,
+		    virtio16_to_cpu(dev, vq->indirect_desc[0].flags));
+	ut_asserteq(VRING_DESC_F_WRITE,
+		    virtio16_to_cpu(dev, vq->indirect_desc[1].flags));
+	vq->vring.used->idx = 1;
+	vq->vring.used->ring[0].id = 0;
+	vq->vring.used->ring[0].len = 6;
+	ut_asserteq_ptr(buffer, virtqueue_get_buf(vq, &len));
+	ut_asserteq(virtqueue_get_vring_size(vq), vq->num_free);
+	ut_assertok(virtio_del_vqs(dev));
+	__virtio_clear_bit(bus, VIRTIO_RING_F_INDIRECT_DESC);
+
 	return 0;
 }
 DM_TEST(dm_test_virtio_ring, UTF_SCAN_PDATA | UTF_SCAN_FDT);
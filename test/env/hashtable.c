@@ -122,3 +122,43 @@ static int env_test_htab_deletes(struct unit_test_state *uts)
 	return 0;
 }
 ENV_TEST(env_test_htab_deletes, 0);
+
+/* Check that the table counts changes, but not lookups or no-op updates */
+static int env_test_htab_changes(struct unit_test_state *uts)
+{
+	struct hsearch_data htab;
+	struct env_entry item;
+	struct env_entry *ritem;
+	uint changes;
+
+	memset(&htab, 0, sizeof(htab));
+	ut_asserteq(1, hcreate_r(SIZE, &htab));
+
+	item.callback = NULL;
+	item.flags = 0;
+	item.key = "counter";
+	item.data = "1";
+	changes = htab.changes;
+	ut_asserteq(1, hsearch_r(item, ENV_ENTER, &ritem, &htab, 0));
+	ut_assert(htab.changes != changes);
+
+	changes = htab.changes;
+	ut_assert(hsearch_r(item, ENV_FIND, &ritem, &htab, 0));
+	ut_asserteq(changes, htab.changes);
+	ut_assert(hsearch_r(item, ENV_ENTER, &ritem, &htab, 0));
+	ut_asserteq(changes, htab.changes);
+	ut_asserteq_str("1", ritem->data);
+
+	item.data = "2";
+	ut_assert(hsearch_r(item, ENV_ENTER, &ritem, &htab, 0));
+	ut_assert(htab.changes != changes);
+	ut_asserteq_str("2", ritem->data);
+
+	changes = htab.changes;
+	ut_assertok(hdelete_r("counter", &htab, 0));
+	ut_assert(htab.changes != changes);
+
+	hdestroy_r(&htab);
+	return 0;
+}
+ENV_TEST(env_test_htab_changes, 0);
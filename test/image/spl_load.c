@@ -5,11 +5,15 @@
 
 #include <image.h>
 #include <imx_container.h>
+#include <malloc.h>
 #include <mapmem.h>
 #include <memalign.h>
 #include <rand.h>
 #include <spi_flash.h>
 #include <spl.h>
+#include <asm/unaligned.h>
+#include <linux/sizes.h>
+#include <linux/zstd.h>
 #include <test/spl.h>
 #include <test/ut.h>
 #include <u-boot/crc.h>
@@ -657,3 +661,231 @@ int do_spl_test_load(struct unit_test_state *uts, const char *test_name,
 	free(img);
 	return 0;
 }
+
+#if CONFIG_IS_ENABLED(FIT_STREAM)
+/* Size of the data to compress, which is larger than the biggest LZ4 block */
+#define STREAM_DATA_SIZE	0x28000
+/* Window which holds a 64KB LZ4 block, but not the whole image */
+#define STREAM_WINDOW		0x10400
+/* Position and block length of the image on the medium */
+#define STREAM_OFFSET		0x123
+#define STREAM_BL_LEN		0x200
+
+/**
+ * struct stream_img - A compressed image to read
+ *
+ * @comp: Compression type (IH_COMP_...)
+ * @data: Compressed data
+ * @len: Length of @data
+ * @plain: Uncompressed data
+ * @plain_size: Length of @plain
+ * @window: Size of the window to read @data with, smaller than @len
+ * @bl_len: Block length of the medium
+ */
+struct stream_img {
+	int comp;
+	const u8 *data;
+	size_t len;
+	const u8 *plain;
+	size_t plain_size;
+	ulong window;
+	int bl_len;
+};
+
+/* Creates a gzip file with stored blocks, returning its size */
+static size_t stream_gzip(u8 *dst, const u8 *data, size_t size)
+{
+	static const u8 hdr[] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 3 };
+	size_t pos, len;
+	u8 *ptr = dst;
+
+	memcpy(ptr, hdr, sizeof(hdr));
+	ptr += sizeof(hdr);
+	for (pos = 0; pos < size; pos += len) {
+		len = min_t(size_t, size - pos, 0xffff);
+
+		/* BFINAL on the last block, then BTYPE 0 (stored) */
+		*ptr++ = pos + len == size;
+		put_unaligned_le16(len, ptr);
+		put_unaligned_le16(~len, ptr + 2);
+		memcpy(ptr + 4, data + pos, len);
+		ptr += 4 + len;
+	}
+	put_unaligned_le32(crc32(0, data, size), ptr);
+	put_unaligned_le32(size, ptr + 4);
+
+	return ptr + 8 - dst;
+}
+
+/*
+ * Creates an LZ4 frame with blocks of up to 64KB, which are alternately
+ * compressed, holding just literals, and uncompressed. @bd is the block
+ * descriptor, giving the largest block size. Returns the size of the frame
+ */
+static size_t stream_lz4(u8 *dst, const u8 *data, size_t size, u8 bd)
+{
+	size_t pos, len, n;
+	bool raw = false;
+	u8 *ptr = dst;
+	u8 *blk;
+
+	put_unaligned_le32(LZ4F_MAGIC, ptr);
+	ptr[4] = 0x60;		/* version 1, independent blocks */
+	ptr[5] = bd;
+	ptr[6] = 0;		/* header checksum, which is not checked */
+	ptr += 7;
+	for (pos = 0; pos < size; pos += len, raw = !raw) {
+		len = min_t(size_t, size - pos, SZ_64K - SZ_1K);
+		blk = ptr + sizeof(u32);
+		if (raw) {
+			put_unaligned_le32(len | BIT(31), ptr);
+		} else {
+			/* A single sequence, with a length of 15 and more */
+			*blk++ = 0xf0;
+			for (n = len - 15; n >= 255; n -= 255)
+				*blk++ = 255;
+			*blk++ = n;
+			put_unaligned_le32(blk - ptr - sizeof(u32) + len, ptr);
+		}
+		memcpy(blk, data + pos, len);
+		ptr = blk + len;
+	}
+	put_unaligned_le32(0, ptr);
+
+	return ptr + sizeof(u32) - dst;
+}
+
+/* Creates a zstd frame with raw blocks, returning its size */
+static size_t stream_zstd(u8 *dst, const u8 *data, size_t size)
+{
+	size_t pos, len;
+	u8 *ptr = dst;
+	u32 hdr;
+
+	put_unaligned_le32(ZSTD_MAGICNUMBER, ptr);
+	ptr[4] = 0xa0;		/* single segment, 4-byte content size */
+	put_unaligned_le32(size, ptr + 5);
+	ptr += 9;
+	for (pos = 0; pos < size; pos += len) {
+		len = min_t(size_t, size - pos, ZSTD_BLOCKSIZE_MAX);
+
+		/* Last-block flag, block type 0 (raw) and then the size */
+		hdr = len << 3 | (pos + len == size);
+		put_unaligned_le16(hdr, ptr);
+		ptr[2] = hdr >> 16;
+		memcpy(ptr + 3, data + pos, len);
+		ptr += 3 + len;
+	}
+
+	return ptr - dst;
+}
+
+/*
+ * Reads an image with spl_fit_stream_load(), checking that it returns @expect.
+ * If @nomem, the decompressor cannot allocate memory
+ */
+static int check_stream(struct unit_test_state *uts,
+			const struct stream_img *img, int expect, bool nomem)
+{
+	ulong size = img->plain_size + SZ_1K;
+	struct spl_load_info load;
+	u8 *medium, *dst;
+	int ret;
+
+	ut_assert(img->len > img->window);
+	medium = calloc(ALIGN(STREAM_OFFSET + img->len, img->bl_len), 1);
+	ut_assertnonnull(medium);
+	memcpy(medium + STREAM_OFFSET, img->data, img->len);
+	dst = calloc(size, 1);
+	ut_assertnonnull(dst);
+
+	spl_load_init(&load, spl_test_read, medium, img->bl_len);
+	spl_fit_stream_set_window(img->window);
+	/* Only the window can be allocated */
+	if (nomem)
+		malloc_enable_testing(1);
+	ret = spl_fit_stream_load(&load, STREAM_OFFSET, img->len, img->comp,
+				  dst, &size);
+	malloc_disable_testing();
+	spl_fit_stream_set_window(CONFIG_SPL_FIT_STREAM_WINDOW);
+	ut_asserteq(expect, ret);
+
+	if (ret) {
+		/* Nothing is written, so the image can be loaded normally */
+		ut_assertnull(memchr_inv(dst, '\0', img->plain_size));
+	} else {
+		ut_asserteq(img->plain_size, size);
+		ut_asserteq_mem(img->plain, dst, img->plain_size);
+	}
+
+	free(dst);
+	free(medium);
+
+	return 0;
+}
+
+/* Test decompressing each type of image while reading it */
+static int spl_test_fit_stream(struct unit_test_state *uts)
+{
+	struct stream_img img = {
+		.plain_size = STREAM_DATA_SIZE,
+		.window = STREAM_WINDOW,
+		.bl_len = STREAM_BL_LEN,
+	};
+	u8 *plain, *data;
+
+	plain = malloc(STREAM_DATA_SIZE);
+	ut_assertnonnull(plain);
+	data = malloc(STREAM_DATA_SIZE + SZ_4K);
+	ut_assertnonnull(data);
+	generate_data(plain, STREAM_DATA_SIZE, "stream");
+	img.plain = plain;
+	img.data = data;
+
+	if (CONFIG_IS_ENABLED(GZIP)) {
+		img.comp = IH_COMP_GZIP;
+		img.len = stream_gzip(data, plain, STREAM_DATA_SIZE);
+		ut_assertok(check_stream(uts, &img, 0, false));
+		ut_assertok(check_stream(uts, &img, -EAGAIN, true));
+	}
+
+	if (CONFIG_IS_ENABLED(LZ4)) {
+		img.comp = IH_COMP_LZ4;
+		img.len = stream_lz4(data, plain, STREAM_DATA_SIZE, 0x40);
+		ut_assertok(check_stream(uts, &img, 0, false));
+
+		/* A window which cannot hold a block must not be used */
+		img.window = SZ_32K;
+		ut_assertok(check_stream(uts, &img, -EAGAIN, false));
+		img.window = STREAM_WINDOW;
+
+		/* Likewise with blocks of up to 256KB */
+		img.len = stream_lz4(data, plain, STREAM_DATA_SIZE, 0x50);
+		ut_assertok(check_stream(uts, &img, -EAGAIN, false));
+	}
+
+	if (CONFIG_IS_ENABLED(ZSTD)) {
+		img.comp = IH_COMP_ZSTD;
+		img.len = stream_zstd(data, plain, STREAM_DATA_SIZE);
+		ut_assertok(check_stream(uts, &img, 0, false));
+		ut_assertok(check_stream(uts, &img, -EAGAIN, true));
+	}
+	free(data);
+
+	if (CONFIG_IS_ENABLED(LZMA)) {
+		generate_data(plain, SPL_TEST_DATA_SIZE, "lzma");
+		img.comp = IH_COMP_LZMA;
+		img.data = (const u8 *)lzma_compressed;
+		img.len = lzma_compressed_size;
+		img.plain_size = SPL_TEST_DATA_SIZE;
+		img.window = 0x20;
+		img.bl_len = 8;
+		ut_assertok(check_stream(uts, &img, 0, false));
+		ut_assertok(check_stream(uts, &img, -EAGAIN, true));
+	}
+	free(plain);
+
+	return 0;
+}
+SPL_TEST(spl_test_fit_stream, 0);
+#endif /* FIT_STREAM */
@@ -6,6 +6,8 @@
  */
 
 #include <efi_loader.h>
+#include <malloc.h>
+#include <time.h>
 #include <test/lib.h>
 #include <test/test.h>
 #include <test/ut.h>
@@ -61,3 +63,146 @@ static int lib_test_efi_allocate_pages(struct unit_test_state *uts)
 	return 0;
 }
 LIB_TEST(lib_test_efi_allocate_pages, 0);
+
+static int lib_test_efi_memory_map_key(struct unit_test_state *uts)
+{
+	struct efi_mem_desc *map1, *map2;
+	efi_uintn_t size1, size2, key1, key2, desc_size;
+	u32 desc_version;
+	u64 memory;
+
+	/* The key only changes when the map does */
+	ut_asserteq_64(EFI_SUCCESS, efi_get_memory_map_alloc(&size1, &map1));
+	map2 = malloc(size1 + 4 * sizeof(*map2));
+	ut_assertnonnull(map2);
+	ut_asserteq_64(EFI_SUCCESS,
+		       efi_get_memory_map(&size1, map1, &key1, &desc_size,
+					  &desc_version));
+	size2 = size1;
+	ut_asserteq_64(EFI_SUCCESS,
+		       efi_get_memory_map(&size2, map2, &key2, &desc_size,
+					  &desc_version));
+	ut_asserteq(key1, key2);
+	ut_asserteq(size1, size2);
+	ut_asserteq_mem(map1, map2, size1);
+
+	ut_asserteq_64(EFI_SUCCESS,
+		       efi_allocate_pages(EFI_ALLOCATE_ANY_PAGES,
+					  EFI_ACPI_RECLAIM_MEMORY, 1, &memory));
+	size2 = size1 + 4 * sizeof(*map2);
+	ut_asserteq_64(EFI_SUCCESS,
+		       efi_get_memory_map(&size2, map2, &key2, &desc_size,
+					  &desc_version));
+	ut_assert(key1 != key2);
+	ut_asserteq_64(EFI_SUCCESS, efi_free_pages(memory, 1));
+
+	/* The map is back as it was, with a new key */
+	key1 = key2;
+	size2 = size1 + 4 * sizeof(*map2);
+	ut_asserteq_64(EFI_SUCCESS,
+		       efi_get_memory_map(&size2, map2, &key2, &desc_size,
+					  &desc_version));
+	ut_assert(key1 != key2);
+	ut_asserteq(size1, size2);
+	ut_asserteq_mem(map1, map2, size1);
+
+	free(map2);
+	efi_free_pool(map1);
+
+	return 0;
+}
+LIB_TEST(lib_test_efi_memory_map_key, 0);
+
+/* Number of allocations in the trace replayed by lib_test_efi_pool_trace() */
+#define POOL_TRACE_LEN	4000
+
+/* Returns the size of the next allocation in the trace */
+static efi_uintn_t pool_trace_size(u32 *seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+
+	/* Mostly handles, device paths and strings, a few larger buffers */
+	switch ((*seed >> 16) % 32) {
+	case 0:
+		return 0x1000 + (*seed >> 8) % 0x3000;
+	case 1 ... 4:
+		return 0x200 + (*seed >> 8) % 0x600;
+	default:
+		return 8 + (*seed >> 8) % 0xf8;
+	}
+}
+
+/* Returns the number of entries in the memory map */
+static int pool_trace_map_entries(struct unit_test_state *uts)
+{
+	efi_uintn_t map_size = 0;
+
+	ut_asserteq_64(EFI_BUFFER_TOO_SMALL,
+		       efi_get_memory_map(&map_size, NULL, NULL, NULL, NULL));
+
+	return map_size / sizeof(struct efi_mem_desc);
+}
+
+/*
+ * Replay a trace of pool allocations like those made while booting, where
+ * about half of the blocks are freed again soon after being allocated
+ */
+static int lib_test_efi_pool_trace(struct unit_test_state *uts)
+{
+	static u8 *bufs[POOL_TRACE_LEN];
+	static efi_uintn_t sizes[POOL_TRACE_LEN];
+	int start_entries, peak_entries;
+	ulong start, alloc_us, free_us;
+	u32 seed = 1;
+	int live = 0;
+	int i, j;
+
+	start_entries = pool_trace_map_entries(uts);
+
+	start = timer_get_us();
+	for (i = 0; i < POOL_TRACE_LEN; i++) {
+		sizes[i] = pool_trace_size(&seed);
+		ut_asserteq_64(EFI_SUCCESS,
+			       efi_allocate_pool(EFI_BOOT_SERVICES_DATA,
+						 sizes[i], (void **)&bufs[i]));
+		ut_assertnonnull(bufs[i]);
+		ut_asserteq(0, (uintptr_t)bufs[i] & 7);
+		memset(bufs[i], i, sizes[i]);
+		live++;
+
+		/* Free an earlier block every other time */
+		if (i & 1) {
+			j = (seed >> 4) % (i + 1);
+			if (bufs[j]) {
+				ut_asserteq((u8)j, bufs[j][0]);
+				ut_asserteq((u8)j, bufs[j][sizes[j] - 1]);
+				ut_asserteq_64(EFI_SUCCESS, efi_free_pool(bufs[j]));
+				bufs[j] = NULL;
+				live--;
+			}
+		}
+	}
+	alloc_us = timer_get_us() - start;
+	peak_entries = pool_trace_map_entries(uts);
+
+	start = timer_get_us();
+	for (i = 0; i < POOL_TRACE_LEN; i++) {
+		if (!bufs[i])
+			continue;
+		ut_asserteq((u8)i, bufs[i][0]);
+		ut_asserteq((u8)i, bufs[i][sizes[i] - 1]);
+		ut_asserteq_64(EFI_SUCCESS, efi_free_pool(bufs[i]));
+		bufs[i] = NULL;
+	}
+	free_us = timer_get_us() - start;
+
+	printf("%d allocations, %d live: alloc %lu us, free %lu us, map entries %d -> %d\n",
+	       POOL_TRACE_LEN, live, alloc_us, free_us, start_entries,
+	       peak_entries);
+
+	/* Everything must have been given back */
+	ut_asserteq(start_entries, pool_trace_map_entries(uts));
+
+	return 0;
+}
+LIB_TEST(lib_test_efi_pool_trace, 0);
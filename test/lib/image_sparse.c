@@ -0,0 +1,152 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests for writing Android sparse images
+ *
+ * An image is written in one go with write_sparse_image() and then again
+ * with sparse_stream_write(), in pieces of random sizes which do not line up
+ * with its headers or chunks. Both must give the same result.
+ */
+
+#include <image-sparse.h>
+#include <rand.h>
+#include <sparse_format.h>
+#include <test/lib.h>
+#include <test/ut.h>
+
+/* Block size of the storage, which is half the block size of the image */
+#define STORAGE_BLKSZ	512
+#define STORAGE_BLKS	32
+#define IMAGE_BLKSZ	1024
+/* Value of storage which the image does not write to */
+#define UNWRITTEN	0xa5
+#define FILL_VAL	0x12345678
+
+static u8 image[0x2000];
+static u8 storage[STORAGE_BLKSZ * STORAGE_BLKS];
+static u8 expect[STORAGE_BLKSZ * STORAGE_BLKS];
+
+static lbaint_t mock_write(struct sparse_storage *info, lbaint_t blk,
+			   lbaint_t blkcnt, const void *buffer)
+{
+	memcpy(info->priv + blk * info->blksz, buffer, blkcnt * info->blksz);
+
+	return blkcnt;
+}
+
+static lbaint_t mock_reserve(struct sparse_storage *info, lbaint_t blk,
+			     lbaint_t blkcnt)
+{
+	return blkcnt;
+}
+
+static void mock_init(struct sparse_storage *info)
+{
+	memset(info, '\0', sizeof(*info));
+	info->blksz = STORAGE_BLKSZ;
+	info->size = STORAGE_BLKS;
+	info->priv = storage;
+	info->write = mock_write;
+	info->reserve = mock_reserve;
+	memset(storage, UNWRITTEN, sizeof(storage));
+}
+
+/* Adds a chunk to the image, returning the next free byte */
+static u8 *add_chunk(u8 *ptr, u16 type, u32 blks, const void *data,
+		     u32 data_sz)
+{
+	chunk_header_t chunk;
+
+	chunk.chunk_type = cpu_to_le16(type);
+	chunk.reserved1 = 0;
+	chunk.chunk_sz = cpu_to_le32(blks);
+	chunk.total_sz = cpu_to_le32(sizeof(chunk) + data_sz);
+	memcpy(ptr, &chunk, sizeof(chunk));
+	ptr += sizeof(chunk);
+	memcpy(ptr, data, data_sz);
+
+	return ptr + data_sz;
+}
+
+/*
+ * Builds an image with a chunk of each type, filling @expect with what it
+ * should write. Returns the size of the image
+ */
+static size_t build_image(void)
+{
+	u8 raw[IMAGE_BLKSZ * 3];
+	sparse_header_t hdr;
+	u32 fill = cpu_to_le32(FILL_VAL);
+	u8 *ptr = image;
+	int i;
+
+	for (i = 0; i < sizeof(raw); i++)
+		raw[i] = i * 7 + (i >> 8);
+
+	hdr.magic = cpu_to_le32(SPARSE_HEADER_MAGIC);
+	hdr.major_version = cpu_to_le16(1);
+	hdr.minor_version = 0;
+	hdr.file_hdr_sz = cpu_to_le16(sizeof(hdr));
+	hdr.chunk_hdr_sz = cpu_to_le16(sizeof(chunk_header_t));
+	hdr.blk_sz = cpu_to_le32(IMAGE_BLKSZ);
+	hdr.total_blks = cpu_to_le32(7);
+	hdr.total_chunks = cpu_to_le32(5);
+	hdr.image_checksum = 0;
+	memcpy(ptr, &hdr, sizeof(hdr));
+	ptr += sizeof(hdr);
+
+	ptr = add_chunk(ptr, CHUNK_TYPE_RAW, 3, raw, sizeof(raw));
+	ptr = add_chunk(ptr, CHUNK_TYPE_FILL, 2, &fill, sizeof(fill));
+	ptr = add_chunk(ptr, CHUNK_TYPE_DONT_CARE, 1, NULL, 0);
+	ptr = add_chunk(ptr, CHUNK_TYPE_CRC32, 0, &fill, sizeof(fill));
+	ptr = add_chunk(ptr, CHUNK_TYPE_RAW, 1, raw + 5, IMAGE_BLKSZ);
+
+	memset(expect, UNWRITTEN, sizeof(expect));
+	memcpy(expect, raw, sizeof(raw));
+	for (i = 0; i < IMAGE_BLKSZ * 2; i += sizeof(fill))
+		memcpy(expect + sizeof(raw) + i, &fill, sizeof(fill));
+	memcpy(expect + IMAGE_BLKSZ * 6, raw + 5, IMAGE_BLKSZ);
+
+	return ptr - image;
+}
+
+/* Test writing a sparse image in pieces of random sizes */
+static int lib_test_sparse_stream(struct unit_test_state *uts)
+{
+	struct sparse_storage info;
+	struct sparse_stream ss;
+	char response[64];
+	size_t size, pos, len;
+	int seed;
+
+	size = build_image();
+
+	/* Write it in one go */
+	mock_init(&info);
+	ut_assertok(write_sparse_image(&info, "test", image, response));
+	ut_assertok(memcmp(expect, storage, sizeof(storage)));
+
+	for (seed = 1; seed <= 20; seed++) {
+		srand(seed);
+		mock_init(&info);
+		sparse_stream_init(&ss, &info, "test");
+		for (pos = 0; pos < size; pos += len) {
+			/* Mostly small pieces, sometimes whole blocks */
+			len = rand() % 8 ? rand() % 100 + 1 :
+				rand() % (IMAGE_BLKSZ * 2) + 1;
+			len = min(len, size - pos);
+			ut_assertok(sparse_stream_write(&ss, image + pos, len,
+							response));
+		}
+		ut_assertok(sparse_stream_finish(&ss, response));
+		ut_assertok(memcmp(expect, storage, sizeof(storage)));
+	}
+
+	/* An image which stops early is incomplete */
+	mock_init(&info);
+	sparse_stream_init(&ss, &info, "test");
+	ut_assertok(sparse_stream_write(&ss, image, size - 1, response));
+	ut_asserteq(-1, sparse_stream_finish(&ss, response));
+
+	return 0;
+}
+LIB_TEST(lib_test_sparse_stream, 0);
@@ -0,0 +1,136 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests for the CRC32 and CRC32C engines
+ */
+
+#include <malloc.h>
+#include <time.h>
+#include <test/lib.h>
+#include <test/ut.h>
+#include <u-boot/crc.h>
+#include <linux/sizes.h>
+
+#define CRC32_POLY	0xedb88320
+#define CRC32C_POLY	0x82f63b78
+
+/* Size of the buffer used for checking and benchmarking */
+#define CRC_BUF_SIZE	SZ_64K
+
+/* Number of random lengths and alignments to check */
+#define CRC_CHECKS	200
+
+static const char *const engine_name[CRC32_ENGINE_COUNT] = {
+	"table", "slice-by-8", "hardware",
+};
+
+/* Works out a CRC one bit at a time, as a reference */
+static u32 crc_bitwise(u32 poly, u32 crc, const u8 *buf, uint len)
+{
+	int i;
+
+	while (len--) {
+		crc ^= *buf++;
+		for (i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ (crc & 1 ? poly : 0);
+	}
+
+	return crc;
+}
+
+static u8 *crc_test_buf(u32 *seed)
+{
+	u8 *buf;
+	int i;
+
+	buf = malloc(CRC_BUF_SIZE);
+	if (buf) {
+		for (i = 0; i < CRC_BUF_SIZE; i++) {
+			*seed = *seed * 1103515245 + 12345;
+			buf[i] = *seed >> 16;
+		}
+	}
+
+	return buf;
+}
+
+/* Check that every engine gives the same result as the reference */
+static int lib_crc32_engines(struct unit_test_state *uts)
+{
+	static const char str[] = "123456789";
+	u32 seed = 1, expect;
+	uint start, len;
+	u8 *buf;
+	int i, e;
+
+	/* Check values for the two polynomials */
+	ut_asserteq(0xcbf43926, crc32(0, str, 9));
+	if (IS_ENABLED(CONFIG_CRC32C))
+		ut_asserteq(0xe3069283,
+			    ~crc32c_engine_cal(CRC32_ENGINE_TABLE, ~0, str, 9));
+
+	buf = crc_test_buf(&seed);
+	ut_assertnonnull(buf);
+	for (i = 0; i < CRC_CHECKS; i++) {
+		seed = seed * 1103515245 + 12345;
+		start = (seed >> 8) & 15;
+		seed = seed * 1103515245 + 12345;
+		len = (seed >> 8) % (i < CRC_CHECKS / 2 ? 64 : 4096);
+
+		expect = crc_bitwise(CRC32_POLY, seed, buf + start, len);
+		ut_asserteq(expect, crc32_no_comp(seed, buf + start, len));
+		for (e = 0; e < CRC32_ENGINE_COUNT; e++) {
+			ut_asserteq(expect,
+				    crc32_engine_no_comp(e, seed, buf + start,
+							 len));
+		}
+
+		if (!IS_ENABLED(CONFIG_CRC32C))
+			continue;
+		expect = crc_bitwise(CRC32C_POLY, seed, buf + start, len);
+		for (e = 0; e < CRC32_ENGINE_COUNT; e++) {
+			ut_asserteq(expect,
+				    crc32c_engine_cal(e, seed, buf + start,
+						      len));
+		}
+	}
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_crc32_engines, 0);
+
+/* Show how fast each engine which is present is */
+static int lib_crc32_bench(struct unit_test_state *uts)
+{
+	ulong start, us;
+	u32 seed = 1;
+	u8 *buf;
+	int i, e;
+
+	buf = crc_test_buf(&seed);
+	ut_assertnonnull(buf);
+	for (e = 0; e < CRC32_ENGINE_COUNT; e++) {
+		if (!crc32_engine_present(e))
+			continue;
+		start = timer_get_us();
+		for (i = 0; i < 16; i++)
+			seed = crc32_engine_no_comp(e, seed, buf, CRC_BUF_SIZE);
+		us = timer_get_us() - start;
+		printf("crc32  %-10s %lu MB/s\n", engine_name[e],
+		       us ? 16UL * CRC_BUF_SIZE / us : 0);
+	}
+	for (e = 0; IS_ENABLED(CONFIG_CRC32C) && e < CRC32_ENGINE_COUNT; e++) {
+		if (!crc32c_engine_present(e))
+			continue;
+		start = timer_get_us();
+		for (i = 0; i < 16; i++)
+			seed = crc32c_engine_cal(e, seed, buf, CRC_BUF_SIZE);
+		us = timer_get_us() - start;
+		printf("crc32c %-10s %lu MB/s\n", engine_name[e],
+		       us ? 16UL * CRC_BUF_SIZE / us : 0);
+	}
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_crc32_bench, 0);
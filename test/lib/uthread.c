@@ -144,3 +144,82 @@ static int uthread_mutex(struct unit_test_state *uts)
 	return 0;
 }
 LIB_TEST(uthread_mutex, 0);
+
+/* A work item which increments a counter five times, yielding in between */
+static void wq_work(void *arg)
+{
+	int *countp = arg;
+	int i;
+
+	for (i = 0; i < 5; i++) {
+		(*countp)++;
+		uthread_schedule();
+	}
+}
+
+/*
+ * uthread_wq() - testing the uthread work queue API
+ *
+ * This submits three work items to a work queue with two workers, so the
+ * third item has to wait until a worker is free. That item is cancelled and
+ * then submitted again once the first two are done, to check that the
+ * workers keep running until the work queue is destroyed.
+ */
+static int uthread_wq(struct unit_test_state *uts)
+{
+	struct uthread_work work[3];
+	struct uthread_wq wq;
+	int count[3] = { 0 };
+	int id;
+	int i;
+
+	id = uthread_grp_new_id();
+	ut_assert(id != 0);
+	ut_asserteq(-EINVAL, uthread_wq_init(&wq, 0, 0));
+	ut_assertok(uthread_wq_init(&wq, 2, 0));
+	for (i = 0; i < 3; i++) {
+		uthread_work_init(&work[i], wq_work, &count[i], id);
+		ut_assertok(uthread_wq_submit(&wq, &work[i]));
+	}
+	ut_asserteq(-EBUSY, uthread_wq_submit(&wq, &work[0]));
+
+	/*
+	 * The first worker picks up the first item, which schedules the second
+	 * worker, which picks up the second item and schedules back to the
+	 * main thread
+	 */
+	ut_assert(uthread_schedule());
+	ut_asserteq(1, count[0]);
+	ut_asserteq(1, count[1]);
+	ut_asserteq(0, count[2]);
+	ut_asserteq(UTHREAD_WORK_RUNNING, work[0].state);
+	ut_asserteq(UTHREAD_WORK_PENDING, work[2].state);
+	ut_assert(!uthread_wq_grp_done(&wq, id));
+
+	/* Only the item which has not started yet can be cancelled */
+	ut_asserteq(-EBUSY, uthread_work_cancel(&work[0]));
+	ut_assertok(uthread_work_cancel(&work[2]));
+	ut_asserteq(-EALREADY, uthread_work_cancel(&work[2]));
+
+	uthread_wq_grp_wait(&wq, id);
+	ut_assert(uthread_wq_grp_done(&wq, id));
+	ut_asserteq(5, count[0]);
+	ut_asserteq(5, count[1]);
+	ut_asserteq(0, count[2]);
+
+	/* Idle workers are parked, so they are not scheduled */
+	ut_assert(!uthread_schedule());
+
+	/* The workers are still there to run more work */
+	ut_assertok(uthread_wq_submit(&wq, &work[2]));
+	uthread_work_wait(&work[2]);
+	ut_asserteq(UTHREAD_WORK_IDLE, work[2].state);
+	ut_asserteq(5, count[2]);
+
+	/* Once the work queue is destroyed, no thread is left */
+	uthread_wq_destroy(&wq);
+	ut_assert(!uthread_schedule());
+
+	return 0;
+}
+LIB_TEST(uthread_wq, 0);
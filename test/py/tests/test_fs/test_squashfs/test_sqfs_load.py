@@ -2,6 +2,7 @@
 # Copyright (C) 2020 Bootlin
 # Author: Joao Marcos Costa <joaomarcos.costa@bootlin.com>
 
+import hashlib
 import os
 import subprocess
 import pytest
@@ -92,6 +93,30 @@ def sqfs_load_files_at_subdir(ubman):
     address = '$kernel_addr_r'
     sqfs_load_files(ubman, files, sizes, address)
 
+def sqfs_load_files_at_offset(ubman):
+    """ Loads the tail of files and asserts their checksums.
+
+    This test checks that a read can start at a given position in the file,
+    both in a data block and in a fragment.
+
+    Args:
+        ubman: provides the means to interact with U-Boot's console.
+    """
+    build_dir = ubman.config.build_dir
+    address = '$kernel_addr_r'
+    for (file, pos, size) in [('f4096', 1000, 3096), ('f5096', 4096, 1000),
+                              ('f1000', 999, 1)]:
+        out = ubman.run_command('sqfsload host 0 {} {} {:x} {:x}'.format(
+            address, file, size, pos))
+        assert '{} bytes read'.format(size) in out
+
+        original_file_path = os.path.join(build_dir, SQFS_SRC_DIR + '/' + file)
+        with open(original_file_path, 'rb') as fd:
+            fd.seek(pos)
+            original_checksum = hashlib.md5(fd.read(size)).hexdigest()
+        u_boot_checksum = uboot_md5sum(ubman, address, hex(size))
+        assert u_boot_checksum == original_checksum
+
 def sqfs_load_non_existent_file(ubman):
     """ Calls sqfs_load_files passing an non-existent file to raise an error.
 
@@ -114,6 +139,7 @@ def sqfs_run_all_load_tests(ubman):
     """
     sqfs_load_files_at_root(ubman)
     sqfs_load_files_at_subdir(ubman)
+    sqfs_load_files_at_offset(ubman)
     sqfs_load_non_existent_file(ubman)
 
 @pytest.mark.boardspec('sandbox')
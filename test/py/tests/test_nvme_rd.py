@@ -0,0 +1,83 @@
+# SPDX-License-Identifier: GPL-2.0+
+
+"""
+Test U-Boot's "nvme read" command and report the read throughput
+
+This reads a region of an NVMe namespace through the block layer, checks that
+no errors occurred and, if the configuration gives a CRC, that the expected
+data was read. The time taken is logged as a throughput figure, so the test
+doubles as a benchmark of the NVMe read path. It can be run on QEMU, e.g. with
+qemu-x86_64 or qemu_arm64 and these extra QEMU arguments:
+
+    -drive file=nvme.img,if=none,format=raw,id=nvm
+    -device nvme,serial=deadbeef,drive=nvm
+
+This test relies on boardenv_* to contain configuration values to define
+which regions should be read. For example:
+
+env__nvme_rd_configs = (
+    {
+        'fixture_id': 'nvme-kernel',
+        'devid': 0,
+        'sector': 0x800,
+        'count': 0x20000,
+        'crc32': '6d3a7b21',
+        'min_rate': 500,
+    },
+)
+
+'count' is in blocks of the namespace's block size, 512 bytes unless
+'blksz' is given. 'min_rate' is optional and is the lowest acceptable read
+rate in MiB/s.
+"""
+
+import pytest
+import time
+import utils
+
+@pytest.mark.buildconfigspec('cmd_nvme')
+def test_nvme_rd(ubman, env__nvme_rd_config):
+    """Test the "nvme read" command and measure how fast it is
+
+    Args:
+        ubman: A U-Boot console connection.
+        env__nvme_rd_config: The single NVMe configuration on which to run
+            the test. See the file-level comment above for details of the
+            format.
+    """
+    devid = env__nvme_rd_config.get('devid', 0)
+    sector = env__nvme_rd_config.get('sector', 0)
+    count = env__nvme_rd_config.get('count', 1)
+    blksz = env__nvme_rd_config.get('blksz', 512)
+    expected_crc32 = env__nvme_rd_config.get('crc32', None)
+    min_rate = env__nvme_rd_config.get('min_rate', 0)
+
+    count_bytes = count * blksz
+    bcfg = ubman.config.buildconfig
+    has_cmd_crc32 = bcfg.get('config_cmd_crc32', 'n') == 'y'
+    addr = '0x%08x' % utils.find_ram_base(ubman)
+
+    ubman.run_command('nvme scan')
+    response = ubman.run_command('nvme device %d' % devid)
+    assert 'is now current device' in response
+
+    cmd = 'nvme read %s %x %x' % (addr, sector, count)
+    tstart = time.time()
+    response = ubman.run_command(cmd)
+    tend = time.time()
+    assert '%d blocks read: OK' % count in response
+
+    if expected_crc32:
+        if has_cmd_crc32:
+            response = ubman.run_command('crc32 %s 0x%x' % (addr, count_bytes))
+            assert expected_crc32 in response
+        else:
+            ubman.log.warning('CONFIG_CMD_CRC32 != y: Skipping check')
+
+    # This includes the console round trip, so is a lower bound
+    elapsed = tend - tstart
+    rate = count_bytes / elapsed / (1 << 20)
+    ubman.log.info('Reading %d bytes took %f seconds: %.1f MiB/s' %
+                   (count_bytes, elapsed, rate))
+    if min_rate:
+        assert rate >= min_rate
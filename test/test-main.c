@@ -16,6 +16,7 @@
 #include <os.h>
 #include <spl.h>
 #include <usb.h>
+#include <dm/device-internal.h>
 #include <dm/ofnode.h>
 #include <dm/root.h>
 #include <dm/test.h>
@@ -112,6 +113,9 @@ static int dm_test_pre_run(struct unit_test_state *uts)
 				       fdt_totalsize(gd->fdt_blob));
 	gd->dm_root = NULL;
 	malloc_disable_testing();
+
+	/* Tests expect every device to be bound, in device tree order */
+	dm_lazy_enable(false);
 	if (CONFIG_IS_ENABLED(UT_DM) && !CONFIG_IS_ENABLED(OF_PLATDATA))
 		memset(dm_testdrv_op_count, '\0', sizeof(dm_testdrv_op_count));
 	arch_reset_for_test();
@@ -129,6 +133,8 @@ static int dm_test_post_run(struct unit_test_state *uts)
 {
 	int id;
 
+	dm_lazy_enable(true);
+
 	if (gd->fdt_blob) {
 		switch (fdt_action()) {
 		case FDTCHK_COPY: